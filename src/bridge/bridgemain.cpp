@@ -1746,6 +1746,22 @@ BRIDGE_IMPEXP void GuiShowReferences()
     _gui_sendmessage(GUI_SHOW_REF, 0, 0);
 }
 
+BRIDGE_IMPEXP void GuiReferenceSetCellContents(const CELLINFO* cells, int count)
+{
+    _gui_sendmessage(GUI_REF_SETCELLCONTENTS, (void*)cells, (void*)(duint)count);
+}
+
+BRIDGE_IMPEXP void GuiUpdateWatchValues(const WATCHINFO* watches, int count)
+{
+    CHECK_GUI_UPDATE_DISABLED
+    _gui_sendmessage(GUI_UPDATE_WATCH_VALUES, (void*)watches, (void*)(duint)count);
+}
+
+BRIDGE_IMPEXP void GuiReferenceSetColumnType(int col, REFCOLUMNTYPE type)
+{
+    _gui_sendmessage(GUI_REF_SETCOLUMNTYPE, (void*)(duint)col, (void*)(duint)type);
+}
+
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
     hInst = hinstDLL;
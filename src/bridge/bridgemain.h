@@ -1036,6 +1036,7 @@ BRIDGE_IMPEXP bool DbgWinEventGlobal(MSG* message);
 BRIDGE_IMPEXP bool DbgIsRunning();
 BRIDGE_IMPEXP duint DbgGetTimeWastedCounter();
 BRIDGE_IMPEXP ARGTYPE DbgGetArgTypeAt(duint addr);
+// Copy of the encode types of a segment (a byte per address), changes are stored when it is released with DbgReleaseEncodeTypeBuffer
 BRIDGE_IMPEXP void* DbgGetEncodeTypeBuffer(duint addr, duint* size);
 BRIDGE_IMPEXP void DbgReleaseEncodeTypeBuffer(void* buffer);
 BRIDGE_IMPEXP ENCODETYPE DbgGetEncodeTypeAt(duint addr, duint size);
@@ -1197,8 +1198,18 @@ typedef enum
     GUI_INVALIDATE_SYMBOL_SOURCE,   // param1=duint base,           param2=unused
     GUI_GET_CURRENT_GRAPH,          // param1=BridgeCFGraphList*,   param2=unused
     GUI_SHOW_REF,                   // param1=unused,               param2=unused
+    GUI_REF_SETCELLCONTENTS,        // param1=(const CELLINFO*)cells, param2=int count
+    GUI_UPDATE_WATCH_VALUES,        // param1=(const WATCHINFO*)watches, param2=int count
+    GUI_REF_SETCOLUMNTYPE,          // param1=int col,              param2=REFCOLUMNTYPE type
 } GUIMSG;
 
+typedef enum
+{
+    REF_COLUMN_TEXT,
+    REF_COLUMN_DECIMAL, // cell text is a decimal number, sorted numerically
+    REF_COLUMN_HEX // cell text is a hexadecimal number, sorted numerically
+} REFCOLUMNTYPE;
+
 //GUI Typedefs
 struct _TYPEDESCRIPTOR;
 
@@ -1378,6 +1389,9 @@ BRIDGE_IMPEXP void GuiInvalidateSymbolSource(duint base);
 BRIDGE_IMPEXP void GuiExecuteOnGuiThreadEx(GUICALLBACKEX cbGuiThread, void* userdata);
 BRIDGE_IMPEXP void GuiGetCurrentGraph(BridgeCFGraphList* graphList);
 BRIDGE_IMPEXP void GuiShowReferences();
+BRIDGE_IMPEXP void GuiReferenceSetCellContents(const CELLINFO* cells, int count);
+BRIDGE_IMPEXP void GuiUpdateWatchValues(const WATCHINFO* watches, int count);
+BRIDGE_IMPEXP void GuiReferenceSetColumnType(int col, REFCOLUMNTYPE type);
 
 #ifdef __cplusplus
 }
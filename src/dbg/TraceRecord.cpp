@@ -13,6 +13,86 @@
 
 TraceRecordManager TraceRecord;
 
+// PackBits: header n < 128 is followed by n + 1 literal bytes, n > 128 by a byte repeated 257 - n times
+static void PackPage(const unsigned char* data, size_t size, std::vector<unsigned char> & packed)
+{
+    packed.clear();
+    for(size_t i = 0; i < size;)
+    {
+        size_t run = 1;
+        while(i + run < size && run < 128 && data[i + run] == data[i])
+            run++;
+        if(run > 2)
+        {
+            packed.push_back((unsigned char)(257 - run));
+            packed.push_back(data[i]);
+            i += run;
+            continue;
+        }
+        auto start = i++;
+        while(i < size && i - start < 128 && !(i + 2 < size && data[i] == data[i + 1] && data[i] == data[i + 2]))
+            i++;
+        packed.push_back((unsigned char)(i - start - 1));
+        packed.insert(packed.end(), data + start, data + i);
+    }
+    packed.shrink_to_fit();
+}
+
+static bool UnpackPage(const std::vector<unsigned char> & packed, unsigned char* data, size_t size)
+{
+    size_t out = 0;
+    for(size_t i = 0; i < packed.size();)
+    {
+        auto header = packed[i++];
+        if(header < 128)
+        {
+            size_t count = header + 1;
+            if(i + count > packed.size() || out + count > size)
+                return false;
+            memcpy(data + out, packed.data() + i, count);
+            i += count;
+            out += count;
+        }
+        else if(header > 128)
+        {
+            size_t count = 257 - header;
+            if(i >= packed.size() || out + count > size)
+                return false;
+            memset(data + out, packed[i++], count);
+            out += count;
+        }
+    }
+    return out == size;
+}
+
+// Reads without unpacking the whole page, cold pages are only decompressed when they are written
+static bool UnpackPageRange(const std::vector<unsigned char> & packed, size_t offset, unsigned char* dest, size_t size)
+{
+    size_t pos = 0;
+    for(size_t i = 0; i < packed.size() && size;)
+    {
+        auto header = packed[i++];
+        size_t count = header < 128 ? header + 1 : 257 - header;
+        if(header == 128)
+            continue;
+        if(offset < pos + count)
+        {
+            auto skip = offset - pos;
+            auto n = min(count - skip, size);
+            if(header < 128)
+                memcpy(dest, packed.data() + i + skip, n);
+            else
+                memset(dest, packed[i], n);
+            dest += n;
+            offset += n;
+            size -= n;
+        }
+        pos += count;
+        i += header < 128 ? count : 1;
+    }
+    return size == 0;
+}
+
 TraceRecordManager::TraceRecordManager()
 {
     ModuleNames.emplace_back("");
@@ -27,10 +107,122 @@ void TraceRecordManager::clear()
 {
     EXCLUSIVE_ACQUIRE(LockTraceRecord);
     for(auto i = TraceRecord.begin(); i != TraceRecord.end(); ++i)
-        efree(i->second.rawPtr, "TraceRecordManager");
+        freePage(i->second);
     TraceRecord.clear();
     ModuleNames.clear();
     ModuleNames.emplace_back("");
+    hotBytes = 0;
+    useCounter = 0;
+}
+
+void TraceRecordManager::setMemoryBudget(duint bytes)
+{
+    EXCLUSIVE_ACQUIRE(LockTraceRecord);
+    memoryBudget = bytes;
+    trimMemory();
+}
+
+TraceRecordManager::MemoryStats TraceRecordManager::getMemoryStats()
+{
+    SHARED_ACQUIRE(LockTraceRecord);
+    MemoryStats stats = {};
+    stats.pages = TraceRecord.size();
+    for(const auto & i : TraceRecord)
+    {
+        if(i.second.rawPtr)
+            stats.hotPages++;
+        else
+        {
+            stats.coldPages++;
+            stats.coldBytes += i.second.packed.size();
+        }
+        stats.rawBytes += getPageSize(i.second.dataType);
+    }
+    stats.hotBytes = hotBytes;
+    stats.budget = memoryBudget;
+    stats.compressions = compressions;
+    stats.decompressions = decompressions;
+    return stats;
+}
+
+size_t TraceRecordManager::getPageSize(TraceRecordType type)
+{
+    switch(type)
+    {
+    case TraceRecordType::TraceRecordBitExec:
+        return 4096 / 8;
+    case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
+        return 4096;
+    case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
+        return 4096 * 2;
+    default:
+        return 0;
+    }
+}
+
+// LockTraceRecord has to be held exclusively, makes the page hot
+void* TraceRecordManager::getPageData(TraceRecordPage & page)
+{
+    page.lastUse = ++useCounter;
+    if(page.rawPtr)
+        return page.rawPtr;
+    auto size = getPageSize(page.dataType);
+    page.rawPtr = emalloc(size, "TraceRecordManager");
+    if(!UnpackPage(page.packed, (unsigned char*)page.rawPtr, size))
+        memset(page.rawPtr, 0, size);
+    std::vector<unsigned char>().swap(page.packed);
+    hotBytes += size;
+    decompressions++;
+    trimMemory();
+    return page.rawPtr;
+}
+
+bool TraceRecordManager::readPageData(const TraceRecordPage & page, size_t offset, void* dest, size_t size) const
+{
+    if(page.rawPtr)
+    {
+        memcpy(dest, (unsigned char*)page.rawPtr + offset, size);
+        return true;
+    }
+    return UnpackPageRange(page.packed, offset, (unsigned char*)dest, size);
+}
+
+void TraceRecordManager::freePage(TraceRecordPage & page)
+{
+    if(page.rawPtr)
+    {
+        hotBytes -= getPageSize(page.dataType);
+        efree(page.rawPtr, "TraceRecordManager");
+        page.rawPtr = nullptr;
+    }
+    std::vector<unsigned char>().swap(page.packed);
+}
+
+// Compresses the least recently used pages until the hot pages use 3/4 of the budget, the most recent page stays hot
+void TraceRecordManager::trimMemory()
+{
+    if(!memoryBudget || hotBytes <= memoryBudget)
+        return;
+    std::vector<TraceRecordPage*> hotPages;
+    for(auto & i : TraceRecord)
+        if(i.second.rawPtr && i.second.lastUse != useCounter)
+            hotPages.push_back(&i.second);
+    std::sort(hotPages.begin(), hotPages.end(), [](const TraceRecordPage * a, const TraceRecordPage * b)
+    {
+        return a->lastUse < b->lastUse;
+    });
+    auto target = memoryBudget - memoryBudget / 4;
+    for(auto page : hotPages)
+    {
+        if(hotBytes <= target)
+            break;
+        auto size = getPageSize(page->dataType);
+        PackPage((unsigned char*)page->rawPtr, size, page->packed);
+        efree(page->rawPtr, "TraceRecordManager");
+        page->rawPtr = nullptr;
+        hotBytes -= size;
+        compressions++;
+    }
 }
 
 bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType type)
@@ -44,24 +236,13 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
         {
             TraceRecordPage newPage;
             char modName[MAX_MODULE_SIZE];
-            switch(type)
-            {
-            case TraceRecordBitExec:
-                newPage.rawPtr = emalloc(4096 / 8, "TraceRecordManager");
-                memset(newPage.rawPtr, 0, 4096 / 8);
-                break;
-            case TraceRecordByteWithExecTypeAndCounter:
-                newPage.rawPtr = emalloc(4096, "TraceRecordManager");
-                memset(newPage.rawPtr, 0, 4096);
-                break;
-            case TraceRecordWordWithExecTypeAndCounter:
-                newPage.rawPtr = emalloc(4096 * 2, "TraceRecordManager");
-                memset(newPage.rawPtr, 0, 4096 * 2);
-                break;
-            default:
+            auto size = getPageSize(type);
+            if(!size)
                 return false;
-            }
+            newPage.rawPtr = emalloc(size, "TraceRecordManager");
+            memset(newPage.rawPtr, 0, size);
             newPage.dataType = type;
+            newPage.lastUse = ++useCounter;
             if(ModNameFromAddr(pageAddress, modName, true))
             {
                 newPage.rva = pageAddress - ModBaseFromAddr(pageAddress);
@@ -76,6 +257,8 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
                 efree(newPage.rawPtr);
                 return false;
             }
+            hotBytes += size;
+            trimMemory();
             return true;
         }
         else
@@ -87,7 +270,7 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
         {
             if(pageInfo != TraceRecord.end())
             {
-                efree(pageInfo->second.rawPtr, "TraceRecordManager");
+                freePage(pageInfo->second);
                 TraceRecord.erase(pageInfo);
             }
             return true;
@@ -117,10 +300,7 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
     auto pageInfoIterator = TraceRecord.find(ModHashFromAddr(base));
     if(pageInfoIterator == TraceRecord.end())
         return;
-    TraceRecordPage pageInfo;
-    pageInfo = pageInfoIterator->second;
     duint offset = address - base;
-    bool isMixed;
     if((offset + size) > 4096) // execution crossed page boundary, splitting into 2 sub calls. Noting that byte type may be mislabelled.
     {
         SHARED_RELEASE();
@@ -128,12 +308,31 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
         TraceExecute(base + 4096, size + offset - 4096);
         return;
     }
-    isMixed = false;
-    switch(pageInfo.dataType)
+    // A hot page is written in place, the page map is not modified so the shared lock is enough (only the debug thread writes)
+    auto & pageInfo = pageInfoIterator->second;
+    if(pageInfo.rawPtr)
+    {
+        pageInfo.lastUse = ++useCounter;
+        recordExecute(pageInfo.dataType, pageInfo.rawPtr, offset, size);
+        return;
+    }
+    // Decompressing a cold page replaces its data and can compress other pages, that needs the exclusive lock
+    SHARED_RELEASE();
+    EXCLUSIVE_ACQUIRE(LockTraceRecord);
+    pageInfoIterator = TraceRecord.find(ModHashFromAddr(base));
+    if(pageInfoIterator == TraceRecord.end())
+        return;
+    recordExecute(pageInfoIterator->second.dataType, getPageData(pageInfoIterator->second), offset, size);
+}
+
+void TraceRecordManager::recordExecute(TraceRecordType type, void* rawPtr, duint offset, duint size)
+{
+    bool isMixed = false;
+    switch(type)
     {
     case TraceRecordType::TraceRecordBitExec:
         for(unsigned char i = 0; i < size; i++)
-            *((char*)pageInfo.rawPtr + (i + offset) / 8) |= 1 << ((i + offset) % 8);
+            *((char*)rawPtr + (i + offset) / 8) |= 1 << ((i + offset) % 8);
         break;
 
     case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
@@ -149,7 +348,7 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
             else
                 currentByteType = TraceRecordByteType_2bit::_InstructionBody;
 
-            char* data = (char*)pageInfo.rawPtr + offset + i;
+            char* data = (char*)rawPtr + offset + i;
             if(*data == 0)
             {
                 *data = (char)currentByteType << 6 | 1;
@@ -162,7 +361,7 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
         }
         if(isMixed)
             for(unsigned char i = 0; i < size; i++)
-                *((char*)pageInfo.rawPtr + i + offset) |= 0xC0;
+                *((char*)rawPtr + i + offset) |= 0xC0;
         break;
 
     case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
@@ -178,7 +377,7 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
             else
                 currentByteType = TraceRecordByteType_2bit::_InstructionBody;
 
-            short* data = (short*)pageInfo.rawPtr + offset + i;
+            short* data = (short*)rawPtr + offset + i;
             if(*data == 0)
             {
                 *data = (char)currentByteType << 14 | 1;
@@ -191,7 +390,7 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
         }
         if(isMixed)
             for(unsigned char i = 0; i < size; i++)
-                *((short*)pageInfo.rawPtr + i + offset) |= 0xC000;
+                *((short*)rawPtr + i + offset) |= 0xC000;
         break;
 
     default:
@@ -439,16 +638,18 @@ unsigned int TraceRecordManager::getHitCount(duint address)
         return 0;
     else
     {
-        TraceRecordPage pageInfo = pageInfoIterator->second;
+        const auto & pageInfo = pageInfoIterator->second;
         duint offset = address - base;
+        unsigned char byteData;
+        unsigned short wordData;
         switch(pageInfo.dataType)
         {
         case TraceRecordType::TraceRecordBitExec:
-            return ((char*)pageInfo.rawPtr)[offset / 8] & (1 << (offset % 8)) ? 1 : 0;
+            return readPageData(pageInfo, offset / 8, &byteData, 1) && (byteData & (1 << (offset % 8))) ? 1 : 0;
         case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
-            return ((char*)pageInfo.rawPtr)[offset] & 0x3F;
+            return readPageData(pageInfo, offset, &byteData, 1) ? byteData & 0x3F : 0;
         case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
-            return ((short*)pageInfo.rawPtr)[offset] & 0x3FFF;
+            return readPageData(pageInfo, offset * 2, &wordData, 2) ? wordData & 0x3FFF : 0;
         default:
             return 0;
         }
@@ -464,17 +665,21 @@ TraceRecordManager::TraceRecordByteType TraceRecordManager::getByteType(duint ad
         return TraceRecordByteType::InstructionHeading;
     else
     {
-        TraceRecordPage pageInfo = pageInfoIterator->second;
+        const auto & pageInfo = pageInfoIterator->second;
         duint offset = address - base;
+        unsigned char byteData = 0;
+        unsigned short wordData = 0;
         switch(pageInfo.dataType)
         {
         case TraceRecordType::TraceRecordBitExec:
         default:
             return TraceRecordByteType::InstructionHeading;
         case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
-            return (TraceRecordByteType)((((char*)pageInfo.rawPtr)[offset] & 0xC0) >> 6);
+            readPageData(pageInfo, offset, &byteData, 1);
+            return (TraceRecordByteType)((byteData & 0xC0) >> 6);
         case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
-            return (TraceRecordByteType)((((short*)pageInfo.rawPtr)[offset] & 0xC000) >> 14);
+            readPageData(pageInfo, offset * 2, &wordData, 2);
+            return (TraceRecordByteType)((wordData & 0xC000) >> 14);
         }
     }
 }
@@ -583,8 +788,8 @@ void TraceRecordManager::saveToDb(JSON root)
 {
     EXCLUSIVE_ACQUIRE(LockTraceRecord);
     const JSON jsonTraceRecords = json_array();
-    const char* byteToHex = "0123456789ABCDEF";
-    for(auto i : TraceRecord)
+    std::vector<unsigned char> coldData;
+    for(const auto & i : TraceRecord)
     {
         JSON jsonObj = json_object();
         if(i.second.moduleIndex != ~0)
@@ -598,21 +803,16 @@ void TraceRecordManager::saveToDb(JSON root)
             json_object_set_new(jsonObj, "rva", json_hex(i.first));
         }
         json_object_set_new(jsonObj, "type", json_hex((duint)i.second.dataType));
+        auto size = getPageSize(i.second.dataType);
+        if(!size)
+            __debugbreak(); // We have encountered an error condition.
         auto ptr = (unsigned char*)i.second.rawPtr;
-        duint size = 0;
-        switch(i.second.dataType)
+        if(!ptr)
         {
-        case TraceRecordType::TraceRecordBitExec:
-            size = 4096 / 8;
-            break;
-        case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
-            size = 4096;
-            break;
-        case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
-            size = 4096 * 2;
-            break;
-        default:
-            __debugbreak(); // We have encountered an error condition.
+            coldData.resize(size);
+            ptr = coldData.data();
+            if(!UnpackPage(i.second.packed, ptr, size))
+                memset(ptr, 0, size);
         }
         auto hex = StringUtils::ToCompressedHex(ptr, size);
         json_object_set_new(jsonObj, "data", json_string(hex.c_str()));
@@ -640,32 +840,17 @@ void TraceRecordManager::loadFromDb(JSON root)
     json_array_foreach(tracerecord, i, value)
     {
         TraceRecordPage currentPage;
-        size_t size;
         currentPage.dataType = (TraceRecordType)json_hex_value(json_object_get(value, "type"));
         currentPage.rva = (duint)json_hex_value(json_object_get(value, "rva"));
-        switch(currentPage.dataType)
-        {
-        case TraceRecordType::TraceRecordBitExec:
-            size = 4096 / 8;
-            break;
-        case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
-            size = 4096;
-            break;
-        case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
-            size = 4096 * 2;
-            break;
-        default:
-            size = 0;
-            break;
-        }
+        auto size = getPageSize(currentPage.dataType);
         if(size != 0)
         {
             currentPage.rawPtr = emalloc(size, "TraceRecordManager");
-            const char* p = json_string_value(json_object_get(value, "data"));
-            std::vector<unsigned char> data;
-            if(StringUtils::FromCompressedHex(p, data) && data.size() == size)
+            auto dataJson = json_object_get(value, "data");
+            const char* p = json_string_value(dataJson);
+            auto decodedSize = size;
+            if(p && StringUtils::FromCompressedHex(p, json_string_length(dataJson), (unsigned char*)currentPage.rawPtr, decodedSize) && decodedSize == size)
             {
-                memcpy(currentPage.rawPtr, data.data(), size);
                 const char* moduleName = json_string_value(json_object_get(value, "module"));
                 duint key;
                 if(*moduleName)
@@ -678,12 +863,16 @@ void TraceRecordManager::loadFromDb(JSON root)
                     currentPage.moduleIndex = ~0;
                     key = currentPage.rva;
                 }
-                TraceRecord.insert(std::make_pair(key, currentPage));
+                if(TraceRecord.insert(std::make_pair(key, currentPage)).second)
+                    hotBytes += size;
+                else
+                    efree(currentPage.rawPtr, "TraceRecordManager");
             }
             else
                 efree(currentPage.rawPtr, "TraceRecordManager");
         }
     }
+    trimMemory();
 }
 
 unsigned int TraceRecordManager::getModuleIndex(const String & moduleName)
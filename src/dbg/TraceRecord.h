@@ -45,10 +45,31 @@ public:
         TraceRecordWordWithExecTypeAndCounter
     };
 
+    /***************************************************************
+     * Page storage: pages that were used recently are kept as raw
+     * arrays (hot), the least recently used pages are PackBits
+     * compressed (cold) once the hot pages exceed the memory budget.
+     **************************************************************/
+    struct MemoryStats
+    {
+        duint pages;
+        duint hotPages;
+        duint hotBytes;
+        duint coldPages;
+        duint coldBytes; // compressed size
+        duint rawBytes; // size of all pages uncompressed
+        duint budget;
+        duint compressions;
+        duint decompressions;
+    };
+
     TraceRecordManager();
     ~TraceRecordManager();
     void clear();
 
+    void setMemoryBudget(duint bytes);
+    MemoryStats getMemoryStats();
+
     bool setTraceRecordType(duint pageAddress, TraceRecordType type);
     TraceRecordType getTraceRecordType(duint pageAddress);
 
@@ -76,10 +97,12 @@ private:
 
     struct TraceRecordPage
     {
-        void* rawPtr;
+        void* rawPtr; // nullptr when the page is cold
+        std::vector<unsigned char> packed; // PackBits data of a cold page
         duint rva;
         TraceRecordType dataType;
         unsigned int moduleIndex;
+        duint lastUse = 0;
     };
 
     typedef union _REGDUMPWORD
@@ -94,6 +117,18 @@ private:
     std::unordered_map<duint, TraceRecordPage> TraceRecord;
     std::vector<std::string> ModuleNames;
     unsigned int getModuleIndex(const String & moduleName);
+
+    static size_t getPageSize(TraceRecordType type);
+    void* getPageData(TraceRecordPage & page);
+    static void recordExecute(TraceRecordType type, void* rawPtr, duint offset, duint size);
+    bool readPageData(const TraceRecordPage & page, size_t offset, void* dest, size_t size) const;
+    void freePage(TraceRecordPage & page);
+    void trimMemory();
+    duint memoryBudget = 64 * 1024 * 1024;
+    duint hotBytes = 0;
+    duint useCounter = 0;
+    duint compressions = 0;
+    duint decompressions = 0;
     unsigned int instructionCounter = 0;
 
     bool rtEnabled = false;
@@ -31,6 +31,9 @@
 #include "exception.h"
 #include "database.h"
 #include "dbghelp_safe.h"
+#include "tracewriteindex.h"
+#include "codefolding.h"
+#include "encodemap.h"
 
 static DBGFUNCTIONS _dbgfunctions;
 
@@ -68,16 +71,7 @@ static bool _patchget(duint addr)
 
 static bool _patchinrange(duint start, duint end)
 {
-    if(start > end)
-        std::swap(start, end);
-
-    for(duint i = start; i <= end; i++)
-    {
-        if(_patchget(i))
-            return true;
-    }
-
-    return false;
+    return PatchInRange(start, end);
 }
 
 static bool _mempatch(duint va, const unsigned char* src, duint size)
@@ -90,8 +84,17 @@ static void _patchrestorerange(duint start, duint end)
     if(start > end)
         std::swap(start, end);
 
-    for(duint i = start; i <= end; i++)
-        PatchDelete(i, true);
+    if(end != ~duint(0) && ModBaseFromAddr(start) == ModBaseFromAddr(end))
+        PatchDelRange(start, end + 1, true);
+    else
+    {
+        for(duint i = start; i <= end; i++)
+        {
+            PatchDelete(i, true);
+            if(i == end)
+                break;
+        }
+    }
 
     GuiUpdatePatches();
 }
@@ -374,6 +377,60 @@ static bool _modrelocationsinrange(duint addr, duint size, ListOf(DBGRELOCATIONI
     return true;
 }
 
+static bool _getusercomments(const duint* addr, size_t count, ListOf(DBGUSERCOMMENT) comments)
+{
+    std::vector<std::pair<duint, String>> found;
+    CommentGetMany(addr, count, found);
+    std::vector<DBGUSERCOMMENT> commentsV(found.size());
+    for(size_t i = 0; i < found.size(); i++)
+    {
+        commentsV[i].addr = found[i].first;
+        strncpy_s(commentsV[i].comment, found[i].second.c_str(), _TRUNCATE);
+    }
+    return BridgeList<DBGUSERCOMMENT>::CopyData(comments, commentsV);
+}
+
+static bool _threadsnapshotupdate(ListOf(THREADALLINFO) changed, ListOf(DWORD) removed, DWORD* currentThreadId)
+{
+    std::vector<THREADALLINFO> changedV;
+    std::vector<DWORD> removedV;
+    DWORD currentThread;
+    ThreadSnapshotUpdate(changedV, removedV, currentThread);
+    if(currentThreadId)
+        *currentThreadId = currentThread;
+    return BridgeList<THREADALLINFO>::CopyData(changed, changedV) && BridgeList<DWORD>::CopyData(removed, removedV);
+}
+
+static bool _threadsnapshotgetdetails(const DWORD* threadIds, size_t count, ListOf(THREADALLINFO) threads)
+{
+    std::vector<THREADALLINFO> threadsV;
+    ThreadSnapshotGetDetails(threadIds, count, threadsV);
+    return BridgeList<THREADALLINFO>::CopyData(threads, threadsV);
+}
+
+static bool _getcodefolds(ListOf(DBGCODEFOLD) folds)
+{
+    std::vector<CODEFOLDSINFO> list;
+    CodeFoldGetList(list);
+    std::vector<DBGCODEFOLD> foldsV;
+    foldsV.reserve(list.size());
+    for(const auto & fold : list)
+    {
+        auto base = ModBaseFromName(fold.mod().c_str());
+        DBGCODEFOLD entry;
+        entry.start = fold.start + base;
+        entry.end = fold.end + base;
+        entry.folded = fold.folded;
+        foldsV.push_back(entry);
+    }
+    return BridgeList<DBGCODEFOLD>::CopyData(folds, foldsV);
+}
+
+static bool _setcodefold(duint start, duint end, bool folded)
+{
+    return CodeFoldSet(start, end, folded, true);
+}
+
 static int SymAutoComplete(const char* Search, char** Buffer, int MaxSymbols)
 {
     //TODO: refactor this in a function because this pattern will become common
@@ -532,4 +589,14 @@ void dbgfunctionsinit()
     _dbgfunctions.RefreshModuleList = _refreshmodulelist;
     _dbgfunctions.GetAddrFromLineEx = _getaddrfromlineex;
     _dbgfunctions.ModSymbolStatus = _modsymbolstatus;
+    _dbgfunctions.TraceWriteIndexRequest = TraceWriteIndexRequest;
+    _dbgfunctions.TraceLastWrite = TraceWriteIndexLastWrite;
+    _dbgfunctions.GetUserComments = _getusercomments;
+    _dbgfunctions.ThreadSnapshotUpdate = _threadsnapshotupdate;
+    _dbgfunctions.ThreadSnapshotGetDetails = _threadsnapshotgetdetails;
+    _dbgfunctions.GetCodeFolds = _getcodefolds;
+    _dbgfunctions.SetCodeFold = _setcodefold;
+    _dbgfunctions.DeleteCodeFold = CodeFoldDelete;
+    _dbgfunctions.CodeFoldGeneration = CodeFoldGeneration;
+    _dbgfunctions.GetEncodeTypes = EncodeMapGetTypes;
 }
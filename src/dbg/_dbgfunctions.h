@@ -54,6 +54,19 @@ typedef struct
     WORD size;
 } DBGRELOCATIONINFO;
 
+typedef struct
+{
+    duint addr;
+    char comment[MAX_COMMENT_SIZE];
+} DBGUSERCOMMENT;
+
+typedef struct
+{
+    duint start;
+    duint end;
+    bool folded;
+} DBGCODEFOLD;
+
 typedef enum
 {
     InstructionBody = 0,
@@ -207,6 +220,16 @@ typedef int(*SYMAUTOCOMPLETE)(const char* Search, char** Buffer, int MaxSymbols)
 typedef void(*REFRESHMODULELIST)();
 typedef duint(*GETADDRFROMLINEEX)(duint mod, const char* szSourceFile, int line);
 typedef MODULESYMBOLSTATUS(*MODSYMBOLSTATUS)(duint mod);
+typedef int(*TRACEWRITEINDEXREQUEST)(const char* traceFile);
+typedef bool(*TRACELASTWRITE)(const char* traceFile, unsigned long long before, duint addr, duint size, unsigned long long* writer);
+typedef bool(*GETUSERCOMMENTS)(const duint* addr, size_t count, ListOf(DBGUSERCOMMENT) comments);
+typedef bool(*THREADSNAPSHOTUPDATE)(ListOf(THREADALLINFO) changed, ListOf(DWORD) removed, DWORD* currentThreadId);
+typedef bool(*THREADSNAPSHOTGETDETAILS)(const DWORD* threadIds, size_t count, ListOf(THREADALLINFO) threads);
+typedef bool(*GETCODEFOLDS)(ListOf(DBGCODEFOLD) folds);
+typedef bool(*SETCODEFOLD)(duint start, duint end, bool folded);
+typedef bool(*DELETECODEFOLD)(duint start, duint end);
+typedef duint(*CODEFOLDGENERATION)();
+typedef bool(*GETENCODETYPES)(duint addr, duint size, unsigned char* types);
 
 //The list of all the DbgFunctions() return value.
 //WARNING: This list is append only. Do not insert things in the middle or plugins would break.
@@ -285,6 +308,16 @@ typedef struct DBGFUNCTIONS_
     REFRESHMODULELIST RefreshModuleList;
     GETADDRFROMLINEEX GetAddrFromLineEx;
     MODSYMBOLSTATUS ModSymbolStatus;
+    TRACEWRITEINDEXREQUEST TraceWriteIndexRequest;
+    TRACELASTWRITE TraceLastWrite;
+    GETUSERCOMMENTS GetUserComments;
+    THREADSNAPSHOTUPDATE ThreadSnapshotUpdate;
+    THREADSNAPSHOTGETDETAILS ThreadSnapshotGetDetails;
+    GETCODEFOLDS GetCodeFolds;
+    SETCODEFOLD SetCodeFold;
+    DELETECODEFOLD DeleteCodeFold;
+    CODEFOLDGENERATION CodeFoldGeneration;
+    GETENCODETYPES GetEncodeTypes;
 } DBGFUNCTIONS;
 
 #ifdef BUILD_DBG
@@ -36,6 +36,7 @@
 #include "recursiveanalysis.h"
 #include "dbghelp_safe.h"
 #include "symcache.h"
+#include "eventreplay.h"
 
 static bool bOnlyCipAutoComments = false;
 static bool bNoSourceLineAutoComments = false;
@@ -91,7 +92,7 @@ extern "C" DLL_EXPORT bool _dbg_valfromstring(const char* string, duint* value)
 
 extern "C" DLL_EXPORT bool _dbg_isdebugging()
 {
-    return hDebugLoopThread && IsFileBeingDebugged();
+    return (hDebugLoopThread && IsFileBeingDebugged()) || EventReplayActive();
 }
 
 extern "C" DLL_EXPORT bool _dbg_isjumpgoingtoexecute(duint addr)
@@ -1076,6 +1077,12 @@ extern "C" DLL_EXPORT duint _dbg_sendmessage(DBGMSG type, void* param1, void* pa
             maxSkipExceptionCount = setting;
         else
             BridgeSettingSetUint("Engine", "MaxSkipExceptionCount", maxSkipExceptionCount);
+
+        // MB, 0 is unlimited
+        if(BridgeSettingGetUint("Engine", "TraceRecordMemoryBudget", &setting) && setting <= duint(-1) / (1024 * 1024))
+            TraceRecord.setMemoryBudget(setting * 1024 * 1024);
+        else
+            BridgeSettingSetUint("Engine", "TraceRecordMemoryBudget", TraceRecord.getMemoryStats().budget / (1024 * 1024));
     }
     break;
 
@@ -1,4 +1,5 @@
 #include "_scriptapi_debug.h"
+#include "debugger.h"
 
 SCRIPT_EXPORT void Script::Debug::Wait()
 {
@@ -75,4 +76,32 @@ SCRIPT_EXPORT bool Script::Debug::DeleteHardwareBreakpoint(duint address)
     char command[128] = "";
     sprintf_s(command, "bphwc %p", address);
     return DbgCmdExecDirect(command);
+}
+
+SCRIPT_EXPORT size_t Script::Debug::SetBreakpoints(const duint* addresses, size_t count, bool singleshoot, bool* results)
+{
+    if(!DbgIsDebugging())
+        return 0;
+    return DebugBulkBreakpoints(BpBulkSet, addresses, count, singleshoot ? UE_SINGLESHOOT : UE_BREAKPOINT, results);
+}
+
+SCRIPT_EXPORT size_t Script::Debug::DeleteBreakpoints(const duint* addresses, size_t count, bool* results)
+{
+    if(!DbgIsDebugging())
+        return 0;
+    return DebugBulkBreakpoints(BpBulkDelete, addresses, count, 0, results);
+}
+
+SCRIPT_EXPORT size_t Script::Debug::EnableBreakpoints(const duint* addresses, size_t count, bool* results)
+{
+    if(!DbgIsDebugging())
+        return 0;
+    return DebugBulkBreakpoints(BpBulkEnable, addresses, count, 0, results);
+}
+
+SCRIPT_EXPORT size_t Script::Debug::DisableBreakpoints(const duint* addresses, size_t count, bool* results)
+{
+    if(!DbgIsDebugging())
+        return 0;
+    return DebugBulkBreakpoints(BpBulkDisable, addresses, count, 0, results);
 }
\ No newline at end of file
@@ -26,6 +26,11 @@ namespace Script
         SCRIPT_EXPORT bool DisableBreakpoint(duint address);
         SCRIPT_EXPORT bool SetHardwareBreakpoint(duint address, HardwareType type = HardwareExecute);
         SCRIPT_EXPORT bool DeleteHardwareBreakpoint(duint address);
+        // Bulk versions, results (optional) receives the status of each address, returns the number of successes
+        SCRIPT_EXPORT size_t SetBreakpoints(const duint* addresses, size_t count, bool singleshoot = false, bool* results = nullptr);
+        SCRIPT_EXPORT size_t DeleteBreakpoints(const duint* addresses, size_t count, bool* results = nullptr);
+        SCRIPT_EXPORT size_t EnableBreakpoints(const duint* addresses, size_t count, bool* results = nullptr);
+        SCRIPT_EXPORT size_t DisableBreakpoints(const duint* addresses, size_t count, bool* results = nullptr);
     }; //Debug
 }; //Script
 
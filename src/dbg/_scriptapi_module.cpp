@@ -204,7 +204,7 @@ SCRIPT_EXPORT bool Script::Module::GetExports(const ModuleInfo* mod, ListOf(Modu
         entry.forwarded = modExport.forwarded;
         strncpy_s(entry.forwardName, modExport.forwardName.c_str(), _TRUNCATE);
         strncpy_s(entry.name, modExport.name.c_str(), _TRUNCATE);
-        strncpy_s(entry.undecoratedName, modExport.undecoratedName.c_str(), _TRUNCATE);
+        strncpy_s(entry.undecoratedName, modExport.undecoratedName().c_str(), _TRUNCATE);
         modExportList.push_back(entry);
     }
     return BridgeList<ModuleExport>::CopyData(list, modExportList);
@@ -232,7 +232,7 @@ SCRIPT_EXPORT bool Script::Module::GetImports(const ModuleInfo* mod, ListOf(Modu
         entry.iatRva = modImport.iatRva;
         entry.iatVa = modImport.iatRva + modInfo->base;
         strncpy_s(entry.name, modImport.name.c_str(), _TRUNCATE);
-        strncpy_s(entry.undecoratedName, modImport.undecoratedName.c_str(), _TRUNCATE);
+        strncpy_s(entry.undecoratedName, modImport.undecoratedName().c_str(), _TRUNCATE);
         modImportList.push_back(entry);
     }
     return BridgeList<ModuleImport>::CopyData(list, modImportList);
@@ -1,5 +1,5 @@
 #include "FunctionPass.h"
-#include <ppl.h>
+#include "taskpool.h"
 #include "memory.h"
 #include "console.h"
 #include "debugger.h"
@@ -69,29 +69,32 @@ const char* FunctionPass::GetName()
 
 bool FunctionPass::Analyse()
 {
-    // THREAD_WORK = ceil(TOTAL / # THREADS)
-    duint workAmount = (m_MainBlocks.size() + (IdealThreadCount() - 1)) / IdealThreadCount();
+    // Function sizes vary a lot, so the blocks are split in pieces smaller than what each thread would get
+    // and threads that finish early steal the remaining pieces
+    // WORK = max(ceil(TOTAL / (# THREADS * 8)), 64)
+    duint workTotal = m_MainBlocks.size();
+    duint workAmount = max((workTotal + (IdealThreadCount() * 8 - 1)) / (IdealThreadCount() * 8), duint(64));
+    duint workCount = (workTotal + workAmount - 1) / workAmount;
 
-    // Initialize thread vector
-    auto threadFunctions = new std::vector<FunctionDef>[IdealThreadCount()];
+    // Initialize piece vector
+    auto threadFunctions = new std::vector<FunctionDef>[workCount];
 
-    concurrency::parallel_for(duint(0), IdealThreadCount(), [&](duint i)
+    ParallelFor(0, workCount, 1, [&](size_t first, size_t last)
     {
-        // Memory allocation optimization
-        // TODO: Option to conserve memory
-        threadFunctions[i].reserve(30000);
-
-        // Execute
-        duint threadWorkStart = (workAmount * i);
-        duint threadWorkStop = min((threadWorkStart + workAmount), m_MainBlocks.size());
+        for(duint i = first; i < last; i++)
+        {
+            // Execute
+            duint threadWorkStart = (workAmount * i);
+            duint threadWorkStop = min((threadWorkStart + workAmount), workTotal);
 
-        AnalysisWorker(threadWorkStart, threadWorkStop, &threadFunctions[i]);
+            AnalysisWorker(threadWorkStart, threadWorkStop, &threadFunctions[i]);
+        }
     });
 
-    // Merge thread vectors into single local
+    // Merge piece vectors into single local
     std::vector<FunctionDef> funcs;
 
-    for(duint i = 0; i < IdealThreadCount(); i++)
+    for(duint i = 0; i < workCount; i++)
         std::move(threadFunctions[i].begin(), threadFunctions[i].end(), std::back_inserter(funcs));
 
     // Sort and remove duplicates
@@ -1,7 +1,7 @@
 #include <thread>
-#include <ppl.h>
 #include "AnalysisPass.h"
 #include "LinearPass.h"
+#include "taskpool.h"
 #include <zydis_wrapper.h>
 
 LinearPass::LinearPass(duint VirtualStart, duint VirtualEnd, BBlockArray & MainBlocks)
@@ -26,38 +26,43 @@ const char* LinearPass::GetName()
 
 bool LinearPass::Analyse()
 {
-    // Divide the work up between each thread
-    // THREAD_WORK = (TOTAL / # THREADS)
-    duint workAmount = m_DataSize / IdealThreadCount();
+    // Divide the work up in pieces smaller than what each thread would get,
+    // threads that finish early steal the remaining pieces
+    // WORK = max(TOTAL / (# THREADS * 8), 4096)
+    duint workAmount = max(m_DataSize / (IdealThreadCount() * 8), duint(0x1000));
+    duint workCount = (m_DataSize + workAmount - 1) / workAmount;
 
-    // Initialize thread vector
-    auto threadBlocks = new std::vector<BasicBlock>[IdealThreadCount()];
+    // Initialize piece vector
+    auto threadBlocks = new std::vector<BasicBlock>[workCount];
 
-    concurrency::parallel_for(duint(0), IdealThreadCount(), [&](duint i)
+    ParallelFor(0, workCount, 1, [&](size_t first, size_t last)
     {
-        duint threadWorkStart = m_VirtualStart + (workAmount * i);
-        duint threadWorkStop = min((threadWorkStart + workAmount), m_VirtualEnd);
-
-        // Allow a 256-byte variance of scanning because of
-        // integer rounding errors and instruction overlap
-        if(threadWorkStart > m_VirtualStart)
+        for(duint i = first; i < last; i++)
         {
-            threadWorkStart = max((threadWorkStart - 256), m_VirtualStart);
-            threadWorkStop = min((threadWorkStop + 256), m_VirtualEnd);
-        }
+            duint threadWorkStart = m_VirtualStart + (workAmount * i);
+            duint threadWorkStop = min((threadWorkStart + workAmount), m_VirtualEnd);
+
+            // Allow a 256-byte variance of scanning because of
+            // integer rounding errors and instruction overlap
+            if(threadWorkStart > m_VirtualStart)
+            {
+                threadWorkStart = max((threadWorkStart - 256), m_VirtualStart);
+                threadWorkStop = min((threadWorkStop + 256), m_VirtualEnd);
+            }
 
-        // Memory allocation optimization
-        // TODO: Option to conserve memory
-        threadBlocks[i].reserve(100000);
+            // Memory allocation optimization
+            // TODO: Option to conserve memory
+            threadBlocks[i].reserve(workAmount / 16);
 
-        // Execute
-        AnalysisWorker(threadWorkStart, threadWorkStop, &threadBlocks[i]);
+            // Execute
+            AnalysisWorker(threadWorkStart, threadWorkStop, &threadBlocks[i]);
+        }
     });
 
     // Clear old data and combine vectors
     m_MainBlocks.clear();
 
-    for(duint i = 0; i < IdealThreadCount(); i++)
+    for(duint i = 0; i < workCount; i++)
     {
         std::move(threadBlocks[i].begin(), threadBlocks[i].end(), std::back_inserter(m_MainBlocks));
 
@@ -88,33 +93,37 @@ void LinearPass::AnalyseOverlaps()
     // This also checks for basic block targets jumping into
     // the middle of other basic blocks.
     //
-    // THREAD_WORK = ceil(TOTAL / # THREADS)
+    // WORK = max(ceil(TOTAL / (# THREADS * 8)), 256)
     duint workTotal = m_MainBlocks.size();
-    duint workAmount = (workTotal + (IdealThreadCount() - 1)) / IdealThreadCount();
+    duint workAmount = max((workTotal + (IdealThreadCount() * 8 - 1)) / (IdealThreadCount() * 8), duint(256));
+    duint workCount = (workTotal + workAmount - 1) / workAmount;
 
-    // Initialize thread vectors
-    auto threadInserts = new std::vector<BasicBlock>[IdealThreadCount()];
+    // Initialize piece vectors
+    auto threadInserts = new std::vector<BasicBlock>[workCount];
 
-    concurrency::parallel_for(duint(0), IdealThreadCount(), [&](duint i)
+    ParallelFor(0, workCount, 1, [&](size_t first, size_t last)
     {
-        duint threadWorkStart = (workAmount * i);
-        duint threadWorkStop = min((threadWorkStart + workAmount), workTotal);
-
-        // Again, allow an overlap of +/- 1 entry
-        if(threadWorkStart > 0)
+        for(duint i = first; i < last; i++)
         {
-            threadWorkStart = max((threadWorkStart - 1), 0);
-            threadWorkStop = min((threadWorkStop + 1), workTotal);
-        }
+            duint threadWorkStart = (workAmount * i);
+            duint threadWorkStop = min((threadWorkStart + workAmount), workTotal);
+
+            // Again, allow an overlap of +/- 1 entry
+            if(threadWorkStart > 0)
+            {
+                threadWorkStart = max((threadWorkStart - 1), 0);
+                threadWorkStop = min((threadWorkStop + 1), workTotal);
+            }
 
-        // Execute
-        AnalysisOverlapWorker(threadWorkStart, threadWorkStop, &threadInserts[i]);
+            // Execute
+            AnalysisOverlapWorker(threadWorkStart, threadWorkStop, &threadInserts[i]);
+        }
     });
 
     // THREAD VECTOR
     std::vector<BasicBlock> overlapInserts;
     {
-        for(duint i = 0; i < IdealThreadCount(); i++)
+        for(duint i = 0; i < workCount; i++)
             std::move(threadInserts[i].begin(), threadInserts[i].end(), std::back_inserter(overlapInserts));
 
         // Sort and remove duplicates
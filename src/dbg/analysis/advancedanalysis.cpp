@@ -36,10 +36,7 @@ void AdvancedAnalysis::SetMarkers()
         for(const auto & function : mFunctions)
             FileHelper::WriteAllText(StringUtils::sprintf("cfgraph_%p.dot", function.entryPoint), function.ToDot());
 
-    duint encMapSize;
-    byte* buffer = (byte*)EncodeMapGetBuffer(mBase, &encMapSize, true);
-    memcpy(buffer, mEncMap, encMapSize);
-    EncodeMapReleaseBuffer(buffer);
+    EncodeMapSetBuffer(mBase, mEncMap, mSize);
 
     XrefDelRange(mBase, mBase + mSize - 1);
     for(const auto & vec : mXrefs)
@@ -0,0 +1,502 @@
+#include "asmpattern.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+static std::string toLower(std::string s)
+{
+    for(auto & ch : s)
+        ch = char(tolower((unsigned char)ch));
+    return s;
+}
+
+static std::string trim(const std::string & s)
+{
+    auto begin = s.find_first_not_of(" \t");
+    if(begin == std::string::npos)
+        return std::string();
+    auto end = s.find_last_not_of(" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+// * matches any characters, ? any character
+static bool globMatch(const char* pattern, const char* text)
+{
+    const char* star = nullptr;
+    const char* retry = nullptr;
+    while(*text)
+    {
+        if(*pattern == '*')
+        {
+            star = pattern++;
+            retry = text;
+        }
+        else if(*pattern == '?' || *pattern == *text)
+        {
+            pattern++;
+            text++;
+        }
+        else if(star)
+        {
+            pattern = star + 1;
+            text = ++retry;
+        }
+        else
+            return false;
+    }
+    while(*pattern == '*')
+        pattern++;
+    return !*pattern;
+}
+
+static bool parseNumber(std::string text, uint64_t & value)
+{
+    auto negative = !text.empty() && text[0] == '-';
+    if(negative)
+        text = trim(text.substr(1));
+    if(text.size() > 2 && text[0] == '0' && text[1] == 'x')
+        text = text.substr(2);
+    if(text.empty() || text.size() > 16 || text.find_first_not_of("0123456789abcdef") != std::string::npos)
+        return false;
+    value = strtoull(text.c_str(), nullptr, 16);
+    if(negative)
+        value = 0 - value;
+    return true;
+}
+
+bool AsmPattern::Range::Match(uint64_t value, int bits) const
+{
+    switch(kind)
+    {
+    case None:
+        return bits > 0 && bits < 64 ? (value & ((1ull << bits) - 1)) == 0 : value == 0;
+    case Any:
+        return true;
+    default:
+        break;
+    }
+    // ranges with a negative lower bound are signed
+    auto isSigned = int64_t(lo) < 0 && int64_t(lo) <= int64_t(hi);
+    auto inRange = [this, isSigned](uint64_t v)
+    {
+        return isSigned ? int64_t(lo) <= int64_t(v) && int64_t(v) <= int64_t(hi) : lo <= v && v <= hi;
+    };
+    if(inRange(value))
+        return true;
+    if(bits <= 0 || bits >= 64)
+        return false;
+    // the decoder extends immediates to the operand size, also accept the zero and sign extended forms
+    auto mask = (1ull << bits) - 1;
+    auto zx = value & mask;
+    auto sx = zx & (1ull << (bits - 1)) ? zx | ~mask : zx;
+    return inRange(zx) || inRange(sx);
+}
+
+bool AsmPattern::Operand::Match(const Zydis & cp, const ZydisDecodedOperand & op) const
+{
+    switch(kind)
+    {
+    case Any:
+        return true;
+    case Register:
+        return op.type == ZYDIS_OPERAND_TYPE_REGISTER && registers[op.reg.value];
+    case Immediate:
+        return op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE && value.Match(op.imm.value.u, op.size);
+    default:
+        break;
+    }
+    if(op.type != ZYDIS_OPERAND_TYPE_MEMORY)
+        return false;
+    if(size && op.size != size)
+        return false;
+    if(segment != ZYDIS_REGISTER_NONE && op.mem.segment != segment)
+        return false;
+    if(anyAddress)
+        return true;
+    if(hasIndex ? !index[op.mem.index] || (scale && op.mem.scale != scale) : op.mem.index != ZYDIS_REGISTER_NONE)
+        return false;
+    if(hasBase)
+        return base[op.mem.base] && value.Match(uint64_t(op.mem.disp.value), 0);
+    // rip relative operands are shown (and matched) as absolute addresses
+    if(op.mem.base == ZYDIS_REGISTER_RIP)
+        return value.Match(uint64_t(cp.Address() + cp.Size() + op.mem.disp.value), 0);
+    return op.mem.base == ZYDIS_REGISTER_NONE && value.Match(uint64_t(op.mem.disp.value), 0);
+}
+
+bool AsmPattern::parseRegisters(const std::string & text, Registers & registers)
+{
+    static const struct
+    {
+        const char* name;
+        ZydisRegisterClass classes[3];
+    } registerClasses[] =
+    {
+        { "gpr8", { ZYDIS_REGCLASS_GPR8 } },
+        { "gpr16", { ZYDIS_REGCLASS_GPR16 } },
+        { "gpr32", { ZYDIS_REGCLASS_GPR32 } },
+        { "gpr64", { ZYDIS_REGCLASS_GPR64 } },
+        { "seg", { ZYDIS_REGCLASS_SEGMENT } },
+        { "x87", { ZYDIS_REGCLASS_X87 } },
+        { "mmx", { ZYDIS_REGCLASS_MMX } },
+        { "vec", { ZYDIS_REGCLASS_XMM, ZYDIS_REGCLASS_YMM, ZYDIS_REGCLASS_ZMM } },
+    };
+
+    registers.reset();
+    Zydis cp;
+    for(int i = ZYDIS_REGISTER_NONE + 1; i <= ZYDIS_REGISTER_MAX_VALUE; i++)
+    {
+        auto reg = ZydisRegister(i);
+        auto regClass = ZydisRegisterGetClass(reg);
+        bool match = false;
+        if(text == "reg")
+            match = regClass != ZYDIS_REGCLASS_INVALID;
+        else if(text == "gpr")
+            match = regClass >= ZYDIS_REGCLASS_GPR8 && regClass <= ZYDIS_REGCLASS_GPR64;
+        else
+        {
+            bool isClass = false;
+            for(const auto & rc : registerClasses)
+            {
+                if(text != rc.name)
+                    continue;
+                isClass = true;
+                for(auto c : rc.classes)
+                    match |= c != ZYDIS_REGCLASS_INVALID && c == regClass;
+            }
+            if(!isClass)
+            {
+                auto name = ZydisRegisterGetString(reg);
+                auto displayName = cp.RegName(reg);
+                match = (name && globMatch(text.c_str(), name)) || (displayName && globMatch(text.c_str(), displayName));
+            }
+        }
+        registers[i] = match;
+    }
+    return registers.any();
+}
+
+bool AsmPattern::parseRange(const std::string & text, Range & range)
+{
+    auto dots = text.find("..");
+    if(dots == std::string::npos)
+    {
+        if(!parseNumber(text, range.lo))
+            return false;
+        range.hi = range.lo;
+    }
+    else if(!parseNumber(trim(text.substr(0, dots)), range.lo) || !parseNumber(trim(text.substr(dots + 2)), range.hi))
+        return false;
+    range.kind = Range::Between;
+    return true;
+}
+
+bool AsmPattern::parseMemory(const std::string & text, Operand & operand, std::string & error)
+{
+    operand.kind = Operand::Memory;
+    auto open = text.find('[');
+    if(text.back() != ']' || text.find('[', open + 1) != std::string::npos)
+    {
+        error = "invalid memory operand \"" + text + "\"";
+        return false;
+    }
+
+    // [size [ptr]] [segment:]
+    auto prefix = trim(text.substr(0, open));
+    if(!prefix.empty() && prefix.back() == ':')
+    {
+        auto space = prefix.find_last_of(" \t");
+        auto name = trim(prefix.substr(space == std::string::npos ? 0 : space + 1));
+        name.pop_back();
+        for(int i = ZYDIS_REGISTER_NONE + 1; i <= ZYDIS_REGISTER_MAX_VALUE; i++)
+        {
+            auto reg = ZydisRegister(i);
+            auto regName = ZydisRegisterGetString(reg);
+            if(ZydisRegisterGetClass(reg) == ZYDIS_REGCLASS_SEGMENT && regName && name == regName)
+                operand.segment = reg;
+        }
+        if(operand.segment == ZYDIS_REGISTER_NONE)
+        {
+            error = "unknown segment \"" + name + "\"";
+            return false;
+        }
+        prefix = space == std::string::npos ? std::string() : trim(prefix.substr(0, space));
+    }
+    if(prefix.size() > 3 && prefix.compare(prefix.size() - 3, 3, "ptr") == 0)
+        prefix = trim(prefix.substr(0, prefix.size() - 3));
+    if(!prefix.empty() && prefix != "?" && prefix != "*")
+    {
+        Zydis cp;
+        for(int size = 1; size <= 64 && !operand.size; size++)
+            if(prefix == cp.MemSizeName(size))
+                operand.size = size * 8;
+        if(!operand.size)
+        {
+            error = "unknown operand size \"" + prefix + "\"";
+            return false;
+        }
+    }
+
+    auto address = trim(text.substr(open + 1, text.size() - open - 2));
+    if(address == "*")
+    {
+        operand.anyAddress = true;
+        return true;
+    }
+
+    // split in terms on + and -, a - after .. belongs to the range
+    std::vector<std::pair<bool, std::string>> terms;
+    std::string term;
+    bool negative = false;
+    for(auto ch : address)
+    {
+        auto current = trim(term);
+        if((ch == '+' || ch == '-') && !current.empty() && current.back() != '.')
+        {
+            terms.emplace_back(negative, current);
+            term.clear();
+            negative = ch == '-';
+        }
+        else if(ch == '-' && current.empty())
+            negative = !negative;
+        else
+            term.push_back(ch);
+    }
+    terms.emplace_back(negative, trim(term));
+
+    bool hasDisplacement = false;
+    for(const auto & t : terms)
+    {
+        const auto & termText = t.second;
+        auto star = termText.find('*');
+        Registers registers;
+        if(termText.empty())
+        {
+            error = "invalid memory operand \"" + text + "\"";
+            return false;
+        }
+        else if(star != std::string::npos && star != 0)
+        {
+            auto scaleText = trim(termText.substr(star + 1));
+            uint64_t scale = 0;
+            if(operand.hasIndex || t.first || !parseRegisters(trim(termText.substr(0, star)), operand.index) ||
+                    (scaleText != "?" && (!parseNumber(scaleText, scale) || (scale != 1 && scale != 2 && scale != 4 && scale != 8))))
+            {
+                error = "invalid index \"" + termText + "\"";
+                return false;
+            }
+            operand.hasIndex = true;
+            operand.scale = int(scale);
+        }
+        else if(termText == "?" || termText == "*")
+        {
+            if(hasDisplacement)
+            {
+                error = "more than one displacement in \"" + text + "\"";
+                return false;
+            }
+            hasDisplacement = true;
+            operand.value.kind = Range::Any;
+        }
+        else if(parseRegisters(termText, registers))
+        {
+            if(t.first || (operand.hasBase && operand.hasIndex))
+            {
+                error = "invalid register \"" + termText + "\"";
+                return false;
+            }
+            if(!operand.hasBase)
+            {
+                operand.hasBase = true;
+                operand.base = registers;
+            }
+            else
+            {
+                operand.hasIndex = true;
+                operand.index = registers;
+                operand.scale = 1;
+            }
+        }
+        else
+        {
+            Range range;
+            if(hasDisplacement || !parseRange(termText, range))
+            {
+                error = "invalid displacement \"" + termText + "\"";
+                return false;
+            }
+            // the sign is part of the first number: [rbp-20..-8]
+            if(t.first)
+            {
+                if(range.lo == range.hi)
+                    range.hi = 0 - range.hi;
+                range.lo = 0 - range.lo;
+            }
+            hasDisplacement = true;
+            operand.value = range;
+        }
+    }
+    return true;
+}
+
+bool AsmPattern::Compile(const std::string & pattern, std::string & error)
+{
+    mMnemonics.reset();
+    mOperands.clear();
+    mMoreOperands = false;
+
+    auto text = trim(toLower(pattern));
+    auto space = text.find_first_of(" \t");
+    auto mnemonic = text.substr(0, space);
+    for(int i = ZYDIS_MNEMONIC_INVALID + 1; i <= ZYDIS_MNEMONIC_MAX_VALUE; i++)
+    {
+        auto name = ZydisMnemonicGetString(ZydisMnemonic(i));
+        auto displayName = Zydis::MnemonicName(ZydisMnemonic(i));
+        mMnemonics[i] = (name && globMatch(mnemonic.c_str(), name)) || (displayName && globMatch(mnemonic.c_str(), displayName));
+    }
+    if(!mMnemonics.any())
+    {
+        error = "unknown mnemonic \"" + mnemonic + "\"";
+        return false;
+    }
+    if(space == std::string::npos)
+        return true;
+
+    // operands are separated by commas outside of brackets
+    std::vector<std::string> operands(1);
+    int depth = 0;
+    for(auto ch : text.substr(space + 1))
+    {
+        if(ch == '[')
+            depth++;
+        else if(ch == ']')
+            depth--;
+        if(ch == ',' && !depth)
+            operands.emplace_back();
+        else
+            operands.back().push_back(ch);
+    }
+
+    for(size_t i = 0; i < operands.size(); i++)
+    {
+        auto op = trim(operands[i]);
+        Operand operand;
+        if(op == "..." && i + 1 == operands.size())
+        {
+            mMoreOperands = true;
+            break;
+        }
+        else if(op == "*" || op == "?")
+            operand.kind = Operand::Any;
+        else if(op.find('[') != std::string::npos)
+        {
+            if(!parseMemory(op, operand, error))
+                return false;
+        }
+        else if(op == "imm")
+        {
+            operand.kind = Operand::Immediate;
+            operand.value.kind = Range::Any;
+        }
+        else if(parseRegisters(op, operand.registers))
+            operand.kind = Operand::Register;
+        else if(parseRange(op, operand.value))
+            operand.kind = Operand::Immediate;
+        else
+        {
+            error = "invalid operand \"" + op + "\"";
+            return false;
+        }
+        mOperands.push_back(operand);
+    }
+    return true;
+}
+
+bool AsmPattern::Match(const Zydis & cp) const
+{
+    auto instr = cp.GetInstr();
+    if(!instr || !mMnemonics[instr->mnemonic])
+        return false;
+    auto count = size_t(cp.OpCount());
+    if(mMoreOperands ? count < mOperands.size() : count != mOperands.size())
+        return false;
+    for(size_t i = 0; i < mOperands.size(); i++)
+        if(!mOperands[i].Match(cp, cp[int(i)]))
+            return false;
+    return true;
+}
+
+struct SweepChunk
+{
+    size_t begin;
+    size_t end;
+    size_t next; // first instruction after the chunk
+    std::vector<bool> starts; // instruction starts, relative to begin
+    std::vector<size_t> matches;
+};
+
+// returns the offset of the next instruction
+static size_t sweepStep(Zydis & cp, const AsmPattern & pattern, uint64_t address, const unsigned char* data, size_t size, size_t offset, std::vector<size_t> & matches)
+{
+    auto length = int((std::min)(size_t(MAX_DISASM_BUFFER), size - offset));
+    if(!cp.Decode(size_t(address + offset), data + offset, length))
+        return offset + 1;
+    if(pattern.Match(cp))
+        matches.push_back(offset);
+    return offset + cp.Size();
+}
+
+size_t AsmPatternFind(const AsmPattern & pattern, uint64_t address, const unsigned char* data, size_t size, std::vector<uint64_t> & results, TaskPool & pool)
+{
+    const size_t minChunkSize = 64 * 1024;
+    auto chunkSize = (std::max)(minChunkSize, size / ((pool.Workers() + 1) * 4) + 1);
+    std::vector<SweepChunk> chunks((size + chunkSize - 1) / chunkSize);
+    for(size_t i = 0; i < chunks.size(); i++)
+    {
+        chunks[i].begin = i * chunkSize;
+        chunks[i].end = (std::min)(size, chunks[i].begin + chunkSize);
+    }
+
+    // every chunk is swept from its start, the boundaries are only fixed up when it is stitched
+    Zydis cp; // initializes the shared decoder before the workers use it
+    ParallelFor(0, chunks.size(), 1, [&](size_t first, size_t last)
+    {
+        Zydis cp;
+        for(auto i = first; i < last; i++)
+        {
+            auto & chunk = chunks[i];
+            chunk.starts.resize(chunk.end - chunk.begin);
+            auto offset = chunk.begin;
+            while(offset < chunk.end)
+            {
+                chunk.starts[offset - chunk.begin] = true;
+                offset = sweepStep(cp, pattern, address, data, size, offset, chunk.matches);
+            }
+            chunk.next = offset;
+        }
+    }, nullptr, ParallelProgress(), pool);
+
+    // a chunk is in sync from the first instruction start it shares with the sequential sweep, redecode up to there
+    auto count = results.size();
+    size_t carry = 0;
+    for(const auto & chunk : chunks)
+    {
+        if(carry >= chunk.end)
+            continue;
+        std::vector<size_t> matches;
+        auto offset = carry;
+        while(offset < chunk.end && !chunk.starts[offset - chunk.begin])
+            offset = sweepStep(cp, pattern, address, data, size, offset, matches);
+        for(auto match : matches)
+            results.push_back(address + match);
+        if(offset >= chunk.end)
+        {
+            carry = offset;
+            continue;
+        }
+        for(auto match : chunk.matches)
+            if(match >= offset)
+                results.push_back(address + match);
+        carry = chunk.next;
+    }
+    return results.size() - count;
+}
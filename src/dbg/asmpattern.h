@@ -0,0 +1,83 @@
+#ifndef _ASMPATTERN_H
+#define _ASMPATTERN_H
+
+// Structural instruction matching on decoded instructions (no debugger or Windows dependencies)
+
+#include "zydis_wrapper.h"
+#include "taskpool.h"
+#include <bitset>
+#include <vector>
+#include <cstdint>
+
+/**
+\brief An instruction pattern in assembly syntax, compiled to checks on the decoded operands. Wildcards:
+       - mnemonic and register names can use * (any characters) and ? (any character): "j*", "cmov??", "r?x"
+       - register classes: reg, gpr, gpr8, gpr16, gpr32, gpr64, seg, x87, mmx, vec (xmm/ymm/zmm)
+       - * or ? as operand matches any operand, a trailing ... matches any remaining operands
+       - imm matches any immediate, numbers (hex) and ranges (lo..hi) match immediates and displacements
+       - [*] matches any memory operand, "?" in a memory operand any displacement and "*?" any scale
+       Example: "mov [rsp+?], r??", "call qword ptr [*]", "add gpr64, 0..10"
+*/
+class AsmPattern
+{
+public:
+    bool Compile(const std::string & pattern, std::string & error);
+    bool Match(const Zydis & cp) const;
+
+private:
+    typedef std::bitset<ZYDIS_REGISTER_MAX_VALUE + 1> Registers;
+
+    struct Range
+    {
+        enum
+        {
+            None, // absent (displacement 0)
+            Any,
+            Between
+        } kind = None;
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+
+        bool Match(uint64_t value, int bits) const;
+    };
+
+    struct Operand
+    {
+        enum
+        {
+            Any,
+            Register,
+            Immediate,
+            Memory
+        } kind = Any;
+        Registers registers; // Register
+        Range value; // Immediate, Memory displacement
+        int size = 0; // Memory size in bits, 0 for any
+        bool anyAddress = false; // [*]
+        ZydisRegister segment = ZYDIS_REGISTER_NONE; // NONE for any
+        bool hasBase = false;
+        Registers base;
+        bool hasIndex = false;
+        Registers index;
+        int scale = 0; // 0 for any
+
+        bool Match(const Zydis & cp, const ZydisDecodedOperand & op) const;
+    };
+
+    std::bitset<ZYDIS_MNEMONIC_MAX_VALUE + 1> mMnemonics;
+    std::vector<Operand> mOperands;
+    bool mMoreOperands = false;
+
+    static bool parseRegisters(const std::string & text, Registers & registers);
+    static bool parseRange(const std::string & text, Range & range);
+    static bool parseMemory(const std::string & text, Operand & operand, std::string & error);
+};
+
+/**
+\brief Finds the instructions matching a pattern in a buffer, decoded linearly like RefFindInRange (bytes that do not
+       decode are skipped one at a time). Chunks are decoded in parallel and stitched where their instruction
+       boundaries meet, so the results are the same as a sequential sweep. Addresses are appended in order.
+*/
+size_t AsmPatternFind(const AsmPattern & pattern, uint64_t address, const unsigned char* data, size_t size, std::vector<uint64_t> & results, TaskPool & pool = TaskPool::Global());
+
+#endif // _ASMPATTERN_H
@@ -0,0 +1,280 @@
+#include "asmsequence.h"
+#include <algorithm>
+#include <unordered_map>
+#include <cstdlib>
+
+static std::string trim(const std::string & s)
+{
+    auto begin = s.find_first_not_of(" \t");
+    if(begin == std::string::npos)
+        return std::string();
+    auto end = s.find_last_not_of(" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+template<typename Work>
+static void runWorkers(TaskPool & pool, size_t count, const Work & work)
+{
+    Zydis cp; // initializes the shared decoder before the workers use it
+    ParallelFor(0, count, 1, [&](size_t first, size_t last)
+    {
+        for(auto i = first; i < last; i++)
+            work(i);
+    }, nullptr, ParallelProgress(), pool);
+}
+
+bool AsmSequence::Compile(const std::string & text, Mode mode, std::string & error)
+{
+    mMode = mode;
+    mSteps.clear();
+    maxInstructions = (std::min)((std::max)(maxInstructions, 1), 64);
+    int gap = 0;
+    size_t begin = 0;
+    while(begin <= text.size())
+    {
+        auto end = text.find(';', begin);
+        if(end == std::string::npos)
+            end = text.size();
+        auto stepText = trim(text.substr(begin, end - begin));
+        begin = end + 1;
+        if(stepText.compare(0, 3, "...") == 0)
+        {
+            auto count = trim(stepText.substr(3));
+            char* countEnd = nullptr;
+            auto n = count.empty() ? maxGap : strtol(count.c_str(), &countEnd, 16);
+            if(!count.empty() && (*countEnd || n < 0))
+            {
+                error = "invalid gap \"" + stepText + "\"";
+                return false;
+            }
+            gap = int((std::min)(long(gap) + n, long(maxInstructions)));
+            continue;
+        }
+        Step step;
+        if(!step.pattern.Compile(stepText, error))
+            return false;
+        step.gap = gap;
+        gap = 0;
+        mSteps.push_back(step);
+    }
+    if(mSteps.empty())
+    {
+        error = "empty sequence";
+        return false;
+    }
+    if(gap)
+    {
+        error = "a sequence cannot end with a gap";
+        return false;
+    }
+    if(mode == Sequence && mSteps[0].gap)
+    {
+        error = "a sequence cannot start with a gap";
+        return false;
+    }
+    if(mSteps.size() > size_t(maxInstructions))
+    {
+        error = "more steps than maxInstructions";
+        return false;
+    }
+    return true;
+}
+
+uint64_t AsmSequence::stepMask(const Zydis & cp) const
+{
+    uint64_t mask = 0;
+    for(size_t i = 0; i < mSteps.size(); i++)
+        if(mSteps[i].pattern.Match(cp))
+            mask |= 1ull << i;
+    return mask;
+}
+
+// masks[i] has bit j set when instruction i of a linear chain matches step j, returns the instruction count of the match
+int AsmSequence::matchChain(const uint64_t* masks, int count, bool anchorEnd) const
+{
+    uint64_t reach = 0; // positions where the previous step matched
+    for(size_t j = 0; j < mSteps.size(); j++)
+    {
+        uint64_t column = 0;
+        for(int i = 0; i < count; i++)
+            if(masks[i] & (1ull << j))
+                column |= 1ull << i;
+        uint64_t allowed = 0;
+        auto gap = mSteps[j].gap;
+        if(j == 0)
+            allowed = gap >= 63 ? ~0ull : (1ull << (gap + 1)) - 1;
+        else
+            for(int k = 0; k <= gap && k < 63; k++)
+                allowed |= reach << (k + 1);
+        reach = allowed & column;
+        if(!reach)
+            return 0;
+    }
+    if(anchorEnd)
+        return reach & (1ull << (count - 1)) ? count : 0;
+    for(int i = 0; i < count; i++)
+        if(reach & (1ull << i))
+            return i + 1;
+    return 0;
+}
+
+size_t AsmSequence::Match(uint64_t address, const unsigned char* data, size_t size) const
+{
+    Zydis cp;
+    uint64_t masks[64];
+    int count = 0;
+    size_t offset = 0;
+    while(count < maxInstructions && offset < size)
+    {
+        if(!cp.Decode(size_t(address + offset), data + offset, int((std::min)(size_t(MAX_DISASM_BUFFER), size - offset))))
+            break;
+        masks[count++] = stepMask(cp);
+        offset += cp.Size();
+    }
+    return matchChain(masks, count, false);
+}
+
+size_t AsmSequence::Find(const std::vector<AsmBuffer> & buffers, std::vector<AsmSequenceMatch> & results, TaskPool & pool) const
+{
+    if(mSteps.empty())
+        return 0;
+    return mMode == Gadget ? findGadgets(buffers, results, pool) : findSequences(buffers, results, pool);
+}
+
+size_t AsmSequence::findSequences(const std::vector<AsmBuffer> & buffers, std::vector<AsmSequenceMatch> & results, TaskPool & pool) const
+{
+    // the first step is searched like findasmpattern, the candidates are then decoded forward
+    std::vector<std::pair<size_t, uint64_t>> candidates;
+    for(size_t i = 0; i < buffers.size(); i++)
+    {
+        std::vector<uint64_t> found;
+        AsmPatternFind(mSteps[0].pattern, buffers[i].address, buffers[i].data, buffers[i].size, found, pool);
+        for(auto addr : found)
+            candidates.emplace_back(i, addr);
+    }
+
+    const size_t batchSize = 1024;
+    std::vector<AsmSequenceMatch> matches(candidates.size());
+    runWorkers(pool, (candidates.size() + batchSize - 1) / batchSize, [&](size_t batch)
+    {
+        Zydis cp;
+        for(auto i = batch * batchSize; i < (std::min)(candidates.size(), (batch + 1) * batchSize); i++)
+        {
+            const auto & buffer = buffers[candidates[i].first];
+            auto address = candidates[i].second;
+            auto offset = size_t(address - buffer.address);
+            uint64_t masks[64];
+            size_t ends[64];
+            int count = 0;
+            while(count < maxInstructions && offset < buffer.size)
+            {
+                if(!cp.Decode(size_t(buffer.address + offset), buffer.data + offset, int((std::min)(size_t(MAX_DISASM_BUFFER), buffer.size - offset))))
+                    break;
+                masks[count] = stepMask(cp);
+                offset += cp.Size();
+                ends[count++] = offset;
+            }
+            auto instructions = matchChain(masks, count, false);
+            matches[i] = { address, instructions ? size_t(buffer.address + ends[instructions - 1] - address) : 0, size_t(instructions), 1 };
+        }
+    });
+
+    auto count = results.size();
+    for(const auto & match : matches)
+        if(match.instructions)
+            results.push_back(match);
+    return results.size() - count;
+}
+
+struct GadgetChunk
+{
+    size_t buffer;
+    size_t begin;
+    size_t end;
+    std::vector<AsmSequenceMatch> matches;
+};
+
+size_t AsmSequence::findGadgets(const std::vector<AsmBuffer> & buffers, std::vector<AsmSequenceMatch> & results, TaskPool & pool) const
+{
+    const size_t chunkSize = 64 * 1024;
+    std::vector<GadgetChunk> chunks;
+    for(size_t i = 0; i < buffers.size(); i++)
+        for(size_t begin = 0; begin < buffers[i].size; begin += chunkSize)
+            chunks.push_back({ i, begin, (std::min)(buffers[i].size, begin + chunkSize) });
+
+    auto lastStep = 1ull << (mSteps.size() - 1);
+    runWorkers(pool, chunks.size(), [&](size_t index)
+    {
+        auto & chunk = chunks[index];
+        const auto & buffer = buffers[chunk.buffer];
+        // decode every offset of the chunk and the bytes before it once, gadgets are walked on this table
+        auto windowBegin = chunk.begin > maxGadgetBytes ? chunk.begin - maxGadgetBytes : 0;
+        struct Decoded
+        {
+            uint8_t size; // 0 if the bytes do not decode
+            bool branch;
+            uint64_t mask;
+        };
+        std::vector<Decoded> decoded(chunk.end - windowBegin);
+        Zydis cp;
+        for(auto offset = windowBegin; offset < chunk.end; offset++)
+        {
+            auto & d = decoded[offset - windowBegin];
+            if(!cp.Decode(size_t(buffer.address + offset), buffer.data + offset, int((std::min)(size_t(MAX_DISASM_BUFFER), buffer.size - offset))))
+            {
+                d = { 0, false, 0 };
+                continue;
+            }
+            d = { uint8_t(cp.Size()), cp.IsBranchType(Zydis::BTAny), stepMask(cp) };
+        }
+
+        uint64_t masks[64];
+        for(auto end = chunk.begin; end < chunk.end; end++)
+        {
+            if(!(decoded[end - windowBegin].mask & lastStep))
+                continue;
+            auto start = end > windowBegin + maxGadgetBytes ? end - maxGadgetBytes : windowBegin;
+            for(; start <= end; start++)
+            {
+                // the chain from start has to reach end exactly, without branching before it
+                int count = 0;
+                auto offset = start;
+                while(offset < end && count < maxInstructions - 1)
+                {
+                    const auto & d = decoded[offset - windowBegin];
+                    if(!d.size || d.branch)
+                        break;
+                    masks[count++] = d.mask;
+                    offset += d.size;
+                }
+                if(offset != end)
+                    continue;
+                masks[count++] = decoded[end - windowBegin].mask;
+                if(matchChain(masks, count, true))
+                    chunk.matches.push_back({ buffer.address + start, size_t(end - start + decoded[end - windowBegin].size), size_t(count), 1 });
+            }
+        }
+    });
+
+    std::vector<std::pair<AsmSequenceMatch, const unsigned char*>> found;
+    for(const auto & chunk : chunks)
+        for(const auto & match : chunk.matches)
+            found.emplace_back(match, buffers[chunk.buffer].data + size_t(match.address - buffers[chunk.buffer].address));
+    std::sort(found.begin(), found.end(), [](const std::pair<AsmSequenceMatch, const unsigned char*> & a, const std::pair<AsmSequenceMatch, const unsigned char*> & b)
+    {
+        return a.first.address < b.first.address || (a.first.address == b.first.address && a.first.size < b.first.size);
+    });
+
+    // gadgets with the same bytes are the same gadget, keep the first address
+    auto count = results.size();
+    std::unordered_map<std::string, size_t> unique;
+    for(const auto & f : found)
+    {
+        auto inserted = unique.emplace(std::string((const char*)f.second, f.first.size), results.size());
+        if(inserted.second)
+            results.push_back(f.first);
+        else
+            results[inserted.first->second].count++;
+    }
+    return results.size() - count;
+}
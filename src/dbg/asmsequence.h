@@ -0,0 +1,64 @@
+#ifndef _ASMSEQUENCE_H
+#define _ASMSEQUENCE_H
+
+// Instruction sequence and gadget search on caller supplied buffers (no debugger or Windows dependencies)
+
+#include "asmpattern.h"
+
+struct AsmBuffer
+{
+    uint64_t address;
+    const unsigned char* data;
+    size_t size;
+};
+
+struct AsmSequenceMatch
+{
+    uint64_t address;
+    size_t size; // bytes
+    size_t instructions;
+    size_t count; // occurrences with the same bytes (gadgets), 1 for sequences
+};
+
+/**
+\brief Ordered instruction patterns separated by ';', "..." between them skips up to maxGap instructions and "...N"
+       up to N (hex). For example "push rbp; mov rbp, rsp; ...4; sub rsp, imm" or, as a gadget, "...; pop r??; ret".
+       Sequences start at the instructions of a linear sweep (like findasm) and report every start. Gadgets end with an
+       instruction matching the last pattern at any byte offset and are found by decoding backwards from it, the
+       instructions before it may not branch. Gadgets with the same bytes are reported once.
+*/
+class AsmSequence
+{
+public:
+    enum Mode
+    {
+        Sequence,
+        Gadget
+    };
+
+    int maxInstructions = 8; // per match, including skipped ones (at most 64)
+    int maxGap = 8; // for "..." without a count
+    size_t maxGadgetBytes = 0x40;
+
+    bool Compile(const std::string & text, Mode mode, std::string & error);
+    size_t Find(const std::vector<AsmBuffer> & buffers, std::vector<AsmSequenceMatch> & results, TaskPool & pool = TaskPool::Global()) const;
+    // Number of instructions of a match starting at data, 0 if there is none
+    size_t Match(uint64_t address, const unsigned char* data, size_t size) const;
+
+private:
+    struct Step
+    {
+        AsmPattern pattern;
+        int gap; // instructions that may be skipped before this step
+    };
+
+    Mode mMode = Sequence;
+    std::vector<Step> mSteps;
+
+    uint64_t stepMask(const Zydis & cp) const;
+    int matchChain(const uint64_t* masks, int count, bool anchorEnd) const;
+    size_t findSequences(const std::vector<AsmBuffer> & buffers, std::vector<AsmSequenceMatch> & results, TaskPool & pool) const;
+    size_t findGadgets(const std::vector<AsmBuffer> & buffers, std::vector<AsmSequenceMatch> & results, TaskPool & pool) const;
+};
+
+#endif // _ASMSEQUENCE_H
@@ -0,0 +1,561 @@
+#include "benchmark.h"
+#include "patternfind.h"
+#include "expressionparser.h"
+#include "serializablemap.h"
+#include "symbolsourcebase.h"
+#include "murmurhash.h"
+#include "stringformat.h"
+#include "comment.h"
+#include "typedecode.h"
+#include "taskpool.h"
+#include <zydis_wrapper.h>
+#include <random>
+
+class BenchmarkTimer
+{
+public:
+    explicit BenchmarkTimer(BenchmarkResult & result)
+        : mResult(result)
+    {
+        QueryPerformanceCounter(&mStart);
+    }
+
+    ~BenchmarkTimer()
+    {
+        LARGE_INTEGER end, frequency;
+        QueryPerformanceCounter(&end);
+        QueryPerformanceFrequency(&frequency);
+        mResult.us = (end.QuadPart - mStart.QuadPart) * 1000000 / frequency.QuadPart;
+    }
+
+private:
+    BenchmarkResult & mResult;
+    LARGE_INTEGER mStart;
+};
+
+static std::vector<unsigned char> randomBytes(std::mt19937 & rng, size_t size)
+{
+    std::vector<unsigned char> data(size);
+    for(auto & x : data)
+        x = (unsigned char)rng();
+    return data;
+}
+
+static String randomName(std::mt19937 & rng)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+    String name;
+    auto length = 4 + rng() % 28;
+    for(size_t i = 0; i < length; i++)
+        name.push_back(alphabet[rng() % (i ? sizeof(alphabet) - 1 : 53)]);
+    return name;
+}
+
+static unsigned long long mix(unsigned long long checksum, unsigned long long value)
+{
+    return (checksum ^ value) * 0x100000001B3ull;
+}
+
+static void benchPatternfind(std::mt19937 & rng, BenchmarkResult & result)
+{
+    auto data = randomBytes(rng, 16 * 1024 * 1024);
+    std::vector<PatternByte> pattern;
+    patterntransform("48 8B ?? 24 ?8 4? 89", pattern);
+    // a single hit near the end so every search scans the whole buffer
+    const unsigned char needle[] = { 0x48, 0x8B, 0x05, 0x24, 0x18, 0x41, 0x89 };
+    memcpy(data.data() + data.size() - 1000, needle, sizeof(needle));
+    BenchmarkTimer timer(result);
+    for(int i = 0; i < 4; i++)
+    {
+        size_t offset = 0;
+        while(true)
+        {
+            auto found = patternfind(data.data() + offset, data.size() - offset, pattern);
+            if(found == -1)
+                break;
+            result.checksum = mix(result.checksum, offset + found);
+            offset += found + 1;
+            result.items++;
+        }
+        result.bytes += data.size();
+    }
+}
+
+static void benchExpressionParser(std::mt19937 & rng, BenchmarkResult & result)
+{
+    std::vector<String> expressions;
+    for(int i = 0; i < 256; i++)
+    {
+        expressions.push_back(StringUtils::sprintf("(%X+%X)*%X-(%X<<%X)/(%X|1)^%X&&%X==%X",
+                              rng() & 0xFFFF, rng() & 0xFFFF, rng() & 0xFF, rng() & 0xFFFF, rng() & 7, rng() & 0xFF, rng(), rng() & 1, rng() & 1));
+    }
+    BenchmarkTimer timer(result);
+    for(int i = 0; i < 200; i++)
+    {
+        for(const auto & expression : expressions)
+        {
+            ExpressionParser parser(expression);
+            duint value = 0;
+            if(parser.Calculate(value, false, false))
+                result.checksum = mix(result.checksum, value);
+            result.items++;
+        }
+    }
+}
+
+struct BenchCommentSerializer : AddrInfoSerializer<COMMENTSINFO>
+{
+    bool Save(const COMMENTSINFO & value) override
+    {
+        AddrInfoSerializer::Save(value);
+        setString("text", value.text);
+        return true;
+    }
+
+    bool Load(COMMENTSINFO & value) override
+    {
+        return AddrInfoSerializer::Load(value) &&
+               getString("text", value.text);
+    }
+};
+
+// same layout as the comments database section
+struct BenchComments : AddrInfoHashMap<LockBenchmark, COMMENTSINFO, BenchCommentSerializer>
+{
+    const char* jsonKey() const override
+    {
+        return "comments";
+    }
+};
+
+static std::vector<COMMENTSINFO> randomComments(std::mt19937 & rng, size_t count)
+{
+    std::vector<COMMENTSINFO> values(count);
+    for(auto & value : values)
+    {
+        value.modhash = 0;
+        value.addr = rng() & 0xFFFFFF;
+        value.manual = (rng() & 1) != 0;
+        value.text = randomName(rng);
+    }
+    return values;
+}
+
+static void benchSerializableMap(std::mt19937 & rng, BenchmarkResult & result)
+{
+    auto values = randomComments(rng, 100000);
+    BenchComments map;
+    BenchmarkTimer timer(result);
+    for(const auto & value : values)
+        map.Add(value);
+    COMMENTSINFO found;
+    for(int i = 0; i < 4; i++)
+    {
+        for(const auto & value : values)
+        {
+            if(map.Get(value.addr, found))
+                result.checksum = mix(result.checksum, found.text.size());
+        }
+    }
+    result.items = values.size() * 5;
+}
+
+static void benchJanssonSection(std::mt19937 & rng, BenchmarkResult & result)
+{
+    auto values = randomComments(rng, 100000);
+    BenchComments map;
+    for(const auto & value : values)
+        map.Add(value);
+    BenchmarkTimer timer(result);
+    // what the database does for one section: serialize, dump, load, deserialize
+    auto root = json_object();
+    map.CacheSave(root);
+    auto text = json_dumps(root, JSON_COMPACT);
+    json_decref(root);
+    if(!text)
+        return;
+    auto size = strlen(text);
+    root = json_loadb(text, size, 0, 0);
+    json_free(text);
+    map.Clear();
+    map.CacheLoad(root);
+    json_decref(root);
+    std::vector<COMMENTSINFO> loaded;
+    map.GetList(loaded);
+    result.items = values.size();
+    result.bytes = size;
+    result.checksum = mix(size, loaded.size());
+}
+
+static void benchNameIndex(std::mt19937 & rng, BenchmarkResult & result)
+{
+    std::vector<String> names;
+    for(int i = 0; i < 200000; i++)
+        names.push_back(randomName(rng));
+    std::vector<NameIndex> byName(names.size());
+    for(size_t i = 0; i < names.size(); i++)
+    {
+        byName[i].name = names[i].c_str();
+        byName[i].index = i;
+    }
+    std::sort(byName.begin(), byName.end());
+    std::vector<String> prefixes;
+    for(int i = 0; i < 20000; i++)
+    {
+        auto & name = names[rng() % names.size()];
+        prefixes.push_back(name.substr(0, 1 + rng() % 4));
+    }
+    BenchmarkTimer timer(result);
+    for(const auto & prefix : prefixes)
+    {
+        NameIndex::findByPrefix(byName, prefix, [&result](const NameIndex & index)
+        {
+            result.checksum = mix(result.checksum, index.index);
+            return true;
+        }, (result.items & 1) != 0);
+        result.items++;
+    }
+}
+
+static void benchCompressedHex(std::mt19937 & rng, BenchmarkResult & result)
+{
+    // encode maps are long runs of the same type byte with short changes in between
+    std::vector<unsigned char> data(4 * 1024 * 1024);
+    for(size_t i = 0; i < data.size();)
+    {
+        auto run = (std::min)(size_t(1 + rng() % 64), data.size() - i);
+        memset(data.data() + i, rng() % 8, run);
+        i += run;
+    }
+    BenchmarkTimer timer(result);
+    for(int i = 0; i < 4; i++)
+    {
+        auto text = StringUtils::ToCompressedHex(data.data(), data.size());
+        std::vector<unsigned char> decoded;
+        if(StringUtils::FromCompressedHex(text, decoded))
+            result.checksum = mix(result.checksum, text.size() + decoded.size());
+        result.items++;
+        result.bytes += data.size();
+    }
+}
+
+static void benchHex(std::mt19937 & rng, BenchmarkResult & result)
+{
+    auto data = randomBytes(rng, 4 * 1024 * 1024);
+    BenchmarkTimer timer(result);
+    for(int i = 0; i < 4; i++)
+    {
+        auto text = StringUtils::ToHex(data.data(), data.size());
+        std::vector<unsigned char> decoded;
+        if(StringUtils::FromHex(text, decoded))
+            result.checksum = mix(result.checksum, text.size() + decoded.size());
+        result.items++;
+        result.bytes += data.size();
+    }
+}
+
+// Byte at a time reference encoders, the vectorized codecs have to produce exactly the same text
+static String scalarToHex(const unsigned char* buffer, size_t size)
+{
+    const char* digits = "0123456789ABCDEF";
+    String result;
+    for(size_t i = 0; i < size; i++)
+    {
+        result.push_back(digits[buffer[i] >> 4]);
+        result.push_back(digits[buffer[i] & 0xF]);
+    }
+    return result;
+}
+
+static String scalarToCompressedHex(const unsigned char* buffer, size_t size)
+{
+    const char* digits = "0123456789ABCDEF";
+    String result;
+    for(size_t i = 0; i < size;)
+    {
+        size_t repeat = 0;
+        auto ch = buffer[i];
+        for(; i < size && buffer[i] == ch; i++)
+            repeat++;
+        result.push_back(digits[ch >> 4]);
+        result.push_back(digits[ch & 0xF]);
+        if(repeat == 2)
+        {
+            result.push_back(digits[ch >> 4]);
+            result.push_back(digits[ch & 0xF]);
+        }
+        else if(repeat > 2)
+            result.append(StringUtils::sprintf("{%llX}", (unsigned long long)repeat));
+    }
+    return result;
+}
+
+// Round trip fuzzing of the hex codecs against the scalar encoders: random lengths and alignments, lowercase digits and whitespace
+static void benchHexRoundTrip(std::mt19937 & rng, BenchmarkResult & result)
+{
+    BenchmarkTimer timer(result);
+    std::vector<unsigned char> decoded;
+    for(int i = 0; i < 20000; i++)
+    {
+        std::vector<unsigned char> data(rng() % 300);
+        auto alphabet = 1 + rng() % 256;
+        for(size_t j = 0; j < data.size();)
+        {
+            auto run = (std::min)(size_t(1 + rng() % (i % 2 ? 40 : 3)), data.size() - j);
+            memset(data.data() + j, rng() % alphabet, run);
+            j += run;
+        }
+        auto offset = rng() % 16; // unaligned input
+        std::vector<unsigned char> input(offset);
+        input.insert(input.end(), data.begin(), data.end());
+        auto text = StringUtils::ToCompressedHex(input.data() + offset, data.size());
+        if(text != scalarToCompressedHex(data.data(), data.size()))
+            result.errors++;
+        if(!data.empty())
+        {
+            if(!StringUtils::FromCompressedHex(text, decoded) || decoded != data)
+                result.errors++;
+            size_t size;
+            if(!StringUtils::FromCompressedHex(text.c_str(), text.size(), nullptr, size) || size != data.size())
+                result.errors++;
+            else
+            {
+                decoded.assign(size, 0);
+                if(!StringUtils::FromCompressedHex(text.c_str(), text.size(), decoded.data(), size) || decoded != data)
+                    result.errors++;
+                size--;
+                if(StringUtils::FromCompressedHex(text.c_str(), text.size(), decoded.data(), size)) // too small
+                    result.errors++;
+            }
+            // lowercase, with whitespace between the byte pairs of runs without a repeat count
+            String spaced;
+            for(size_t j = 0; j < text.size(); j++)
+            {
+                if(j % 2 == 0 && text.find('{') == String::npos && rng() % 8 == 0)
+                    spaced.push_back(" \t\r\n"[rng() % 4]);
+                spaced.push_back((char)tolower(text[j]));
+            }
+            if(!StringUtils::FromCompressedHex(spaced, decoded) || decoded != data)
+                result.errors++;
+            // half a byte or a missing '}'
+            if(StringUtils::FromCompressedHex(text.substr(0, text.size() - 1), decoded))
+                result.errors++;
+        }
+        auto hex = StringUtils::ToHex(input.data() + offset, data.size());
+        if(hex != scalarToHex(data.data(), data.size()))
+            result.errors++;
+        if(!StringUtils::FromHex(hex, decoded) || decoded != data)
+            result.errors++;
+        if(!hex.empty())
+        {
+            hex[rng() % hex.size()] = "gG:/@`{ "[rng() % 8];
+            if(StringUtils::FromHex(hex, decoded))
+                result.errors++;
+        }
+        result.checksum = mix(result.checksum, text.size());
+        result.items++;
+        result.bytes += data.size();
+    }
+}
+
+static void benchMurmurHash(std::mt19937 & rng, BenchmarkResult & result)
+{
+    auto data = randomBytes(rng, 16 * 1024 * 1024);
+    BenchmarkTimer timer(result);
+    for(int i = 0; i < 4; i++)
+    {
+        for(size_t offset = 0; offset < data.size(); offset += PAGE_SIZE)
+        {
+            unsigned long long hash[2];
+            MurmurHash3_x64_128(data.data() + offset, PAGE_SIZE, 0x1337, hash);
+            result.checksum = mix(result.checksum, hash[0] ^ hash[1]);
+            result.items++;
+        }
+        result.bytes += data.size();
+    }
+}
+
+static void benchParallelFor(std::mt19937 & rng, BenchmarkResult & result)
+{
+    // items of very uneven cost, like functions in a module
+    auto data = randomBytes(rng, 16 * 1024 * 1024);
+    const size_t pageCount = data.size() / PAGE_SIZE;
+    std::vector<std::pair<size_t, size_t>> items(8192);
+    for(auto & item : items)
+    {
+        item.first = rng() % pageCount;
+        item.second = rng() % 16 ? 1 : 1 + rng() % 64;
+        item.second = min(item.second, pageCount - item.first);
+        result.bytes += item.second * PAGE_SIZE;
+    }
+    auto hashItem = [&](size_t i)
+    {
+        unsigned long long hash[2];
+        MurmurHash3_x64_128(data.data() + items[i].first * PAGE_SIZE, int(items[i].second * PAGE_SIZE), 0x1337, hash);
+        return hash[0] ^ hash[1];
+    };
+    std::vector<unsigned long long> hashes(items.size());
+    {
+        BenchmarkTimer timer(result);
+        ParallelFor(0, items.size(), 0, [&](size_t first, size_t last)
+        {
+            for(auto i = first; i < last; i++)
+                hashes[i] = hashItem(i);
+        });
+    }
+    result.items = items.size();
+    for(size_t i = 0; i < items.size(); i++)
+    {
+        result.checksum = mix(result.checksum, hashes[i]);
+        if(hashes[i] != hashItem(i))
+            result.errors++;
+    }
+}
+
+static void benchZydis(std::mt19937 & rng, BenchmarkResult & result)
+{
+    auto data = randomBytes(rng, 4 * 1024 * 1024);
+    Zydis cp;
+    BenchmarkTimer timer(result);
+    for(size_t offset = 0; offset + MAX_DISASM_BUFFER <= data.size();)
+    {
+        if(cp.Disassemble(offset, data.data() + offset))
+        {
+            result.checksum = mix(result.checksum, cp.GetId());
+            offset += cp.Size();
+        }
+        else
+            offset++;
+        result.items++;
+    }
+    result.bytes = data.size();
+}
+
+static void benchStringformat(std::mt19937 & rng, BenchmarkResult & result)
+{
+    std::vector<String> arguments;
+    for(int i = 0; i < 64; i++)
+        arguments.push_back(StringUtils::sprintf("%X", rng()));
+    BenchmarkTimer timer(result);
+    for(int i = 0; i < 20000; i++)
+    {
+        FormatValueVector values = { arguments[i % 64].c_str(), arguments[(i + 1) % 64].c_str(), arguments[(i + 2) % 64].c_str() };
+        auto text = stringformat("value {0} at {x:1}, count {d:2} ({u:0})", values);
+        result.checksum = mix(result.checksum, text.size());
+        result.items++;
+    }
+}
+
+// Decodes 100k synthetic struct instances with a pointer into a table and checks the columns
+static void benchTypeDecode(std::mt19937 & rng, BenchmarkResult & result)
+{
+    Types::TypeManager types;
+    types.AddStruct("bench", "Node");
+    types.AddMember("Node", "int", "value");
+    types.AddMember("Node", "Node*", "next");
+    types.AddStruct("bench", "Row");
+    types.AddMember("Row", "uint32_t", "id");
+    types.AddMember("Row", "char", "tag", 4);
+    types.AddMember("Row", "double", "weight");
+    types.AddMember("Row", "Node*", "node");
+    TypeDecoder decoder;
+    if(!decoder.Compile(*types.GetLayout("Row")))
+    {
+        result.errors++;
+        return;
+    }
+
+    // the rows point into a node pool at a fake address
+    const size_t rows = 100000;
+    const uint64_t poolBase = 0x10000000;
+    const size_t nodeSize = sizeof(int) + sizeof(void*);
+    auto stride = size_t(decoder.Stride());
+    auto pool = randomBytes(rng, 4096 * nodeSize);
+    auto data = randomBytes(rng, rows * stride);
+    std::vector<unsigned int> nodes(rows);
+    for(size_t i = 0; i < rows; i++)
+    {
+        auto instance = data.data() + i * stride;
+        auto id = (unsigned int)i;
+        memcpy(instance, &id, sizeof(id));
+        nodes[i] = rng() % 4096;
+        uint64_t ptr = i % 8 ? poolBase + nodes[i] * nodeSize : 0;
+        memcpy(instance + stride - sizeof(void*), &ptr, sizeof(void*));
+    }
+    auto read = [&](uint64_t addr, void* dest, size_t size)
+    {
+        if(addr < poolBase || addr - poolBase + size > pool.size())
+            return false;
+        memcpy(dest, pool.data() + (addr - poolBase), size);
+        return true;
+    };
+
+    TypeDecodeTable table;
+    {
+        BenchmarkTimer timer(result);
+        for(int i = 0; i < 4; i++)
+        {
+            result.items += decoder.Decode(data.data(), data.size(), 0x400000, rows, table, read);
+            result.bytes += data.size();
+        }
+    }
+    const auto & fields = decoder.Fields();
+    for(size_t f = 0; f < fields.size(); f++)
+    {
+        const auto & column = table.columns[f];
+        for(size_t row = 0; row < table.rows; row++)
+        {
+            if(fields[f].name == "id" && column.values[row] != row)
+                result.errors++;
+            if(fields[f].name == "node->value")
+            {
+                int expected;
+                memcpy(&expected, pool.data() + nodes[row] * nodeSize, sizeof(expected));
+                if(column.valid[row] != (row % 8 != 0) || (column.valid[row] && int(column.values[row]) != expected))
+                    result.errors++;
+            }
+            result.checksum = mix(result.checksum, column.valid[row] ? column.values[row] : 0);
+        }
+    }
+}
+
+struct BenchmarkEntry
+{
+    const char* name;
+    void(*run)(std::mt19937 & rng, BenchmarkResult & result);
+};
+
+static const BenchmarkEntry benchmarks[] =
+{
+    { "patternfind", benchPatternfind },
+    { "expressionparser", benchExpressionParser },
+    { "serializablemap", benchSerializableMap },
+    { "jansson", benchJanssonSection },
+    { "nameindex", benchNameIndex },
+    { "compressedhex", benchCompressedHex },
+    { "hex", benchHex },
+    { "hexroundtrip", benchHexRoundTrip },
+    { "murmurhash", benchMurmurHash },
+    { "parallelfor", benchParallelFor },
+    { "zydis", benchZydis },
+    { "stringformat", benchStringformat },
+    { "typedecode", benchTypeDecode },
+};
+
+size_t BenchmarkRun(unsigned int seed, const char* filter, const BenchmarkCallback & callback)
+{
+    size_t count = 0;
+    for(const auto & benchmark : benchmarks)
+    {
+        if(filter && *filter && !StringUtils::StartsWith(benchmark.name, filter))
+            continue;
+        // every benchmark gets its own generator, so filtering does not change the inputs
+        std::mt19937 rng(seed);
+        BenchmarkResult result;
+        result.name = benchmark.name;
+        benchmark.run(rng, result);
+        callback(result);
+        count++;
+    }
+    return count;
+}
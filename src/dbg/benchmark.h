@@ -0,0 +1,22 @@
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+#include "_global.h"
+#include <functional>
+
+struct BenchmarkResult
+{
+    const char* name;
+    unsigned long long items = 0; // operations timed
+    unsigned long long bytes = 0; // input bytes processed, 0 when not meaningful
+    unsigned long long us = 0;
+    unsigned long long checksum = 0; // depends only on the seed, compare runs to make sure they did the same work
+    unsigned long long errors = 0; // failed self checks
+};
+
+typedef std::function<void(const BenchmarkResult & result)> BenchmarkCallback;
+
+// Runs the core data structure benchmarks whose name starts with filter (nullptr or empty for all) on synthetic inputs generated from seed
+size_t BenchmarkRun(unsigned int seed, const char* filter, const BenchmarkCallback & callback);
+
+#endif // _BENCHMARK_H
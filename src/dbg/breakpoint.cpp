@@ -12,10 +12,46 @@
 #include "debugger.h"
 #include "exception.h"
 #include <algorithm>
+#include <unordered_map>
 
 typedef std::pair<BP_TYPE, duint> BreakpointKey;
 std::map<BreakpointKey, BREAKPOINT> breakpoints;
 
+// Keys of the breakpoints in breakpoints by BREAKPOINT::mod, so module loads only touch their own breakpoints
+static std::unordered_map<String, std::set<BreakpointKey>> breakpointModules;
+
+static std::pair<std::map<BreakpointKey, BREAKPOINT>::iterator, bool> bpInsert(const BreakpointKey & key, const BREAKPOINT & bp)
+{
+    auto result = breakpoints.insert(std::make_pair(key, bp));
+    if(result.second)
+        breakpointModules[bp.mod].insert(key);
+    return result;
+}
+
+static bool bpErase(const BreakpointKey & key)
+{
+    auto found = breakpoints.find(key);
+    if(found == breakpoints.end())
+        return false;
+    auto module = breakpointModules.find(found->second.mod);
+    if(module != breakpointModules.end())
+    {
+        module->second.erase(found->first);
+        if(module->second.empty())
+            breakpointModules.erase(module);
+    }
+    breakpoints.erase(found);
+    return true;
+}
+
+// Base added to the rva of a (non DLL/exception) breakpoint to get its address
+static duint bpModuleBase(const BREAKPOINT & bp, duint base)
+{
+    if(base) //workaround for some Windows bullshit with compatibility mode
+        return base;
+    return ModBaseFromName(bp.mod);
+}
+
 static void setBpActive(BREAKPOINT & bp)
 {
     // DLL/Exception breakpoints are always enabled
@@ -131,11 +167,11 @@ bool BpNew(duint Address, bool Enable, bool Singleshot, short OldBytes, BP_TYPE
 
     if(Type != BPDLL && Type != BPEXCEPTION)
     {
-        return breakpoints.insert(std::make_pair(BreakpointKey(Type, ModHashFromAddr(Address)), bp)).second;
+        return bpInsert(BreakpointKey(Type, ModHashFromAddr(Address)), bp).second;
     }
     else
     {
-        return breakpoints.insert(std::make_pair(BreakpointKey(Type, Address), bp)).second;
+        return bpInsert(BreakpointKey(Type, Address), bp).second;
     }
 }
 
@@ -159,7 +195,35 @@ bool BpNewDll(const char* module, bool Enable, bool Singleshot, DWORD TitanType,
     // Insert new entry to the global list
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
 
-    return breakpoints.insert(std::make_pair(BreakpointKey(BPDLL, bp.addr), bp)).second;
+    return bpInsert(BreakpointKey(BPDLL, bp.addr), bp).second;
+}
+
+size_t BpNewBulk(const std::vector<BREAKPOINT> & List, bool* Results)
+{
+    ASSERT_DEBUGGING("Export call");
+    EXCLUSIVE_ACQUIRE(LockBreakpoints);
+
+    size_t count = 0;
+    for(size_t i = 0; i < List.size(); i++)
+    {
+        BREAKPOINT bp = List[i];
+        auto address = bp.addr;
+        BreakpointKey key(bp.type, address);
+        if(bp.type != BPDLL && bp.type != BPEXCEPTION)
+        {
+            *bp.mod = '\0';
+            ModNameFromAddr(address, bp.mod, true);
+            bp.addr = address - ModBaseFromAddr(address);
+            key.second = ModHashFromAddr(address);
+        }
+        bp.active = true;
+        auto inserted = bpInsert(key, bp).second;
+        if(Results)
+            Results[i] = inserted;
+        if(inserted)
+            count++;
+    }
+    return count;
 }
 
 bool BpGet(duint Address, BP_TYPE Type, const char* Name, BREAKPOINT* Bp)
@@ -303,8 +367,8 @@ bool BpUpdateDllPath(const char* module1, BREAKPOINT** newBpInfo)
                 strcpy_s(temp.mod, module1);
                 _strlwr_s(temp.mod, strlen(temp.mod) + 1);
                 temp.addr = ModHashFromName(module1);
-                breakpoints.erase(i.first);
-                auto newItem = breakpoints.insert(std::make_pair(BreakpointKey(BPDLL, temp.addr), temp));
+                bpErase(i.first);
+                auto newItem = bpInsert(BreakpointKey(BPDLL, temp.addr), temp);
                 *newBpInfo = &newItem.first->second;
                 return true;
             }
@@ -320,8 +384,8 @@ bool BpUpdateDllPath(const char* module1, BREAKPOINT** newBpInfo)
                 strcpy_s(temp.mod, dashPos1 + 1);
                 _strlwr_s(temp.mod, strlen(temp.mod) + 1);
                 temp.addr = ModHashFromName(dashPos1 + 1);
-                breakpoints.erase(i.first);
-                auto newItem = breakpoints.insert(std::make_pair(BreakpointKey(BPDLL, temp.addr), temp));
+                bpErase(i.first);
+                auto newItem = bpInsert(BreakpointKey(BPDLL, temp.addr), temp);
                 *newBpInfo = &newItem.first->second;
                 return true;
             }
@@ -348,9 +412,57 @@ bool BpDelete(duint Address, BP_TYPE Type)
 
     // Erase the index from the global list
     if(Type != BPDLL)
-        return (breakpoints.erase(BreakpointKey(Type, ModHashFromAddr(Address))) > 0);
+        return bpErase(BreakpointKey(Type, ModHashFromAddr(Address)));
     else
-        return (breakpoints.erase(BreakpointKey(BPDLL, Address)) > 0);
+        return bpErase(BreakpointKey(BPDLL, Address));
+}
+
+size_t BpDeleteBulk(BP_TYPE Type, const duint* Addresses, size_t Count, bool* Results, bool* WasEnabled)
+{
+    ASSERT_DEBUGGING("Export call");
+    EXCLUSIVE_ACQUIRE(LockBreakpoints);
+
+    size_t count = 0;
+    for(size_t i = 0; i < Count; i++)
+    {
+        auto found = breakpoints.find(BreakpointKey(Type, Type != BPDLL && Type != BPEXCEPTION ? ModHashFromAddr(Addresses[i]) : Addresses[i]));
+        auto deleted = found != breakpoints.end();
+        if(WasEnabled)
+            WasEnabled[i] = deleted && found->second.enabled;
+        if(deleted)
+        {
+            bpErase(found->first);
+            count++;
+        }
+        if(Results)
+            Results[i] = deleted;
+    }
+    return count;
+}
+
+size_t BpEnableBulk(BP_TYPE Type, const duint* Addresses, size_t Count, bool Enable, const unsigned short* OldBytes, bool* Results, bool* WasEnabled, DWORD* TitanTypes)
+{
+    ASSERT_DEBUGGING("Export call");
+    EXCLUSIVE_ACQUIRE(LockBreakpoints);
+
+    size_t count = 0;
+    for(size_t i = 0; i < Count; i++)
+    {
+        auto bpInfo = BpInfoFromAddr(Type, Addresses[i]);
+        if(WasEnabled)
+            WasEnabled[i] = bpInfo && bpInfo->enabled;
+        if(TitanTypes)
+            TitanTypes[i] = bpInfo ? bpInfo->titantype : 0;
+        if(Results)
+            Results[i] = bpInfo != nullptr;
+        if(!bpInfo)
+            continue;
+        if(Enable && !bpInfo->enabled && Type == BPNORMAL && OldBytes)
+            bpInfo->oldbytes = OldBytes[i];
+        bpInfo->enabled = Enable;
+        count++;
+    }
+    return count;
 }
 
 bool BpEnable(duint Address, BP_TYPE Type, bool Enable)
@@ -532,45 +644,108 @@ bool BpSetSilent(duint Address, BP_TYPE Type, bool silent)
     return true;
 }
 
-bool BpEnumAll(BPENUMCALLBACK EnumCallback, const char* Module, duint base)
+size_t BpGetModuleList(const char* Module, duint base, std::vector<BREAKPOINT> & List)
 {
-    ASSERT_DEBUGGING("Export call");
     SHARED_ACQUIRE(LockBreakpoints);
 
-    // Loop each entry, executing the user's callback
-    bool callbackStatus = true;
-
-    for(auto i = breakpoints.begin(); i != breakpoints.end();)
+    auto add = [&List](const BREAKPOINT & bp, duint modbase)
     {
-        auto j = i;
-        ++i; // Increment here, because the callback might remove the current entry
+        List.push_back(bp);
+        auto & bpInfo = List.back();
+        if(bpInfo.type != BPDLL && bpInfo.type != BPEXCEPTION)
+            bpInfo.addr += modbase;
+        setBpActive(bpInfo);
+    };
 
-        // If a module name was sent, check it
-        if(Module)
+    auto count = List.size();
+    if(Module)
+    {
+        auto found = breakpointModules.find(Module);
+        if(found == breakpointModules.end())
+            return 0;
+        // All breakpoints share the module, look up its base once
+        duint modbase = 0;
+        auto needBase = true;
+        List.reserve(List.size() + found->second.size());
+        for(const auto & key : found->second)
         {
-            if(strcmp(j->second.mod, Module) != 0)
-                continue;
+            const auto & bp = breakpoints.find(key)->second;
+            if(needBase && bp.type != BPDLL && bp.type != BPEXCEPTION)
+            {
+                modbase = bpModuleBase(bp, base);
+                needBase = false;
+            }
+            add(bp, modbase);
         }
+    }
+    else
+    {
+        List.reserve(List.size() + breakpoints.size());
+        for(const auto & i : breakpoints)
+            add(i.second, i.second.type != BPDLL && i.second.type != BPEXCEPTION ? bpModuleBase(i.second, base) : 0);
+    }
+    return List.size() - count;
+}
 
-        BREAKPOINT bpInfo = j->second;
-        if(bpInfo.type != BPDLL && bpInfo.type != BPEXCEPTION)
+int BpUpdateModuleList(const std::vector<BREAKPOINT> & Original, const std::vector<BREAKPOINT> & List, duint base)
+{
+    ASSERT_DEBUGGING("Export call");
+    if(Original.size() != List.size())
+        return 0;
+    EXCLUSIVE_ACQUIRE(LockBreakpoints);
+
+    int updated = 0;
+    const char* lastModule = nullptr;
+    duint lastBase = 0, lastHash = 0;
+    for(size_t i = 0; i < List.size(); i++)
+    {
+        // Only the fields changed since BpGetModuleList, the user can modify the others in the meantime
+        const auto & bp = List[i];
+        const auto & original = Original[i];
+        auto enabledChanged = bp.enabled != original.enabled;
+        auto titantypeChanged = bp.titantype != original.titantype;
+        if(!enabledChanged && !titantypeChanged)
+            continue;
+        BreakpointKey key(bp.type, bp.addr);
+        if(bp.type != BPDLL && bp.type != BPEXCEPTION)
         {
-            if(base) //workaround for some Windows bullshit with compatibility mode
-                bpInfo.addr += base;
-            else
-                bpInfo.addr += ModBaseFromName(bpInfo.mod);
+            // Cache of the last module lookup, the breakpoints of a module are usually listed together
+            if(!lastModule || strcmp(lastModule, bp.mod) != 0)
+            {
+                lastModule = bp.mod;
+                lastBase = bpModuleBase(bp, base);
+                lastHash = ModHashFromName(bp.mod);
+            }
+            key.second = lastHash + (bp.addr - lastBase);
         }
-        setBpActive(bpInfo);
+        auto found = breakpoints.find(key);
+        if(found == breakpoints.end())
+            continue;
+        auto & bpInfo = found->second;
+        if(enabledChanged)
+            bpInfo.enabled = bp.enabled;
+        if(titantypeChanged)
+            bpInfo.titantype = bp.titantype;
+        updated++;
+    }
+    return updated;
+}
+
+bool BpEnumAll(BPENUMCALLBACK EnumCallback, const char* Module, duint base)
+{
+    ASSERT_DEBUGGING("Export call");
 
-        // Lock must be released due to callback sub-locks
-        SHARED_RELEASE();
+    // Copy the breakpoints under a single lock, the callbacks take their own locks and might remove entries
+    std::vector<BREAKPOINT> list;
+    BpGetModuleList(Module, base, list);
 
-        // Execute the callback
+    // Loop each entry, executing the user's callback
+    bool callbackStatus = true;
+
+    for(auto & bpInfo : list)
+    {
         if(!EnumCallback(&bpInfo))
             callbackStatus = false;
-
-        // Restore the breakpoint map lock
-        SHARED_REACQUIRE();
     }
 
     return callbackStatus;
@@ -870,7 +1045,8 @@ void BpCacheLoad(JSON Root)
         {
             key = BpGetDLLBpAddr(breakpoint.mod);
         }
-        breakpoints[BreakpointKey(breakpoint.type, key)] = breakpoint;
+        bpErase(BreakpointKey(breakpoint.type, key));
+        bpInsert(BreakpointKey(breakpoint.type, key), breakpoint);
     }
 }
 
@@ -878,4 +1054,5 @@ void BpClear()
 {
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
     breakpoints.clear();
+    breakpointModules.clear();
 }
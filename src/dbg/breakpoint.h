@@ -50,6 +50,10 @@ BREAKPOINT* BpInfoFromAddr(BP_TYPE Type, duint Address);
 int BpGetList(std::vector<BREAKPOINT>* List);
 bool BpNew(duint Address, bool Enable, bool Singleshot, short OldBytes, BP_TYPE Type, DWORD TitanType, const char* Name, duint memsize = 0);
 bool BpNewDll(const char* module, bool Enable, bool Singleshot, DWORD TitanType, const char* Name);
+// Bulk versions under a single lock, the arrays are indexed like the input and the optional ones can be nullptr
+size_t BpNewBulk(const std::vector<BREAKPOINT> & List, bool* Results);
+size_t BpDeleteBulk(BP_TYPE Type, const duint* Addresses, size_t Count, bool* Results, bool* WasEnabled);
+size_t BpEnableBulk(BP_TYPE Type, const duint* Addresses, size_t Count, bool Enable, const unsigned short* OldBytes, bool* Results, bool* WasEnabled, DWORD* TitanTypes);
 bool BpGet(duint Address, BP_TYPE Type, const char* Name, BREAKPOINT* Bp);
 bool BpGetAny(BP_TYPE Type, const char* Name, BREAKPOINT* Bp);
 bool BpDelete(duint Address, BP_TYPE Type);
@@ -67,6 +71,10 @@ bool BpEnumAll(BPENUMCALLBACK EnumCallback, const char* Module, duint base = 0);
 bool BpSetSilent(duint Address, BP_TYPE Type, bool silent);
 duint BpGetDLLBpAddr(const char* fileName);
 bool BpEnumAll(BPENUMCALLBACK EnumCallback);
+// Appends the breakpoints of Module (all when nullptr) to List with absolute addresses, under a single lock
+size_t BpGetModuleList(const char* Module, duint base, std::vector<BREAKPOINT> & List);
+// Writes back the enabled flags and titantypes that differ between List and Original (the unmodified list from BpGetModuleList), under a single lock
+int BpUpdateModuleList(const std::vector<BREAKPOINT> & Original, const std::vector<BREAKPOINT> & List, duint base = 0);
 int BpGetCount(BP_TYPE Type, bool EnabledOnly = false);
 uint32 BpGetHitCount(duint Address, BP_TYPE Type);
 bool BpResetHitCount(duint Address, BP_TYPE Type, uint32 newHitCount);
@@ -0,0 +1,159 @@
+#include "codefolding.h"
+#include "module.h"
+#include "memory.h"
+#include "threading.h"
+#include <atomic>
+
+struct CodeFoldSerializer : JSONWrapper<CODEFOLDSINFO>
+{
+    bool Save(const CODEFOLDSINFO & value) override
+    {
+        setString("module", value.mod());
+        setHex("start", value.start);
+        setHex("end", value.end);
+        setBool("folded", value.folded);
+        setBool("manual", value.manual);
+        return true;
+    }
+
+    bool Load(CODEFOLDSINFO & value) override
+    {
+        std::string mod;
+        if(!getString("module", mod))
+            return false;
+        value.modhash = ModHashFromName(mod.c_str());
+        return getHex("start", value.start) &&
+               getHex("end", value.end) &&
+               getBool("folded", value.folded) &&
+               getBool("manual", value.manual) &&
+               value.end >= value.start;
+    }
+};
+
+// Folds nest, so unlike the other range maps the key is the exact range and not an overlap comparison
+struct CodeFolds : SerializableMap<LockCodeFolds, ModuleRange, CODEFOLDSINFO, CodeFoldSerializer>
+{
+    static ModuleRange VaKey(duint start, duint end)
+    {
+        auto moduleBase = ModBaseFromAddr(start);
+        return ModuleRange(ModHashFromAddr(moduleBase), Range(start - moduleBase, end - moduleBase));
+    }
+
+    void AdjustValue(CODEFOLDSINFO & value) const override
+    {
+        auto base = ModBaseFromName(value.mod().c_str());
+        value.start += base;
+        value.end += base;
+    }
+
+protected:
+    const char* jsonKey() const override
+    {
+        return "codefolds";
+    }
+
+    ModuleRange makeKey(const CODEFOLDSINFO & value) const override
+    {
+        return ModuleRange(value.modhash, Range(value.start, value.end));
+    }
+};
+
+static CodeFolds codeFolds;
+// Incremented on every change so the GUI only reloads the folds when something happened
+static std::atomic<duint> codeFoldGeneration(1);
+
+bool CodeFoldSet(duint Start, duint End, bool Folded, bool Manual)
+{
+    // Make sure memory is readable
+    if(!MemIsValidReadPtr(Start))
+        return false;
+
+    // Fail if boundary exceeds module size
+    auto moduleBase = ModBaseFromAddr(Start);
+
+    if(moduleBase != ModBaseFromAddr(End) || Start > End)
+        return false;
+
+    CODEFOLDSINFO fold;
+    fold.modhash = ModHashFromAddr(moduleBase);
+    fold.start = Start - moduleBase;
+    fold.end = End - moduleBase;
+    fold.folded = Folded;
+    fold.manual = Manual;
+
+    if(!codeFolds.Add(fold))
+        return false;
+    codeFoldGeneration++;
+    return true;
+}
+
+bool CodeFoldDelete(duint Start, duint End)
+{
+    if(!codeFolds.Delete(CodeFolds::VaKey(Start, End)))
+        return false;
+    codeFoldGeneration++;
+    return true;
+}
+
+void CodeFoldDelRange(duint Start, duint End, bool DeleteManual)
+{
+    // Should all folds be deleted?
+    // 0x00000000 - 0xFFFFFFFF
+    if(Start == 0 && End == ~0)
+    {
+        CodeFoldClear();
+    }
+    else
+    {
+        // The start and end address must be in the same module
+        auto moduleBase = ModBaseFromAddr(Start);
+
+        if(moduleBase != ModBaseFromAddr(End))
+            return;
+
+        // Convert these to a relative offset
+        Start -= moduleBase;
+        End -= moduleBase;
+        auto modhash = ModHashFromAddr(moduleBase);
+
+        codeFolds.DeleteWhere([ = ](const CODEFOLDSINFO & value)
+        {
+            if(!DeleteManual && value.manual)
+                return false;
+            return value.modhash == modhash && value.end >= Start && value.start <= End;
+        });
+        codeFoldGeneration++;
+    }
+}
+
+void CodeFoldCacheSave(JSON Root)
+{
+    codeFolds.CacheSave(Root);
+}
+
+void CodeFoldCacheLoad(JSON Root)
+{
+    codeFolds.CacheLoad(Root);
+    codeFoldGeneration++;
+}
+
+void CodeFoldClear()
+{
+    codeFolds.Clear();
+    codeFoldGeneration++;
+}
+
+void CodeFoldGetList(std::vector<CODEFOLDSINFO> & list)
+{
+    codeFolds.GetList(list);
+}
+
+bool CodeFoldEnum(CODEFOLDSINFO* List, size_t* Size)
+{
+    return codeFolds.Enum(List, Size);
+}
+
+duint CodeFoldGeneration()
+{
+    return codeFoldGeneration;
+}
\ No newline at end of file
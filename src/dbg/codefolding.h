@@ -0,0 +1,30 @@
+#ifndef _CODEFOLDING_H
+#define _CODEFOLDING_H
+
+#include "addrinfo.h"
+
+struct CODEFOLDSINFO
+{
+    duint modhash;
+    duint start;
+    duint end;
+    bool folded;
+    bool manual;
+
+    std::string mod() const
+    {
+        return ModNameFromHash(modhash);
+    }
+};
+
+bool CodeFoldSet(duint Start, duint End, bool Folded, bool Manual);
+bool CodeFoldDelete(duint Start, duint End);
+void CodeFoldDelRange(duint Start, duint End, bool DeleteManual = false);
+void CodeFoldCacheSave(JSON Root);
+void CodeFoldCacheLoad(JSON Root);
+void CodeFoldClear();
+void CodeFoldGetList(std::vector<CODEFOLDSINFO> & list);
+bool CodeFoldEnum(CODEFOLDSINFO* List, size_t* Size);
+duint CodeFoldGeneration();
+
+#endif // _CODEFOLDING_H
\ No newline at end of file
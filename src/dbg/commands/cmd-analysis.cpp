@@ -13,6 +13,8 @@
 #include "variable.h"
 #include "exhandlerinfo.h"
 #include "symbolinfo.h"
+#include "symbolsourcebase.h"
+#include "tableexport.h"
 #include "exception.h"
 #include "TraceRecord.h"
 #include "dbghelp_safe.h"
@@ -251,6 +253,68 @@ bool cbDebugUnloadSymbol(int argc, char* argv[])
     return true;
 }
 
+struct SymExportData
+{
+    TableExport table;
+    std::vector<String> cells;
+    bool ok;
+};
+
+static bool cbSymExport(const SYMBOLPTR* symbol, void* user)
+{
+    auto data = (SymExportData*)user;
+    SYMBOLINFO info;
+    ((const SymbolInfoGui*)symbol->symbol)->convertToGuiSymbol(symbol->modbase, &info);
+    auto & cells = data->cells;
+    cells[0] = StringUtils::sprintf("%p", info.addr);
+    switch(info.type)
+    {
+    case sym_import:
+        cells[1] = "Import";
+        break;
+    case sym_export:
+        cells[1] = "Export";
+        break;
+    default:
+        cells[1] = "Symbol";
+        break;
+    }
+    cells[2] = info.type == sym_export ? StringUtils::sprintf("%u", info.ordinal) : "";
+    cells[3] = info.decoratedSymbol ? info.decoratedSymbol : "";
+    cells[4] = info.undecoratedSymbol ? info.undecoratedSymbol : "";
+    if(info.freeDecorated)
+        BridgeFree(info.decoratedSymbol);
+    if(info.freeUndecorated)
+        BridgeFree(info.undecoratedSymbol);
+    data->ok = data->table.Row(cells);
+    return data->ok;
+}
+
+bool cbDebugExportSymbols(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 3))
+        return false;
+    duint modbase = ModBaseFromName(argv[2]);
+    if(!modbase)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Invalid module \"%s\"!\n"), argv[2]);
+        return false;
+    }
+    SymExportData data;
+    data.cells.resize(5);
+    data.ok = data.table.Open(argv[1], TableExport::FormatFromFileName(argv[1]), { "Address", "Type", "Ordinal", "Symbol", "Symbol (undecorated)" });
+    if(data.ok)
+        SymEnum(modbase, cbSymExport, &data);
+    if(!data.table.Close() || !data.ok)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to write \"%s\"!\n"), argv[1]);
+        return false;
+    }
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%llu symbol(s) exported to \"%s\"\n"), data.table.Rows(), argv[1]);
+    varset("$result", duint(data.table.Rows()), false);
+    return true;
+}
+
 bool cbInstrImageinfo(int argc, char* argv[])
 {
     duint address;
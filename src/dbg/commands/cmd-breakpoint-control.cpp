@@ -4,6 +4,8 @@
 #include "debugger.h"
 #include "exception.h"
 #include "value.h"
+#include "variable.h"
+#include "filehelper.h"
 
 // breakpoint enumeration callbacks
 static bool cbDeleteAllBreakpoints(const BREAKPOINT* bp)
@@ -1452,3 +1454,90 @@ bool cbDebugSetBPXOptions(int argc, char* argv[])
     dprintf(QT_TRANSLATE_NOOP("DBG", "Default breakpoint type set to: %s\n"), strType);
     return true;
 }
+
+bool cbDebugBulkBPX(int argc, char* argv[]) //bpbulk action, source [, type]
+{
+    if(IsArgumentsLessThan(argc, 3))
+        return false;
+    BPBULKOP op;
+    if(scmp(argv[1], "set"))
+        op = BpBulkSet;
+    else if(scmp(argv[1], "delete"))
+        op = BpBulkDelete;
+    else if(scmp(argv[1], "enable"))
+        op = BpBulkEnable;
+    else if(scmp(argv[1], "disable"))
+        op = BpBulkDisable;
+    else
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "Invalid action, expected set, delete, enable or disable"));
+        return false;
+    }
+    DWORD type = UE_BREAKPOINT;
+    if(argc > 3)
+    {
+        char argtype[deflen] = "";
+        strcpy_s(argtype, argv[3]);
+        _strlwr_s(argtype);
+        if(strstr(argtype, "ss"))
+            type = UE_SINGLESHOOT;
+        if(strstr(argtype, "long"))
+            type |= UE_BREAKPOINT_TYPE_LONG_INT3;
+        else if(strstr(argtype, "ud2"))
+            type |= UE_BREAKPOINT_TYPE_UD2;
+        else if(strstr(argtype, "short"))
+            type |= UE_BREAKPOINT_TYPE_INT3;
+    }
+
+    // The addresses come from the first column of the reference view or from a file with one expression per line
+    std::vector<duint> addresses;
+    if(scmp(argv[2], "ref"))
+    {
+        auto rows = GuiReferenceGetRowCount();
+        addresses.reserve(rows);
+        for(int row = 0; row < rows; row++)
+        {
+            auto content = GuiReferenceGetCellContent(row, 0);
+            duint addr = 0;
+            if(content && valfromstring(content, &addr, false))
+                addresses.push_back(addr);
+            BridgeFree(content);
+        }
+    }
+    else
+    {
+        std::vector<String> lines;
+        if(!FileHelper::ReadAllLines(argv[2], lines))
+        {
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to read \"%s\"\n"), argv[2]);
+            return false;
+        }
+        addresses.reserve(lines.size());
+        for(const auto & line : lines)
+        {
+            duint addr = 0;
+            if(!valfromstring(StringUtils::Trim(line).c_str(), &addr))
+            {
+                dprintf(QT_TRANSLATE_NOOP("DBG", "Invalid addr: \"%s\"\n"), line.c_str());
+                return false;
+            }
+            addresses.push_back(addr);
+        }
+    }
+
+    std::unique_ptr<bool[]> results(new bool[addresses.size() + 1]());
+    auto succeeded = DebugBulkBreakpoints(op, addresses.data(), addresses.size(), type, results.get());
+    size_t failed = 0;
+    for(size_t i = 0; i < addresses.size(); i++)
+    {
+        if(results[i])
+            continue;
+        if(failed++ < 100)
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Breakpoint %p failed!\n"), addresses[i]);
+    }
+    if(failed > 100)
+        dprintf(QT_TRANSLATE_NOOP("DBG", "%llu more breakpoints failed...\n"), (unsigned long long)(failed - 100));
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%llu/%llu breakpoints done!\n"), (unsigned long long)succeeded, (unsigned long long)addresses.size());
+    varset("$result", succeeded, false);
+    return true;
+}
@@ -3,6 +3,7 @@
 #include "command.h"
 
 bool cbDebugSetBPX(int argc, char* argv[]);
+bool cbDebugBulkBPX(int argc, char* argv[]);
 bool cbDebugDeleteBPX(int argc, char* argv[]);
 bool cbDebugEnableBPX(int argc, char* argv[]);
 bool cbDebugDisableBPX(int argc, char* argv[]);
@@ -7,6 +7,7 @@
 #include "value.h"
 #include "stringformat.h"
 #include "comment.h"
+#include "patches.h"
 
 bool cbDebugAlloc(int argc, char* argv[])
 {
@@ -209,4 +210,36 @@ bool cbInstrSavedata(int argc, char* argv[])
 #endif
 
     return success;
+}
+
+bool cbInstrPatchExport(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+    duint report = 0;
+    if(argc > 2 && !valfromstring(argv[2], &report, false))
+        return false;
+
+    size_t cbsize;
+    if(!PatchEnum(nullptr, &cbsize))
+        return false;
+    std::vector<PATCHINFO> patches(cbsize / sizeof(PATCHINFO));
+    if(patches.empty())
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "No patches to apply"));
+        return false;
+    }
+    if(!PatchEnum(patches.data(), nullptr))
+        return false;
+
+    char error[MAX_ERROR_SIZE] = "";
+    auto patched = PatchExport(patches.data(), int(patches.size()), stringformatinline(argv[1]).c_str(), report != 0, error);
+    if(patched == -1)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to export patches (%s)\n"), error);
+        return false;
+    }
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%d/%d patch(es) applied!\n"), patched, int(patches.size()));
+    varset("$result", patched, false);
+    return true;
 }
\ No newline at end of file
@@ -8,4 +8,5 @@ bool cbDebugMemset(int argc, char* argv[]);
 bool cbDebugMemcpy(int argc, char* argv[]);
 bool cbDebugGetPageRights(int argc, char* argv[]);
 bool cbDebugSetPageRights(int argc, char* argv[]);
-bool cbInstrSavedata(int argc, char* argv[]);
\ No newline at end of file
+bool cbInstrSavedata(int argc, char* argv[]);
+bool cbInstrPatchExport(int argc, char* argv[]);
\ No newline at end of file
@@ -10,6 +10,8 @@
 #include "stringformat.h"
 #include "disasm_helper.h"
 #include "symbolinfo.h"
+#include "module.h"
+#include "asmsequence.h"
 
 static int maxFindResults = 5000;
 
@@ -379,6 +381,241 @@ bool cbInstrFindAsm(int argc, char* argv[])
     return true;
 }
 
+struct SEARCHRANGE
+{
+    duint start;
+    duint size;
+    String name;
+};
+
+// the ranges RefFind would search
+static bool getSearchRanges(duint addr, duint size, REFFINDTYPE type, std::vector<SEARCHRANGE> & ranges)
+{
+    char moduleName[MAX_MODULE_SIZE] = "";
+    if(type == CURRENT_REGION)
+    {
+        duint regionSize = 0;
+        duint regionBase = MemFindBaseAddr(addr, &regionSize, true);
+        if(!regionBase || !regionSize)
+        {
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Invalid memory page 0x%p\n"), addr);
+            return false;
+        }
+        SEARCHRANGE range = { regionBase, regionSize };
+        if(size)
+        {
+            range.start = addr;
+            range.size = min(size, regionSize - (addr - regionBase));
+        }
+        range.name = ModNameFromAddr(range.start, moduleName, true) ? moduleName : StringUtils::sprintf("%p", range.start);
+        ranges.push_back(range);
+    }
+    else if(type == CURRENT_MODULE)
+    {
+        SHARED_ACQUIRE(LockModules);
+        auto modInfo = ModInfoFromAddr(addr);
+        if(!modInfo)
+        {
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Couldn't locate module for 0x%p\n"), addr);
+            return false;
+        }
+        ranges.push_back({ modInfo->base, modInfo->size, String(modInfo->name) + modInfo->extension });
+    }
+    else
+    {
+        ModEnum([&ranges](const MODINFO & mod)
+        {
+            ranges.push_back({ mod.base, mod.size, String(mod.name) + mod.extension });
+        });
+        if(ranges.empty())
+        {
+            dputs(QT_TRANSLATE_NOOP("DBG", "Couldn't get module list"));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool cbInstrFindAsmPattern(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+
+    duint addr = 0;
+    if(argc < 3 || !valfromstring(argv[2], &addr))
+        addr = GetContextDataEx(hActiveThread, UE_CIP);
+    duint size = 0;
+    if(argc >= 4)
+        if(!valfromstring(argv[3], &size))
+            size = 0;
+
+    duint refFindType = CURRENT_REGION;
+    if(argc >= 5 && valfromstring(argv[4], &refFindType, true))
+        if(refFindType != CURRENT_REGION && refFindType != CURRENT_MODULE && refFindType != ALL_MODULES)
+            refFindType = CURRENT_REGION;
+
+    AsmPattern pattern;
+    std::string error;
+    auto patternText = stringformatinline(argv[1]);
+    if(!pattern.Compile(patternText, error))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Invalid instruction pattern \"%s\" (%s)!\n"), patternText.c_str(), error.c_str());
+        return false;
+    }
+    std::vector<SEARCHRANGE> ranges;
+    if(!getSearchRanges(addr, size, REFFINDTYPE(refFindType), ranges))
+        return false;
+
+    duint ticks = GetTickCount();
+    std::vector<uint64_t> results;
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+        const auto & range = ranges[i];
+        GuiReferenceSetCurrentTaskProgress(0, range.name.c_str());
+        Memory<unsigned char*> data(range.size, "findasmpattern:data");
+        memset(data(), 0xCC, data.size());
+        MemReadDumb(range.start, data(), range.size);
+        AsmPatternFind(pattern, range.start, data(), range.size, results);
+        GuiReferenceSetProgress(int((i + 1) * 100 / ranges.size()));
+    }
+
+    char title[256] = "";
+    if(refFindType == ALL_MODULES)
+        sprintf_s(title, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "All Modules (Pattern: \"%s\")")), patternText.c_str());
+    else
+        sprintf_s(title, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Pattern: \"%s\" (%s)")), patternText.c_str(), ranges[0].name.c_str());
+    GuiReferenceInitialize(title);
+    GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
+    GuiReferenceAddColumn(0, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Disassembly")));
+    // only the results are formatted
+    auto rowCount = int(min(results.size(), size_t(maxFindResults)));
+    GuiReferenceSetRowCount(rowCount);
+    for(int i = 0; i < rowCount; i++)
+    {
+        auto resultAddr = duint(results[i]);
+        char addrText[20] = "";
+        sprintf_s(addrText, "%p", resultAddr);
+        GuiReferenceSetCellContent(i, 0, addrText);
+        char disassembly[GUI_MAX_DISASSEMBLY_SIZE] = "";
+        if(GuiGetDisassembly(resultAddr, disassembly))
+            GuiReferenceSetCellContent(i, 1, disassembly);
+    }
+    GuiReferenceSetProgress(100);
+    GuiReferenceReloadData();
+    if(results.size() > size_t(rowCount))
+        dprintf(QT_TRANSLATE_NOOP("DBG", "%u result(s) in %ums, showing the first %d\n"), DWORD(results.size()), GetTickCount() - DWORD(ticks), rowCount);
+    else
+        dprintf(QT_TRANSLATE_NOOP("DBG", "%u result(s) in %ums\n"), DWORD(results.size()), GetTickCount() - DWORD(ticks));
+    varset("$result", results.size(), false);
+    return true;
+}
+
+static bool cbFindSequence(int argc, char* argv[], AsmSequence::Mode mode)
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+
+    duint addr = 0;
+    if(argc < 3 || !valfromstring(argv[2], &addr))
+        addr = GetContextDataEx(hActiveThread, UE_CIP);
+    duint size = 0;
+    if(argc >= 4)
+        if(!valfromstring(argv[3], &size))
+            size = 0;
+
+    duint refFindType = CURRENT_REGION;
+    if(argc >= 5 && valfromstring(argv[4], &refFindType, true))
+        if(refFindType != CURRENT_REGION && refFindType != CURRENT_MODULE && refFindType != ALL_MODULES)
+            refFindType = CURRENT_REGION;
+
+    AsmSequence sequence;
+    duint maxInstructions = 0;
+    if(argc >= 6 && valfromstring(argv[5], &maxInstructions, true) && maxInstructions)
+        sequence.maxInstructions = int(min(maxInstructions, duint(64)));
+    std::string error;
+    auto sequenceText = stringformatinline(argv[1]);
+    if(!sequence.Compile(sequenceText, mode, error))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Invalid instruction sequence \"%s\" (%s)!\n"), sequenceText.c_str(), error.c_str());
+        return false;
+    }
+    std::vector<SEARCHRANGE> ranges;
+    if(!getSearchRanges(addr, size, REFFINDTYPE(refFindType), ranges))
+        return false;
+
+    // all ranges are searched at once, so small modules are spread over the workers too
+    duint ticks = GetTickCount();
+    std::vector<std::vector<unsigned char>> data(ranges.size());
+    std::vector<AsmBuffer> buffers;
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+        data[i].resize(ranges[i].size, 0xCC);
+        MemReadDumb(ranges[i].start, data[i].data(), ranges[i].size);
+        buffers.push_back({ ranges[i].start, data[i].data(), data[i].size() });
+    }
+    std::vector<AsmSequenceMatch> results;
+    sequence.Find(buffers, results);
+
+    auto gadgets = mode == AsmSequence::Gadget;
+    char title[256] = "";
+    if(refFindType == ALL_MODULES)
+        sprintf_s(title, GuiTranslateText(gadgets ? QT_TRANSLATE_NOOP("DBG", "All Modules (Gadgets: \"%s\")") : QT_TRANSLATE_NOOP("DBG", "All Modules (Sequence: \"%s\")")), sequenceText.c_str());
+    else
+        sprintf_s(title, GuiTranslateText(gadgets ? QT_TRANSLATE_NOOP("DBG", "Gadgets: \"%s\" (%s)") : QT_TRANSLATE_NOOP("DBG", "Sequence: \"%s\" (%s)")), sequenceText.c_str(), ranges[0].name.c_str());
+    GuiReferenceInitialize(title);
+    GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
+    if(gadgets)
+        GuiReferenceAddColumn(8, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Count")));
+    GuiReferenceAddColumn(0, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Instructions")));
+    auto rowCount = int(min(results.size(), size_t(maxFindResults)));
+    GuiReferenceSetRowCount(rowCount);
+    Zydis cp;
+    for(int i = 0; i < rowCount; i++)
+    {
+        const auto & result = results[i];
+        auto resultAddr = duint(result.address);
+        const AsmBuffer* buffer = nullptr;
+        for(const auto & b : buffers)
+            if(resultAddr >= b.address && resultAddr < b.address + b.size)
+                buffer = &b;
+        String instructions;
+        for(size_t offset = 0; offset < result.size && buffer;)
+        {
+            auto start = size_t(resultAddr - buffer->address) + offset;
+            if(!cp.Disassemble(resultAddr + offset, buffer->data + start, int(min(size_t(MAX_DISASM_BUFFER), buffer->size - start))))
+                break;
+            if(!instructions.empty())
+                instructions += " ; ";
+            instructions += cp.InstructionText();
+            offset += cp.Size();
+        }
+        char addrText[20] = "";
+        sprintf_s(addrText, "%p", resultAddr);
+        GuiReferenceSetCellContent(i, 0, addrText);
+        if(gadgets)
+            GuiReferenceSetCellContent(i, 1, StringUtils::sprintf("%u", DWORD(result.count)).c_str());
+        GuiReferenceSetCellContent(i, gadgets ? 2 : 1, instructions.c_str());
+    }
+    GuiReferenceSetProgress(100);
+    GuiReferenceReloadData();
+    if(results.size() > size_t(rowCount))
+        dprintf(QT_TRANSLATE_NOOP("DBG", "%u result(s) in %ums, showing the first %d\n"), DWORD(results.size()), GetTickCount() - DWORD(ticks), rowCount);
+    else
+        dprintf(QT_TRANSLATE_NOOP("DBG", "%u result(s) in %ums\n"), DWORD(results.size()), GetTickCount() - DWORD(ticks));
+    varset("$result", results.size(), false);
+    return true;
+}
+
+bool cbInstrFindAsmSequence(int argc, char* argv[])
+{
+    return cbFindSequence(argc, argv, AsmSequence::Sequence);
+}
+
+bool cbInstrFindGadget(int argc, char* argv[])
+{
+    return cbFindSequence(argc, argv, AsmSequence::Gadget);
+}
+
 bool cbInstrRefFind(int argc, char* argv[])
 {
     if(IsArgumentsLessThan(argc, 2))
@@ -6,6 +6,9 @@ bool cbInstrFind(int argc, char* argv[]);
 bool cbInstrFindAll(int argc, char* argv[]);
 bool cbInstrFindAllMem(int argc, char* argv[]);
 bool cbInstrFindAsm(int argc, char* argv[]);
+bool cbInstrFindAsmPattern(int argc, char* argv[]);
+bool cbInstrFindAsmSequence(int argc, char* argv[]);
+bool cbInstrFindGadget(int argc, char* argv[]);
 bool cbInstrRefFind(int argc, char* argv[]);
 bool cbInstrRefFindRange(int argc, char* argv[]);
 bool cbInstrRefStr(int argc, char* argv[]);
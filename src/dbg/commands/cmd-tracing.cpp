@@ -8,6 +8,12 @@
 #include "value.h"
 #include "variable.h"
 #include "TraceRecord.h"
+#include "tracestate.h"
+#include "tracewriteindex.h"
+#include "traceprofile.h"
+#include "tableexport.h"
+#include "symbolinfo.h"
+#include "zydis_wrapper.h"
 
 extern std::vector<std::pair<duint, duint>> RunToUserCodeBreakpoints;
 
@@ -181,4 +187,392 @@ bool cbDebugStartRunTrace(int argc, char* argv[])
 bool cbDebugStopRunTrace(int argc, char* argv[])
 {
     return _dbg_dbgenableRunTrace(false, nullptr);
-}
\ No newline at end of file
+}
+
+bool cbDebugTraceRecordStats(int argc, char* argv[])
+{
+    if(argc > 1)
+    {
+        duint budget;
+        if(!valfromstring(argv[1], &budget, false))
+            return false;
+        if(budget > duint(-1) / (1024 * 1024))
+        {
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Memory budget too large, the maximum is %lluMB\n"), (unsigned long long)(duint(-1) / (1024 * 1024)));
+            return false;
+        }
+        TraceRecord.setMemoryBudget(budget * 1024 * 1024);
+    }
+    auto stats = TraceRecord.getMemoryStats();
+    dprintf(QT_TRANSLATE_NOOP("DBG", "Trace record: %llu page(s), %llu hot (%lluKB), %llu compressed (%lluKB, %lluKB uncompressed), budget %lluKB\n"),
+            (unsigned long long)stats.pages, (unsigned long long)stats.hotPages, (unsigned long long)stats.hotBytes / 1024,
+            (unsigned long long)stats.coldPages, (unsigned long long)stats.coldBytes / 1024,
+            (unsigned long long)(stats.rawBytes - stats.hotBytes) / 1024, (unsigned long long)stats.budget / 1024);
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%llu page(s) compressed, %llu page(s) decompressed\n"), (unsigned long long)stats.compressions, (unsigned long long)stats.decompressions);
+    varset("$result", stats.hotBytes + stats.coldBytes, false);
+    return true;
+}
+
+bool cbDebugTraceStateLoad(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+    auto status = TraceStateLoad(argv[1]);
+    if(status == TraceStateFailed)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to index run trace \"%s\"!\n"), argv[1]);
+        return false;
+    }
+    if(status == TraceStateReady)
+        dprintf(QT_TRANSLATE_NOOP("DBG", "%llu instructions indexed!\n"), TraceStateLength());
+    else
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Indexing run trace (%d%%)...\n"), status);
+    varset("$result", status, false);
+    return true;
+}
+
+bool cbDebugTraceStateRegisters(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+    duint index;
+    if(!valfromstring(argv[1], &index, false))
+        return false;
+    union
+    {
+        REGDUMP registers;
+        duint regwords[TRACE_REGWORD_COUNT];
+    };
+    memset(&registers, 0, sizeof(registers));
+    DWORD threadId;
+    if(!TraceStateRegisters(index, regwords, &threadId))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "No trace state at index %p!\n"), index);
+        return false;
+    }
+    const auto & ctx = registers.regcontext;
+    dprintf_untranslated("TID: %u\n", threadId);
+    dprintf_untranslated("%s: %p %s: %p %s: %p %s: %p\n", ArchValue("EAX", "RAX"), ctx.cax, ArchValue("EBX", "RBX"), ctx.cbx, ArchValue("ECX", "RCX"), ctx.ccx, ArchValue("EDX", "RDX"), ctx.cdx);
+    dprintf_untranslated("%s: %p %s: %p %s: %p %s: %p\n", ArchValue("ESI", "RSI"), ctx.csi, ArchValue("EDI", "RDI"), ctx.cdi, ArchValue("EBP", "RBP"), ctx.cbp, ArchValue("ESP", "RSP"), ctx.csp);
+#ifdef _WIN64
+    dprintf_untranslated("R8: %p R9: %p R10: %p R11: %p\n", ctx.r8, ctx.r9, ctx.r10, ctx.r11);
+    dprintf_untranslated("R12: %p R13: %p R14: %p R15: %p\n", ctx.r12, ctx.r13, ctx.r14, ctx.r15);
+#endif //_WIN64
+    dprintf_untranslated("%s: %p EFLAGS: %p\n", ArchValue("EIP", "RIP"), ctx.cip, ctx.eflags);
+    varset("$result", ctx.cip, false);
+    return true;
+}
+
+bool cbDebugTraceStateMemory(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 3))
+        return false;
+    duint index, addr, size = sizeof(duint);
+    if(!valfromstring(argv[1], &index, false) || !valfromstring(argv[2], &addr, false))
+        return false;
+    if(argc > 3 && (!valfromstring(argv[3], &size, false) || !size || size > sizeof(duint)))
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "Invalid size!"));
+        return false;
+    }
+    duint value = 0;
+    if(!TraceStateReadMemory(index, addr, (unsigned char*)&value, size))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Memory at %p was not traced before index %p!\n"), addr, index);
+        return false;
+    }
+    dprintf_untranslated("[%p]@%p = %p\n", addr, index, value);
+    varset("$result", value, false);
+    return true;
+}
+
+bool cbDebugTraceWriteIndex(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+    auto status = TraceWriteIndexRequest(argv[1]);
+    if(status == TraceWriteIndexFailed)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to index trace file \"%s\"!\n"), argv[1]);
+        return false;
+    }
+    if(status == TraceWriteIndexReady)
+        dputs(QT_TRANSLATE_NOOP("DBG", "Trace write index ready!"));
+    else
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Building trace write index (%d%%)...\n"), status);
+    varset("$result", status, false);
+    return true;
+}
+
+bool cbDebugTraceLastWrite(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 3))
+        return false;
+    duint index, addr, size = 1;
+    if(!valfromstring(argv[1], &index, false) || !valfromstring(argv[2], &addr, false))
+        return false;
+    if(argc > 3 && (!valfromstring(argv[3], &size, false) || !size))
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "Invalid size!"));
+        return false;
+    }
+    TraceWriteIndex::Index writer;
+    if(!TraceWriteIndexLastWrite(nullptr, index, addr, size, &writer))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "No write to %p found before index %p (is the trace write index ready?)\n"), addr, index);
+        return false;
+    }
+    dprintf_untranslated("[%p]@%p <- %p\n", addr, index, duint(writer));
+    varset("$result", duint(writer), false);
+    return true;
+}
+
+static String profileShare(unsigned long long count, unsigned long long total)
+{
+    return StringUtils::sprintf("%6.2f%%", total ? count * 100.0 / total : 0.0);
+}
+
+static void setProfileCountColumns(int first, int last)
+{
+    for(int col = first; col <= last; col++)
+        GuiReferenceSetColumnType(col, REF_COLUMN_DECIMAL);
+}
+
+static void showTraceProfile(const TraceProfile & profile)
+{
+    auto total = profile.instructionCount;
+
+    GuiReferenceInitialize(GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Trace profile: functions")));
+    GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Entry")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Calls")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Inclusive")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Exclusive")));
+    GuiReferenceAddColumn(8, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Share")));
+    GuiReferenceAddColumn(0, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Symbol")));
+    GuiReferenceSetRowCount(int(profile.functions.size()));
+    for(size_t i = 0; i < profile.functions.size(); i++)
+    {
+        const auto & function = profile.functions[i];
+        auto row = int(i);
+        GuiReferenceSetCellContent(row, 0, StringUtils::sprintf("%p", function.entry).c_str());
+        GuiReferenceSetCellContent(row, 1, StringUtils::sprintf("%llu", function.calls).c_str());
+        GuiReferenceSetCellContent(row, 2, StringUtils::sprintf("%llu", function.inclusive).c_str());
+        GuiReferenceSetCellContent(row, 3, StringUtils::sprintf("%llu", function.exclusive).c_str());
+        GuiReferenceSetCellContent(row, 4, profileShare(function.exclusive, total).c_str());
+        GuiReferenceSetCellContent(row, 5, SymGetSymbolicName(function.entry).c_str());
+    }
+    setProfileCountColumns(1, 3);
+    GuiReferenceReloadData();
+
+    GuiReferenceInitialize(GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Trace profile: call tree")));
+    GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Entry")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Calls")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Inclusive")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Exclusive")));
+    GuiReferenceAddColumn(8, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Share")));
+    GuiReferenceAddColumn(0, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Call path")));
+    GuiReferenceSetRowCount(int(profile.callTree.size() - 1));
+    for(size_t i = 1; i < profile.callTree.size(); i++)
+    {
+        const auto & node = profile.callTree[i];
+        auto row = int(i - 1);
+        GuiReferenceSetCellContent(row, 0, StringUtils::sprintf("%p", node.entry).c_str());
+        GuiReferenceSetCellContent(row, 1, StringUtils::sprintf("%llu", node.calls).c_str());
+        GuiReferenceSetCellContent(row, 2, StringUtils::sprintf("%llu", node.inclusive).c_str());
+        GuiReferenceSetCellContent(row, 3, StringUtils::sprintf("%llu", node.exclusive).c_str());
+        GuiReferenceSetCellContent(row, 4, profileShare(node.inclusive, total).c_str());
+        GuiReferenceSetCellContent(row, 5, (String(2 * (node.depth - 1), ' ') + SymGetSymbolicName(node.entry)).c_str());
+    }
+    setProfileCountColumns(1, 3);
+    GuiReferenceReloadData();
+
+    GuiReferenceInitialize(GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Trace profile: addresses")));
+    GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Count")));
+    GuiReferenceAddColumn(8, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Share")));
+    GuiReferenceAddColumn(0, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Symbol")));
+    GuiReferenceSetRowCount(int(profile.addresses.size()));
+    for(size_t i = 0; i < profile.addresses.size(); i++)
+    {
+        const auto & address = profile.addresses[i];
+        auto row = int(i);
+        GuiReferenceSetCellContent(row, 0, StringUtils::sprintf("%p", address.addr).c_str());
+        GuiReferenceSetCellContent(row, 1, StringUtils::sprintf("%llu", address.count).c_str());
+        GuiReferenceSetCellContent(row, 2, profileShare(address.count, total).c_str());
+        GuiReferenceSetCellContent(row, 3, SymGetSymbolicName(address.addr).c_str());
+    }
+    setProfileCountColumns(1, 1);
+    GuiReferenceReloadData();
+
+    GuiReferenceInitialize(GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Trace profile: modules")));
+    GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Base")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Count")));
+    GuiReferenceAddColumn(8, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Share")));
+    GuiReferenceAddColumn(0, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Module")));
+    GuiReferenceSetRowCount(int(profile.modules.size()));
+    for(size_t i = 0; i < profile.modules.size(); i++)
+    {
+        const auto & module = profile.modules[i];
+        auto row = int(i);
+        GuiReferenceSetCellContent(row, 0, StringUtils::sprintf("%p", module.base).c_str());
+        GuiReferenceSetCellContent(row, 1, StringUtils::sprintf("%llu", module.count).c_str());
+        GuiReferenceSetCellContent(row, 2, profileShare(module.count, total).c_str());
+        GuiReferenceSetCellContent(row, 3, module.name.c_str());
+    }
+    setProfileCountColumns(1, 1);
+    GuiReferenceReloadData();
+
+    GuiReferenceInitialize(GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Trace profile: threads")));
+    GuiReferenceAddColumn(8, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Thread")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Count")));
+    GuiReferenceAddColumn(0, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Share")));
+    GuiReferenceSetRowCount(int(profile.threads.size()));
+    for(size_t i = 0; i < profile.threads.size(); i++)
+    {
+        const auto & thread = profile.threads[i];
+        auto row = int(i);
+        GuiReferenceSetCellContent(row, 0, StringUtils::sprintf("%u", thread.id).c_str());
+        GuiReferenceSetCellContent(row, 1, StringUtils::sprintf("%llu", thread.count).c_str());
+        GuiReferenceSetCellContent(row, 2, profileShare(thread.count, total).c_str());
+    }
+    setProfileCountColumns(0, 1);
+    GuiReferenceReloadData();
+}
+
+bool cbDebugTraceProfile(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+    auto status = TraceProfileRequest(argv[1]);
+    if(status == TraceProfileFailed)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to profile trace file \"%s\"!\n"), argv[1]);
+        return false;
+    }
+    varset("$result", status, false);
+    auto profile = TraceProfileGet();
+    if(status != TraceProfileReady || !profile)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Profiling trace file (%d%%), run TraceProfile again to show the result...\n"), status);
+        return true;
+    }
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%llu instructions, %d function(s), %d thread(s) profiled\n"), profile->instructionCount, int(profile->functions.size()), int(profile->threads.size()));
+    if(profile->truncated)
+        dputs(QT_TRANSLATE_NOOP("DBG", "The call tree was truncated, the trace is too deep or has too many call paths."));
+    showTraceProfile(*profile);
+    return true;
+}
+
+bool cbDebugTraceProfileCancel(int argc, char* argv[])
+{
+    TraceProfileClear();
+    dputs(QT_TRANSLATE_NOOP("DBG", "Trace profile cancelled"));
+    return true;
+}
+
+bool cbDebugTraceProfileExport(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+    auto profile = TraceProfileGet();
+    if(!profile)
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "No trace profile, use TraceProfile first!"));
+        return false;
+    }
+    if(!profile->Export(argv[1]))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to write \"%s\"!\n"), argv[1]);
+        return false;
+    }
+    dprintf(QT_TRANSLATE_NOOP("DBG", "Trace profile exported to \"%s\"\n"), argv[1]);
+    return true;
+}
+
+bool cbDebugTraceExport(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 3))
+        return false;
+    duint start = 0;
+    duint count = ~0;
+    if(argc > 3 && !valfromstring(argv[3], &start, false))
+        return false;
+    if(argc > 4 && !valfromstring(argv[4], &count, false))
+        return false;
+    TraceFileSource source;
+    unsigned long long offset;
+    if(!source.Open(argv[2]) || !TraceReadHeader(source, offset))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to open trace file \"%s\"!\n"), argv[2]);
+        return false;
+    }
+    TableExport table;
+    if(!table.Open(argv[1], TableExport::FormatFromFileName(argv[1]), { "Index", "Thread", "Address", "Bytes", "Disassembly", "Memory" }))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to write \"%s\"!\n"), argv[1]);
+        return false;
+    }
+
+    // Registers are delta encoded, so the blocks before start are decoded but not written
+    const auto cipPosition = offsetof(REGDUMP, regcontext.cip) / sizeof(duint);
+    duint regs[TRACE_REGWORD_COUNT];
+    memset(regs, 0, sizeof(regs));
+    DWORD threadId = 0;
+    Zydis zydis;
+    TraceBlock block;
+    std::vector<String> cells(6);
+    auto size = source.Size();
+    int lastProgress = -1;
+    bool ok = true;
+    GuiReferenceSetProgress(0);
+    for(duint index = 0; offset < size && (index < start || index - start < count); index++)
+    {
+        if(!TraceReadBlock(source, offset, block))
+        {
+            ok = false;
+            break;
+        }
+        for(unsigned char i = 0; i < block.regCount; i++)
+            regs[block.regPosition[i]] = block.regValue[i];
+        if(block.hasThreadId)
+            threadId = block.threadId;
+        if(index < start)
+            continue;
+        auto cip = regs[cipPosition];
+        cells[0] = StringUtils::sprintf("%llu", (unsigned long long)index);
+        cells[1] = StringUtils::sprintf("%u", threadId);
+        cells[2] = StringUtils::sprintf("%p", cip);
+        cells[3] = StringUtils::ToHex(block.opcode, block.opcodeSize);
+        cells[4] = zydis.Disassemble(cip, block.opcode, block.opcodeSize) ? zydis.InstructionText() : "???";
+        cells[5].clear();
+        for(unsigned char i = 0; i < block.memCount; i++)
+        {
+            if(i)
+                cells[5].push_back(' ');
+            if(block.memFlags[i] & 1) //memory is unchanged
+                cells[5] += StringUtils::sprintf("[%p]=%p", block.memAddress[i], block.memOld[i]);
+            else
+                cells[5] += StringUtils::sprintf("[%p]=%p->%p", block.memAddress[i], block.memOld[i], block.memNew[i]);
+        }
+        if(!table.Row(cells))
+        {
+            ok = false;
+            break;
+        }
+        auto progress = int(offset * 100 / size);
+        if(progress != lastProgress)
+        {
+            lastProgress = progress;
+            GuiReferenceSetProgress(progress);
+        }
+    }
+    GuiReferenceSetProgress(100);
+    if(!table.Close() || !ok)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to export trace file \"%s\"!\n"), argv[2]);
+        return false;
+    }
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%llu instruction(s) exported to \"%s\"\n"), table.Rows(), argv[1]);
+    varset("$result", duint(table.Rows()), false);
+    return true;
+}
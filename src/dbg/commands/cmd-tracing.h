@@ -15,4 +15,14 @@ bool cbDebugTraceSetCommand(int argc, char* argv[]);
 bool cbDebugTraceSetSwitchCondition(int argc, char* argv[]);
 bool cbDebugTraceSetLogFile(int argc, char* argv[]);
 bool cbDebugStartRunTrace(int argc, char* argv[]);
-bool cbDebugStopRunTrace(int argc, char* argv[]);
\ No newline at end of file
+bool cbDebugStopRunTrace(int argc, char* argv[]);
+bool cbDebugTraceRecordStats(int argc, char* argv[]);
+bool cbDebugTraceStateLoad(int argc, char* argv[]);
+bool cbDebugTraceStateRegisters(int argc, char* argv[]);
+bool cbDebugTraceStateMemory(int argc, char* argv[]);
+bool cbDebugTraceWriteIndex(int argc, char* argv[]);
+bool cbDebugTraceLastWrite(int argc, char* argv[]);
+bool cbDebugTraceProfile(int argc, char* argv[]);
+bool cbDebugTraceProfileCancel(int argc, char* argv[]);
+bool cbDebugTraceProfileExport(int argc, char* argv[]);
+bool cbDebugTraceExport(int argc, char* argv[]);
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "variable.h"
 #include "filehelper.h"
 #include "label.h"
+#include "typedecode.h"
+#include "typesimport.h"
 
 using namespace Types;
 
@@ -646,6 +648,84 @@ bool cbInstrVisitType(int argc, char* argv[])
     return true;
 }
 
+bool cbInstrDecodeType(int argc, char* argv[]) //DecodeType type, addr, count [, maxPtrDepth]
+{
+    if(IsArgumentsLessThan(argc, 4))
+        return false;
+    duint addr, count, maxPtrDepth = 0;
+    if(!valfromstring(argv[2], &addr, false) || !valfromstring(argv[3], &count, false))
+        return false;
+    if(argc > 4 && !valfromstring(argv[4], &maxPtrDepth, false))
+        return false;
+    TypeDecoder decoder;
+    decoder.maxPointerDepth = int(maxPtrDepth);
+    decoder.maxFields = 256;
+    if(!CompileTypeDecoder(argv[1], decoder))
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "DecodeType failed"));
+        return false;
+    }
+    if(decoder.Truncated())
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Too many members, only the first %d columns are shown\n"), int(decoder.Fields().size()));
+
+    //Read all instances at once, the pointers are followed per row
+    duint stride = decoder.Stride();
+    count = min(count, duint(256 * 1024 * 1024) / stride);
+    Memory<unsigned char*> data(count * stride, "cbInstrDecodeType:data");
+    if(!count || !MemRead(addr, data(), data.size()))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to read memory at %p!\n"), addr);
+        return false;
+    }
+    TypeDecodeTable table;
+    auto rows = decoder.Decode(data(), data.size(), addr, size_t(count), table, [](uint64_t ptr, void* dest, size_t size)
+    {
+        return MemRead(duint(ptr), dest, size);
+    });
+
+    GuiReferenceInitialize(StringUtils::sprintf("%s[%llu]", argv[1], (unsigned long long)rows).c_str());
+    GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
+    const auto & fields = decoder.Fields();
+    for(const auto & field : fields)
+        GuiReferenceAddColumn(0, field.name.c_str());
+    GuiReferenceSetRowCount(int(rows));
+    //Send the cells in batches, one GUI call per cell is too slow for large tables
+    const size_t batchRows = 1024;
+    std::vector<String> texts;
+    std::vector<CELLINFO> cells;
+    texts.reserve(batchRows * (fields.size() + 1));
+    cells.reserve(texts.capacity());
+    for(size_t first = 0; first < rows; first += batchRows)
+    {
+        auto last = min(first + batchRows, rows);
+        texts.clear();
+        cells.clear();
+        for(size_t row = first; row < last; row++)
+        {
+            texts.push_back(StringUtils::sprintf("%p", addr + row * stride));
+            for(size_t f = 0; f < fields.size(); f++)
+            {
+                const auto & column = table.columns[f];
+                texts.push_back(column.valid[row] ? TypeDecoder::Format(fields[f], column.values[row]) : String("???"));
+            }
+        }
+        //texts does not reallocate (reserved above), so the pointers stay valid
+        for(size_t i = 0; i < texts.size(); i++)
+        {
+            CELLINFO cell;
+            cell.row = int(first + i / (fields.size() + 1));
+            cell.col = int(i % (fields.size() + 1));
+            cell.str = texts[i].c_str();
+            cells.push_back(cell);
+        }
+        GuiReferenceSetCellContents(cells.data(), int(cells.size()));
+        GuiReferenceSetProgress(int(last * 100 / rows));
+    }
+    GuiReferenceReloadData();
+    varset("$result", rows, false);
+    return true;
+}
+
 bool cbInstrClearTypes(int argc, char* argv[])
 {
     auto owner = towner;
@@ -712,4 +792,73 @@ bool cbInstrParseTypes(int argc, char* argv[])
         return false;
     dputs("Types parsed");
     return true;
+}
+
+static void importTypesDirectory(const char* dir, std::vector<TypesImportFile> & files)
+{
+    std::vector<String> found;
+    for(auto pattern : { "*.h", "*.json" })
+    {
+        WIN32_FIND_DATAW foundData;
+        HANDLE hSearch = FindFirstFileW(StringUtils::Utf8ToUtf16(StringUtils::sprintf("%s\\%s", dir, pattern)).c_str(), &foundData);
+        if(hSearch == INVALID_HANDLE_VALUE)
+            continue;
+        do
+        {
+            if(!(foundData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                found.push_back(StringUtils::sprintf("%s\\%s", dir, StringUtils::Utf16ToUtf8(foundData.cFileName).c_str()));
+        }
+        while(FindNextFileW(hSearch, &foundData));
+        FindClose(hSearch);
+    }
+    std::sort(found.begin(), found.end());
+    for(auto & path : found)
+    {
+        TypesImportFile file;
+        file.path = std::move(path);
+        files.push_back(std::move(file));
+    }
+}
+
+bool cbInstrImportTypes(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+    std::vector<TypesImportFile> files;
+    for(int i = 1; i < argc; i++)
+    {
+        if(DirExists(argv[i]))
+        {
+            importTypesDirectory(argv[i], files);
+            continue;
+        }
+        TypesImportFile file;
+        file.path = argv[i];
+        files.push_back(std::move(file));
+    }
+    if(files.empty())
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "No files to import"));
+        return false;
+    }
+    std::vector<TypesModelConflict> conflicts;
+    auto success = TypesImport(files, false, conflicts);
+    size_t counts[4] = {};
+    for(const auto & file : files)
+    {
+        counts[file.status]++;
+        if(file.status == TypesImportFile::Failed)
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to import %s: %s\n"), file.path.c_str(), StringUtils::TrimRight(file.error).c_str());
+    }
+    for(const auto & conflict : conflicts)
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Conflicting %s %s in %s, keeping the definition from %s\n"), conflict.kind.c_str(), conflict.name.c_str(), files[conflict.second].owner.c_str(), conflict.owner.c_str());
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%d file(s) imported (%d unchanged, %d cached, %d parsed, %d failed), %d conflict(s)\n"),
+            int(files.size() - counts[TypesImportFile::Failed]),
+            int(counts[TypesImportFile::Unchanged]),
+            int(counts[TypesImportFile::Cached]),
+            int(counts[TypesImportFile::Parsed]),
+            int(counts[TypesImportFile::Failed]),
+            int(conflicts.size()));
+    varset("$result", counts[TypesImportFile::Cached] + counts[TypesImportFile::Parsed], false);
+    return success;
 }
\ No newline at end of file
@@ -32,8 +32,10 @@ bool cbInstrAddArg(int argc, char* argv[]);
 bool cbInstrAppendArg(int argc, char* argv[]);
 bool cbInstrSizeofType(int argc, char* argv[]);
 bool cbInstrVisitType(int argc, char* argv[]);
+bool cbInstrDecodeType(int argc, char* argv[]);
 bool cbInstrClearTypes(int argc, char* argv[]);
 bool cbInstrRemoveType(int argc, char* argv[]);
 bool cbInstrEnumTypes(int argc, char* argv[]);
 bool cbInstrLoadTypes(int argc, char* argv[]);
-bool cbInstrParseTypes(int argc, char* argv[]);
\ No newline at end of file
+bool cbInstrParseTypes(int argc, char* argv[]);
+bool cbInstrImportTypes(int argc, char* argv[]);
\ No newline at end of file
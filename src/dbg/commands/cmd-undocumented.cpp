@@ -12,6 +12,12 @@
 #include "value.h"
 #include "symbolinfo.h"
 #include "argument.h"
+#include "module.h"
+#include "filehelper.h"
+#include "symbolundecorator.h"
+#include "eventreplay.h"
+#include "benchmark.h"
+#include <thread>
 
 bool cbBadCmd(int argc, char* argv[])
 {
@@ -113,6 +119,160 @@ bool cbDebugBenchmark(int argc, char* argv[])
     return true;
 }
 
+bool cbDebugBenchmarkUndecorate(int argc, char* argv[])
+{
+    //corpus: one mangled name per line from a file, or the exports and imports of the loaded modules
+    std::vector<String> corpus;
+    if(argc > 1)
+    {
+        if(!FileHelper::ReadAllLines(argv[1], corpus))
+        {
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to read \"%s\"!\n"), argv[1]);
+            return false;
+        }
+    }
+    else
+    {
+        ModEnum([&corpus](const MODINFO & mod)
+        {
+            for(const auto & x : mod.exports)
+                if(!x.name.empty())
+                    corpus.push_back(x.name);
+            for(const auto & x : mod.imports)
+                if(!x.name.empty())
+                    corpus.push_back(x.name);
+        });
+    }
+    if(corpus.empty())
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "No names to undecorate!"));
+        return false;
+    }
+
+    //uncached, single thread (the old eager behavior at module load)
+    auto ticks = GetTickCount();
+    String undecorated;
+    for(const auto & name : corpus)
+        undecorateName(name, undecorated);
+    auto serialMs = GetTickCount() - ticks;
+
+    //uncached, all cores
+    auto threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+    ticks = GetTickCount();
+    {
+        std::vector<std::thread> threads;
+        for(unsigned int t = 0; t < threadCount; t++)
+        {
+            threads.emplace_back([&corpus, t, threadCount]()
+            {
+                String undecorated;
+                for(size_t i = t; i < corpus.size(); i += threadCount)
+                    undecorateName(corpus[i], undecorated);
+            });
+        }
+        for(auto & thread : threads)
+            thread.join();
+    }
+    auto parallelMs = GetTickCount() - ticks;
+
+    //lazy per name cache (like MODEXPORT), first and second lookup of every name
+    std::vector<LazyUndecoratedName> cache(corpus.size());
+    ticks = GetTickCount();
+    for(size_t i = 0; i < corpus.size(); i++)
+        cache[i].get(corpus[i]);
+    auto coldMs = GetTickCount() - ticks;
+    ticks = GetTickCount();
+    for(size_t i = 0; i < corpus.size(); i++)
+        cache[i].get(corpus[i]);
+    auto warmMs = GetTickCount() - ticks;
+
+    dprintf_untranslated("{\"names\":%llu,\"threads\":%u,\"serialMs\":%u,\"parallelMs\":%u,\"cachedColdMs\":%u,\"cachedWarmMs\":%u}\n",
+                         (unsigned long long)corpus.size(), threadCount, serialMs, parallelMs, coldMs, warmMs);
+    return true;
+}
+
+bool cbDebugEventRecordStart(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+    if(!EventRecordStart(argv[1]))
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "Already recording debug events!"));
+        return false;
+    }
+    dprintf(QT_TRANSLATE_NOOP("DBG", "Recording debug events to \"%s\"...\n"), argv[1]);
+    return true;
+}
+
+bool cbDebugEventRecordStop(int argc, char* argv[])
+{
+    size_t eventCount = 0;
+    if(!EventRecordStop(&eventCount))
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "Failed to save the debug event recording!"));
+        return false;
+    }
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%llu debug events recorded!\n"), (unsigned long long)eventCount);
+    return true;
+}
+
+bool cbDebugBenchmarkReplay(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 2))
+        return false;
+    duint iterations = 1;
+    if(argc > 2 && (!valfromstring(argv[2], &iterations, false) || !iterations))
+        return false;
+    if(DbgIsDebugging())
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "The replay needs the breakpoint and module lists, stop debugging first!"));
+        return false;
+    }
+    EventRecording recording;
+    if(!recording.Load(argv[1]))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to load debug event recording \"%s\"!\n"), argv[1]);
+        return false;
+    }
+    EventReplayStats stats;
+    if(!EventReplay(recording, stats, int(iterations)))
+        return false;
+    auto toUs = [&stats](unsigned long long ticks)
+    {
+        return ticks * 1000000 / stats.frequency;
+    };
+    String handlers;
+    for(int i = 0; i < ReplayEventLast; i++)
+    {
+        if(!handlers.empty())
+            handlers += ",";
+        handlers += StringUtils::sprintf("\"%s\":{\"count\":%llu,\"us\":%llu}", EventReplayHandlerName(REPLAYEVENTTYPE(i)), stats.count[i], toUs(stats.ticks[i]));
+    }
+    dprintf_untranslated("{\"events\":%llu,\"iterations\":%llu,\"breakpoints\":%llu,\"watches\":%llu,\"totalUs\":%llu,\"handlers\":{%s},\"breaks\":%llu,\"moduleBreakpoints\":%llu,\"missingMemory\":%llu}\n",
+                         stats.events, (unsigned long long)iterations, stats.breakpoints, stats.watches, toUs(stats.totalTicks),
+                         handlers.c_str(), stats.breaks, stats.moduleBreakpoints, stats.missingMemory);
+    return true;
+}
+
+bool cbDebugBenchmarkCore(int argc, char* argv[])
+{
+    //benchcore [filter[, seed]], one JSON object per line
+    duint seed = 0x1337;
+    if(argc > 2 && !valfromstring(argv[2], &seed, false))
+        return false;
+    auto count = BenchmarkRun((unsigned int)seed, argc > 1 ? argv[1] : nullptr, [seed](const BenchmarkResult & result)
+    {
+        dprintf_untranslated("{\"name\":\"%s\",\"seed\":%u,\"items\":%llu,\"bytes\":%llu,\"us\":%llu,\"checksum\":\"%016llX\",\"errors\":%llu}\n",
+                             result.name, (unsigned int)seed, result.items, result.bytes, result.us, result.checksum, result.errors);
+    });
+    if(!count)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "No benchmark matches \"%s\"!\n"), argv[1]);
+        return false;
+    }
+    return true;
+}
+
 bool cbInstrSetstr(int argc, char* argv[])
 {
     if(IsArgumentsLessThan(argc, 3))
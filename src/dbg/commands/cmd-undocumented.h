@@ -4,6 +4,11 @@
 
 bool cbBadCmd(int argc, char* argv[]);
 bool cbDebugBenchmark(int argc, char* argv[]);
+bool cbDebugBenchmarkUndecorate(int argc, char* argv[]);
+bool cbDebugEventRecordStart(int argc, char* argv[]);
+bool cbDebugEventRecordStop(int argc, char* argv[]);
+bool cbDebugBenchmarkReplay(int argc, char* argv[]);
+bool cbDebugBenchmarkCore(int argc, char* argv[]);
 bool cbInstrSetstr(int argc, char* argv[]);
 bool cbInstrGetstr(int argc, char* argv[]);
 bool cbInstrCopystr(int argc, char* argv[]);
@@ -9,6 +9,7 @@
 #include "function.h"
 #include "argument.h"
 #include "loop.h"
+#include "codefolding.h"
 #include "debugger.h"
 #include "stringformat.h"
 
@@ -561,4 +562,58 @@ bool cbInstrLoopClear(int argc, char* argv[])
     GuiUpdateAllViews();
     dputs(QT_TRANSLATE_NOOP("DBG", "All loops deleted!"));
     return true;
+}
+
+bool cbInstrFoldFunctions(int argc, char* argv[])
+{
+    duint addr = 0;
+    if(argc > 1)
+    {
+        if(!valfromstring(argv[1], &addr, false))
+            return false;
+    }
+    else
+        addr = GetContextDataEx(hActiveThread, UE_CIP);
+    auto base = ModBaseFromAddr(addr);
+    if(!base)
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "Invalid module"));
+        return false;
+    }
+    auto modhash = ModHashFromAddr(base);
+    std::vector<FUNCTIONSINFO> functions;
+    FunctionGetList(functions);
+    size_t count = 0;
+    for(const auto & function : functions)
+    {
+        if(function.modhash != modhash || function.start == function.end)
+            continue;
+        if(CodeFoldSet(function.start + base, function.end + base, true, false))
+            count++;
+    }
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%d function(s) folded!\n"), int(count));
+    GuiUpdateDisassemblyView();
+    return true;
+}
+
+bool cbInstrFoldClear(int argc, char* argv[])
+{
+    if(argc > 1)
+    {
+        duint addr = 0;
+        if(!valfromstring(argv[1], &addr, false))
+            return false;
+        auto base = ModBaseFromAddr(addr);
+        if(!base)
+        {
+            dputs(QT_TRANSLATE_NOOP("DBG", "Invalid module"));
+            return false;
+        }
+        CodeFoldDelRange(base, base + ModSizeFromAddr(base) - 1, true);
+    }
+    else
+        CodeFoldClear();
+    GuiUpdateDisassemblyView();
+    dputs(QT_TRANSLATE_NOOP("DBG", "Code folds deleted!"));
+    return true;
 }
\ No newline at end of file
@@ -34,4 +34,7 @@ bool cbInstrArgumentClear(int argc, char* argv[]);
 bool cbInstrLoopAdd(int argc, char* argv[]);
 bool cbInstrLoopDel(int argc, char* argv[]);
 bool cbInstrLoopList(int argc, char* argv[]);
-bool cbInstrLoopClear(int argc, char* argv[]);
\ No newline at end of file
+bool cbInstrLoopClear(int argc, char* argv[]);
+
+bool cbInstrFoldFunctions(int argc, char* argv[]);
+bool cbInstrFoldClear(int argc, char* argv[]);
\ No newline at end of file
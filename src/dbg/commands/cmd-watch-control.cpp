@@ -149,18 +149,12 @@ bool cbSetWatchName(int argc, char* argv[])
 
 bool cbCheckWatchdog(int argc, char* argv[])
 {
-    EXCLUSIVE_ACQUIRE(LockWatch);
-    bool watchdogTriggered = false;
-    for(auto j = watchexpr.begin(); j != watchexpr.end(); ++j)
-    {
-        std::pair<unsigned int, WatchExpr*> i = *j;
-        i.second->watchdogTriggered = false;
-        duint intVal = i.second->getIntValue();
-        watchdogTriggered |= i.second->watchdogTriggered;
-    }
-    EXCLUSIVE_RELEASE();
-    if(watchdogTriggered)
-        GuiUpdateWatchViewAsync();
+    bool watchdogTriggered;
+    std::vector<WATCHINFO> changed;
+    WatchEvaluateAll(watchdogTriggered, changed);
+    //only the changed rows are sent, the view is not rebuilt
+    if(!changed.empty())
+        GuiUpdateWatchValues(changed.data(), int(changed.size()));
     varset("$result", watchdogTriggered ? 1 : 0, false);
     return true;
 }
\ No newline at end of file
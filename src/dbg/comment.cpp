@@ -97,3 +97,24 @@ bool CommentGetInfo(duint Address, COMMENTSINFO* info)
 {
     return comments.GetInfo(Comments::VaKey(Address), info);
 }
+
+void CommentGetMany(const duint* Addresses, size_t Count, std::vector<std::pair<duint, String>> & List)
+{
+    // Hash the addresses first, the module lock is not taken with the comment lock held
+    std::vector<duint> keys(Count);
+    for(size_t i = 0; i < Count; i++)
+        keys[i] = Comments::VaKey(Addresses[i]);
+
+    SHARED_ACQUIRE(LockComments);
+    const auto & map = comments.GetDataUnsafe();
+    for(size_t i = 0; i < Count; i++)
+    {
+        auto found = map.find(keys[i]);
+        if(found == map.end())
+            continue;
+        if(found->second.manual)
+            List.emplace_back(Addresses[i], found->second.text);
+        else
+            List.emplace_back(Addresses[i], "\1" + found->second.text);
+    }
+}
@@ -19,5 +19,6 @@ bool CommentEnum(COMMENTSINFO* List, size_t* Size);
 void CommentClear();
 void CommentGetList(std::vector<COMMENTSINFO> & list);
 bool CommentGetInfo(duint Address, COMMENTSINFO* info);
+void CommentGetMany(const duint* Addresses, size_t Count, std::vector<std::pair<duint, String>> & List);
 
 #endif // _COMMENT_H
\ No newline at end of file
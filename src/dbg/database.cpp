@@ -23,6 +23,7 @@
 #include "encodemap.h"
 #include "plugin_loader.h"
 #include "argument.h"
+#include "codefolding.h"
 #include "filemap.h"
 #include "debugger.h"
 #include "stringformat.h"
@@ -66,6 +67,7 @@ void DbSave(DbLoadSaveType saveType, const char* dbfile, bool disablecompression
         BookmarkCacheSave(root);
         FunctionCacheSave(root);
         ArgumentCacheSave(root);
+        CodeFoldCacheSave(root);
         LoopCacheSave(root);
         XrefCacheSave(root);
         EncodeMapCacheSave(root);
@@ -242,6 +244,7 @@ void DbLoad(DbLoadSaveType loadType, const char* dbfile)
         BookmarkCacheLoad(root);
         FunctionCacheLoad(root);
         ArgumentCacheLoad(root);
+        CodeFoldCacheLoad(root);
         LoopCacheLoad(root);
         XrefCacheLoad(root);
         EncodeMapCacheLoad(root);
@@ -299,6 +302,7 @@ void DbClear(bool terminating)
     BookmarkClear();
     FunctionClear();
     ArgumentClear();
+    CodeFoldClear();
     LoopClear();
     XrefClear();
     EncodeMapClear();
@@ -421,4 +425,9 @@ bool DbCheckHash(duint currentHash)
 duint DbGetHash()
 {
     return dbhash;
+}
+
+const char* DbGetBasePath()
+{
+    return dbbasepath;
 }
\ No newline at end of file
@@ -17,5 +17,6 @@ void DbClear(bool terminating = false);
 void DbSetPath(const char* Directory, const char* ModulePath);
 bool DbCheckHash(duint currentHash);
 duint DbGetHash();
+const char* DbGetBasePath();
 
 #endif // _DATABASE_H
\ No newline at end of file
@@ -36,6 +36,8 @@
 #include "exprfunc.h"
 #include "debugger_cookie.h"
 #include "debugger_tracing.h"
+#include "eventreplay.h"
+#include "tracewriteindex.h"
 
 // Debugging variables
 static PROCESS_INFORMATION g_pi = {0, 0, 0, 0};
@@ -103,6 +105,14 @@ static duint dbgcleartracestate()
     return steps;
 }
 
+void dbgreplayreset()
+{
+    // handler state left over from the previous replay
+    dbgcleartracestate();
+    stepRepeat = 0;
+    mRtrPreviousCSP = 0;
+}
+
 static void dbgClearRtuBreakpoints()
 {
     EXCLUSIVE_ACQUIRE(LockRunToUserCode);
@@ -553,6 +563,9 @@ void DebugUpdateGuiSetStateAsync(duint disasm_addr, bool stack, DBGSTATE state)
     // call paused routine to clean up various tracing states.
     if(state == paused)
         cbDebuggerPaused();
+    // a replayed event has no process to show
+    if(EventReplayActive())
+        return;
     GuiSetDebugStateAsync(state);
     DebugUpdateGuiAsync(disasm_addr, stack);
 }
@@ -755,6 +768,12 @@ void cbPauseBreakpoint()
     wait(WAITID_RUN);
 }
 
+// CIP of the active thread, the recorded one when an event is replayed
+static duint getActiveCip()
+{
+    return EventReplayActive() ? EventReplayContext().cip : GetContextDataEx(hActiveThread, UE_CIP);
+}
+
 static void handleBreakCondition(const BREAKPOINT & bp, const void* ExceptionAddress, duint CIP, bool doBreak)
 {
     if(doBreak)
@@ -795,7 +814,9 @@ static void handleBreakCondition(const BREAKPOINT & bp, const void* ExceptionAdd
 static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr)
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
-    auto CIP = GetContextDataEx(hActiveThread, UE_CIP);
+    if(bEventRecording)
+        EventRecordBreakpoint(bptype, ExceptionAddress);
+    auto CIP = getActiveCip();
 
     //handle process cookie retrieval
     if(bptype == BPNORMAL && cookie.HandleBreakpoint(CIP))
@@ -805,31 +826,34 @@ static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr
     //NOTE: this locking is very tricky, make sure you understand it before modifying anything
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
     duint breakpointExceptionAddress = 0;
+    duint bpAddress = 0;
     switch(bptype)
     {
     case BPNORMAL:
-        bpPtr = BpInfoFromAddr(BPNORMAL, CIP);
+        bpAddress = CIP;
         breakpointExceptionAddress = CIP;
         break;
     case BPHARDWARE:
-        bpPtr = BpInfoFromAddr(BPHARDWARE, duint(ExceptionAddress));
+        bpAddress = duint(ExceptionAddress);
         breakpointExceptionAddress = duint(ExceptionAddress);
         break;
     case BPMEMORY:
-        bpPtr = BpInfoFromAddr(BPMEMORY, MemFindBaseAddr(duint(ExceptionAddress), nullptr, true));
+        bpAddress = MemFindBaseAddr(duint(ExceptionAddress), nullptr, true);
         breakpointExceptionAddress = duint(ExceptionAddress);
         break;
     case BPDLL:
-        bpPtr = BpInfoFromAddr(BPDLL, BpGetDLLBpAddr(reinterpret_cast<const char*>(ExceptionAddress)));
+        bpAddress = BpGetDLLBpAddr(reinterpret_cast<const char*>(ExceptionAddress));
         breakpointExceptionAddress = 0; //makes no sense
         break;
     case BPEXCEPTION:
-        bpPtr = BpInfoFromAddr(BPEXCEPTION, ((EXCEPTION_DEBUG_INFO*)ExceptionAddress)->ExceptionRecord.ExceptionCode);
+        bpAddress = ((EXCEPTION_DEBUG_INFO*)ExceptionAddress)->ExceptionRecord.ExceptionCode;
         breakpointExceptionAddress = (duint)((EXCEPTION_DEBUG_INFO*)ExceptionAddress)->ExceptionRecord.ExceptionAddress;
         break;
     default:
         break;
     }
+    if(bptype <= BPEXCEPTION)
+        bpPtr = BpInfoFromAddr(bptype, bpAddress);
     varset("$breakpointexceptionaddress", breakpointExceptionAddress, true);
     if(!(bpPtr && bpPtr->enabled)) //invalid / disabled breakpoint hit (most likely a bug)
     {
@@ -838,7 +862,7 @@ static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr
             // release the breakpoint lock to prevent deadlocks during the wait
             EXCLUSIVE_RELEASE();
             dputs(QT_TRANSLATE_NOOP("DBG", "Breakpoint reached not in list!"));
-            DebugUpdateGuiSetStateAsync(GetContextDataEx(hActiveThread, UE_CIP), true);
+            DebugUpdateGuiSetStateAsync(getActiveCip(), true);
             //lock
             lock(WAITID_RUN);
             // Plugin callback
@@ -951,6 +975,11 @@ void cbMemoryBreakpoint(void* ExceptionAddress)
     cbGenericBreakpoint(BPMEMORY, ExceptionAddress);
 }
 
+void dbgreplaybreakpoint(BP_TYPE bptype, void* ExceptionAddress)
+{
+    cbGenericBreakpoint(bptype, ExceptionAddress);
+}
+
 void cbRunToUserCodeBreakpoint(void* ExceptionAddress)
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
@@ -1040,10 +1069,14 @@ static BOOL CALLBACK SymRegisterCallbackProc64(HANDLE, ULONG ActionCode, ULONG64
     return TRUE;
 }
 
-bool cbSetModuleBreakpoints(const BREAKPOINT* bp)
+// Arms a breakpoint in TitanEngine, changes to the enabled flag and titantype are only made to bp
+static bool setModuleBreakpoint(BREAKPOINT* bp)
 {
     if(!bp->enabled)
         return true;
+    // a replayed dll load has no process to arm the breakpoint in
+    if(EventReplayActive())
+        return EventReplayArmBreakpoint(bp);
     switch(bp->type)
     {
     case BPNORMAL:
@@ -1057,7 +1090,7 @@ bool cbSetModuleBreakpoints(const BREAKPOINT* bp)
                         bp->addr,
                         ((unsigned char*)&bp->oldbytes)[0], ((unsigned char*)&bp->oldbytes)[1],
                         ((unsigned char*)&oldbytes)[0], ((unsigned char*)&oldbytes)[1]);
-                BpEnable(bp->addr, BPNORMAL, false);
+                bp->enabled = false;
             }
             else if(!SetBPX(bp->addr, bp->titantype, (void*)cbUserBreakpoint))
                 dprintf(QT_TRANSLATE_NOOP("DBG", "Could not set breakpoint %p! (SetBPX)\n"), bp->addr);
@@ -1084,9 +1117,7 @@ bool cbSetModuleBreakpoints(const BREAKPOINT* bp)
             dputs(QT_TRANSLATE_NOOP("DBG", "You can only set 4 hardware breakpoints"));
             return false;
         }
-        int titantype = bp->titantype;
-        TITANSETDRX(titantype, drx);
-        BpSetTitanType(bp->addr, BPHARDWARE, titantype);
+        TITANSETDRX(bp->titantype, drx);
         if(!SetHardwareBreakPoint(bp->addr, drx, TITANGETTYPE(bp->titantype), TITANGETSIZE(bp->titantype), (void*)cbHardwareBreakpoint))
             dprintf(QT_TRANSLATE_NOOP("DBG", "Could not set hardware breakpoint %p! (SetHardwareBreakPoint)\n"), bp->addr);
         else
@@ -1100,6 +1131,29 @@ bool cbSetModuleBreakpoints(const BREAKPOINT* bp)
     return true;
 }
 
+bool cbSetModuleBreakpoints(const BREAKPOINT* bp)
+{
+    BREAKPOINT armed = *bp;
+    auto result = setModuleBreakpoint(&armed);
+    if(armed.enabled != bp->enabled)
+        BpEnable(bp->addr, bp->type, armed.enabled);
+    if(armed.titantype != bp->titantype)
+        BpSetTitanType(bp->addr, bp->type, armed.titantype);
+    return result;
+}
+
+// Arms all breakpoints of a module (all modules when nullptr) and stores the changes under a single lock
+static void setModuleBreakpoints(const char* modname, duint base = 0)
+{
+    std::vector<BREAKPOINT> list;
+    if(!BpGetModuleList(modname, base, list))
+        return;
+    auto armed = list;
+    for(auto & bp : armed)
+        setModuleBreakpoint(&bp);
+    BpUpdateModuleList(list, armed, base);
+}
+
 bool cbSetDLLBreakpoints(const BREAKPOINT* bp)
 {
     if(!bp->enabled)
@@ -1146,13 +1200,169 @@ void DebugRemoveBreakpoints()
 
 void DebugSetBreakpoints()
 {
-    BpEnumAll(cbSetModuleBreakpoints);
+    setModuleBreakpoints(nullptr);
+}
+
+// Reads the original bytes of sorted breakpoint addresses with one read per page
+static void readBreakpointBytes(const duint* addrs, size_t count, unsigned short* oldbytes, bool* ok)
+{
+    std::vector<unsigned char> page(PAGE_SIZE);
+    duint pageBase = 0;
+    bool pageRead = false, pageValid = false;
+    for(size_t i = 0; i < count; i++)
+    {
+        auto addr = addrs[i];
+        auto base = addr & ~duint(PAGE_SIZE - 1);
+        auto offset = addr - base;
+        if(offset + sizeof(unsigned short) > PAGE_SIZE) // crosses the page
+        {
+            ok[i] = MemRead(addr, &oldbytes[i], sizeof(unsigned short));
+            continue;
+        }
+        if(!pageRead || base != pageBase)
+        {
+            pageBase = base;
+            pageRead = true;
+            pageValid = MemRead(base, page.data(), PAGE_SIZE);
+        }
+        if(pageValid)
+        {
+            memcpy(&oldbytes[i], page.data() + offset, sizeof(unsigned short));
+            ok[i] = true;
+        }
+        else
+            ok[i] = MemRead(addr, &oldbytes[i], sizeof(unsigned short));
+    }
+}
+
+size_t DebugBulkBreakpoints(BPBULKOP op, const duint* addresses, size_t count, DWORD titantype, bool* results)
+{
+    if(!count)
+        return 0;
+
+    // Work in address order, so the memory reads and int3 writes of a page are done together
+    std::vector<size_t> order(count);
+    for(size_t i = 0; i < count; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [addresses](size_t a, size_t b)
+    {
+        return addresses[a] < addresses[b];
+    });
+    std::vector<duint> addrs(count);
+    for(size_t i = 0; i < count; i++)
+        addrs[i] = addresses[order[i]];
+
+    std::unique_ptr<bool[]> ok(new bool[count]());
+    std::unique_ptr<bool[]> wasEnabled(new bool[count]());
+    std::vector<unsigned short> oldbytes(count);
+    std::vector<duint> revert;
+    switch(op)
+    {
+    case BpBulkSet:
+    {
+        readBreakpointBytes(addrs.data(), count, oldbytes.data(), ok.get());
+        std::vector<BREAKPOINT> list;
+        std::vector<size_t> listIndex;
+        BREAKPOINT bp;
+        memset(&bp, 0, sizeof(bp));
+        bp.enabled = true;
+        bp.singleshoot = (titantype & UE_SINGLESHOOT) != 0;
+        bp.type = BPNORMAL;
+        bp.titantype = titantype;
+        for(size_t i = 0; i < count; i++)
+        {
+            if(!ok[i] || IsBPXEnabled(addrs[i]))
+            {
+                ok[i] = false;
+                continue;
+            }
+            bp.addr = addrs[i];
+            bp.oldbytes = oldbytes[i];
+            list.push_back(bp);
+            listIndex.push_back(i);
+        }
+        std::unique_ptr<bool[]> inserted(new bool[list.size() + 1]());
+        BpNewBulk(list, inserted.get());
+        for(size_t j = 0; j < list.size(); j++)
+        {
+            auto i = listIndex[j];
+            ok[i] = inserted[j] && SetBPX(addrs[i], titantype, (void*)cbUserBreakpoint);
+            if(inserted[j] && !ok[i])
+                revert.push_back(addrs[i]);
+        }
+        if(!revert.empty())
+            BpDeleteBulk(BPNORMAL, revert.data(), revert.size(), nullptr, nullptr);
+    }
+    break;
+
+    case BpBulkDelete:
+    {
+        BpDeleteBulk(BPNORMAL, addrs.data(), count, ok.get(), wasEnabled.get());
+        for(size_t i = 0; i < count; i++)
+            if(wasEnabled[i] && !DeleteBPX(addrs[i]))
+                ok[i] = false;
+    }
+    break;
+
+    case BpBulkEnable:
+    {
+        readBreakpointBytes(addrs.data(), count, oldbytes.data(), ok.get());
+        std::vector<duint> readable;
+        std::vector<unsigned short> readableBytes;
+        std::vector<size_t> readableIndex;
+        for(size_t i = 0; i < count; i++)
+        {
+            if(!ok[i])
+                continue;
+            readable.push_back(addrs[i]);
+            readableBytes.push_back(oldbytes[i]);
+            readableIndex.push_back(i);
+        }
+        auto size = readable.size();
+        std::unique_ptr<bool[]> found(new bool[size + 1]());
+        std::unique_ptr<bool[]> enabled(new bool[size + 1]());
+        std::vector<DWORD> titantypes(size);
+        BpEnableBulk(BPNORMAL, readable.data(), size, true, readableBytes.data(), found.get(), enabled.get(), titantypes.data());
+        for(size_t j = 0; j < size; j++)
+        {
+            auto i = readableIndex[j];
+            ok[i] = found[j] && (enabled[j] || SetBPX(addrs[i], titantypes[j], (void*)cbUserBreakpoint));
+            if(found[j] && !ok[i])
+                revert.push_back(addrs[i]);
+        }
+        if(!revert.empty())
+            BpEnableBulk(BPNORMAL, revert.data(), revert.size(), false, nullptr, nullptr, nullptr, nullptr);
+    }
+    break;
+
+    case BpBulkDisable:
+    {
+        BpEnableBulk(BPNORMAL, addrs.data(), count, false, nullptr, ok.get(), wasEnabled.get(), nullptr);
+        for(size_t i = 0; i < count; i++)
+            if(wasEnabled[i] && !DeleteBPX(addrs[i]))
+                ok[i] = false;
+    }
+    break;
+    }
+
+    size_t succeeded = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        if(results)
+            results[order[i]] = ok[i];
+        if(ok[i])
+            succeeded++;
+    }
+    GuiUpdateAllViews();
+    return succeeded;
 }
 
 void cbStep()
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
-    duint CIP = GetContextDataEx(hActiveThread, UE_CIP);
+    duint CIP = getActiveCip();
+    if(bEventRecording)
+        EventRecordStep();
     if(!stepRepeat || !--stepRepeat)
     {
         DebugUpdateGuiSetStateAsync(CIP, true);
@@ -1185,7 +1395,7 @@ static void cbRtrFinalStep(bool checkRepeat = false)
     {
         dbgcleartracestate();
         hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
-        duint CIP = GetContextDataEx(hActiveThread, UE_CIP);
+        duint CIP = getActiveCip();
         // Trace record
         _dbg_dbgtraceexecute(CIP);
         DebugUpdateGuiSetStateAsync(CIP, true);
@@ -1241,6 +1451,8 @@ void cbRtrStep()
 
 static void cbTraceUniversalConditionalStep(duint cip, bool bStepInto, void(*callback)(), bool forceBreakTrace)
 {
+    if(bEventRecording)
+        EventRecordTraceStep(traceState.TraceConditionText(), traceState.LogConditionText(), traceState.LogText(), traceState.SwitchConditionText());
     PLUG_CB_TRACEEXECUTE info;
     info.cip = cip;
     auto breakCondition = (info.stop = traceState.BreakTrace() || forceBreakTrace);
@@ -1292,13 +1504,13 @@ static void cbTraceUniversalConditionalStep(duint cip, bool bStepInto, void(*cal
 static void cbTraceXConditionalStep(bool bStepInto, void (*callback)())
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
-    cbTraceUniversalConditionalStep(GetContextDataEx(hActiveThread, UE_CIP), bStepInto, callback, false);
+    cbTraceUniversalConditionalStep(getActiveCip(), bStepInto, callback, false);
 }
 
 static void cbTraceXXTraceRecordStep(bool bStepInto, bool bInto, void(*callback)())
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
-    auto cip = GetContextDataEx(hActiveThread, UE_CIP);
+    auto cip = getActiveCip();
     auto forceBreakTrace = TraceRecord.getTraceRecordType(cip) != TraceRecordManager::TraceRecordNone && (TraceRecord.getHitCount(cip) == 0) ^ bInto;
     cbTraceUniversalConditionalStep(cip, bStepInto, callback, forceBreakTrace);
 }
@@ -1333,6 +1545,20 @@ void cbTraceOverIntoTraceRecordStep()
     cbTraceXXTraceRecordStep(false, true, cbTraceOverIntoTraceRecordStep);
 }
 
+void dbgreplaytracestep(const String & traceCondition, const String & logCondition, const String & logText, const String & switchCondition)
+{
+    // the recording has the trace settings of every step, a trace that finished starts again
+    if(!traceState.IsActive() || traceState.TraceConditionText() != traceCondition || traceState.LogConditionText() != logCondition
+            || traceState.LogText() != logText || traceState.SwitchConditionText() != switchCondition)
+    {
+        dbgcleartracestate();
+        traceState.InitTraceCondition(traceCondition, duint(-1));
+        traceState.InitLogCondition(logCondition, logText);
+        traceState.InitSwitchCondition(switchCondition);
+    }
+    cbTraceOverConditionalStep();
+}
+
 static void cbCreateProcess(CREATE_PROCESS_DEBUG_INFO* CreateProcessInfo)
 {
     fdProcessInfo->hProcess = CreateProcessInfo->hProcess;
@@ -1372,9 +1598,9 @@ static void cbCreateProcess(CREATE_PROCESS_DEBUG_INFO* CreateProcessInfo)
 
     char modname[256] = "";
     if(ModNameFromAddr((duint)base, modname, true))
-        BpEnumAll(cbSetModuleBreakpoints, modname, duint(base));
+        setModuleBreakpoints(modname, duint(base));
     BpEnumAll(cbSetDLLBreakpoints);
-    BpEnumAll(cbSetModuleBreakpoints, "");
+    setModuleBreakpoints("");
     DebugUpdateBreakpointsViewAsync();
     pCreateProcessBase = (duint)CreateProcessInfo->lpBaseOfImage;
     pDebuggedBase = pCreateProcessBase; //debugged base = executable
@@ -1651,6 +1877,14 @@ static void cbSystemBreakpoint(void* ExceptionData) // TODO: System breakpoint e
     wait(WAITID_RUN);
 }
 
+// Arms the breakpoints of a module that was just loaded, modname receives the module name
+static void setLoadedModuleBreakpoints(duint base, char* modname)
+{
+    if(ModNameFromAddr(base, modname, true))
+        setModuleBreakpoints(modname, base);
+    DebugUpdateBreakpointsViewAsync();
+}
+
 static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
@@ -1660,15 +1894,16 @@ static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
     if(!GetFileNameFromHandle(LoadDll->hFile, DLLDebugFileName) && !GetFileNameFromModuleHandle(fdProcessInfo->hProcess, HMODULE(base), DLLDebugFileName))
         strcpy_s(DLLDebugFileName, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "??? (GetFileNameFromHandle failed)")));
 
+    if(bEventRecording)
+        EventRecordLoadDll(duint(base), DLLDebugFileName);
+
     ModLoad((duint)base, 1, DLLDebugFileName);
 
     // Update memory map
     MemUpdateMapAsync();
 
     char modname[MAX_MODULE_SIZE] = "";
-    if(ModNameFromAddr(duint(base), modname, true))
-        BpEnumAll(cbSetModuleBreakpoints, modname, duint(base));
-    DebugUpdateBreakpointsViewAsync();
+    setLoadedModuleBreakpoints(duint(base), modname);
     bool bAlreadySetEntry = false;
 
     char command[MAX_PATH * 2] = "";
@@ -1785,6 +2020,14 @@ static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
     }
 }
 
+void dbgreplayloaddll(duint base, const char* fileName)
+{
+    // the module list and module breakpoints part of cbLoadDll, the rest needs the process
+    ModLoad(base, 1, fileName);
+    char modname[MAX_MODULE_SIZE] = "";
+    setLoadedModuleBreakpoints(base, modname);
+}
+
 static void cbUnloadDll(UNLOAD_DLL_DEBUG_INFO* UnloadDll)
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
@@ -2793,6 +3036,7 @@ static void debugLoopFunction(void* lpParameter, bool attach)
     ThreadClear();
     WatchClear();
     TraceRecord.clear();
+    TraceWriteIndexClear();
     _dbg_dbgenableRunTrace(false, nullptr); //Stop run trace
     GuiSetDebugState(stopped);
     GuiUpdateAllViews();
@@ -2839,7 +3083,7 @@ const char* dbggetdebuggeeinitscript()
 
 void dbgsetforeground()
 {
-    if(!bNoForegroundWindow)
+    if(!bNoForegroundWindow && !EventReplayActive())
         SetForegroundWindow(GuiGetWindowHandle());
 }
 
@@ -2874,6 +3118,9 @@ bool dbgrestartadmin()
 
 void StepIntoWow64(LPVOID traceCallBack)
 {
+    // the next event of a replayed recording is the result of the step
+    if(EventReplayActive())
+        return;
 #ifndef _WIN64
     //NOTE: this workaround has the potential of detecting x64dbg while tracing, disable it if that happens
     if(!bNoWow64SingleStepWorkaround)
@@ -2904,6 +3151,8 @@ void StepIntoWow64(LPVOID traceCallBack)
 
 void StepOverWrapper(LPVOID traceCallBack)
 {
+    if(EventReplayActive())
+        return;
     if(bPausedOnException && exceptionDispatchAddr && !IsBPXEnabled(exceptionDispatchAddr))
     {
         SetBPX(exceptionDispatchAddr, UE_SINGLESHOOT, traceCallBack);
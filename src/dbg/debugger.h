@@ -51,6 +51,17 @@ void DebugUpdateBreakpointsViewAsync();
 void DebugUpdateStack(duint dumpAddr, duint csp, bool forceDump = false);
 void DebugRemoveBreakpoints();
 void DebugSetBreakpoints();
+
+enum BPBULKOP
+{
+    BpBulkSet,
+    BpBulkDelete,
+    BpBulkEnable,
+    BpBulkDisable
+};
+
+// Applies op to the normal breakpoints at addresses with a single breakpoint lock per step and one GUI update, results (optional) receives the status of each address
+size_t DebugBulkBreakpoints(BPBULKOP op, const duint* addresses, size_t count, DWORD titantype, bool* results);
 void GuiSetDebugStateAsync(DBGSTATE state);
 void dbgsetskipexceptions(bool skip);
 void dbgsetsteprepeat(bool steppingIn, duint repeat);
@@ -81,6 +92,10 @@ bool dbggetwintext(std::vector<std::string>* winTextList, const DWORD dwProcessI
 void dbgtracebrowserneedsupdate();
 bool dbgsetdllbreakpoint(const char* mod, DWORD type, bool singleshoot);
 bool dbgdeletedllbreakpoint(const char* mod, DWORD type);
+void dbgreplayreset();
+void dbgreplaybreakpoint(BP_TYPE bptype, void* ExceptionAddress);
+void dbgreplaytracestep(const String & traceCondition, const String & logCondition, const String & logText, const String & switchCondition);
+void dbgreplayloaddll(duint base, const char* fileName);
 
 void cbStep();
 void cbRtrStep();
@@ -103,6 +103,11 @@ struct TraceState
         return !traceCondition || traceCondition->BreakTrace();
     }
 
+    const String & TraceConditionText() const
+    {
+        return traceCondition ? traceCondition->condition.GetExpression() : emptyString;
+    }
+
     duint StepCount() const
     {
         return traceCondition ? traceCondition->steps : 0;
@@ -128,6 +133,11 @@ struct TraceState
         return logCondition ? logCondition->text : emptyString;
     }
 
+    const String & LogConditionText() const
+    {
+        return logCondition ? logCondition->condition.GetExpression() : emptyString;
+    }
+
     bool InitCmdCondition(const String & expression, const String & text)
     {
         delete cmdCondition;
@@ -163,6 +173,11 @@ struct TraceState
         return switchCondition && switchCondition->Evaluate(defaultValue);
     }
 
+    const String & SwitchConditionText() const
+    {
+        return switchCondition ? switchCondition->condition.GetExpression() : emptyString;
+    }
+
     void SetLogFile(const char* fileName)
     {
         logFile = StringUtils::Utf8ToUtf16(fileName);
@@ -3,14 +3,34 @@
 #include "addrinfo.h"
 #include <zydis_wrapper.h>
 
+struct ENCODERUN
+{
+    ENCODETYPE type;
+    duint unit; // type every unit bytes from the start of the run, enc_middle in between, 0 for code
+    std::vector<bool> starts; // code only, a bit per byte of the run that is set where an instruction starts
+};
+
+// inclusive offset ranges in the segment, the gaps are enc_unknown
+typedef std::map<Range, ENCODERUN, RangeCompare> EncodeRuns;
+
 struct ENCODEMAP : AddrInfo
 {
     duint size;
-    byte* data;
+    EncodeRuns runs;
 };
 
 std::unordered_map<duint, duint> referenceCount;
 
+// The segment state a buffer was made from, to write back the bytes that were changed in the buffer
+struct ENCODEBUFFER
+{
+    duint base;
+    duint size;
+    EncodeRuns runs;
+};
+
+static std::unordered_map<duint, ENCODEBUFFER> encodeBuffers;
+
 void IncreaseReferenceCount(void* buffer, bool lock = true)
 {
     if(lock)
@@ -43,12 +63,220 @@ duint DecreaseReferenceCount(void* buffer, bool lock = true)
     return iter->second;
 }
 
+static bool IsCodeType(ENCODETYPE type)
+{
+    return type == enc_code || type == enc_junk;
+}
+
+static ENCODETYPE RunsGetType(const EncodeRuns & runs, duint offset)
+{
+    auto found = runs.find(Range(offset, offset));
+    if(found == runs.end())
+        return enc_unknown;
+    const auto & run = found->second;
+    auto index = offset - found->first.first;
+    if(!run.unit)
+        return run.starts[index] ? run.type : enc_middle;
+    return index % run.unit ? enc_middle : run.type;
+}
+
+// Removes [start, end], elements cut at the end are removed completely (their middle bytes would be orphaned)
+static void RunsErase(EncodeRuns & runs, duint start, duint end)
+{
+    std::vector<std::pair<Range, ENCODERUN>> remaining;
+    for(auto itr = runs.lower_bound(Range(start, start)); itr != runs.end() && itr->first.first <= end;)
+    {
+        auto range = itr->first;
+        auto run = itr->second;
+        itr = runs.erase(itr);
+        if(range.first < start)
+        {
+            auto left = run;
+            left.starts.resize(run.unit ? 0 : start - range.first);
+            remaining.push_back({ Range(range.first, start - 1), left });
+        }
+        if(range.second > end)
+        {
+            auto next = end + 1;
+            if(run.unit)
+            {
+                auto phase = (next - range.first) % run.unit;
+                if(phase)
+                    next += run.unit - phase;
+            }
+            else
+            {
+                while(next <= range.second && !run.starts[next - range.first])
+                    next++;
+            }
+            if(next <= range.second)
+            {
+                auto right = run;
+                if(!run.unit)
+                    right.starts.assign(run.starts.begin() + (next - range.first), run.starts.end());
+                remaining.push_back({ Range(next, range.second), right });
+            }
+        }
+    }
+    for(const auto & run : remaining)
+        runs.insert(run);
+}
+
+// [start, end] has to be free, merges with the neighbours when the elements line up (code always merges)
+static void RunsInsert(EncodeRuns & runs, duint start, duint end, ENCODERUN run)
+{
+    auto mergeable = [&run](const ENCODERUN & other, duint distance)
+    {
+        return other.type == run.type && other.unit == run.unit && (!run.unit || distance % run.unit == 0);
+    };
+    if(start)
+    {
+        auto prev = runs.find(Range(start - 1, start - 1));
+        if(prev != runs.end() && mergeable(prev->second, start - prev->first.first))
+        {
+            run.starts.insert(run.starts.begin(), prev->second.starts.begin(), prev->second.starts.end());
+            start = prev->first.first;
+            runs.erase(prev);
+        }
+    }
+    auto next = runs.find(Range(end + 1, end + 1));
+    if(next != runs.end() && mergeable(next->second, next->first.first - start))
+    {
+        run.starts.insert(run.starts.end(), next->second.starts.begin(), next->second.starts.end());
+        end = next->first.second;
+        runs.erase(next);
+    }
+    runs.emplace(Range(start, end), std::move(run));
+}
+
+// A single code run for [start, start + size), starts are set by the caller
+static ENCODERUN CodeRun(ENCODETYPE type, duint size)
+{
+    ENCODERUN run;
+    run.type = type;
+    run.unit = 0;
+    run.starts.resize(size);
+    return run;
+}
+
+// Converts a byte per address map (the old database format) to runs
+static void RunsFromBytes(const unsigned char* data, duint size, duint offset, std::vector<std::pair<Range, ENCODERUN>> & runs)
+{
+    for(duint i = 0; i < size;)
+    {
+        auto type = ENCODETYPE(data[i]);
+        if(type == enc_unknown)
+        {
+            i++;
+            continue;
+        }
+        duint length = 1;
+        if(type != enc_middle)
+            while(i + length < size && data[i + length] == enc_middle)
+                length++;
+        auto start = offset + i;
+        i += length;
+        if(!runs.empty())
+        {
+            auto & last = runs.back();
+            if(last.second.type == type && last.first.second + 1 == start)
+            {
+                if(!last.second.unit)
+                {
+                    last.second.starts.push_back(true);
+                    last.second.starts.resize(last.second.starts.size() + length - 1);
+                    last.first.second = start + length - 1;
+                    continue;
+                }
+                if((start - last.first.first) % last.second.unit == 0 && length <= last.second.unit)
+                {
+                    last.first.second = start + length - 1;
+                    continue;
+                }
+            }
+        }
+        if(IsCodeType(type))
+        {
+            auto run = CodeRun(type, length);
+            run.starts[0] = true;
+            runs.push_back({ Range(start, start + length - 1), std::move(run) });
+        }
+        else
+            runs.push_back({ Range(start, start + length - 1), ENCODERUN{ type, length } });
+    }
+}
+
+// Writes the types of the offsets [offset, offset + size) to data, the gaps are left alone
+static void RunsToBytes(const EncodeRuns & runs, unsigned char* data, duint offset, duint size)
+{
+    if(!size)
+        return;
+    auto last = offset + size - 1;
+    for(auto itr = runs.lower_bound(Range(offset, offset)); itr != runs.end() && itr->first.first <= last; ++itr)
+    {
+        const auto & run = itr->second;
+        auto first = itr->first.first;
+        auto start = first < offset ? offset : first;
+        auto end = min(itr->first.second, last);
+        if(run.unit == 1)
+        {
+            memset(data + start - offset, (byte)run.type, end - start + 1);
+            continue;
+        }
+        memset(data + start - offset, (byte)enc_middle, end - start + 1);
+        if(!run.unit)
+        {
+            for(auto i = start; i <= end; i++)
+                if(run.starts[i - first])
+                    data[i - offset] = (byte)run.type;
+            continue;
+        }
+        auto phase = (start - first) % run.unit;
+        for(auto i = phase ? start + run.unit - phase : start; i <= end; i += run.unit)
+            data[i - offset] = (byte)run.type;
+    }
+}
+
+static String StartsToHex(const std::vector<bool> & starts)
+{
+    std::vector<unsigned char> bits((starts.size() + 7) / 8);
+    for(size_t i = 0; i < starts.size(); i++)
+        if(starts[i])
+            bits[i / 8] |= 1 << (i % 8);
+    return StringUtils::ToCompressedHex(bits.data(), bits.size());
+}
+
+static bool StartsFromHex(const char* text, duint size, std::vector<bool> & starts)
+{
+    std::vector<unsigned char> bits;
+    if(!text || !StringUtils::FromCompressedHex(text, bits) || bits.size() != (size + 7) / 8)
+        return false;
+    starts.resize(size);
+    for(duint i = 0; i < size; i++)
+        starts[i] = (bits[i / 8] >> (i % 8) & 1) != 0;
+    return size && starts[0];
+}
+
 struct EncodeMapSerializer : AddrInfoSerializer<ENCODEMAP>
 {
     bool Save(const ENCODEMAP & value) override
     {
         AddrInfoSerializer::Save(value);
-        setString("data", StringUtils::ToCompressedHex(value.data, value.size));
+        setHex("size", value.size);
+        // flat array of offset, size, type, unit, the instruction starts of code runs (unit 0) are bitmaps in starts
+        auto runs = json_array();
+        auto starts = json_array();
+        for(const auto & itr : value.runs)
+        {
+            json_array_append_new(runs, json_integer(itr.first.first));
+            json_array_append_new(runs, json_integer(itr.first.second - itr.first.first + 1));
+            json_array_append_new(runs, json_integer(itr.second.type));
+            json_array_append_new(runs, json_integer(itr.second.unit));
+            if(!itr.second.unit)
+                json_array_append_new(starts, json_string(StartsToHex(itr.second.starts).c_str()));
+        }
+        set("runs", runs);
+        set("starts", starts);
         return true;
     }
 
@@ -56,6 +284,35 @@ struct EncodeMapSerializer : AddrInfoSerializer<ENCODEMAP>
     {
         if(!AddrInfoSerializer::Load(value))
             return false;
+        value.runs.clear();
+        auto runs = get("runs");
+        if(runs)
+        {
+            if(!getHex("size", value.size))
+                return false;
+            auto count = json_array_size(runs);
+            if(count % 4)
+                return false;
+            auto starts = get("starts");
+            size_t code = 0;
+            duint next = 0;
+            for(size_t i = 0; i < count; i += 4)
+            {
+                auto start = duint(json_integer_value(json_array_get(runs, i)));
+                auto size = duint(json_integer_value(json_array_get(runs, i + 1)));
+                auto type = ENCODETYPE(json_integer_value(json_array_get(runs, i + 2)));
+                auto unit = duint(json_integer_value(json_array_get(runs, i + 3)));
+                if(start < next || !size || size > value.size - start || type == enc_unknown)
+                    return false;
+                ENCODERUN run{ type, unit };
+                if(!unit && (!IsCodeType(type) || !StartsFromHex(json_string_value(json_array_get(starts, code++)), size, run.starts)))
+                    return false;
+                next = start + size;
+                value.runs.emplace_hint(value.runs.end(), Range(start, next - 1), std::move(run));
+            }
+            return true;
+        }
+        // old databases have a byte per address
         auto dataJson = get("data");
         if(!dataJson)
             return false;
@@ -63,11 +320,10 @@ struct EncodeMapSerializer : AddrInfoSerializer<ENCODEMAP>
         if(!StringUtils::FromCompressedHex(json_string_value(dataJson), data))
             return false;
         value.size = data.size();
-        value.data = (byte*)VirtualAlloc(NULL, value.size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-        if(!value.data)
-            return false;
-        memcpy(value.data, data.data(), data.size());
-        IncreaseReferenceCount(value.data, false);
+        std::vector<std::pair<Range, ENCODERUN>> converted;
+        RunsFromBytes(data.data(), data.size(), 0, converted);
+        for(const auto & run : converted)
+            value.runs.emplace_hint(value.runs.end(), run);
         return true;
     }
 };
@@ -82,64 +338,137 @@ struct EncodeMap : AddrInfoHashMap<LockEncodeMaps, ENCODEMAP, EncodeMapSerialize
 
 static EncodeMap encmaps;
 
-static bool EncodeMapGetorCreate(duint addr, ENCODEMAP & map, bool* created = nullptr)
+// LockEncodeMaps has to be held
+static ENCODEMAP* EncodeMapFind(duint key)
 {
-    duint base, segsize;
+    auto & maps = encmaps.GetDataUnsafe();
+    auto found = maps.find(key);
+    return found == maps.end() ? nullptr : &found->second;
+}
 
-    base = MemFindBaseAddr(addr, &segsize);
-    if(!base)
-        return false;
+// Replaces [offset, offset + size) of the segment at base with runs (sorted, inside the range)
+static bool EncodeMapReplace(duint base, duint segsize, duint offset, duint size, const std::vector<std::pair<Range, ENCODERUN>> & runs, bool create, bool* created = nullptr)
+{
+    auto key = EncodeMap::VaKey(base);
+    ENCODEMAP prepared;
+    auto prepare = create && !encmaps.Contains(key);
+    if(prepare)
+    {
+        prepared.size = segsize;
+        if(!encmaps.PrepareValue(prepared, base, false))
+            return false;
+    }
 
-    duint key = EncodeMap::VaKey(base);
-    if(!encmaps.Contains(key))
+    EXCLUSIVE_ACQUIRE(LockEncodeMaps);
+    auto map = EncodeMapFind(key);
+    if(!map)
     {
+        if(!prepare)
+            return !create;
+        map = &encmaps.GetDataUnsafe().emplace(key, prepared).first->second;
         if(created)
             *created = true;
-        map.size = segsize;
-        map.data = (byte*)VirtualAlloc(NULL, segsize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-        if(map.data == NULL) return false;
-        IncreaseReferenceCount(map.data);
-        encmaps.PrepareValue(map, base, false);
-        encmaps.Add(map);
     }
-    else
+    if(!size)
+        return true;
+    if(offset >= map->size)
+        return false;
+    auto end = min(offset + size, map->size) - 1;
+    RunsErase(map->runs, offset, end);
+    for(const auto & run : runs)
     {
-        if(!encmaps.Get(key, map))
-            return false;
+        if(run.first.first > end)
+            break;
+        auto last = min(run.first.second, end);
+        auto inserted = run.second;
+        if(!inserted.unit)
+            inserted.starts.resize(last - run.first.first + 1);
+        RunsInsert(map->runs, run.first.first, last, std::move(inserted));
     }
     return true;
 }
 
 void* EncodeMapGetBuffer(duint addr, duint* size, bool create)
 {
-    auto base = MemFindBaseAddr(addr);
+    if(size)
+        *size = 0;
+    duint segsize;
+    auto base = MemFindBaseAddr(addr, &segsize);
+    if(!base)
+        return nullptr;
+    if(create && !EncodeMapReplace(base, segsize, 0, 0, {}, true))
+        return nullptr;
 
-    ENCODEMAP map;
-    if(create ? EncodeMapGetorCreate(addr, map) : encmaps.Get(EncodeMap::VaKey(base), map))
+    auto key = EncodeMap::VaKey(base);
+    EXCLUSIVE_ACQUIRE(LockEncodeMaps);
+    auto map = EncodeMapFind(key);
+    if(!map || addr - base >= map->size)
+        return nullptr;
+    auto buffer = (byte*)VirtualAlloc(NULL, map->size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if(!buffer)
+        return nullptr;
+    RunsToBytes(map->runs, buffer, 0, map->size);
+    IncreaseReferenceCount(buffer, false);
+    encodeBuffers[(duint)buffer] = ENCODEBUFFER{ base, map->size, map->runs };
+    if(size)
+        *size = map->size;
+    return buffer;
+}
+
+void EncodeMapReleaseBuffer(void* buffer)
+{
+    ENCODEBUFFER snapshot;
     {
-        auto offset = addr - base;
-        if(offset < map.size)
+        EXCLUSIVE_ACQUIRE(LockEncodeMaps);
+        if(DecreaseReferenceCount(buffer, false) != 0)
+            return;
+        auto found = encodeBuffers.find((duint)buffer);
+        if(found == encodeBuffers.end())
         {
-            IncreaseReferenceCount(map.data);
-            if(size)
-                *size = map.size;
-            return map.data;
+            VirtualFree(buffer, 0, MEM_RELEASE);
+            return;
         }
+        snapshot = std::move(found->second);
+        encodeBuffers.erase(found);
     }
-    if(size)
-        *size = 0;
-    return nullptr;
-}
 
-void EncodeMapReleaseBuffer(void* buffer, bool lock)
-{
-    if(DecreaseReferenceCount(buffer, lock) == 0)
-        VirtualFree(buffer, 0, MEM_RELEASE);
+    // Write back the spans that differ from the snapshot, types set in the meantime elsewhere in the segment are kept
+    auto data = (const unsigned char*)buffer;
+    std::vector<unsigned char> original(snapshot.size);
+    RunsToBytes(snapshot.runs, original.data(), 0, snapshot.size);
+    for(duint i = 0; i < snapshot.size;)
+    {
+        if(data[i] == original[i])
+        {
+            i++;
+            continue;
+        }
+        auto start = i;
+        while(i < snapshot.size && data[i] != original[i])
+            i++;
+        // widen to whole items, a span must not start or end in the middle of one
+        while(start && data[start] == enc_middle)
+            start--;
+        while(i < snapshot.size && data[i] == enc_middle)
+            i++;
+        std::vector<std::pair<Range, ENCODERUN>> runs;
+        RunsFromBytes(data + start, i - start, start, runs);
+        EncodeMapReplace(snapshot.base, snapshot.size, start, i - start, runs, false);
+    }
+    VirtualFree(buffer, 0, MEM_RELEASE);
 }
 
-void EncodeMapReleaseBuffer(void* buffer)
+bool EncodeMapSetBuffer(duint addr, const unsigned char* data, duint size)
 {
-    EncodeMapReleaseBuffer(buffer, true);
+    duint segsize;
+    auto base = MemFindBaseAddr(addr, &segsize);
+    if(!base)
+        return false;
+    auto offset = addr - base;
+    size = min(segsize - offset, size);
+    std::vector<std::pair<Range, ENCODERUN>> runs;
+    RunsFromBytes(data, size, offset, runs);
+    return EncodeMapReplace(base, segsize, offset, size, runs, true);
 }
 
 duint GetEncodeTypeSize(ENCODETYPE type)
@@ -181,26 +510,21 @@ duint GetEncodeTypeSize(ENCODETYPE type)
     }
 }
 
-static bool IsCodeType(ENCODETYPE type)
-{
-    return type == enc_code || type == enc_junk;
-}
-
 ENCODETYPE EncodeMapGetType(duint addr, duint codesize)
 {
-    duint size;
-    auto base = MemFindBaseAddr(addr, &size);
-
-    ENCODEMAP map;
-    if(base && encmaps.Get(EncodeMap::VaKey(base), map))
-    {
-        auto offset = addr - base;
-        if(offset >= map.size)
-            return enc_unknown;
-        return ENCODETYPE(map.data[offset]);
-    }
+    auto base = MemFindBaseAddr(addr, nullptr);
+    if(!base)
+        return enc_unknown;
 
-    return enc_unknown;
+    auto key = EncodeMap::VaKey(base);
+    SHARED_ACQUIRE(LockEncodeMaps);
+    auto map = EncodeMapFind(key);
+    if(!map)
+        return enc_unknown;
+    auto offset = addr - base;
+    if(offset >= map->size)
+        return enc_unknown;
+    return RunsGetType(map->runs, offset);
 }
 
 duint EncodeMapGetSize(duint addr, duint codesize)
@@ -209,13 +533,15 @@ duint EncodeMapGetSize(duint addr, duint codesize)
     if(!base)
         return codesize;
 
-    ENCODEMAP map;
-    if(encmaps.Get(EncodeMap::VaKey(base), map))
+    auto key = EncodeMap::VaKey(base);
+    SHARED_ACQUIRE(LockEncodeMaps);
+    auto map = EncodeMapFind(key);
+    if(map)
     {
         auto offset = addr - base;
-        if(offset >= map.size)
+        if(offset >= map->size)
             return 1;
-        auto type = ENCODETYPE(map.data[offset]);
+        auto type = RunsGetType(map->runs, offset);
 
         auto datasize = GetEncodeTypeSize(type);
         if(!IsCodeType(type))
@@ -225,61 +551,66 @@ duint EncodeMapGetSize(duint addr, duint codesize)
     return codesize;
 }
 
-bool EncodeMapSetType(duint addr, duint size, ENCODETYPE type, bool* created)
+bool EncodeMapGetTypes(duint addr, duint size, unsigned char* types)
 {
+    memset(types, enc_unknown, size);
     auto base = MemFindBaseAddr(addr, nullptr);
     if(!base)
         return false;
 
-    ENCODEMAP map;
+    auto key = EncodeMap::VaKey(base);
+    SHARED_ACQUIRE(LockEncodeMaps);
+    auto map = EncodeMapFind(key);
+    if(map)
+    {
+        auto offset = addr - base;
+        if(offset < map->size)
+            RunsToBytes(map->runs, types, offset, min(size, map->size - offset));
+    }
+    return true;
+}
+
+bool EncodeMapSetType(duint addr, duint size, ENCODETYPE type, bool* created)
+{
     if(created)
         *created = false;
-    if(!EncodeMapGetorCreate(base, map, created))
+    duint segsize;
+    auto base = MemFindBaseAddr(addr, &segsize);
+    if(!base)
         return false;
+
     auto offset = addr - base;
-    size = min(map.size - offset, size);
-    auto datasize = GetEncodeTypeSize(type);
-    if(datasize == 1 && !IsCodeType(type))
-    {
-        memset(map.data + offset, (byte)type, size);
-    }
-    else
+    size = min(segsize - offset, size);
+    std::vector<std::pair<Range, ENCODERUN>> runs;
+    if(size && type != enc_unknown)
     {
-        memset(map.data + offset, (byte)enc_middle, size);
-        if(IsCodeType(type) && size > 1)
+        if(IsCodeType(type))
         {
-            Zydis cp;
-            Memory<unsigned char*> buffer(size);
-            if(!MemRead(addr, buffer(), size))
-                return false;
-
-            duint buffersize = size, bufferoffset = 0, cmdsize;
-            for(auto i = offset; i < offset + size;)
+            // one run for the whole range with a bit per instruction start
+            auto run = CodeRun(type, size);
+            if(size > 1)
             {
-                map.data[i] = (byte)type;
-                cp.Disassemble(base + i, buffer() + bufferoffset, int(buffersize - bufferoffset));
-                cmdsize = cp.Success() ? cp.Size() : 1;
-                i += cmdsize;
-                bufferoffset += cmdsize;
-                buffersize -= cmdsize;
+                Zydis cp;
+                Memory<unsigned char*> buffer(size);
+                if(!MemRead(addr, buffer(), size))
+                    return false;
+
+                duint cmdsize;
+                for(duint i = 0; i < size; i += cmdsize)
+                {
+                    cp.Disassemble(addr + i, buffer() + i, int(size - i));
+                    cmdsize = cp.Success() ? cp.Size() : 1;
+                    run.starts[i] = true;
+                }
             }
+            else
+                run.starts[0] = true;
+            runs.push_back({ Range(offset, offset + size - 1), std::move(run) });
         }
         else
-        {
-            for(auto i = offset; i < offset + size; i += datasize)
-                map.data[i] = (byte)type;
-        }
-
-    }
-
-    for(auto i = offset + size + 1; i < map.size; i++)
-    {
-        if(map.data[i] == enc_middle)
-            map.data[i] = (byte)enc_unknown;
-        else
-            break;
+            runs.push_back({ Range(offset, offset + size - 1), ENCODERUN{ type, GetEncodeTypeSize(type) } });
     }
-    return true;
+    return EncodeMapReplace(base, segsize, offset, size, runs, type != enc_unknown, created);
 }
 
 void EncodeMapDelSegment(duint Start)
@@ -287,14 +618,7 @@ void EncodeMapDelSegment(duint Start)
     duint base = MemFindBaseAddr(Start, 0);
     if(!base)
         return;
-    duint key = EncodeMap::VaKey(base);
-    ENCODEMAP map;
-    if(encmaps.Contains(key))
-    {
-        encmaps.Get(key, map);
-        EncodeMapReleaseBuffer(map.data);
-    }
-    encmaps.Delete(key);
+    encmaps.Delete(EncodeMap::VaKey(base));
 }
 
 void EncodeMapDelRange(duint Start, duint End)
@@ -314,9 +638,5 @@ void EncodeMapCacheLoad(JSON Root)
 
 void EncodeMapClear()
 {
-    EXCLUSIVE_ACQUIRE(LockEncodeMaps);
-    for(auto & encmap : encmaps.GetDataUnsafe())
-        EncodeMapReleaseBuffer(encmap.second.data, false);
-    EXCLUSIVE_RELEASE();
     encmaps.Clear();
 }
@@ -3,10 +3,16 @@
 #include "_global.h"
 #include "jansson/jansson_x64dbg.h"
 
+// Returns a snapshot of the segment with a byte per address, release it with EncodeMapReleaseBuffer
+// Bytes changed in the snapshot are written back to the map when the buffer is released
 void* EncodeMapGetBuffer(duint addr, duint* size, bool create = false);
 void EncodeMapReleaseBuffer(void* buffer);
+// Replaces the types of [addr, addr + size) with a byte per address map (like the buffer above)
+bool EncodeMapSetBuffer(duint addr, const unsigned char* data, duint size);
 ENCODETYPE EncodeMapGetType(duint addr, duint codesize);
 duint EncodeMapGetSize(duint addr, duint codesize);
+// Fills types with a byte per address of [addr, addr + size), enc_unknown outside of the segment map
+bool EncodeMapGetTypes(duint addr, duint size, unsigned char* types);
 void EncodeMapDelSegment(duint addr);
 void EncodeMapDelRange(duint addr, duint size);
 bool EncodeMapSetType(duint addr, duint size, ENCODETYPE type, bool* created = nullptr);
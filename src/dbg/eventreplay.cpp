@@ -0,0 +1,531 @@
+#include "eventreplay.h"
+#include "threading.h"
+#include "debugger.h"
+#include "memory.h"
+#include "module.h"
+#include "watch.h"
+#include "filemap.h"
+#include "filehelper.h"
+#include "TraceRecord.h"
+#include "jansson/jansson_x64dbg.h"
+
+#define EVENT_RECORDING_MAGIC MAKEFOURCC('X', 'E', 'V', 'R')
+#define EVENT_RECORDING_VERSION 2
+
+struct EventRecordingHeader
+{
+    DWORD magic;
+    DWORD version;
+    DWORD pointerSize;
+    DWORD contextSize;
+    unsigned long long moduleCount;
+    unsigned long long eventCount;
+};
+
+struct EventRecordingEvent
+{
+    DWORD type;
+    DWORD threadId;
+    DWORD bpType;
+    DWORD exceptionCode;
+    DWORD textCount;
+    DWORD reserved;
+    duint address;
+    unsigned long long memoryCount;
+};
+
+static bool writeString(BufferedWriter & writer, const String & str)
+{
+    auto size = DWORD(str.size());
+    return writer.Write(&size, sizeof(size)) && writer.Write(str.c_str(), size);
+}
+
+bool EventRecording::Save(const char* fileName) const
+{
+    auto hFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return false;
+    EventRecordingHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = EVENT_RECORDING_MAGIC;
+    header.version = EVENT_RECORDING_VERSION;
+    header.pointerSize = sizeof(duint);
+    header.contextSize = sizeof(TITAN_ENGINE_CONTEXT_t);
+    header.moduleCount = modules.size();
+    header.eventCount = events.size();
+    BufferedWriter writer(hFile);
+    if(!writer.Write(&header, sizeof(header)) || !writeString(writer, state))
+        return false;
+    for(const auto & module : modules)
+    {
+        if(!writer.Write(&module.base, sizeof(module.base)) || !writer.Write(&module.size, sizeof(module.size)) || !writeString(writer, module.path))
+            return false;
+    }
+    for(const auto & event : events)
+    {
+        EventRecordingEvent entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.type = event.type;
+        entry.threadId = event.threadId;
+        entry.bpType = event.bpType;
+        entry.exceptionCode = event.exceptionCode;
+        entry.textCount = DWORD(event.text.size());
+        entry.address = event.address;
+        entry.memoryCount = event.memory.size();
+        if(!writer.Write(&entry, sizeof(entry)) || !writer.Write(&event.context, sizeof(event.context)))
+            return false;
+        for(const auto & text : event.text)
+            if(!writeString(writer, text))
+                return false;
+        for(const auto & memory : event.memory)
+        {
+            auto size = DWORD(memory.data.size());
+            if(!writer.Write(&memory.addr, sizeof(memory.addr)) || !writer.Write(&size, sizeof(size)) || !writer.Write(memory.data.data(), size))
+                return false;
+        }
+    }
+    return true;
+}
+
+class RecordingReader
+{
+public:
+    explicit RecordingReader(const std::vector<unsigned char> & data)
+        : mData(data)
+    {
+    }
+
+    bool Read(void* dest, size_t size)
+    {
+        if(size > mData.size() - mOffset)
+            return false;
+        memcpy(dest, mData.data() + mOffset, size);
+        mOffset += size;
+        return true;
+    }
+
+    bool ReadString(String & str)
+    {
+        DWORD size;
+        if(!Read(&size, sizeof(size)) || size > mData.size() - mOffset)
+            return false;
+        str.assign((const char*)mData.data() + mOffset, size);
+        mOffset += size;
+        return true;
+    }
+
+    // A count read from the file is only plausible if the remaining data holds that many entries of at least minSize bytes
+    bool CountFits(unsigned long long count, size_t minSize) const
+    {
+        return count <= (mData.size() - mOffset) / minSize;
+    }
+
+    bool AtEnd() const
+    {
+        return mOffset == mData.size();
+    }
+
+private:
+    const std::vector<unsigned char> & mData;
+    size_t mOffset = 0;
+};
+
+bool EventRecording::Load(const char* fileName)
+{
+    state.clear();
+    modules.clear();
+    events.clear();
+    std::vector<unsigned char> data;
+    if(!FileHelper::ReadAllData(fileName, data))
+        return false;
+    RecordingReader reader(data);
+    EventRecordingHeader header;
+    if(!reader.Read(&header, sizeof(header)))
+        return false;
+    // recordings are bound to the bitness (and context layout) of the debugger that made them
+    if(header.magic != EVENT_RECORDING_MAGIC || header.version != EVENT_RECORDING_VERSION || header.pointerSize != sizeof(duint)
+            || header.contextSize != sizeof(TITAN_ENGINE_CONTEXT_t))
+        return false;
+    if(!reader.ReadString(state))
+        return false;
+    for(unsigned long long i = 0; i < header.moduleCount; i++)
+    {
+        ReplayModule module;
+        if(!reader.Read(&module.base, sizeof(module.base)) || !reader.Read(&module.size, sizeof(module.size)) || !reader.ReadString(module.path))
+            return false;
+        modules.push_back(std::move(module));
+    }
+    for(unsigned long long i = 0; i < header.eventCount; i++)
+    {
+        EventRecordingEvent entry;
+        ReplayEvent event;
+        if(!reader.Read(&entry, sizeof(entry)) || !reader.Read(&event.context, sizeof(event.context)))
+            return false;
+        event.type = REPLAYEVENTTYPE(entry.type);
+        event.threadId = entry.threadId;
+        event.bpType = BP_TYPE(entry.bpType);
+        event.exceptionCode = entry.exceptionCode;
+        event.address = entry.address;
+        if(!reader.CountFits(entry.textCount, sizeof(DWORD)) || !reader.CountFits(entry.memoryCount, sizeof(duint) + sizeof(DWORD)))
+            return false;
+        event.text.resize(entry.textCount);
+        for(auto & text : event.text)
+            if(!reader.ReadString(text))
+                return false;
+        for(unsigned long long j = 0; j < entry.memoryCount; j++)
+        {
+            ReplayMemory memory;
+            DWORD size;
+            if(!reader.Read(&memory.addr, sizeof(memory.addr)) || !reader.Read(&size, sizeof(size)) || !reader.CountFits(size, 1))
+                return false;
+            memory.data.resize(size);
+            if(!reader.Read(memory.data.data(), size))
+                return false;
+            event.memory.push_back(std::move(memory));
+        }
+        if(event.type >= ReplayEventLast || (event.type == ReplayEventTraceStep && event.text.size() != ReplayTextTraceCount))
+            return false;
+        // the handlers of these events take a module name
+        if((event.type == ReplayEventLoadDll || (event.type == ReplayEventBreakpoint && event.bpType == BPDLL)) && event.text.size() != 1)
+            return false;
+        events.push_back(std::move(event));
+    }
+    return reader.AtEnd();
+}
+
+std::atomic<DWORD> eventReplayThreadId(0);
+static const ReplayEvent* replayEvent = nullptr;
+static EventReplayStats* replayStats = nullptr;
+
+const TITAN_ENGINE_CONTEXT_t & EventReplayContext()
+{
+    return replayEvent->context;
+}
+
+bool EventReplayRead(duint addr, void* dest, duint size, duint* bytesRead)
+{
+    // the most recent read wins, memory can change while an event is handled
+    const auto & memory = replayEvent->memory;
+    for(auto it = memory.rbegin(); it != memory.rend(); ++it)
+    {
+        if(addr >= it->addr && addr - it->addr + size <= it->data.size())
+        {
+            memcpy(dest, it->data.data() + (addr - it->addr), size);
+            if(bytesRead)
+                *bytesRead = size;
+            return true;
+        }
+    }
+    replayStats->missingMemory++;
+    return false;
+}
+
+bool EventReplayGetRegister(const char* name, duint & value, int* size)
+{
+    return WatchReadContextRegister(replayEvent->context, name, value, size);
+}
+
+void EventReplayPause()
+{
+    // the handler locked WAITID_RUN because the debugger pauses here, there is nobody to resume it
+    if(waitislocked(WAITID_RUN))
+    {
+        replayStats->breaks++;
+        unlock(WAITID_RUN);
+    }
+}
+
+bool EventReplayArmBreakpoint(const BREAKPOINT* bp)
+{
+    replayStats->moduleBreakpoints++;
+    return true;
+}
+
+class HandlerTimer
+{
+public:
+    HandlerTimer(EventReplayStats & stats, REPLAYEVENTTYPE type)
+        : mStats(stats),
+          mType(type)
+    {
+        QueryPerformanceCounter(&mStart);
+    }
+
+    ~HandlerTimer()
+    {
+        LARGE_INTEGER end;
+        QueryPerformanceCounter(&end);
+        mStats.ticks[mType] += end.QuadPart - mStart.QuadPart;
+        mStats.count[mType]++;
+    }
+
+private:
+    EventReplayStats & mStats;
+    REPLAYEVENTTYPE mType;
+    LARGE_INTEGER mStart;
+};
+
+const char* EventReplayHandlerName(REPLAYEVENTTYPE type)
+{
+    switch(type)
+    {
+    case ReplayEventStep:
+        return "step";
+    case ReplayEventBreakpoint:
+        return "breakpoint";
+    case ReplayEventTraceStep:
+        return "tracestep";
+    case ReplayEventLoadDll:
+        return "loaddll";
+    default:
+        return "";
+    }
+}
+
+static void replayHandler(const ReplayEvent & event)
+{
+    switch(event.type)
+    {
+    case ReplayEventStep:
+        cbStep();
+        break;
+
+    case ReplayEventBreakpoint:
+        switch(event.bpType)
+        {
+        case BPDLL:
+            dbgreplaybreakpoint(BPDLL, (void*)event.text[0].c_str());
+            break;
+        case BPEXCEPTION:
+        {
+            EXCEPTION_DEBUG_INFO info;
+            memset(&info, 0, sizeof(info));
+            info.ExceptionRecord.ExceptionCode = event.exceptionCode;
+            info.ExceptionRecord.ExceptionAddress = (PVOID)event.address;
+            dbgreplaybreakpoint(BPEXCEPTION, &info);
+        }
+        break;
+        default:
+            dbgreplaybreakpoint(event.bpType, (void*)event.address);
+            break;
+        }
+        break;
+
+    case ReplayEventTraceStep:
+        dbgreplaytracestep(event.text[ReplayTextTraceCondition], event.text[ReplayTextLogCondition], event.text[ReplayTextLogText], event.text[ReplayTextSwitchCondition]);
+        break;
+
+    case ReplayEventLoadDll:
+        dbgreplayloaddll(event.address, event.text[0].c_str());
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void replayClear()
+{
+    BpClear();
+    WatchClear();
+    TraceRecord.clear();
+    ModClear();
+    dbgreplayreset();
+}
+
+bool EventReplay(const EventRecording & recording, EventReplayStats & stats, int iterations)
+{
+    // the replay takes over the lists of the debugger, there can be no process
+    if(DbgIsDebugging() || bEventRecording)
+        return false;
+    auto state = json_loads(recording.state.c_str(), 0, 0);
+    if(!state)
+        return false;
+    // breakpoint commands could run or change a process that does not exist
+    size_t i;
+    JSON value;
+    json_array_foreach(json_object_get(state, "breakpoints"), i, value)
+        json_object_del(value, "commandText");
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    stats.frequency = frequency.QuadPart;
+
+    GuiUpdateDisable();
+    GuiDisableLog();
+    replayStats = &stats;
+    eventReplayThreadId = GetCurrentThreadId();
+    for(int iteration = 0; iteration < iterations; iteration++)
+    {
+        // every iteration starts from the state at the start of the recording
+        replayClear();
+        for(const auto & module : recording.modules)
+            ModLoad(module.base, module.size, module.path.c_str());
+        BpCacheLoad(state);
+        WatchCacheLoad(state);
+        TraceRecord.loadFromDb(state);
+        stats.breakpoints = BpGetList(nullptr);
+        stats.watches = WatchGetList().size();
+
+        for(const auto & event : recording.events)
+        {
+            replayEvent = &event;
+            HandlerTimer timer(stats, event.type);
+            replayHandler(event);
+            stats.events++;
+        }
+    }
+    eventReplayThreadId = 0;
+    replayEvent = nullptr;
+    replayStats = nullptr;
+    replayClear();
+    json_decref(state);
+    GuiEnableLog();
+    GuiUpdateEnable(true);
+
+    for(int type = 0; type < ReplayEventLast; type++)
+        stats.totalTicks += stats.ticks[type];
+    return true;
+}
+
+std::atomic<bool> bEventRecording(false);
+static String recordFile;
+static DWORD recordThreadId = 0;
+static EventRecording recording;
+
+bool EventRecordStart(const char* fileName)
+{
+    // snapshot before taking the lock, the database and module functions take their own locks
+    auto root = json_object();
+    BpCacheSave(root);
+    WatchCacheSave(root);
+    TraceRecord.saveToDb(root);
+    auto text = json_dumps(root, JSON_COMPACT);
+    json_decref(root);
+    if(!text)
+        return false;
+    String state = text;
+    json_free(text);
+    std::vector<ReplayModule> modules;
+    ModEnum([&modules](const MODINFO & mod)
+    {
+        modules.push_back({ mod.base, mod.size, mod.path });
+    });
+
+    EXCLUSIVE_ACQUIRE(LockEventRecording);
+    if(bEventRecording)
+        return false;
+    recordFile = fileName;
+    recording.state = std::move(state);
+    recording.modules = std::move(modules);
+    recording.events.clear();
+    bEventRecording = true;
+    return true;
+}
+
+bool EventRecordStop(size_t* eventCount)
+{
+    EventRecording data;
+    String fileName;
+    {
+        EXCLUSIVE_ACQUIRE(LockEventRecording);
+        if(!bEventRecording)
+            return false;
+        bEventRecording = false;
+        data = std::move(recording);
+        recording = EventRecording();
+        fileName = std::move(recordFile);
+    }
+    if(eventCount)
+        *eventCount = data.events.size();
+    return data.Save(fileName.c_str());
+}
+
+static void recordEvent(ReplayEvent & event)
+{
+    event.threadId = ((DEBUG_EVENT*)GetDebugData())->dwThreadId;
+    memset(&event.context, 0, sizeof(event.context));
+    GetFullContextDataEx(hActiveThread, &event.context);
+    // the memory the handler reads from here on is recorded by the MemRead hook
+    EXCLUSIVE_ACQUIRE(LockEventRecording);
+    if(!bEventRecording)
+        return;
+    recordThreadId = GetCurrentThreadId();
+    recording.events.push_back(std::move(event));
+}
+
+void EventRecordStep()
+{
+    ReplayEvent event;
+    event.type = ReplayEventStep;
+    event.bpType = BPNORMAL;
+    event.exceptionCode = 0;
+    event.address = 0;
+    recordEvent(event);
+}
+
+void EventRecordBreakpoint(BP_TYPE type, const void* ExceptionAddress)
+{
+    // the handler input, it is resolved to a breakpoint again when replayed
+    ReplayEvent event;
+    event.type = ReplayEventBreakpoint;
+    event.bpType = type;
+    event.exceptionCode = 0;
+    event.address = 0;
+    switch(type)
+    {
+    case BPHARDWARE:
+    case BPMEMORY:
+        event.address = duint(ExceptionAddress);
+        break;
+    case BPDLL:
+        event.text = { (const char*)ExceptionAddress };
+        break;
+    case BPEXCEPTION:
+    {
+        const auto & record = ((const EXCEPTION_DEBUG_INFO*)ExceptionAddress)->ExceptionRecord;
+        event.exceptionCode = record.ExceptionCode;
+        event.address = duint(record.ExceptionAddress);
+    }
+    break;
+    default:
+        break;
+    }
+    recordEvent(event);
+}
+
+void EventRecordTraceStep(const String & traceCondition, const String & logCondition, const String & logText, const String & switchCondition)
+{
+    ReplayEvent event;
+    event.type = ReplayEventTraceStep;
+    event.bpType = BPNORMAL;
+    event.exceptionCode = 0;
+    event.address = 0;
+    event.text = { traceCondition, logCondition, logText, switchCondition };
+    recordEvent(event);
+}
+
+void EventRecordLoadDll(duint base, const char* fileName)
+{
+    ReplayEvent event;
+    event.type = ReplayEventLoadDll;
+    event.bpType = BPNORMAL;
+    event.exceptionCode = 0;
+    event.address = base;
+    event.text = { fileName };
+    recordEvent(event);
+}
+
+void EventRecordMemory(duint addr, const void* data, duint size)
+{
+    // only the debug loop thread handles events, reads from the GUI are not part of them
+    if(!size || GetCurrentThreadId() != recordThreadId)
+        return;
+    EXCLUSIVE_ACQUIRE(LockEventRecording);
+    if(!bEventRecording || recording.events.empty())
+        return;
+    ReplayMemory memory;
+    memory.addr = addr;
+    memory.data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+    recording.events.back().memory.push_back(std::move(memory));
+}
@@ -0,0 +1,122 @@
+#ifndef _EVENTREPLAY_H
+#define _EVENTREPLAY_H
+
+#include "_global.h"
+#include "breakpoint.h"
+#include "TitanEngine/TitanEngine.h"
+#include <atomic>
+
+enum REPLAYEVENTTYPE
+{
+    ReplayEventStep,
+    ReplayEventBreakpoint,
+    ReplayEventTraceStep,
+    ReplayEventLoadDll,
+    ReplayEventLast
+};
+
+// TraceStep texts
+enum
+{
+    ReplayTextTraceCondition,
+    ReplayTextLogCondition,
+    ReplayTextLogText,
+    ReplayTextSwitchCondition,
+    ReplayTextTraceCount
+};
+
+struct ReplayMemory
+{
+    duint addr;
+    std::vector<unsigned char> data;
+};
+
+struct ReplayEvent
+{
+    REPLAYEVENTTYPE type;
+    DWORD threadId;
+    BP_TYPE bpType; // Breakpoint
+    DWORD exceptionCode; // Breakpoint: BPEXCEPTION
+    duint address; // Breakpoint: exception address passed to the handler, LoadDll: module base
+    std::vector<String> text; // Breakpoint: BPDLL module name, LoadDll: module path, TraceStep: see ReplayText*
+    TITAN_ENGINE_CONTEXT_t context;
+    std::vector<ReplayMemory> memory; // debuggee memory read while the event was handled
+};
+
+struct ReplayModule
+{
+    duint base;
+    duint size;
+    String path;
+};
+
+/**
+\brief A recorded stream of debug events. Everything the debug event handlers read from the debuggee (thread context
+       and memory) is stored with the event, together with the modules and the database state (breakpoints, watches
+       and trace record) at the start of the recording, so the handlers can be replayed without a process.
+*/
+struct EventRecording
+{
+    String state; // JSON in the database format
+    std::vector<ReplayModule> modules;
+    std::vector<ReplayEvent> events;
+
+    bool Save(const char* fileName) const;
+    bool Load(const char* fileName);
+};
+
+struct EventReplayStats
+{
+    unsigned long long events;
+    unsigned long long count[ReplayEventLast]; // per handler
+    unsigned long long ticks[ReplayEventLast];
+    unsigned long long totalTicks;
+    unsigned long long frequency; // ticks per second
+    unsigned long long breakpoints; // installed from the recording
+    unsigned long long watches;
+    unsigned long long breaks; // events where the debugger paused
+    unsigned long long moduleBreakpoints; // breakpoints armed on dll loads
+    unsigned long long missingMemory; // reads that were not in the recording
+
+    EventReplayStats()
+    {
+        memset(this, 0, sizeof(*this));
+        frequency = 1;
+    }
+};
+
+/**
+\brief Replays a recording through the debug event handlers of debugger.cpp. The handlers run on the calling thread
+       against a fake process: EventReplayActive() is true on that thread and the debugger hooks below serve the
+       recorded context and memory, skip stepping and breakpoint arming and count the pauses. Only possible while not
+       debugging, the breakpoint, watch, module and trace record lists are replaced for the duration of the replay.
+*/
+bool EventReplay(const EventRecording & recording, EventReplayStats & stats, int iterations = 1);
+const char* EventReplayHandlerName(REPLAYEVENTTYPE type);
+
+extern std::atomic<DWORD> eventReplayThreadId;
+
+inline bool EventReplayActive()
+{
+    return eventReplayThreadId != 0 && eventReplayThreadId == GetCurrentThreadId();
+}
+
+// Fake process, only called when EventReplayActive()
+const TITAN_ENGINE_CONTEXT_t & EventReplayContext();
+bool EventReplayRead(duint addr, void* dest, duint size, duint* bytesRead);
+bool EventReplayGetRegister(const char* name, duint & value, int* size);
+void EventReplayPause();
+bool EventReplayArmBreakpoint(const BREAKPOINT* bp);
+
+// Recording, the hooks are called from the debug event handlers
+extern std::atomic<bool> bEventRecording;
+
+bool EventRecordStart(const char* fileName);
+bool EventRecordStop(size_t* eventCount = nullptr);
+void EventRecordStep();
+void EventRecordBreakpoint(BP_TYPE type, const void* ExceptionAddress);
+void EventRecordTraceStep(const String & traceCondition, const String & logCondition, const String & logText, const String & switchCondition);
+void EventRecordLoadDll(duint base, const char* fileName);
+void EventRecordMemory(duint addr, const void* data, duint size);
+
+#endif // _EVENTREPLAY_H
@@ -776,12 +776,32 @@ bool ExpressionParser::signedOperation(Token::Type type, const EvalValue & op1,
 }
 
 bool ExpressionParser::Calculate(duint & value, bool signedcalc, bool allowassign, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly) const
+{
+    return calculate(value, signedcalc, allowassign, silent, baseonly, value_size, isvar, hexonly, nullptr);
+}
+
+bool ExpressionParser::Calculate(duint & value, bool signedcalc, const DataResolver & resolver) const
+{
+    return calculate(value, signedcalc, false, true, false, nullptr, nullptr, nullptr, &resolver);
+}
+
+std::vector<String> ExpressionParser::GetDataOperands() const
+{
+    std::vector<String> operands;
+    for(const auto & token : mPrefixTokens)
+        if(!token.isOperator() && token.type() != Token::Type::Function)
+            operands.push_back(token.data());
+    return operands;
+}
+
+bool ExpressionParser::calculate(duint & value, bool signedcalc, bool allowassign, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly, const DataResolver* resolver) const
 {
     value = 0;
     if(!mPrefixTokens.size() || !mIsValidExpression)
         return false;
     std::vector<EvalValue> stack;
     stack.reserve(mPrefixTokens.size());
+    size_t dataIndex = 0;
     //calculate the result from the RPN queue
     for(const auto & token : mPrefixTokens)
     {
@@ -893,6 +913,13 @@ bool ExpressionParser::Calculate(duint & value, bool signedcalc, bool allowassig
                 return false;
             stack.push_back(EvalValue(result));
         }
+        else if(resolver)
+        {
+            duint data;
+            if(!(*resolver)(dataIndex++, token.data(), data))
+                return false;
+            stack.push_back(EvalValue(data));
+        }
         else
             stack.push_back(EvalValue(token.data()));
     }
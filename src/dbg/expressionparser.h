@@ -3,6 +3,7 @@
 
 #include "_global.h"
 #include "value.h"
+#include <functional>
 
 class ExpressionParser
 {
@@ -10,6 +11,10 @@ public:
     explicit ExpressionParser(const String & expression);
     bool Calculate(duint & value, bool signedcalc, bool allowassign, bool silent = true, bool baseonly = false, int* value_size = nullptr, bool* isvar = nullptr, bool* hexonly = nullptr) const;
 
+    // Resolves the n-th data operand of the RPN queue, used to evaluate with operands that were resolved up front
+    typedef std::function<bool(size_t index, const String & data, duint & value)> DataResolver;
+    bool Calculate(duint & value, bool signedcalc, const DataResolver & resolver) const;
+
     const String & GetExpression() const
     {
         return mExpression;
@@ -20,6 +25,9 @@ public:
         return mIsValidExpression;
     }
 
+    // Data operands in the order they are passed to a DataResolver
+    std::vector<String> GetDataOperands() const;
+
     class Token
     {
     public:
@@ -141,6 +149,7 @@ public:
 
 private:
     static String fixClosingBrackets(const String & expression);
+    bool calculate(duint & value, bool signedcalc, bool allowassign, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly, const DataResolver* resolver) const;
     bool isUnaryOperator() const;
     void tokenize();
     void shuntingYard();
@@ -82,6 +82,11 @@ struct BufferedWriter
         return true;
     }
 
+    bool Flush()
+    {
+        return flush();
+    }
+
     ~BufferedWriter()
     {
         flush();
@@ -12,6 +12,8 @@
 #include "module.h"
 #include "taskthread.h"
 #include "value.h"
+#include "eventreplay.h"
+#include "taskpool.h"
 
 #define PAGE_SHIFT              (12)
 //#define PAGE_SIZE               (4096)
@@ -353,6 +355,10 @@ bool MemRead(duint BaseAddress, void* Buffer, duint Size, duint* NumberOfBytesRe
     if(!MemIsCanonicalAddress(BaseAddress) || !DbgIsDebugging())
         return false;
 
+    // a replayed event reads the memory recorded with it, there is no memory map
+    if(EventReplayActive())
+        return Buffer && Size && EventReplayRead(BaseAddress, Buffer, Size, NumberOfBytesRead);
+
     if(cache && !MemIsValidReadPtr(BaseAddress, true))
         return false;
 
@@ -384,6 +390,9 @@ bool MemRead(duint BaseAddress, void* Buffer, duint Size, duint* NumberOfBytesRe
             __debugbreak(); //TODO: remove when proven stable, this checks if (BaseAddress + offset) is aligned to PAGE_SIZE after the first call
     }
 
+    if(bEventRecording)
+        EventRecordMemory(BaseAddress, Buffer, *NumberOfBytesRead);
+
     auto success = *NumberOfBytesRead == Size;
     SetLastError(success ? ERROR_SUCCESS : ERROR_PARTIAL_COPY);
     return success;
@@ -504,8 +513,7 @@ bool MemPatch(duint BaseAddress, const void* Buffer, duint Size, duint* NumberOf
     // Are we able to write on this page?
     if(MemWrite(BaseAddress, Buffer, Size, NumberOfBytesWritten))
     {
-        for(duint i = 0; i < Size; i++)
-            PatchSet(BaseAddress + i, oldData()[i], ((const unsigned char*)Buffer)[i]);
+        PatchSetRange(BaseAddress, oldData(), (const unsigned char*)Buffer, Size);
 
         // Done
         return true;
@@ -721,17 +729,40 @@ bool MemFindInPage(const SimplePage & page, duint startoffset, const std::vector
 
 bool MemFindInMap(const std::vector<SimplePage> & pages, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults, bool progress)
 {
-    duint count = 0;
-    duint total = pages.size();
-    for(const auto page : pages)
+    if(results.size() >= maxresults)
+        return true;
+
+    // the pages are searched in parallel, the search stops once the finished pages at the start have enough results
+    std::vector<std::vector<duint>> pageResults(pages.size());
+    std::vector<bool> pageDone(pages.size());
+    std::mutex doneLock;
+    size_t donePrefix = 0;
+    duint prefixResults = results.size();
+    std::atomic<bool> enough(false);
+    ParallelFor(0, pages.size(), 1, [&](size_t first, size_t last)
+    {
+        for(auto i = first; i < last && !enough; i++)
+        {
+            MemFindInPage(pages[i], 0, pattern, pageResults[i], maxresults - results.size());
+            std::lock_guard<std::mutex> lock(doneLock);
+            pageDone[i] = true;
+            while(donePrefix < pages.size() && pageDone[donePrefix])
+                prefixResults += pageResults[donePrefix++].size();
+            if(prefixResults >= maxresults)
+                enough = true;
+        }
+    }, &enough, [progress](size_t done, size_t total)
     {
-        if(!MemFindInPage(page, 0, pattern, results, maxresults))
-            continue;
         if(progress)
-            GuiReferenceSetProgress(int(floor((float(count) / float(total)) * 100.0f)));
+            GuiReferenceSetProgress(int(floor((float(done) / float(total)) * 100.0f)));
+    });
+
+    for(const auto & found : pageResults)
+    {
+        auto count = min(found.size(), size_t(maxresults - results.size()));
+        results.insert(results.end(), found.begin(), found.begin() + count);
         if(results.size() >= maxresults)
             break;
-        count++;
     }
     if(progress)
     {
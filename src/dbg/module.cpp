@@ -208,12 +208,7 @@ static void ReadExportDirectory(MODINFO & Info, ULONG_PTR FileMapVA)
         return Info.exports.at(a).rva < Info.exports.at(b).rva;
     });
 
-    // undecorate names
-    for(auto & x : Info.exports)
-    {
-        if(!x.name.empty())
-            undecorateName(x.name, x.undecoratedName);
-    }
+    // names are undecorated lazily, see MODEXPORT::undecoratedName
 }
 
 static void ReadImportDirectory(MODINFO & Info, ULONG_PTR FileMapVA)
@@ -297,10 +292,6 @@ static void ReadImportDirectory(MODINFO & Info, ULONG_PTR FileMapVA)
     {
         return Info.imports[a].iatRva < Info.imports[b].iatRva;
     });
-
-    // undecorate names
-    for(auto & i : Info.imports)
-        undecorateName(i.name, i.undecoratedName);
 }
 
 static void ReadTlsCallbacks(MODINFO & Info, ULONG_PTR FileMapVA)
@@ -1069,6 +1060,18 @@ duint ModSizeFromAddr(duint Address)
     return module->size;
 }
 
+duint ModNextBaseFromAddr(duint Address)
+{
+    SHARED_ACQUIRE(LockModules);
+
+    auto found = modinfo.upper_bound(Range(Address, Address));
+
+    if(found == modinfo.end())
+        return 0;
+
+    return found->first.first;
+}
+
 std::string ModNameFromHash(duint Hash)
 {
     SHARED_ACQUIRE(LockModuleHashes);
@@ -1313,22 +1316,32 @@ const MODEXPORT* MODINFO::findExport(duint rva) const
     return nullptr;
 }
 
+const String & MODIMPORT::undecoratedName() const
+{
+    return undecorated.get(name);
+}
+
 void MODIMPORT::convertToGuiSymbol(duint base, SYMBOLINFO* info) const
 {
     info->addr = base + iatRva;
     info->type = sym_import;
     info->decoratedSymbol = (char*)name.c_str();
-    info->undecoratedSymbol = (char*)undecoratedName.c_str();
+    info->undecoratedSymbol = (char*)undecoratedName().c_str();
     info->freeDecorated = info->freeUndecorated = false;
     info->ordinal = 0;
 }
 
+const String & MODEXPORT::undecoratedName() const
+{
+    return undecorated.get(name);
+}
+
 void MODEXPORT::convertToGuiSymbol(duint base, SYMBOLINFO* info) const
 {
     info->addr = base + rva;
     info->type = sym_export;
     info->decoratedSymbol = (char*)name.c_str();
-    info->undecoratedSymbol = (char*)undecoratedName.c_str();
+    info->undecoratedSymbol = (char*)undecoratedName().c_str();
     info->freeDecorated = info->freeUndecorated = false;
     info->ordinal = ordinal;
 }
@@ -5,6 +5,7 @@
 #include <functional>
 
 #include "symbolsourcebase.h"
+#include "symbolundecorator.h"
 
 // Macros to safely access IMAGE_NT_HEADERS fields since the compile-time typedef of this struct may not match the actual file bitness.
 // Never access OptionalHeader.xx values directly unless they have the same size and offset on 32 and 64 bit. IMAGE_FILE_HEADER fields are safe to use
@@ -57,8 +58,9 @@ struct MODEXPORT : SymbolInfoGui
     bool forwarded = false;
     String forwardName;
     String name;
-    String undecoratedName;
+    LazyUndecoratedName undecorated;
 
+    const String & undecoratedName() const;
     virtual void convertToGuiSymbol(duint base, SYMBOLINFO* info) const override;
 };
 
@@ -68,8 +70,9 @@ struct MODIMPORT : SymbolInfoGui
     DWORD iatRva = 0;
     duint ordinal = -1; //equal to -1 if imported by name
     String name;
-    String undecoratedName;
+    LazyUndecoratedName undecorated;
 
+    const String & undecoratedName() const;
     virtual void convertToGuiSymbol(duint base, SYMBOLINFO* info) const override;
 };
 
@@ -151,6 +154,8 @@ duint ModHashFromName(const char* Module);
 duint ModContentHashFromAddr(duint Address);
 duint ModBaseFromName(const char* Module);
 duint ModSizeFromAddr(duint Address);
+// Base of the first module above Address, 0 if there is none
+duint ModNextBaseFromAddr(duint Address);
 std::string ModNameFromHash(duint Hash);
 bool ModSectionsFromAddr(duint Address, std::vector<MODSECTIONINFO>* Sections);
 duint ModEntryFromAddr(duint Address);
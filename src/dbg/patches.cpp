@@ -9,54 +9,176 @@
 #include "debugger.h"
 #include "threading.h"
 #include "module.h"
+#include "addrinfo.h"
+#include "filehelper.h"
+#include "patchexport.h"
+#include "console.h"
 
-static std::unordered_map<duint, PATCHINFO> patches;
+struct PATCHRANGE
+{
+    String mod;
+    duint rva; // of the first byte, the address when not in a module
+    std::vector<unsigned char> oldbytes;
+    std::vector<unsigned char> newbytes;
+};
+
+// Key := ModHashFromAddr range, every byte in a range is patched (old != new)
+static std::map<Range, PATCHRANGE, RangeCompare> patches;
+static size_t patchCount = 0;
 static std::unordered_map<DWORD, size_t> lastEnumSize;
 
-bool PatchSet(duint Address, unsigned char OldByte, unsigned char NewByte)
+struct PatchChunk
 {
-    if(!DbgIsDebugging())
-        return false;
-
-    // Address must be valid
-    if(!MemIsValidReadPtr(Address))
-        return false;
+    duint key;
+    duint rva;
+    duint size;
+    char mod[MAX_MODULE_SIZE];
+};
+
+// LockPatches has to be held
+static void patchErase(duint Start, duint End, bool Restore)
+{
+    std::vector<std::pair<Range, PATCHRANGE>> remaining;
+    for(auto itr = patches.lower_bound(Range(Start, Start)); itr != patches.end() && itr->first.first <= End;)
+    {
+        const auto & range = itr->first;
+        const auto & patch = itr->second;
+        auto first = max(range.first, Start) - range.first;
+        auto last = min(range.second, End) - range.first;
+        // Restore the original bytes if necessary
+        if(Restore)
+            MemWrite(ModBaseFromName(patch.mod.c_str()) + patch.rva + first, patch.oldbytes.data() + first, last - first + 1);
+        auto split = [&](duint from, duint to)
+        {
+            PATCHRANGE part;
+            part.mod = patch.mod;
+            part.rva = patch.rva + from;
+            part.oldbytes.assign(patch.oldbytes.begin() + from, patch.oldbytes.begin() + to + 1);
+            part.newbytes.assign(patch.newbytes.begin() + from, patch.newbytes.begin() + to + 1);
+            remaining.push_back({ Range(range.first + from, range.first + to), std::move(part) });
+        };
+        if(first > 0)
+            split(0, first - 1);
+        if(range.first + last < range.second)
+            split(last + 1, range.second - range.first);
+        patchCount -= last - first + 1;
+        itr = patches.erase(itr);
+    }
+    for(auto & patch : remaining)
+        patches.insert(std::move(patch));
+}
 
-    // Don't patch anything if the new and old values are the same
-    if(OldByte == NewByte)
-        return true;
+// LockPatches has to be held, merges the write with the overlapping and adjacent ranges
+static void patchWrite(const PatchChunk & Chunk, const unsigned char* OldBytes, const unsigned char* NewBytes)
+{
+    auto start = Chunk.key;
+    auto end = Chunk.key + Chunk.size - 1;
+    auto mergeable = [&Chunk](decltype(patches)::const_iterator itr)
+    {
+        return itr != patches.end() && !_stricmp(itr->second.mod.c_str(), Chunk.mod);
+    };
+    if(start)
+    {
+        auto prev = patches.find(Range(start - 1, start - 1));
+        if(mergeable(prev))
+            start = prev->first.first;
+    }
+    auto next = patches.find(Range(end + 1, end + 1));
+    if(mergeable(next))
+        end = next->first.second;
+
+    // gather the existing bytes of the span, then apply the write on top of them
+    auto size = end - start + 1;
+    std::vector<unsigned char> oldbytes(size), newbytes(size), patched(size);
+    for(auto itr = patches.lower_bound(Range(start, start)); itr != patches.end() && itr->first.first <= end; ++itr)
+    {
+        auto offset = itr->first.first - start;
+        auto count = itr->first.second - itr->first.first + 1;
+        memcpy(oldbytes.data() + offset, itr->second.oldbytes.data(), count);
+        memcpy(newbytes.data() + offset, itr->second.newbytes.data(), count);
+        memset(patched.data() + offset, 1, count);
+    }
+    auto writeOffset = Chunk.key - start;
+    for(duint i = 0; i < Chunk.size; i++)
+    {
+        auto j = writeOffset + i;
+        // Keep the original byte from the previous patch
+        if(!patched[j])
+            oldbytes[j] = OldBytes[i];
+        newbytes[j] = NewBytes[i];
+        // The patch was undone here
+        patched[j] = oldbytes[j] != newbytes[j];
+    }
 
-    PATCHINFO newPatch;
-    newPatch.addr = Address - ModBaseFromAddr(Address);
-    newPatch.oldbyte = OldByte;
-    newPatch.newbyte = NewByte;
-    ModNameFromAddr(Address, newPatch.mod, true);
+    patchErase(start, end, false);
+    auto spanRva = Chunk.rva - writeOffset;
+    for(duint i = 0; i < size;)
+    {
+        if(!patched[i])
+        {
+            i++;
+            continue;
+        }
+        auto first = i;
+        while(i < size && patched[i])
+            i++;
+        PATCHRANGE patch;
+        patch.mod = Chunk.mod;
+        patch.rva = spanRva + first;
+        patch.oldbytes.assign(oldbytes.begin() + first, oldbytes.begin() + i);
+        patch.newbytes.assign(newbytes.begin() + first, newbytes.begin() + i);
+        patches.emplace(Range(start + first, start + i - 1), std::move(patch));
+        patchCount += i - first;
+    }
+}
 
-    // Generate a key for this address
-    const duint key = ModHashFromAddr(Address);
+bool PatchSet(duint Address, unsigned char OldByte, unsigned char NewByte)
+{
+    return PatchSetRange(Address, &OldByte, &NewByte, 1);
+}
 
-    EXCLUSIVE_ACQUIRE(LockPatches);
+bool PatchSetRange(duint Address, const unsigned char* OldBytes, const unsigned char* NewBytes, duint Size)
+{
+    if(!DbgIsDebugging())
+        return false;
 
-    // Find any patch with this specific address
-    auto found = patches.find(key);
+    // The whole range must be valid
+    if(!MemIsValidReadPtr(Address) || (Size && !MemIsValidReadPtr(Address + Size - 1)))
+        return false;
 
-    if(found != patches.end())
+    // Split the write at module boundaries, the module information is gathered before the lock is taken
+    std::vector<PatchChunk> chunks;
+    for(duint offset = 0; offset < Size;)
     {
-        if(found->second.oldbyte == NewByte)
+        auto address = Address + offset;
+        PatchChunk chunk;
+        auto base = ModBaseFromAddr(address);
+        chunk.key = ModHashFromAddr(address);
+        chunk.rva = address - base;
+        chunk.size = Size - offset;
+        *chunk.mod = '\0';
+        if(base)
         {
-            // The patch was undone here
-            patches.erase(found);
-            return true;
+            chunk.size = min(chunk.size, base + ModSizeFromAddr(address) - address);
+            ModNameFromAddr(address, chunk.mod, true);
         }
-
-        // Keep the original byte from the previous patch
-        newPatch.oldbyte = found->second.oldbyte;
-        found->second = newPatch;
+        else
+        {
+            // Stop where the range runs into a module, its bytes are keyed by the module
+            auto nextBase = ModNextBaseFromAddr(address);
+            if(nextBase)
+                chunk.size = min(chunk.size, nextBase - address);
+        }
+        chunks.push_back(chunk);
+        offset += chunk.size;
     }
-    else
+
+    EXCLUSIVE_ACQUIRE(LockPatches);
+    duint offset = 0;
+    for(const auto & chunk : chunks)
     {
-        // The entry was never found, insert it
-        patches.insert(std::make_pair(key, newPatch));
+        patchWrite(chunk, OldBytes + offset, NewBytes + offset);
+        offset += chunk.size;
     }
 
     return true;
@@ -66,10 +188,11 @@ bool PatchGet(duint Address, PATCHINFO* Patch)
 {
     if(!DbgIsDebugging())
         return false;
+    auto key = ModHashFromAddr(Address);
     SHARED_ACQUIRE(LockPatches);
 
     // Find this specific address in the list
-    auto found = patches.find(ModHashFromAddr(Address));
+    auto found = patches.find(Range(key, key));
 
     if(found == patches.end())
         return false;
@@ -77,32 +200,52 @@ bool PatchGet(duint Address, PATCHINFO* Patch)
     // Did the user request an output buffer?
     if(Patch)
     {
-        *Patch = found->second;
-        Patch->addr += ModBaseFromAddr(Address);
+        auto offset = key - found->first.first;
+        strcpy_s(Patch->mod, found->second.mod.c_str());
+        Patch->addr = found->second.rva + offset + ModBaseFromAddr(Address);
+        Patch->oldbyte = found->second.oldbytes[offset];
+        Patch->newbyte = found->second.newbytes[offset];
     }
 
     // Return true because the patch was found
     return true;
 }
 
+bool PatchInRange(duint Start, duint End)
+{
+    if(!DbgIsDebugging())
+        return false;
+    if(Start > End)
+        std::swap(Start, End);
+    auto key = ModHashFromAddr(Start);
+    if(ModBaseFromAddr(Start) != ModBaseFromAddr(End))
+    {
+        // the range covers multiple modules, check them byte by byte
+        for(duint i = Start; i <= End && i >= Start; i++)
+        {
+            if(PatchGet(i, nullptr))
+                return true;
+        }
+        return false;
+    }
+    SHARED_ACQUIRE(LockPatches);
+    auto found = patches.lower_bound(Range(key, key));
+    return found != patches.end() && found->first.first <= key + (End - Start);
+}
+
 bool PatchDelete(duint Address, bool Restore)
 {
     if(!DbgIsDebugging())
         return false;
+    auto key = ModHashFromAddr(Address);
     EXCLUSIVE_ACQUIRE(LockPatches);
 
     // Do a list lookup with hash
-    auto found = patches.find(ModHashFromAddr(Address));
-
-    if(found == patches.end())
+    if(patches.find(Range(key, key)) == patches.end())
         return false;
 
-    // Restore the original byte at this address
-    if(Restore)
-        MemWrite((found->second.addr + ModBaseFromAddr(Address)), &found->second.oldbyte, sizeof(char));
-
-    // Finally remove it from the list
-    patches.erase(found);
+    // Restore the original byte at this address and remove it from the list
+    patchErase(key, key, Restore);
     return true;
 }
 
@@ -117,6 +260,7 @@ void PatchDelRange(duint Start, duint End, bool Restore)
     {
         EXCLUSIVE_ACQUIRE(LockPatches);
         patches.clear();
+        patchCount = 0;
     }
     else
     {
@@ -126,26 +270,13 @@ void PatchDelRange(duint Start, duint End, bool Restore)
         if(moduleBase != ModBaseFromAddr(End))
             return;
 
-        // VA to RVA in module
-        Start -= moduleBase;
-        End -= moduleBase;
+        // [Start, End)
+        if(End <= Start)
+            return;
+        auto key = ModHashFromAddr(Start);
 
         EXCLUSIVE_ACQUIRE(LockPatches);
-        for(auto itr = patches.begin(); itr != patches.end();)
-        {
-            const auto & currentPatch = itr->second;
-            // [Start, End)
-            if(currentPatch.addr >= Start && currentPatch.addr < End)
-            {
-                // Restore the original byte if necessary
-                if(Restore)
-                    MemWrite((currentPatch.addr + moduleBase), &currentPatch.oldbyte, sizeof(char));
-
-                itr = patches.erase(itr);
-            }
-            else
-                ++itr;
-        }
+        patchErase(key, key + (End - Start) - 1, Restore);
     }
 }
 
@@ -159,15 +290,15 @@ bool PatchEnum(PATCHINFO* List, size_t* Size)
     // Did the user request the size?
     if(Size)
     {
-        *Size = patches.size() * sizeof(PATCHINFO);
-        lastEnumSize[GetCurrentThreadId()] = patches.size();
+        *Size = patchCount * sizeof(PATCHINFO);
+        lastEnumSize[GetCurrentThreadId()] = patchCount;
 
         if(!List)
             return true;
     }
 
-    // Copy each vector entry to a C-style array
-    auto limit = patches.size();
+    // Copy each byte of the ranges to a C-style array
+    auto limit = patchCount;
     {
         auto lastSizeItr = lastEnumSize.find(GetCurrentThreadId());
         if(lastSizeItr != lastEnumSize.end())
@@ -176,16 +307,28 @@ bool PatchEnum(PATCHINFO* List, size_t* Size)
             lastEnumSize.erase(lastSizeItr);
         }
     }
-    for(auto itr = patches.cbegin(); itr != patches.cend() && limit != 0; ++itr, --limit, ++List)
+    for(auto itr = patches.cbegin(); itr != patches.cend() && limit != 0; ++itr)
     {
-        *List = itr->second;
-        List->addr += ModBaseFromName(itr->second.mod);
+        const auto & patch = itr->second;
+        auto base = ModBaseFromName(patch.mod.c_str());
+        for(size_t i = 0; i < patch.oldbytes.size() && limit != 0; i++, --limit, ++List)
+        {
+            strcpy_s(List->mod, patch.mod.c_str());
+            List->addr = base + patch.rva + i;
+            List->oldbyte = patch.oldbytes[i];
+            List->newbyte = patch.newbytes[i];
+        }
     }
 
     return true;
 }
 
 int PatchFile(const PATCHINFO* List, int Count, const char* FileName, char* Error)
+{
+    return PatchExport(List, Count, FileName, false, Error);
+}
+
+int PatchExport(const PATCHINFO* List, int Count, const char* Path, bool Report, char* Error)
 {
     //
     // This function returns an int based on the number
@@ -200,104 +343,119 @@ int PatchFile(const PATCHINFO* List, int Count, const char* FileName, char* Erro
         return -1;
     }
 
-    // Get a copy of the first module name in the array
-    char moduleName[MAX_MODULE_SIZE];
-    strcpy_s(moduleName, List[0].mod);
-
-    // Check if all patches are in the same module
+    // Group the patches by module
+    struct ExportModule
+    {
+        const char* name;
+        duint base;
+        char path[MAX_PATH];
+        std::vector<PatchExportByte> patches;
+    };
+    std::vector<ExportModule> modules;
+    std::unordered_map<String, size_t> moduleIndex;
     for(int i = 0; i < Count; i++)
     {
-        if(_stricmp(List[i].mod, moduleName))
+        auto key = StringUtils::ToLower(List[i].mod);
+        auto found = moduleIndex.find(key);
+        if(found == moduleIndex.end())
         {
-            if(Error)
-                sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Not all patches are in module %s")), moduleName);
-
-            return -1;
+            found = moduleIndex.insert({ key, modules.size() }).first;
+            modules.emplace_back();
+            modules.back().name = List[i].mod;
         }
+        modules[found->second].patches.push_back({ List[i].addr, List[i].oldbyte, List[i].newbyte });
     }
 
-    // See if the module was loaded
-    duint moduleBase = ModBaseFromName(moduleName);
-
-    if(!moduleBase)
+    // Resolve all modules before anything is written
+    for(auto & module : modules)
     {
-        if(Error)
-            sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to get base of module %s")), moduleName);
+        // See if the module was loaded
+        module.base = ModBaseFromName(module.name);
 
-        return -1;
-    }
-
-    //get the origin module path
-    char modPath[MAX_PATH] = "";
-    if(!ModPathFromAddr(moduleBase, modPath, MAX_PATH))
-    {
-        if(Error)
-            sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to get module path of module %s")), moduleName);
+        if(!module.base)
+        {
+            if(Error)
+                sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to get base of module %s")), module.name);
 
-        return -1;
-    }
+            return -1;
+        }
 
-    // Create file copy at destination path with attributes
-    WString srcPath = StringUtils::Utf8ToUtf16(modPath);
-    WString dstPath = StringUtils::Utf8ToUtf16(FileName);
+        //get the origin module path
+        if(!ModPathFromAddr(module.base, module.path, MAX_PATH))
+        {
+            if(Error)
+                sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to get module path of module %s")), module.name);
 
-    if(!CopyFileW(srcPath.c_str(), dstPath.c_str(), false))
-    {
-        if(Error)
-            strcpy_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to make a copy of the original file (patch target is in use?)")));
+            return -1;
+        }
 
-        return -1;
+        for(auto & patch : module.patches)
+            patch.rva -= module.base;
     }
 
-    // Strip the READONLY flag from file so we can load it
-    DWORD fileAttrs = GetFileAttributesW(dstPath.c_str());
-
-    if(fileAttrs == INVALID_FILE_ATTRIBUTES)
+    // A single module is written to Path, multiple modules to files named like the module in the Path directory
+    auto directory = modules.size() > 1;
+    if(directory && !CreateDirectoryW(StringUtils::Utf8ToUtf16(Path).c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
     {
         if(Error)
-            strcpy_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Unable to obtain attributes for copied file")));
+            sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to create directory %s")), Path);
 
         return -1;
     }
 
-    SetFileAttributesW(dstPath.c_str(), fileAttrs & ~FILE_ATTRIBUTE_READONLY);
-
-    // Try loading (will fail if SetFileAttributesW fails)
-    HANDLE fileHandle;
-    DWORD loadedSize;
-    HANDLE fileMap;
-    ULONG_PTR fileMapVa;
-    if(!StaticFileLoadW(dstPath.c_str(), UE_ACCESS_ALL, false, &fileHandle, &loadedSize, &fileMap, &fileMapVa))
+    // Read every module file once, patch it in memory and write it in one go
+    int patchCount = 0;
+    std::vector<unsigned char> data;
+    std::vector<size_t> offsets;
+    for(const auto & module : modules)
     {
-        if(Error)
-            strcpy_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "StaticFileLoad failed")));
+        if(!FileHelper::ReadAllData(module.path, data))
+        {
+            if(Error)
+                sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to read the original file of module %s")), module.name);
 
-        return -1;
-    }
+            return -1;
+        }
 
-    // Begin iterating all patches, applying them to a file
-    int patchCount = 0;
+        PeSectionMap sections;
+        if(!sections.Parse(data.data(), data.size()))
+        {
+            if(Error)
+                sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to parse the PE headers of module %s")), module.name);
 
-    for(int i = 0; i < Count; i++)
-    {
-        // Convert the virtual address to an offset within disk file data
-        unsigned char* ptr = (unsigned char*)ConvertVAtoFileOffsetEx(fileMapVa, loadedSize, moduleBase, List[i].addr, false, true);
+            return -1;
+        }
 
-        // Skip patches that do not have a raw address
-        if(!ptr)
-            continue;
+        PatchExportStats stats;
+        offsets.clear();
+        PatchExportApply(data, sections, module.patches, stats, Report ? &offsets : nullptr);
+        if(stats.unmapped)
+            dprintf(QT_TRANSLATE_NOOP("DBG", "%llu patched byte(s) of module %s are not backed by the file and were not exported\n"), (unsigned long long)stats.unmapped, module.name);
+        if(stats.mismatched)
+            dprintf(QT_TRANSLATE_NOOP("DBG", "%llu patched byte(s) of module %s did not match the original file byte (relocations?), check the output\n"), (unsigned long long)stats.mismatched, module.name);
 
-        *ptr = List[i].newbyte;
-        patchCount++;
-    }
+        String fileName = directory ? StringUtils::sprintf("%s\\%s", Path, module.name) : Path;
+        if(!FileHelper::WriteAllData(fileName, data.data(), data.size()))
+        {
+            if(Error)
+                sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to write %s (patch target is in use?)")), fileName.c_str());
 
-    // Unload the file from memory and commit changes to disk
-    if(!StaticFileUnloadW(dstPath.c_str(), true, fileHandle, loadedSize, fileMap, fileMapVa))
-    {
-        if(Error)
-            strcpy_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "StaticFileUnload failed")));
+            return -1;
+        }
 
-        return -1;
+        if(Report)
+        {
+            auto ips = PatchExportIps(data, offsets);
+            if(!FileHelper::WriteAllData(fileName + ".ips", ips.data(), ips.size()))
+            {
+                if(Error)
+                    sprintf_s(Error, MAX_ERROR_SIZE, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Failed to write %s")), (fileName + ".ips").c_str());
+
+                return -1;
+            }
+        }
+
+        patchCount += int(stats.applied);
     }
 
     // Zero the error message and return count
@@ -316,6 +474,7 @@ void PatchClear(const char* Module)
     {
         // No specific entries to delete, so remove all of them
         patches.clear();
+        patchCount = 0;
     }
     else
     {
@@ -323,8 +482,11 @@ void PatchClear(const char* Module)
         // module for the address
         for(auto itr = patches.begin(); itr != patches.end();)
         {
-            if(!_stricmp(itr->second.mod, Module))
+            if(!_stricmp(itr->second.mod.c_str(), Module))
+            {
+                patchCount -= itr->second.oldbytes.size();
                 itr = patches.erase(itr);
+            }
             else
                 ++itr;
         }
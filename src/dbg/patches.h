@@ -13,11 +13,14 @@ struct PATCHINFO
 };
 
 bool PatchSet(duint Address, unsigned char OldByte, unsigned char NewByte);
+bool PatchSetRange(duint Address, const unsigned char* OldBytes, const unsigned char* NewBytes, duint Size);
 bool PatchGet(duint Address, PATCHINFO* Patch);
+bool PatchInRange(duint Start, duint End);
 bool PatchDelete(duint Address, bool Restore);
 void PatchDelRange(duint Start, duint End, bool Restore);
 bool PatchEnum(PATCHINFO* List, size_t* Size);
 int PatchFile(const PATCHINFO* List, int Count, const char* FileName, char* Error);
+int PatchExport(const PATCHINFO* List, int Count, const char* Path, bool Report, char* Error);
 void PatchClear(const char* Module = nullptr);
 
 #endif // _PATCHES_H
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "patchexport.h"
+#include <algorithm>
+
+static uint32_t read16(const unsigned char* data)
+{
+    return data[0] | data[1] << 8;
+}
+
+static uint32_t read32(const unsigned char* data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | uint32_t(data[3]) << 24;
+}
+
+bool PeSectionMap::Parse(const unsigned char* data, size_t size)
+{
+    mSections.clear();
+    mHeaderSize = 0;
+    mFileSize = size;
+    if(size < 0x40 || data[0] != 'M' || data[1] != 'Z')
+        return false;
+    size_t ntHeaders = read32(data + 0x3C);
+    if(ntHeaders > size || size - ntHeaders < 24 || read32(data + ntHeaders) != 0x4550) // PE\0\0
+        return false;
+    auto numberOfSections = read16(data + ntHeaders + 6);
+    auto sizeOfOptionalHeader = read16(data + ntHeaders + 20);
+    auto optionalHeader = ntHeaders + 24;
+    if(sizeOfOptionalHeader < 64 || size - optionalHeader < sizeOfOptionalHeader)
+        return false;
+    auto magic = read16(data + optionalHeader);
+    if(magic != 0x10B && magic != 0x20B)
+        return false;
+    auto fileAlignment = read32(data + optionalHeader + 36);
+    mHeaderSize = read32(data + optionalHeader + 60);
+    auto sectionTable = optionalHeader + sizeOfOptionalHeader;
+    if(size - sectionTable < numberOfSections * size_t(40))
+        return false;
+    mSections.reserve(numberOfSections);
+    for(size_t i = 0; i < numberOfSections; i++)
+    {
+        auto header = data + sectionTable + i * 40;
+        Section section;
+        section.virtualSize = read32(header + 8);
+        section.rva = read32(header + 12);
+        section.rawSize = read32(header + 16);
+        section.rawOffset = read32(header + 20);
+        // the loader rounds the raw offset down to 512 bytes
+        if(fileAlignment >= 0x200)
+            section.rawOffset &= ~uint64_t(0x1FF);
+        if(!section.virtualSize)
+            section.virtualSize = section.rawSize;
+        mSections.push_back(section);
+    }
+    std::sort(mSections.begin(), mSections.end(), [](const Section & a, const Section & b)
+    {
+        return a.rva < b.rva;
+    });
+    return true;
+}
+
+bool PeSectionMap::RvaToOffset(uint64_t rva, size_t & offset) const
+{
+    auto found = std::upper_bound(mSections.begin(), mSections.end(), rva, [](uint64_t value, const Section & section)
+    {
+        return value < section.rva;
+    });
+    if(found == mSections.begin())
+    {
+        if(rva >= mHeaderSize || rva >= mFileSize)
+            return false;
+        offset = size_t(rva);
+        return true;
+    }
+    const auto & section = *(found - 1);
+    auto delta = rva - section.rva;
+    if(delta >= section.virtualSize || delta >= section.rawSize || section.rawOffset + delta >= mFileSize)
+        return false;
+    offset = size_t(section.rawOffset + delta);
+    return true;
+}
+
+void PatchExportApply(std::vector<unsigned char> & file, const PeSectionMap & sections, const std::vector<PatchExportByte> & patches, PatchExportStats & stats, std::vector<size_t>* offsets)
+{
+    for(const auto & patch : patches)
+    {
+        size_t offset;
+        if(!sections.RvaToOffset(patch.rva, offset) || offset >= file.size())
+        {
+            stats.unmapped++;
+            continue;
+        }
+        if(file[offset] != patch.oldbyte)
+            stats.mismatched++;
+        file[offset] = patch.newbyte;
+        stats.applied++;
+        if(offsets)
+            offsets->push_back(offset);
+    }
+}
+
+static void writeBigEndian(std::vector<unsigned char> & out, uint64_t value, int size)
+{
+    for(int i = size - 1; i >= 0; i--)
+        out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+std::vector<unsigned char> PatchExportIps(const std::vector<unsigned char> & file, std::vector<size_t> offsets)
+{
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+    auto ips32 = !offsets.empty() && offsets.back() >= 0x1000000;
+    int offsetSize = ips32 ? 4 : 3;
+    // a record can't start at the offset that spells the footer
+    uint64_t footerOffset = ips32 ? 0x45454F46 : 0x454F46;
+
+    std::vector<unsigned char> ips;
+    const char* header = ips32 ? "IPS32" : "PATCH";
+    ips.insert(ips.end(), header, header + 5);
+    for(size_t i = 0; i < offsets.size();)
+    {
+        auto start = offsets[i];
+        auto end = start + 1;
+        if(start == footerOffset)
+            start--;
+        for(i++; i < offsets.size() && offsets[i] == end && end - start < 0xFFFF; i++)
+            end++;
+        writeBigEndian(ips, start, offsetSize);
+        writeBigEndian(ips, end - start, 2);
+        ips.insert(ips.end(), file.begin() + start, file.begin() + end);
+    }
+    const char* footer = ips32 ? "EEOF" : "EOF";
+    ips.insert(ips.end(), footer, footer + (ips32 ? 4 : 3));
+    return ips;
+}
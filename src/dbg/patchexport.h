@@ -0,0 +1,51 @@
+#ifndef _PATCHEXPORT_H
+#define _PATCHEXPORT_H
+
+// Patch export core, it only works on file buffers (no debugger or Windows dependencies)
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct PatchExportByte
+{
+    uint64_t rva;
+    unsigned char oldbyte;
+    unsigned char newbyte;
+};
+
+struct PatchExportStats
+{
+    size_t applied = 0;
+    size_t unmapped = 0; // the rva has no raw data in the file (uninitialized data, overlays)
+    size_t mismatched = 0; // the file byte differs from the original byte (relocations)
+};
+
+// Section table of a PE file, RVA to file offset conversion like the loader maps the file
+class PeSectionMap
+{
+public:
+    bool Parse(const unsigned char* data, size_t size);
+    bool RvaToOffset(uint64_t rva, size_t & offset) const;
+
+private:
+    struct Section
+    {
+        uint64_t rva;
+        uint64_t virtualSize;
+        uint64_t rawOffset;
+        uint64_t rawSize;
+    };
+
+    std::vector<Section> mSections; // sorted by rva
+    uint64_t mHeaderSize = 0;
+    size_t mFileSize = 0;
+};
+
+// Applies the patches to the file, the file offsets of the applied bytes are appended to offsets (optional)
+void PatchExportApply(std::vector<unsigned char> & file, const PeSectionMap & sections, const std::vector<PatchExportByte> & patches, PatchExportStats & stats, std::vector<size_t>* offsets = nullptr);
+
+// IPS report of the patched bytes at offsets in the (patched) file, IPS32 when an offset does not fit in 24 bits
+std::vector<unsigned char> PatchExportIps(const std::vector<unsigned char> & file, std::vector<size_t> offsets);
+
+#endif // _PATCHEXPORT_H
@@ -1,6 +1,9 @@
 #include "stringutils.h"
 #include <windows.h>
 #include <cstdint>
+#include <algorithm>
+#include <intrin.h>
+#include <emmintrin.h>
 
 static inline bool convertLongLongNumber(const char* str, unsigned long long & result, int radix)
 {
@@ -502,20 +505,76 @@ static int hex2int(char ch)
     return -1;
 }
 
+#define HEXLOOKUP "0123456789ABCDEF"
+
+// SSE2 is part of both the x86 and x64 baselines
+static inline __m128i nibblesToHex(__m128i nibbles)
+{
+    auto letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+static inline void hexEncode16(const unsigned char* src, char* dest)
+{
+    auto bytes = _mm_loadu_si128((const __m128i*)src);
+    auto mask = _mm_set1_epi8(0xF);
+    auto high = nibblesToHex(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+    auto low = nibblesToHex(_mm_and_si128(bytes, mask));
+    _mm_storeu_si128((__m128i*)dest, _mm_unpacklo_epi8(high, low));
+    _mm_storeu_si128((__m128i*)(dest + 16), _mm_unpackhi_epi8(high, low));
+}
+
+static void hexEncode(const unsigned char* src, size_t size, char* dest)
+{
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16)
+        hexEncode16(src + i, dest + i * 2);
+    for(; i < size; i++)
+    {
+        dest[i * 2] = HEXLOOKUP[(src[i] >> 4) & 0xF];
+        dest[i * 2 + 1] = HEXLOOKUP[src[i] & 0xF];
+    }
+}
+
+// Decodes size bytes from size * 2 hex characters, returns false on an invalid character
+static bool hexDecode(const char* text, size_t size, unsigned char* dest)
+{
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        auto chars = _mm_loadu_si128((const __m128i*)(text + i * 2));
+        auto digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+        auto isDigit = _mm_and_si128(_mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)), _mm_cmplt_epi8(digit, _mm_set1_epi8(10)));
+        auto alpha = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        auto isAlpha = _mm_and_si128(_mm_cmpgt_epi8(alpha, _mm_set1_epi8(-1)), _mm_cmplt_epi8(alpha, _mm_set1_epi8(6)));
+        if(_mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha)) != 0xFFFF)
+            return false;
+        auto nibbles = _mm_or_si128(_mm_and_si128(digit, isDigit), _mm_and_si128(_mm_add_epi8(alpha, _mm_set1_epi8(10)), isAlpha));
+        // every 16-bit lane holds the high nibble in its low byte and the low nibble in its high byte
+        auto bytes = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0xF)), 4), _mm_srli_epi16(nibbles, 8));
+        _mm_storel_epi64((__m128i*)(dest + i), _mm_packus_epi16(bytes, bytes));
+    }
+    for(; i < size; i++)
+    {
+        auto high = hex2int(text[i * 2]);
+        auto low = hex2int(text[i * 2 + 1]);
+        if(high == -1 || low == -1)
+            return false;
+        dest[i] = (high << 4) | low;
+    }
+    return true;
+}
+
 bool StringUtils::FromHex(const String & text, std::vector<unsigned char> & data, bool reverse)
 {
     auto size = text.size();
     if(size % 2)
         return false;
     data.resize(size / 2);
-    for(size_t i = 0, j = 0; i < size; i += 2, j++)
-    {
-        auto high = hex2int(text[i]);
-        auto low = hex2int(text[i + 1]);
-        if(high == -1 || low == -1)
-            return false;
-        data[reverse ? data.size() - j - 1 : j] = (high << 4) | low;
-    }
+    if(!hexDecode(text.c_str(), data.size(), data.data()))
+        return false;
+    if(reverse)
+        std::reverse(data.begin(), data.end());
     return true;
 }
 
@@ -526,99 +585,211 @@ String StringUtils::ToHex(unsigned long long value)
     return buf;
 }
 
-#define HEXLOOKUP "0123456789ABCDEF"
-
 String StringUtils::ToHex(const unsigned char* buffer, size_t size, bool reverse)
 {
     String result;
     result.resize(size * 2);
+    if(!reverse)
+    {
+        hexEncode(buffer, size, &result[0]);
+        return result;
+    }
     for(size_t i = 0, j = 0; i < size; i++, j += 2)
     {
-        auto ch = buffer[reverse ? size - i - 1 : i];
+        auto ch = buffer[size - i - 1];
         result[j] = HEXLOOKUP[(ch >> 4) & 0xF];
         result[j + 1] = HEXLOOKUP[ch & 0xF];
     }
     return result;
 }
 
+// Length of the run of buffer[i] starting at i
+static size_t runLength(const unsigned char* buffer, size_t size, size_t i)
+{
+    auto ch = buffer[i];
+    auto end = i + 1;
+    auto broadcast = _mm_set1_epi8(char(ch));
+    for(; end + 16 <= size; end += 16)
+    {
+        auto equal = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(buffer + end)), broadcast)));
+        if(equal != 0xFFFF)
+        {
+            unsigned long index;
+            _BitScanForward(&index, ~equal);
+            return end + index - i;
+        }
+    }
+    while(end < size && buffer[end] == ch)
+        end++;
+    return end - i;
+}
+
 String StringUtils::ToCompressedHex(const unsigned char* buffer, size_t size)
 {
     if(!size)
         return "";
+    // one byte never takes more than two characters: runs of one and two are written out, longer runs are at most "XX{N}"
     String result;
-    result.reserve(size * 2);
+    result.resize(size * 2);
+    auto dest = &result[0];
+    size_t j = 0;
     for(size_t i = 0; i < size;)
     {
-        size_t repeat = 0;
-        auto lastCh = buffer[i];
-        result.push_back(HEXLOOKUP[(lastCh >> 4) & 0xF]);
-        result.push_back(HEXLOOKUP[lastCh & 0xF]);
-        for(; i < size && buffer[i] == lastCh; i++)
-            repeat++;
+        // 16 bytes without equal neighbours (the 17th byte included) are plain hex
+        if(i + 17 <= size)
+        {
+            auto current = _mm_loadu_si128((const __m128i*)(buffer + i));
+            auto next = _mm_loadu_si128((const __m128i*)(buffer + i + 1));
+            if(!_mm_movemask_epi8(_mm_cmpeq_epi8(current, next)))
+            {
+                hexEncode16(buffer + i, dest + j);
+                i += 16;
+                j += 32;
+                continue;
+            }
+        }
+        auto ch = buffer[i];
+        auto repeat = runLength(buffer, size, i);
+        i += repeat;
+        dest[j++] = HEXLOOKUP[(ch >> 4) & 0xF];
+        dest[j++] = HEXLOOKUP[ch & 0xF];
         if(repeat == 2)
         {
-            result.push_back(HEXLOOKUP[(lastCh >> 4) & 0xF]);
-            result.push_back(HEXLOOKUP[lastCh & 0xF]);
+            dest[j++] = HEXLOOKUP[(ch >> 4) & 0xF];
+            dest[j++] = HEXLOOKUP[ch & 0xF];
         }
         else if(repeat > 2)
-#ifdef _WIN64
-            result.append(StringUtils::sprintf("{%llX}", repeat));
-#else //x86
-            result.append(StringUtils::sprintf("{%X}", repeat));
-#endif //_WIN64
+        {
+            char digits[sizeof(size_t) * 2];
+            size_t count = 0;
+            for(; repeat; repeat >>= 4)
+                digits[count++] = HEXLOOKUP[repeat & 0xF];
+            dest[j++] = '{';
+            while(count)
+                dest[j++] = digits[--count];
+            dest[j++] = '}';
+        }
     }
+    result.resize(j);
     return result;
 }
 
-bool StringUtils::FromCompressedHex(const String & text, std::vector<unsigned char> & data)
+// Parses compressed hex, output.Append(count, dest) reserves room for the decoded bytes (dest is nullptr when only measuring)
+template<class TOutput>
+static bool compressedHexDecode(const char* text, size_t length, TOutput & output)
 {
-    auto size = text.size();
-    if(size < 2)
+    if(length < 2)
         return false;
-    data.clear();
-    data.reserve(size); //TODO: better initial estimate
-    String repeatStr;
-    for(size_t i = 0; i < size;)
+    unsigned char* last = nullptr;
+    for(size_t i = 0; i < length;)
     {
-        if(isspace(text[i])) //skip whitespace
+        if(isspace((unsigned char)text[i])) //skip whitespace
         {
             i++;
             continue;
         }
-        auto high = hex2int(text[i++]); //eat high nibble
-        if(i >= size) //not enough data
+        // plain hex up to the next repeat count or whitespace
+        auto end = i;
+        while(end < length && text[end] != '{' && (unsigned char)text[end] > ' ')
+            end++;
+        auto count = end - i;
+        if(!count || count % 2) //repeat without a byte or half a byte
             return false;
-        auto low = hex2int(text[i++]); //eat low nibble
-        if(high == -1 || low == -1) //invalid character
+        count /= 2;
+        unsigned char* dest;
+        if(!output.Append(count, dest) || (dest && !hexDecode(text + i, count, dest)))
             return false;
-        auto lastCh = (high << 4) | low;
-        data.push_back(lastCh);
-
-        if(i >= size) //end of buffer
-            break;
+        last = dest ? dest + count - 1 : nullptr;
+        i = end;
 
-        if(text[i] == '{')
+        if(i < length && text[i] == '{')
         {
-            repeatStr.clear();
             i++; //eat '{'
-            while(text[i] != '}')
+            size_t repeat = 0;
+            auto digits = i;
+            for(; i < length && repeat >> (sizeof(size_t) * 8 - 4) == 0; i++)
+            {
+                auto nibble = hex2int(text[i]);
+                if(nibble == -1)
+                    break;
+                repeat = (repeat << 4) | nibble;
+            }
+            if(i >= length || text[i] != '}')
             {
-                repeatStr.push_back(text[i++]); //eat character
-                if(i >= size) //unexpected end of buffer (missing '}')
+                // not plain hex digits, fall back to the lenient number parser
+                auto close = (const char*)memchr(text + digits, '}', length - digits);
+                if(!close) //unexpected end of buffer (missing '}')
+                    return false;
+                i = close - text;
+                if(!convertNumber(String(text + digits, close).c_str(), repeat, 16))
                     return false;
             }
+            else if(i == digits)
+                return false;
             i++; //eat '}'
-
-            size_t repeat = 0;
-            if(!convertNumber(repeatStr.c_str(), repeat, 16) || !repeat) //conversion failed or repeat zero times
+            if(!repeat) //repeat zero times
+                return false;
+            auto ch = last ? *last : 0;
+            if(!output.Append(repeat - 1, dest))
                 return false;
-            for(size_t j = 1; j < repeat; j++)
-                data.push_back(lastCh);
+            if(dest)
+            {
+                memset(dest, ch, repeat - 1);
+                last = dest + repeat - 2;
+            }
         }
     }
     return true;
 }
 
+struct CompressedHexVector
+{
+    std::vector<unsigned char> & data;
+
+    bool Append(size_t count, unsigned char* & dest)
+    {
+        auto size = data.size();
+        if(count > data.max_size() - size)
+            return false;
+        data.resize(size + count);
+        dest = data.data() + size;
+        return true;
+    }
+};
+
+struct CompressedHexBuffer
+{
+    unsigned char* dest; // nullptr to only compute the size
+    size_t capacity;
+    size_t size;
+
+    bool Append(size_t count, unsigned char* & result)
+    {
+        if(count > capacity - size)
+            return false;
+        result = dest ? dest + size : nullptr;
+        size += count;
+        return true;
+    }
+};
+
+bool StringUtils::FromCompressedHex(const String & text, std::vector<unsigned char> & data)
+{
+    data.clear();
+    data.reserve(text.size()); // typical for encode maps, grows for long runs
+    CompressedHexVector output = { data };
+    return compressedHexDecode(text.c_str(), text.size(), output);
+}
+
+bool StringUtils::FromCompressedHex(const char* text, size_t length, unsigned char* dest, size_t & size)
+{
+    CompressedHexBuffer output = { dest, dest ? size : size_t(-1), 0 };
+    if(!compressedHexDecode(text, length, output))
+        return false;
+    size = output.size;
+    return true;
+}
+
 int StringUtils::hackicmp(const char* s1, const char* s2)
 {
     unsigned char c1, c2;
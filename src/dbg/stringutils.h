@@ -46,6 +46,8 @@ public:
     static String ToHex(const unsigned char* buffer, size_t size, bool reverse = false);
     static String ToCompressedHex(const unsigned char* buffer, size_t size);
     static bool FromCompressedHex(const String & text, std::vector<unsigned char> & data);
+    // Decodes into dest, size is the capacity of dest and receives the decoded size. With dest == nullptr only the decoded size is computed (the digits are validated when decoding).
+    static bool FromCompressedHex(const char* text, size_t length, unsigned char* dest, size_t & size);
     static int hackicmp(const char* s1, const char* s2);
 
     template<typename T>
@@ -0,0 +1,41 @@
+#include "_global.h"
+#include "symbolundecorator.h"
+#include "threading.h"
+
+LazyUndecoratedName::LazyUndecoratedName(const LazyUndecoratedName & other)
+{
+    SHARED_ACQUIRE(LockUndecorateCache);
+    mName = other.mName;
+    mValid = other.mValid;
+}
+
+LazyUndecoratedName & LazyUndecoratedName::operator=(const LazyUndecoratedName & other)
+{
+    if(this != &other)
+    {
+        EXCLUSIVE_ACQUIRE(LockUndecorateCache);
+        mName = other.mName;
+        mValid = other.mValid;
+    }
+    return *this;
+}
+
+const std::string & LazyUndecoratedName::get(const std::string & decoratedName) const
+{
+    {
+        SHARED_ACQUIRE(LockUndecorateCache);
+        if(mValid)
+            return mName;
+    }
+    // __unDNameEx does not need the dbghelp lock, so concurrent misses undecorate in parallel
+    std::string undecoratedName;
+    if(!decoratedName.empty())
+        undecorateName(decoratedName, undecoratedName);
+    EXCLUSIVE_ACQUIRE(LockUndecorateCache);
+    if(!mValid)
+    {
+        mName = std::move(undecoratedName);
+        mValid = true;
+    }
+    return mName;
+}
@@ -93,4 +93,20 @@ inline bool undecorateName(const std::string & decoratedName, std::string & unde
             undecoratedName = ""; //https://stackoverflow.com/a/18299315
         return true;
     }
-}
\ No newline at end of file
+}
+
+//Lazily undecorated name, kept next to the decorated name so it is freed with its owner (the module on unload)
+class LazyUndecoratedName
+{
+public:
+    LazyUndecoratedName() = default;
+    LazyUndecoratedName(const LazyUndecoratedName & other);
+    LazyUndecoratedName & operator=(const LazyUndecoratedName & other);
+
+    //The returned reference stays valid for the lifetime of this object, empty when the name is not decorated
+    const std::string & get(const std::string & decoratedName) const;
+
+private:
+    mutable std::string mName;
+    mutable bool mValid = false;
+};
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "tableexport.h"
+
+TABLEEXPORTFORMAT TableExport::FormatFromFileName(const char* fileName)
+{
+    auto extension = strrchr(fileName, '.');
+    if(extension && _stricmp(extension, ".tsv") == 0)
+        return TableExportTsv;
+    if(extension && _stricmp(extension, ".json") == 0)
+        return TableExportJson;
+    return TableExportCsv;
+}
+
+static void appendJsonString(String & line, const String & str)
+{
+    line.push_back('\"');
+    for(auto ch : str)
+    {
+        switch(ch)
+        {
+        case '\"':
+            line.append("\\\"");
+            break;
+        case '\\':
+            line.append("\\\\");
+            break;
+        case '\r':
+            line.append("\\r");
+            break;
+        case '\n':
+            line.append("\\n");
+            break;
+        case '\t':
+            line.append("\\t");
+            break;
+        default:
+            if((unsigned char)ch < 0x20)
+                line.append(StringUtils::sprintf("\\u%04X", (unsigned char)ch));
+            else
+                line.push_back(ch);
+            break;
+        }
+    }
+    line.push_back('\"');
+}
+
+bool TableExport::Open(const char* fileName, TABLEEXPORTFORMAT format, const std::vector<String> & columns)
+{
+    auto hFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return false;
+    mWriter = std::make_unique<BufferedWriter>(hFile);
+    mFormat = format;
+    mRows = 0;
+    mOk = true;
+    mLine.clear();
+    if(mFormat == TableExportJson)
+    {
+        mKeys.resize(columns.size());
+        for(size_t i = 0; i < columns.size(); i++)
+        {
+            mKeys[i].clear();
+            appendJsonString(mKeys[i], columns[i]);
+            mKeys[i].push_back(':');
+        }
+        mLine = "[";
+        return writeLine();
+    }
+    for(size_t i = 0; i < columns.size(); i++)
+        appendCell(columns[i], i == 0);
+    return writeLine();
+}
+
+bool TableExport::Row(const std::vector<String> & cells)
+{
+    if(!mOk)
+        return false;
+    if(mFormat == TableExportJson)
+    {
+        mLine.append(mRows ? ",\n{" : "\n{");
+        for(size_t i = 0; i < cells.size() && i < mKeys.size(); i++)
+        {
+            if(i)
+                mLine.push_back(',');
+            mLine.append(mKeys[i]);
+            appendJsonString(mLine, cells[i]);
+        }
+        mLine.push_back('}');
+    }
+    else
+    {
+        for(size_t i = 0; i < cells.size(); i++)
+            appendCell(cells[i], i == 0);
+    }
+    mRows++;
+    return writeLine();
+}
+
+bool TableExport::Close()
+{
+    if(!mWriter)
+        return false;
+    if(mOk && mFormat == TableExportJson)
+    {
+        mLine = "\n]";
+        writeLine();
+    }
+    mOk = mOk && mWriter->Flush();
+    mWriter.reset();
+    return mOk;
+}
+
+unsigned long long TableExport::Rows() const
+{
+    return mRows;
+}
+
+void TableExport::appendCell(const String & cell, bool first)
+{
+    if(mFormat == TableExportTsv)
+    {
+        if(!first)
+            mLine.push_back('\t');
+        // TSV has no quoting, keep the row on one line
+        for(auto ch : cell)
+            mLine.push_back(ch == '\t' || ch == '\r' || ch == '\n' ? ' ' : ch);
+    }
+    else
+    {
+        if(!first)
+            mLine.push_back(',');
+        if(cell.find_first_of("\",\r\n") == String::npos)
+            mLine.append(cell);
+        else
+        {
+            mLine.push_back('\"');
+            for(auto ch : cell)
+            {
+                if(ch == '\"')
+                    mLine.push_back('\"');
+                mLine.push_back(ch);
+            }
+            mLine.push_back('\"');
+        }
+    }
+}
+
+bool TableExport::writeLine()
+{
+    if(mFormat != TableExportJson)
+        mLine.push_back('\n');
+    mOk = mOk && mWriter->Write(mLine.data(), mLine.size());
+    mLine.clear();
+    return mOk;
+}
\ No newline at end of file
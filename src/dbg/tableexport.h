@@ -0,0 +1,41 @@
+#ifndef _TABLEEXPORT_H
+#define _TABLEEXPORT_H
+
+#include "_global.h"
+#include "filemap.h"
+#include <memory>
+
+enum TABLEEXPORTFORMAT
+{
+    TableExportCsv,
+    TableExportTsv,
+    TableExportJson
+};
+
+/**
+\brief Writes a table to a CSV, TSV or JSON file one row at a time, so large results are never held in memory as text.
+       The JSON format is an array with one object per row, keyed by the column names.
+*/
+class TableExport
+{
+public:
+    static TABLEEXPORTFORMAT FormatFromFileName(const char* fileName);
+
+    bool Open(const char* fileName, TABLEEXPORTFORMAT format, const std::vector<String> & columns);
+    bool Row(const std::vector<String> & cells);
+    bool Close();
+    unsigned long long Rows() const;
+
+private:
+    std::unique_ptr<BufferedWriter> mWriter;
+    TABLEEXPORTFORMAT mFormat = TableExportCsv;
+    std::vector<String> mKeys; // JSON: quoted column names
+    unsigned long long mRows = 0;
+    bool mOk = false;
+    String mLine;
+
+    void appendCell(const String & cell, bool first);
+    bool writeLine();
+};
+
+#endif // _TABLEEXPORT_H
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "taskpool.h"
+#include <algorithm>
+#include <chrono>
+
+// VS2013 has no thread_local and no thread safe function local statics
+static TaskPool* globalPool = nullptr;
+static std::once_flag globalPoolOnce;
+
+TaskPool::TaskPool(unsigned int workers)
+    : mQueued(0)
+{
+    if(!workers)
+    {
+        auto concurrency = std::thread::hardware_concurrency();
+        workers = concurrency > 1 ? concurrency - 1 : 1;
+    }
+    for(unsigned int i = 0; i <= workers; i++)
+        mQueues.emplace_back(new Queue());
+    for(unsigned int i = 0; i < workers; i++)
+        mThreads.emplace_back(&TaskPool::worker, this);
+    for(auto & thread : mThreads)
+        mThreadIds.push_back(thread.get_id());
+    {
+        std::lock_guard<std::mutex> lock(mWakeLock);
+        mStarted = true;
+    }
+    mWake.notify_all();
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mWakeLock);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for(auto & thread : mThreads)
+        thread.join();
+}
+
+TaskPool & TaskPool::Global()
+{
+    // never destroyed: joining the workers while the dll unloads would deadlock
+    std::call_once(globalPoolOnce, []
+    {
+        globalPool = new TaskPool();
+    });
+    return *globalPool;
+}
+
+int TaskPool::currentQueue() const
+{
+    auto id = std::this_thread::get_id();
+    for(size_t i = 0; i < mThreadIds.size(); i++)
+        if(mThreadIds[i] == id)
+            return int(i);
+    return int(mQueues.size() - 1);
+}
+
+void TaskPool::push(Task && task)
+{
+    // counted first, so a worker never sees a queued task with a count of zero
+    {
+        std::lock_guard<std::mutex> lock(mWakeLock);
+        mQueued++;
+    }
+    auto & queue = *mQueues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.lock);
+        queue.tasks.push_back(std::move(task));
+    }
+    mWake.notify_one();
+}
+
+bool TaskPool::runOne()
+{
+    Task task;
+    bool found = false;
+    auto self = currentQueue();
+    // own queue from the back, the others from the front
+    {
+        auto & queue = *mQueues[self];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if(!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            found = true;
+        }
+    }
+    for(size_t i = 1; !found && i < mQueues.size(); i++)
+    {
+        auto & queue = *mQueues[(self + i) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if(!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            found = true;
+        }
+    }
+    if(!found)
+        return false;
+    mQueued--;
+    if(!task.group->Cancelled())
+        task.run();
+    task.group->finished();
+    return true;
+}
+
+void TaskPool::worker()
+{
+    // mThreadIds is complete once the constructor set mStarted
+    {
+        std::unique_lock<std::mutex> lock(mWakeLock);
+        mWake.wait(lock, [this] { return mStarted || mStop; });
+    }
+    while(true)
+    {
+        if(runOne())
+            continue;
+        std::unique_lock<std::mutex> lock(mWakeLock);
+        mWake.wait(lock, [this] { return mStop || mQueued > 0; });
+        if(mStop)
+            break;
+    }
+}
+
+TaskGroup::TaskGroup(TaskPool & pool)
+    : mPool(pool),
+      mPending(0),
+      mCancelled(false)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    Wait();
+}
+
+void TaskGroup::Run(std::function<void()> task)
+{
+    mPending++;
+    mPool.push({ std::move(task), this });
+}
+
+void TaskGroup::finished()
+{
+    // decremented under the lock, Wait takes it before returning so the group outlives this call
+    std::lock_guard<std::mutex> lock(mDoneLock);
+    if(--mPending == 0)
+        mDone.notify_all();
+}
+
+bool TaskGroup::Wait(const std::function<void()> & idle)
+{
+    while(mPending)
+    {
+        if(idle)
+            idle();
+        if(mPool.runOne())
+            continue;
+        // the remaining tasks run on other threads, they can still queue more work
+        std::unique_lock<std::mutex> lock(mDoneLock);
+        mDone.wait_for(lock, std::chrono::milliseconds(idle ? 50 : 2), [this] { return mPending == 0; });
+    }
+    std::lock_guard<std::mutex> lock(mDoneLock);
+    if(idle)
+        idle();
+    return !Cancelled();
+}
+
+bool ParallelFor(size_t begin, size_t end, size_t grain, const ParallelBody & body, const std::atomic<bool>* cancel, const ParallelProgress & progress, TaskPool & pool)
+{
+    if(begin >= end)
+        return !(cancel && *cancel);
+    auto total = end - begin;
+    if(!grain)
+        grain = (std::max)(size_t(1), total / ((pool.Workers() + 1) * 8));
+
+    TaskGroup group(pool);
+    group.SetCancel(cancel);
+    std::atomic<size_t> done(0);
+    std::function<void(size_t, size_t)> split = [&](size_t first, size_t last)
+    {
+        // keep the first half, the second half is left for stealing
+        while(last - first > grain && !group.Cancelled())
+        {
+            auto middle = first + (last - first) / 2;
+            group.Run([&split, middle, last] { split(middle, last); });
+            last = middle;
+        }
+        if(group.Cancelled())
+            return;
+        body(first, last);
+        done += last - first;
+    };
+    group.Run([&split, begin, end] { split(begin, end); });
+
+    size_t reported = size_t(-1);
+    return group.Wait(progress ? std::function<void()>([&]
+    {
+        auto current = size_t(done);
+        if(current != reported)
+            progress(reported = current, total);
+    }) : std::function<void()>());
+}
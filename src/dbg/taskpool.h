@@ -0,0 +1,102 @@
+#ifndef _TASKPOOL_H
+#define _TASKPOOL_H
+
+// Portable work stealing task runtime (standard library only)
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+
+class TaskGroup;
+
+/**
+\brief A fixed set of worker threads with a task queue each. Workers take their own newest task first and steal the
+       oldest task of another queue when they run out, so recursively split work (see ParallelFor) keeps the large
+       pieces available for stealing. Threads that wait on a TaskGroup run queued tasks meanwhile.
+*/
+class TaskPool
+{
+public:
+    explicit TaskPool(unsigned int workers = 0); // 0 for the hardware threads minus one
+    ~TaskPool();
+    TaskPool(const TaskPool &) = delete;
+    TaskPool & operator=(const TaskPool &) = delete;
+
+    static TaskPool & Global();
+    unsigned int Workers() const { return unsigned(mThreads.size()); }
+
+private:
+    friend class TaskGroup;
+
+    struct Task
+    {
+        std::function<void()> run;
+        TaskGroup* group;
+    };
+
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> mQueues; // one per worker, the last one is for other threads
+    std::vector<std::thread> mThreads;
+    std::vector<std::thread::id> mThreadIds; // worker index of the threads, filled before the workers start
+    std::mutex mWakeLock;
+    std::condition_variable mWake;
+    std::atomic<size_t> mQueued;
+    bool mStarted = false;
+    bool mStop = false;
+
+    int currentQueue() const;
+    void push(Task && task);
+    bool runOne();
+    void worker();
+};
+
+class TaskGroup
+{
+public:
+    explicit TaskGroup(TaskPool & pool = TaskPool::Global());
+    ~TaskGroup();
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup & operator=(const TaskGroup &) = delete;
+
+    void Run(std::function<void()> task);
+    // Runs queued tasks until the ones of this group are done, false if the group was cancelled
+    bool Wait(const std::function<void()> & idle = std::function<void()>());
+    // Tasks that did not start yet are skipped, running tasks can poll Cancelled
+    void Cancel() { mCancelled = true; }
+    bool Cancelled() const { return mCancelled || (mCancel && *mCancel); }
+    void SetCancel(const std::atomic<bool>* cancel) { mCancel = cancel; }
+
+private:
+    friend class TaskPool;
+
+    TaskPool & mPool;
+    std::atomic<size_t> mPending;
+    std::atomic<bool> mCancelled;
+    const std::atomic<bool>* mCancel = nullptr;
+    std::mutex mDoneLock;
+    std::condition_variable mDone;
+
+    void finished();
+};
+
+typedef std::function<void(size_t begin, size_t end)> ParallelBody;
+typedef std::function<void(size_t done, size_t total)> ParallelProgress;
+
+/**
+\brief Calls body on pieces of [begin, end) of at most grain items (0 picks a grain for the pool size). The range is
+       split in halves on demand, idle workers steal the largest remaining halves. Progress is reported on the calling
+       thread. Returns false if cancel was set before all pieces ran.
+*/
+bool ParallelFor(size_t begin, size_t end, size_t grain, const ParallelBody & body, const std::atomic<bool>* cancel = nullptr, const ParallelProgress & progress = ParallelProgress(), TaskPool & pool = TaskPool::Global());
+
+#endif // _TASKPOOL_H
@@ -9,6 +9,7 @@
 #include "threading.h"
 #include "ntdll/ntdll.h"
 #include "debugger.h"
+#include "threadsnapshot.h"
 
 static std::unordered_map<DWORD, THREADINFO> threadList;
 static std::unordered_map<DWORD, THREADWAITREASON> threadWaitReasons;
@@ -377,29 +378,181 @@ ULONG64 ThreadQueryCycleTime(HANDLE hThread)
     return CycleTime;
 }
 
-void ThreadUpdateWaitReasons()
+static bool querySystemThreads(std::vector<SYSTEM_THREAD_INFORMATION> & threads)
 {
+    if(!fdProcessInfo)
+        return false;
     ULONG size;
     if(NtQuerySystemInformation(SystemProcessInformation, NULL, 0, &size) != STATUS_INFO_LENGTH_MISMATCH)
-        return;
+        return false;
     Memory<PSYSTEM_PROCESS_INFORMATION> systemProcessInfo(2 * size, "_dbg_threadwaitreason");
     NTSTATUS status = NtQuerySystemInformation(SystemProcessInformation, systemProcessInfo(), (ULONG)systemProcessInfo.size(), NULL);
     if(!NT_SUCCESS(status))
-        return;
+        return false;
 
     PSYSTEM_PROCESS_INFORMATION process = systemProcessInfo();
-
-    EXCLUSIVE_ACQUIRE(LockThreads);
     while(true)
     {
-        for(ULONG thread = 0; thread < process->NumberOfThreads; ++thread)
+        if((DWORD)(ULONG_PTR)process->UniqueProcessId == fdProcessInfo->dwProcessId)
         {
-            auto tid = (DWORD)process->Threads[thread].ClientId.UniqueThread;
-            if(threadList.count(tid))
-                threadWaitReasons[tid] = (THREADWAITREASON)process->Threads[thread].WaitReason;
+            threads.assign(process->Threads, process->Threads + process->NumberOfThreads);
+            return true;
         }
         if(process->NextEntryOffset == 0) // Last entry
             break;
         process = (PSYSTEM_PROCESS_INFORMATION)((ULONG_PTR)process + process->NextEntryOffset);
     }
+    return false;
+}
+
+void ThreadUpdateWaitReasons()
+{
+    std::vector<SYSTEM_THREAD_INFORMATION> threads;
+    if(!querySystemThreads(threads))
+        return;
+
+    EXCLUSIVE_ACQUIRE(LockThreads);
+    for(const auto & thread : threads)
+    {
+        auto tid = (DWORD)thread.ClientId.UniqueThread;
+        if(threadList.count(tid))
+            threadWaitReasons[tid] = (THREADWAITREASON)thread.WaitReason;
+    }
+}
+
+static ThreadSnapshotThread toSnapshotThread(const THREADINFO & info)
+{
+    ThreadSnapshotThread thread;
+    thread.ThreadId = info.ThreadId;
+    thread.ThreadNumber = info.ThreadNumber;
+    thread.Handle = duint(info.Handle);
+    thread.StartAddress = info.ThreadStartAddress;
+    thread.LocalBase = info.ThreadLocalBase;
+    thread.Name = info.threadName;
+    return thread;
+}
+
+static FILETIME toFileTime(ULONG64 time)
+{
+    FILETIME result;
+    result.dwLowDateTime = DWORD(time);
+    result.dwHighDateTime = DWORD(time >> 32);
+    return result;
+}
+
+class DebuggeeThreadSource : public ThreadSnapshotSource
+{
+public:
+    bool QueryAll(std::unordered_map<uint32_t, ThreadSnapshotState> & states) override
+    {
+        std::vector<SYSTEM_THREAD_INFORMATION> threads;
+        if(!querySystemThreads(threads))
+            return false;
+        for(const auto & thread : threads)
+        {
+            auto & state = states[(DWORD)thread.ClientId.UniqueThread];
+            state.WaitReason = int(thread.WaitReason);
+            state.UserTime = thread.UserTime.QuadPart;
+            state.KernelTime = thread.KernelTime.QuadPart;
+            state.CreationTime = thread.CreateTime.QuadPart;
+        }
+        return true;
+    }
+
+    void QueryState(const ThreadSnapshotThread & thread, ThreadSnapshotState & state) override
+    {
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if(GetThreadTimes(HANDLE(duint(thread.Handle)), &creationTime, &exitTime, &kernelTime, &userTime))
+        {
+            state.UserTime = ULONG64(userTime.dwHighDateTime) << 32 | userTime.dwLowDateTime;
+            state.KernelTime = ULONG64(kernelTime.dwHighDateTime) << 32 | kernelTime.dwLowDateTime;
+            state.CreationTime = ULONG64(creationTime.dwHighDateTime) << 32 | creationTime.dwLowDateTime;
+        }
+        SHARED_ACQUIRE(LockThreads);
+        auto found = threadWaitReasons.find(thread.ThreadId);
+        if(found != threadWaitReasons.end())
+            state.WaitReason = found->second;
+    }
+
+    bool QueryDetails(const ThreadSnapshotThread & thread, ThreadSnapshotDetails & details) override
+    {
+        // The handle is closed when the thread exits
+        SHARED_ACQUIRE(LockThreads);
+        if(!threadList.count(thread.ThreadId))
+            return false;
+        auto handle = HANDLE(duint(thread.Handle));
+        details.Cip = GetContextDataEx(handle, UE_CIP);
+        details.SuspendCount = ThreadGetSuspendCount(handle);
+        details.Priority = ThreadGetPriority(handle);
+        details.LastError = ThreadGetLastErrorTEB(duint(thread.LocalBase));
+        details.Cycles = ThreadQueryCycleTime(handle);
+        return true;
+    }
+};
+
+static DebuggeeThreadSource threadSnapshotSource;
+static ThreadSnapshot threadSnapshot(threadSnapshotSource);
+
+static bool getSnapshotThread(DWORD threadId, THREADALLINFO & info, bool details)
+{
+    ThreadSnapshotThread thread;
+    ThreadSnapshotState state;
+    ThreadSnapshotDetails threadDetails;
+    if(!threadSnapshot.Get(threadId, thread, state, details ? &threadDetails : nullptr))
+        return false;
+    memset(&info, 0, sizeof(info));
+    info.BasicInfo.ThreadNumber = thread.ThreadNumber;
+    info.BasicInfo.Handle = HANDLE(duint(thread.Handle));
+    info.BasicInfo.ThreadId = thread.ThreadId;
+    info.BasicInfo.ThreadStartAddress = duint(thread.StartAddress);
+    info.BasicInfo.ThreadLocalBase = duint(thread.LocalBase);
+    strncpy_s(info.BasicInfo.threadName, thread.Name.c_str(), _TRUNCATE);
+    info.WaitReason = THREADWAITREASON(state.WaitReason);
+    info.UserTime = toFileTime(state.UserTime);
+    info.KernelTime = toFileTime(state.KernelTime);
+    info.CreationTime = toFileTime(state.CreationTime);
+    if(details)
+    {
+        info.ThreadCip = duint(threadDetails.Cip);
+        info.SuspendCount = threadDetails.SuspendCount;
+        info.Priority = THREADPRIORITY(threadDetails.Priority);
+        info.LastError = threadDetails.LastError;
+        info.Cycles = threadDetails.Cycles;
+    }
+    return true;
+}
+
+void ThreadSnapshotUpdate(std::vector<THREADALLINFO> & changed, std::vector<DWORD> & removed, DWORD & currentThreadId)
+{
+    std::vector<THREADINFO> threads;
+    ThreadGetList(threads);
+    currentThreadId = 0;
+    for(const auto & thread : threads)
+        if(thread.Handle == hActiveThread)
+            currentThreadId = thread.ThreadId;
+
+    std::vector<ThreadSnapshotThread> snapshotThreads;
+    snapshotThreads.reserve(threads.size());
+    for(const auto & thread : threads)
+        snapshotThreads.push_back(toSnapshotThread(thread));
+
+    EXCLUSIVE_ACQUIRE(LockThreadSnapshot);
+    std::vector<uint32_t> changedIds, removedIds;
+    threadSnapshot.Update(snapshotThreads, changedIds, removedIds);
+    changed.resize(changedIds.size());
+    for(size_t i = 0; i < changedIds.size(); i++)
+        getSnapshotThread(changedIds[i], changed[i], false);
+    removed.assign(removedIds.begin(), removedIds.end());
+}
+
+void ThreadSnapshotGetDetails(const DWORD* threadIds, size_t count, std::vector<THREADALLINFO> & threads)
+{
+    EXCLUSIVE_ACQUIRE(LockThreadSnapshot);
+    threads.reserve(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        THREADALLINFO info;
+        if(getSnapshotThread(threadIds[i], info, true))
+            threads.push_back(info);
+    }
 }
\ No newline at end of file
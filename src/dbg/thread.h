@@ -30,5 +30,7 @@ int ThreadResumeAll();
 ULONG_PTR ThreadGetLocalBase(DWORD ThreadId);
 ULONG64 ThreadQueryCycleTime(HANDLE hThread);
 void ThreadUpdateWaitReasons();
+void ThreadSnapshotUpdate(std::vector<THREADALLINFO> & changed, std::vector<DWORD> & removed, DWORD & currentThreadId);
+void ThreadSnapshotGetDetails(const DWORD* threadIds, size_t count, std::vector<THREADALLINFO> & threads);
 
 #endif // _THREAD_H
\ No newline at end of file
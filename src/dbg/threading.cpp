@@ -1,5 +1,6 @@
 #include <ntstatus.h>
 #include "threading.h"
+#include "eventreplay.h"
 
 static HANDLE waitArray[WAITID_LAST];
 
@@ -11,6 +12,12 @@ void waitclear()
 
 void wait(WAIT_ID id)
 {
+    // a replayed event has no process to resume
+    if(id == WAITID_RUN && EventReplayActive())
+    {
+        EventReplayPause();
+        return;
+    }
     WaitForSingleObject(waitArray[id], INFINITE);
 }
 
@@ -73,6 +73,14 @@ enum SectionLock
     LockModuleHashes,
     LockFormatFunctions,
     LockDllBreakpoints,
+    LockTraceState,
+    LockTraceWriteIndex,
+    LockTraceProfile,
+    LockUndecorateCache,
+    LockEventRecording,
+    LockBenchmark,
+    LockThreadSnapshot,
+    LockCodeFolds,
 
     // Number of elements in this enumeration. Must always be the last index.
     LockLast
@@ -0,0 +1,96 @@
+#include "threadsnapshot.h"
+
+static bool sameThread(const ThreadSnapshotThread & a, const ThreadSnapshotThread & b)
+{
+    return a.ThreadNumber == b.ThreadNumber &&
+           a.Handle == b.Handle &&
+           a.StartAddress == b.StartAddress &&
+           a.LocalBase == b.LocalBase &&
+           a.Name == b.Name;
+}
+
+static bool sameState(const ThreadSnapshotState & a, const ThreadSnapshotState & b)
+{
+    return a.WaitReason == b.WaitReason &&
+           a.UserTime == b.UserTime &&
+           a.KernelTime == b.KernelTime &&
+           a.CreationTime == b.CreationTime;
+}
+
+ThreadSnapshot::ThreadSnapshot(ThreadSnapshotSource & source)
+    : mSource(source)
+{
+}
+
+void ThreadSnapshot::Update(const std::vector<ThreadSnapshotThread> & threads, std::vector<uint32_t> & changed, std::vector<uint32_t> & removed)
+{
+    changed.clear();
+    removed.clear();
+    mGeneration++;
+
+    std::unordered_map<uint32_t, ThreadSnapshotState> states;
+    if(!threads.empty() && !mSource.QueryAll(states))
+        states.clear();
+
+    for(const auto & thread : threads)
+    {
+        ThreadSnapshotState state;
+        auto found = states.find(thread.ThreadId);
+        if(found != states.end())
+            state = found->second;
+        else
+            mSource.QueryState(thread, state);
+
+        auto inserted = mThreads.emplace(thread.ThreadId, Entry());
+        auto & entry = inserted.first->second;
+        if(inserted.second || !sameThread(entry.thread, thread) || !sameState(entry.state, state))
+        {
+            entry.thread = thread;
+            entry.state = state;
+            changed.push_back(thread.ThreadId);
+        }
+        entry.generation = mGeneration;
+    }
+
+    for(auto itr = mThreads.begin(); itr != mThreads.end();)
+    {
+        if(itr->second.generation != mGeneration)
+        {
+            removed.push_back(itr->first);
+            itr = mThreads.erase(itr);
+        }
+        else
+            ++itr;
+    }
+}
+
+bool ThreadSnapshot::Get(uint32_t threadId, ThreadSnapshotThread & thread, ThreadSnapshotState & state, ThreadSnapshotDetails* details)
+{
+    auto found = mThreads.find(threadId);
+    if(found == mThreads.end())
+        return false;
+    auto & entry = found->second;
+    thread = entry.thread;
+    state = entry.state;
+    if(details)
+    {
+        if(entry.detailsGeneration != mGeneration)
+        {
+            entry.details = ThreadSnapshotDetails();
+            mSource.QueryDetails(entry.thread, entry.details);
+            entry.detailsGeneration = mGeneration;
+        }
+        *details = entry.details;
+    }
+    return true;
+}
+
+size_t ThreadSnapshot::Count() const
+{
+    return mThreads.size();
+}
+
+unsigned int ThreadSnapshot::Generation() const
+{
+    return mGeneration;
+}
@@ -0,0 +1,83 @@
+#ifndef _THREADSNAPSHOT_H
+#define _THREADSNAPSHOT_H
+
+// Thread snapshot core, the debugger queries are behind ThreadSnapshotSource (no debugger or Windows dependencies)
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+// The basic thread information, a change of any field reports the thread as changed
+struct ThreadSnapshotThread
+{
+    uint32_t ThreadId = 0;
+    int ThreadNumber = 0;
+    uint64_t Handle = 0;
+    uint64_t StartAddress = 0;
+    uint64_t LocalBase = 0;
+    std::string Name;
+};
+
+// The thread state a single system-wide query provides
+struct ThreadSnapshotState
+{
+    int WaitReason = 0; // THREADWAITREASON
+    uint64_t UserTime = 0;
+    uint64_t KernelTime = 0;
+    uint64_t CreationTime = 0;
+};
+
+// The thread state that needs calls per thread
+struct ThreadSnapshotDetails
+{
+    uint64_t Cip = 0;
+    uint32_t SuspendCount = 0;
+    int Priority = 0; // THREADPRIORITY
+    uint32_t LastError = 0;
+    uint64_t Cycles = 0;
+};
+
+class ThreadSnapshotSource
+{
+public:
+    virtual ~ThreadSnapshotSource() { }
+    // State of all threads of the debuggee, false when the system-wide query is not available
+    virtual bool QueryAll(std::unordered_map<uint32_t, ThreadSnapshotState> & states) = 0;
+    // State of a single thread, for threads QueryAll did not return
+    virtual void QueryState(const ThreadSnapshotThread & thread, ThreadSnapshotState & state) = 0;
+    virtual bool QueryDetails(const ThreadSnapshotThread & thread, ThreadSnapshotDetails & details) = 0;
+};
+
+/**
+\brief Thread list snapshots that are cheap to take repeatedly. Update queries the state of all threads at once and
+       reports which threads were added, changed or removed since the previous snapshot. The per-thread details are
+       only queried when a thread is asked for with details, at most once per snapshot.
+*/
+class ThreadSnapshot
+{
+public:
+    explicit ThreadSnapshot(ThreadSnapshotSource & source);
+
+    void Update(const std::vector<ThreadSnapshotThread> & threads, std::vector<uint32_t> & changed, std::vector<uint32_t> & removed);
+    // details can be nullptr to skip the per-thread queries
+    bool Get(uint32_t threadId, ThreadSnapshotThread & thread, ThreadSnapshotState & state, ThreadSnapshotDetails* details);
+    size_t Count() const;
+    unsigned int Generation() const;
+
+private:
+    struct Entry
+    {
+        ThreadSnapshotThread thread;
+        ThreadSnapshotState state;
+        ThreadSnapshotDetails details;
+        unsigned int generation = 0; // snapshot that last saw the thread
+        unsigned int detailsGeneration = 0; // snapshot the details were queried for
+    };
+
+    ThreadSnapshotSource & mSource;
+    std::unordered_map<uint32_t, Entry> mThreads;
+    unsigned int mGeneration = 0;
+};
+
+#endif // _THREADSNAPSHOT_H
@@ -0,0 +1,566 @@
+#include "traceprofile.h"
+#include "module.h"
+#include "threading.h"
+#include "filemap.h"
+#include "zydis_wrapper.h"
+#include "jansson/jansson_x64dbg.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace
+{
+    struct Sample
+    {
+        duint cip;
+        DWORD threadId;
+    };
+
+    typedef std::vector<Sample> Chunk;
+
+    enum InstructionKind : unsigned char
+    {
+        KindOther,
+        KindCall,
+        KindRet
+    };
+
+    // Bounded queue between the decoder and the counting workers, keeps memory usage independent of the trace size
+    class ChunkQueue
+    {
+    public:
+        explicit ChunkQueue(size_t capacity)
+            : mCapacity(capacity)
+        {
+        }
+
+        void Push(Chunk && chunk)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mNotFull.wait(lock, [this] { return mChunks.size() < mCapacity; });
+            mChunks.push_back(std::move(chunk));
+            mNotEmpty.notify_one();
+        }
+
+        bool Pop(Chunk & chunk)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mNotEmpty.wait(lock, [this] { return !mChunks.empty() || mClosed; });
+            if(mChunks.empty())
+                return false;
+            chunk = std::move(mChunks.front());
+            mChunks.pop_front();
+            mNotFull.notify_one();
+            return true;
+        }
+
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mClosed = true;
+            mNotEmpty.notify_all();
+        }
+
+    private:
+        std::mutex mMutex;
+        std::condition_variable mNotEmpty;
+        std::condition_variable mNotFull;
+        std::deque<Chunk> mChunks;
+        size_t mCapacity;
+        bool mClosed = false;
+    };
+
+    struct WorkerCounts
+    {
+        std::unordered_map<duint, unsigned long long> addresses;
+        std::unordered_map<DWORD, unsigned long long> threads;
+    };
+
+    struct NodeKey
+    {
+        int parent;
+        duint entry;
+
+        bool operator==(const NodeKey & other) const
+        {
+            return parent == other.parent && entry == other.entry;
+        }
+    };
+
+    struct NodeKeyHash
+    {
+        size_t operator()(const NodeKey & key) const
+        {
+            return std::hash<duint>()(key.entry) ^ (size_t(key.parent) * 0x9E3779B97F4A7C15ull);
+        }
+    };
+
+    class CallTreeBuilder
+    {
+    public:
+        CallTreeBuilder(std::vector<TraceProfileNode> & nodes, size_t maxNodes, size_t maxDepth, bool & truncated)
+            : mNodes(nodes),
+              mMaxNodes(maxNodes),
+              mMaxDepth(maxDepth),
+              mTruncated(truncated)
+        {
+            mNodes.clear();
+            mNodes.push_back(TraceProfileNode { 0, -1, 0, 0, 0, 0 });
+        }
+
+        void Step(DWORD threadId, duint cip, InstructionKind kind, int size)
+        {
+            auto & thread = mThreads[threadId];
+            if(thread.stack.empty())
+            {
+                // The first instruction of a thread is its root frame
+                auto node = child(0, cip);
+                mNodes[node].calls++;
+                thread.stack.push_back(Frame { node, 0 });
+            }
+            else if(thread.pending == KindCall)
+            {
+                if(thread.stack.size() < mMaxDepth)
+                {
+                    auto node = child(thread.stack.back().node, cip);
+                    mNodes[node].calls++;
+                    thread.stack.push_back(Frame { node, thread.pendingReturn });
+                }
+                else
+                {
+                    thread.overflow++;
+                    mTruncated = true;
+                }
+            }
+            else if(thread.pending == KindRet)
+            {
+                if(thread.overflow)
+                    thread.overflow--;
+                else
+                {
+                    // Unwind to the frame we returned to, this also handles exceptions and longjmp
+                    auto depth = thread.stack.size() - 1;
+                    while(depth > 0 && thread.stack[depth].returnAddress != cip)
+                        depth--;
+                    if(depth > 0)
+                        thread.stack.resize(depth);
+                    else if(thread.stack.size() > 1)
+                        thread.stack.pop_back();
+                }
+            }
+            thread.pending = kind;
+            thread.pendingReturn = cip + size;
+            mNodes[thread.stack.back().node].exclusive++;
+        }
+
+    private:
+        struct Frame
+        {
+            int node;
+            duint returnAddress;
+        };
+
+        struct ThreadState
+        {
+            std::vector<Frame> stack;
+            InstructionKind pending = KindOther;
+            duint pendingReturn = 0;
+            size_t overflow = 0;
+        };
+
+        std::vector<TraceProfileNode> & mNodes;
+        size_t mMaxNodes;
+        size_t mMaxDepth;
+        bool & mTruncated;
+        std::unordered_map<NodeKey, int, NodeKeyHash> mChildren;
+        std::unordered_map<DWORD, ThreadState> mThreads;
+
+        int child(int parent, duint entry)
+        {
+            auto found = mChildren.find(NodeKey { parent, entry });
+            if(found != mChildren.end())
+                return found->second;
+            if(mNodes.size() >= mMaxNodes)
+            {
+                mTruncated = true;
+                return parent;
+            }
+            auto node = int(mNodes.size());
+            mNodes.push_back(TraceProfileNode { entry, parent, mNodes[parent].depth + 1, 0, 0, 0 });
+            mChildren.emplace(NodeKey { parent, entry }, node);
+            return node;
+        }
+    };
+}
+
+bool TraceProfile::Build(TraceDataSource & source, const std::atomic<bool>* cancel, const TraceStateIndex::ProgressCallback & progress, unsigned int workers)
+{
+    instructionCount = 0;
+    truncated = false;
+    addresses.clear();
+    threads.clear();
+    modules.clear();
+    functions.clear();
+    callTree.clear();
+
+    unsigned long long offset;
+    if(!TraceReadHeader(source, offset))
+        return false;
+
+    if(!workers)
+    {
+        auto concurrency = std::thread::hardware_concurrency();
+        workers = concurrency > 1 ? concurrency - 1 : 1;
+    }
+    ChunkQueue queue(workers * 2);
+    std::vector<WorkerCounts> counts(workers);
+    std::vector<std::thread> threadPool;
+    for(unsigned int i = 0; i < workers; i++)
+    {
+        threadPool.emplace_back([&queue](WorkerCounts & result)
+        {
+            Chunk chunk;
+            while(queue.Pop(chunk))
+            {
+                for(const auto & sample : chunk)
+                {
+                    result.addresses[sample.cip]++;
+                    result.threads[sample.threadId]++;
+                }
+            }
+        }, std::ref(counts[i]));
+    }
+
+    // Decode sequentially (register values are delta encoded), the call tree needs the execution order anyway
+    const auto cipPosition = offsetof(REGDUMP, regcontext.cip) / sizeof(duint);
+    duint regs[TRACE_REGWORD_COUNT];
+    memset(regs, 0, sizeof(regs));
+    DWORD threadId = 0;
+    std::unordered_map<duint, InstructionKind> kinds;
+    CallTreeBuilder callTreeBuilder(callTree, maxNodes, maxDepth, truncated);
+    Zydis zydis;
+    Chunk chunk;
+    chunk.reserve(65536);
+    auto size = source.Size();
+    int lastProgress = -1;
+    bool ok = true;
+    TraceBlock block;
+    while(offset < size)
+    {
+        if(!TraceReadBlock(source, offset, block))
+        {
+            ok = false;
+            break;
+        }
+        for(unsigned char i = 0; i < block.regCount; i++)
+            regs[block.regPosition[i]] = block.regValue[i];
+        if(block.hasThreadId)
+            threadId = block.threadId;
+        auto cip = regs[cipPosition];
+
+        auto found = kinds.find(cip);
+        if(found == kinds.end())
+        {
+            auto kind = KindOther;
+            if(zydis.Disassemble(cip, block.opcode, block.opcodeSize))
+                kind = zydis.IsCall() ? KindCall : zydis.IsRet() ? KindRet : KindOther;
+            found = kinds.emplace(cip, kind).first;
+        }
+        callTreeBuilder.Step(threadId, cip, found->second, block.opcodeSize);
+
+        chunk.push_back(Sample { cip, threadId });
+        if(chunk.size() == 65536)
+        {
+            queue.Push(std::move(chunk));
+            chunk = Chunk();
+            chunk.reserve(65536);
+            if(cancel && *cancel)
+            {
+                ok = false;
+                break;
+            }
+            auto percent = int(offset * 100 / size);
+            if(progress && percent != lastProgress)
+                progress(lastProgress = percent);
+        }
+        instructionCount++;
+    }
+    if(!chunk.empty())
+        queue.Push(std::move(chunk));
+    queue.Close();
+    for(auto & thread : threadPool)
+        thread.join();
+    if(!ok)
+        return false;
+
+    // Merge the worker results
+    std::unordered_map<duint, unsigned long long> addressCounts;
+    std::unordered_map<DWORD, unsigned long long> threadCounts;
+    for(const auto & result : counts)
+    {
+        for(const auto & it : result.addresses)
+            addressCounts[it.first] += it.second;
+        for(const auto & it : result.threads)
+            threadCounts[it.first] += it.second;
+    }
+    addresses.reserve(addressCounts.size());
+    for(const auto & it : addressCounts)
+        addresses.push_back(TraceProfileAddress { it.first, it.second });
+    std::sort(addresses.begin(), addresses.end(), [](const TraceProfileAddress & a, const TraceProfileAddress & b)
+    {
+        return a.count > b.count || (a.count == b.count && a.addr < b.addr);
+    });
+    for(const auto & it : threadCounts)
+        threads.push_back(TraceProfileThread { it.first, it.second });
+    std::sort(threads.begin(), threads.end(), [](const TraceProfileThread & a, const TraceProfileThread & b)
+    {
+        return a.count > b.count;
+    });
+
+    // Module share, addresses outside of a loaded module are grouped under base 0
+    {
+        std::map<duint, TraceProfileModule> moduleCounts;
+        SHARED_ACQUIRE(LockModules);
+        for(const auto & address : addresses)
+        {
+            auto info = ModInfoFromAddr(address.addr);
+            auto base = info ? info->base : 0;
+            auto & module = moduleCounts[base];
+            if(!module.count && info)
+                module.name = String(info->name) + info->extension;
+            module.base = base;
+            module.count += address.count;
+        }
+        for(auto & it : moduleCounts)
+            modules.push_back(std::move(it.second));
+        std::sort(modules.begin(), modules.end(), [](const TraceProfileModule & a, const TraceProfileModule & b)
+        {
+            return a.count > b.count;
+        });
+    }
+
+    // Children always have a higher index than their parent, so a reverse pass accumulates the inclusive counts
+    for(auto & node : callTree)
+        node.inclusive = node.exclusive;
+    for(auto i = callTree.size() - 1; i > 0; i--)
+        callTree[callTree[i].parent].inclusive += callTree[i].inclusive;
+
+    // Preorder walk to lay out the tree and to count recursive frames only once in the function inclusive time
+    std::vector<int> firstChild(callTree.size(), -1), nextSibling(callTree.size(), -1);
+    for(auto i = callTree.size() - 1; i > 0; i--)
+    {
+        nextSibling[i] = firstChild[callTree[i].parent];
+        firstChild[callTree[i].parent] = int(i);
+    }
+    std::vector<TraceProfileNode> preorder;
+    preorder.reserve(callTree.size());
+    std::unordered_map<duint, TraceProfileFunction> functionCounts;
+    std::unordered_map<duint, int> active;
+    std::vector<std::pair<int, int>> stack; // (node, parent in preorder)
+    stack.emplace_back(0, -1);
+    std::vector<int> path; // nodes currently on the walk path
+    while(!stack.empty())
+    {
+        auto node = stack.back().first;
+        auto parent = stack.back().second;
+        stack.pop_back();
+        while(!path.empty() && (parent < 0 || path.back() != parent))
+        {
+            active[preorder[path.back()].entry]--;
+            path.pop_back();
+        }
+        auto entry = callTree[node];
+        auto index = int(preorder.size());
+        entry.parent = parent;
+        preorder.push_back(entry);
+        if(node)
+        {
+            auto & function = functionCounts[entry.entry];
+            function.entry = entry.entry;
+            function.calls += entry.calls;
+            function.exclusive += entry.exclusive;
+            if(!active[entry.entry])
+                function.inclusive += entry.inclusive;
+            active[entry.entry]++;
+        }
+        path.push_back(index);
+        // Push in reverse so children keep their discovery order
+        std::vector<int> children;
+        for(auto c = firstChild[node]; c != -1; c = nextSibling[c])
+            children.push_back(c);
+        for(auto c = children.rbegin(); c != children.rend(); ++c)
+            stack.emplace_back(*c, index);
+    }
+    callTree = std::move(preorder);
+    for(auto & it : functionCounts)
+        functions.push_back(it.second);
+    std::sort(functions.begin(), functions.end(), [](const TraceProfileFunction & a, const TraceProfileFunction & b)
+    {
+        return a.exclusive > b.exclusive;
+    });
+
+    if(progress)
+        progress(100);
+    return true;
+}
+
+bool TraceProfile::Export(const char* fileName) const
+{
+    auto root = json_object();
+    json_object_set_new(root, "instructions", json_integer(instructionCount));
+    json_object_set_new(root, "truncated", json_boolean(truncated));
+    auto jsonThreads = json_array();
+    for(const auto & thread : threads)
+    {
+        auto jsonThread = json_object();
+        json_object_set_new(jsonThread, "id", json_integer(thread.id));
+        json_object_set_new(jsonThread, "count", json_integer(thread.count));
+        json_array_append_new(jsonThreads, jsonThread);
+    }
+    json_object_set_new(root, "threads", jsonThreads);
+    auto jsonModules = json_array();
+    for(const auto & module : modules)
+    {
+        auto jsonModule = json_object();
+        json_object_set_new(jsonModule, "base", json_hex(module.base));
+        json_object_set_new(jsonModule, "name", json_string(module.name.c_str()));
+        json_object_set_new(jsonModule, "count", json_integer(module.count));
+        json_array_append_new(jsonModules, jsonModule);
+    }
+    json_object_set_new(root, "modules", jsonModules);
+    auto jsonFunctions = json_array();
+    for(const auto & function : functions)
+    {
+        auto jsonFunction = json_object();
+        json_object_set_new(jsonFunction, "entry", json_hex(function.entry));
+        json_object_set_new(jsonFunction, "calls", json_integer(function.calls));
+        json_object_set_new(jsonFunction, "inclusive", json_integer(function.inclusive));
+        json_object_set_new(jsonFunction, "exclusive", json_integer(function.exclusive));
+        json_array_append_new(jsonFunctions, jsonFunction);
+    }
+    json_object_set_new(root, "functions", jsonFunctions);
+    auto jsonAddresses = json_array();
+    for(const auto & address : addresses)
+    {
+        auto jsonAddress = json_object();
+        json_object_set_new(jsonAddress, "address", json_hex(address.addr));
+        json_object_set_new(jsonAddress, "count", json_integer(address.count));
+        json_array_append_new(jsonAddresses, jsonAddress);
+    }
+    json_object_set_new(root, "addresses", jsonAddresses);
+    auto jsonCallTree = json_array();
+    for(const auto & node : callTree)
+    {
+        auto jsonNode = json_object();
+        json_object_set_new(jsonNode, "entry", json_hex(node.entry));
+        json_object_set_new(jsonNode, "parent", json_integer(node.parent));
+        json_object_set_new(jsonNode, "calls", json_integer(node.calls));
+        json_object_set_new(jsonNode, "inclusive", json_integer(node.inclusive));
+        json_object_set_new(jsonNode, "exclusive", json_integer(node.exclusive));
+        json_array_append_new(jsonCallTree, jsonNode);
+    }
+    json_object_set_new(root, "callTree", jsonCallTree);
+
+    auto dumpSuccess = false;
+    auto hFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        BufferedWriter bufWriter(hFile);
+        dumpSuccess = !json_dump_callback(root, [](const char* buffer, size_t size, void* data) -> int
+        {
+            return ((BufferedWriter*)data)->Write(buffer, size) ? 0 : -1;
+        }, &bufWriter, JSON_INDENT(1));
+    }
+    json_decref(root);
+    return dumpSuccess;
+}
+
+struct TraceProfileEntry
+{
+    String traceFile;
+    std::shared_ptr<TraceProfile> profile;
+    std::atomic<int> progress;
+    std::atomic<bool> cancel;
+
+    TraceProfileEntry(const char* traceFile)
+        : traceFile(traceFile),
+          progress(0),
+          cancel(false)
+    {
+    }
+};
+
+static std::shared_ptr<TraceProfileEntry> currentEntry;
+static HANDLE hBuildThread = nullptr;
+
+static DWORD WINAPI traceProfileThread(void* param)
+{
+    auto entry = *(std::shared_ptr<TraceProfileEntry>*)param;
+    delete (std::shared_ptr<TraceProfileEntry>*)param;
+    TraceFileSource source;
+    if(!source.Open(entry->traceFile.c_str()))
+    {
+        entry->progress = TraceProfileFailed;
+        return 0;
+    }
+    auto profile = std::make_shared<TraceProfile>();
+    GuiReferenceSetProgress(0);
+    auto ok = profile->Build(source, &entry->cancel, [&entry](int percent)
+    {
+        entry->progress = min(percent, TraceProfileReady - 1);
+        GuiReferenceSetProgress(percent);
+    });
+    GuiReferenceSetProgress(100);
+    if(!ok)
+    {
+        entry->progress = TraceProfileFailed;
+        return 0;
+    }
+    // Published by the progress store, the lock is not taken so the build thread can be waited for while holding it
+    entry->profile = profile;
+    entry->progress = TraceProfileReady;
+    return 0;
+}
+
+static void stopBuildThread()
+{
+    if(currentEntry)
+        currentEntry->cancel = true;
+    if(hBuildThread)
+    {
+        WaitForThreadTermination(hBuildThread);
+        hBuildThread = nullptr;
+    }
+}
+
+int TraceProfileRequest(const char* traceFile)
+{
+    EXCLUSIVE_ACQUIRE(LockTraceProfile);
+    if(currentEntry && currentEntry->traceFile == traceFile && currentEntry->progress != TraceProfileFailed)
+        return currentEntry->progress;
+    stopBuildThread();
+    currentEntry = std::make_shared<TraceProfileEntry>(traceFile);
+    hBuildThread = CreateThread(nullptr, 0, traceProfileThread, new std::shared_ptr<TraceProfileEntry>(currentEntry), 0, nullptr);
+    if(!hBuildThread)
+    {
+        currentEntry->progress = TraceProfileFailed;
+        return TraceProfileFailed;
+    }
+    return currentEntry->progress;
+}
+
+std::shared_ptr<TraceProfile> TraceProfileGet()
+{
+    SHARED_ACQUIRE(LockTraceProfile);
+    if(!currentEntry || currentEntry->progress != TraceProfileReady)
+        return nullptr;
+    return currentEntry->profile;
+}
+
+void TraceProfileClear()
+{
+    EXCLUSIVE_ACQUIRE(LockTraceProfile);
+    stopBuildThread();
+    currentEntry.reset();
+}
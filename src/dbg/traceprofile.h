@@ -0,0 +1,80 @@
+#ifndef _TRACEPROFILE_H
+#define _TRACEPROFILE_H
+
+#include "_global.h"
+#include "tracestate.h"
+
+struct TraceProfileAddress
+{
+    duint addr;
+    unsigned long long count;
+};
+
+struct TraceProfileThread
+{
+    DWORD id;
+    unsigned long long count;
+};
+
+struct TraceProfileModule
+{
+    duint base;
+    String name;
+    unsigned long long count;
+};
+
+struct TraceProfileFunction
+{
+    duint entry;
+    unsigned long long calls;
+    unsigned long long inclusive;
+    unsigned long long exclusive;
+};
+
+struct TraceProfileNode
+{
+    duint entry; // 0 for the root
+    int parent;
+    int depth;
+    unsigned long long calls;
+    unsigned long long inclusive;
+    unsigned long long exclusive;
+};
+
+/**
+\brief Aggregate statistics of a run trace. The trace is decoded once, sequentially (register deltas chain every block),
+       while per-address and per-thread counting of decoded chunks is spread over worker threads. The call tree is a
+       calling context tree: equal call paths share a node, so its size depends on the code and not on the trace length.
+*/
+class TraceProfile
+{
+public:
+    size_t maxNodes = 1 << 20;
+    size_t maxDepth = 1 << 14;
+
+    bool Build(TraceDataSource & source, const std::atomic<bool>* cancel = nullptr, const TraceStateIndex::ProgressCallback & progress = TraceStateIndex::ProgressCallback(), unsigned int workers = 0);
+    bool Export(const char* fileName) const;
+
+    unsigned long long instructionCount = 0;
+    bool truncated = false; // the call tree hit maxNodes or maxDepth
+    std::vector<TraceProfileAddress> addresses; // sorted by count, descending
+    std::vector<TraceProfileThread> threads;
+    std::vector<TraceProfileModule> modules;
+    std::vector<TraceProfileFunction> functions;
+    std::vector<TraceProfileNode> callTree; // preorder, node 0 is the root
+};
+
+enum TRACEPROFILESTATUS
+{
+    TraceProfileFailed = -1,
+    TraceProfileReady = 100 // values below are the build progress
+};
+
+// Starts (or polls) the background profile of a trace file, requesting another trace cancels the running build
+int TraceProfileRequest(const char* traceFile);
+// The finished profile of the most recently requested trace, nullptr while it is being built
+std::shared_ptr<TraceProfile> TraceProfileGet();
+// Cancels a running build and releases the profile
+void TraceProfileClear();
+
+#endif // _TRACEPROFILE_H
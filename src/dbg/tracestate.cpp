@@ -0,0 +1,520 @@
+#include "tracestate.h"
+#include "threading.h"
+#include "console.h"
+#include "jansson/jansson_x64dbg.h"
+#include <unordered_map>
+
+TraceBufferSource::TraceBufferSource(std::vector<unsigned char> data)
+    : mData(std::move(data))
+{
+}
+
+unsigned long long TraceBufferSource::Size() const
+{
+    return mData.size();
+}
+
+bool TraceBufferSource::ReadAt(unsigned long long offset, void* buffer, size_t size)
+{
+    if(offset > mData.size() || size > mData.size() - offset)
+        return false;
+    memcpy(buffer, mData.data() + offset, size);
+    return true;
+}
+
+TraceFileSource::TraceFileSource()
+    : mFile(INVALID_HANDLE_VALUE),
+      mSize(0),
+      mWindow(65536),
+      mWindowStart(0),
+      mWindowSize(0)
+{
+}
+
+TraceFileSource::~TraceFileSource()
+{
+    if(mFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mFile);
+}
+
+bool TraceFileSource::Open(const char* fileName)
+{
+    mFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(mFile == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(mFile, &size))
+        return false;
+    mSize = size.QuadPart;
+    return true;
+}
+
+unsigned long long TraceFileSource::Size() const
+{
+    return mSize;
+}
+
+bool TraceFileSource::ReadAt(unsigned long long offset, void* buffer, size_t size)
+{
+    if(offset > mSize || size > mSize - offset)
+        return false;
+    // Blocks are small and read mostly sequentially, serve them from a read-ahead window
+    if(size > mWindow.size())
+    {
+        LARGE_INTEGER pos;
+        pos.QuadPart = offset;
+        DWORD read = 0;
+        return SetFilePointerEx(mFile, pos, nullptr, FILE_BEGIN) && ReadFile(mFile, buffer, DWORD(size), &read, nullptr) && read == size;
+    }
+    if(offset < mWindowStart || offset + size > mWindowStart + mWindowSize)
+    {
+        LARGE_INTEGER pos;
+        pos.QuadPart = offset;
+        DWORD read = 0;
+        if(!SetFilePointerEx(mFile, pos, nullptr, FILE_BEGIN) || !ReadFile(mFile, mWindow.data(), DWORD(mWindow.size()), &read, nullptr))
+        {
+            mWindowSize = 0;
+            return false;
+        }
+        mWindowStart = offset;
+        mWindowSize = read;
+        if(read < size)
+            return false;
+    }
+    memcpy(buffer, mWindow.data() + (offset - mWindowStart), size);
+    return true;
+}
+
+bool TraceReadHeader(TraceDataSource & source, unsigned long long & dataOffset)
+{
+    DWORD header[2];
+    if(!source.ReadAt(0, header, sizeof(header)))
+        return false;
+    if(header[0] != MAKEFOURCC('T', 'R', 'A', 'C') || header[1] > 16384)
+        return false;
+    std::vector<char> jsonData(header[1]);
+    if(!source.ReadAt(sizeof(header), jsonData.data(), jsonData.size()))
+        return false;
+    auto root = json_loadb(jsonData.data(), jsonData.size(), 0, nullptr);
+    if(!root)
+        return false;
+    auto ver = json_integer_value(json_object_get(root, "ver"));
+    auto arch = json_string_value(json_object_get(root, "arch"));
+    auto valid = ver == 1 && arch && strcmp(arch, ArchValue("x86", "x64")) == 0;
+    json_decref(root);
+    dataOffset = sizeof(header) + header[1];
+    return valid;
+}
+
+bool TraceReadBlock(TraceDataSource & source, unsigned long long & offset, TraceBlock & block)
+{
+    // Largest possible block, see TraceRecordManager::TraceExecuteRecord
+    unsigned char buffer[4 + sizeof(DWORD) + 16 + TRACE_REGWORD_COUNT * (1 + sizeof(duint)) + TRACE_MAX_MEMORY_OPERANDS * (1 + 3 * sizeof(duint))];
+    auto available = source.Size() - offset;
+    if(offset >= source.Size() || available < 4)
+        return false;
+    auto readSize = size_t(min(available, (unsigned long long)sizeof(buffer)));
+    if(!source.ReadAt(offset, buffer, readSize))
+        return false;
+    auto ptr = buffer;
+    auto end = buffer + readSize;
+    auto take = [&](void* dest, size_t size)
+    {
+        if(size > size_t(end - ptr))
+            return false;
+        memcpy(dest, ptr, size);
+        ptr += size;
+        return true;
+    };
+
+    if(ptr[0] != 0) //block type
+        return false;
+    block.regCount = ptr[1];
+    block.memCount = ptr[2];
+    auto flags = ptr[3];
+    ptr += 4;
+    if(block.regCount > TRACE_REGWORD_COUNT || block.memCount > TRACE_MAX_MEMORY_OPERANDS)
+        return false;
+    block.hasThreadId = (flags & 0x80) != 0;
+    if(block.hasThreadId && !take(&block.threadId, sizeof(DWORD)))
+        return false;
+    block.opcodeSize = flags & 0x0F;
+    if(!block.opcodeSize || !take(block.opcode, block.opcodeSize))
+        return false;
+    unsigned char relative[TRACE_REGWORD_COUNT];
+    if(!take(relative, block.regCount) || !take(block.regValue, block.regCount * sizeof(duint)))
+        return false;
+    int lastPosition = -1;
+    for(unsigned char i = 0; i < block.regCount; i++)
+    {
+        lastPosition += relative[i] + 1;
+        if(lastPosition >= TRACE_REGWORD_COUNT)
+            return false;
+        block.regPosition[i] = (unsigned char)lastPosition;
+    }
+    if(!take(block.memFlags, block.memCount) || !take(block.memAddress, block.memCount * sizeof(duint)) || !take(block.memOld, block.memCount * sizeof(duint)))
+        return false;
+    for(unsigned char i = 0; i < block.memCount; i++)
+    {
+        if(block.memFlags[i] & 1) //memory is unchanged
+            block.memNew[i] = block.memOld[i];
+        else if(!take(&block.memNew[i], sizeof(duint)))
+            return false;
+    }
+    offset += ptr - buffer;
+    return true;
+}
+
+struct TraceStateIndex::MemoryBuilder
+{
+    std::unordered_map<duint, MemoryEvent> latest; // latest event of every word
+    std::vector<MemoryEvent> deltas; // events of the open segment in time order
+};
+
+TraceStateIndex::TraceStateIndex(unsigned int keyframeInterval, unsigned int checkpointDeltas)
+    : mKeyframeInterval(keyframeInterval ? keyframeInterval : 1),
+      mCheckpointDeltas(checkpointDeltas ? checkpointDeltas : 1),
+      mLength(0)
+{
+}
+
+bool TraceStateIndex::Build(std::unique_ptr<TraceDataSource> source, const std::atomic<bool>* cancel, const ProgressCallback & progress)
+{
+    mSource = std::move(source);
+    mLength = 0;
+    mKeyframes.clear();
+    mKeyframeRegs.clear();
+    mCheckpoints.clear();
+    mFirstMemory.clear();
+    MemoryBuilder builder;
+    addCheckpoint(builder, 0);
+
+    unsigned long long offset;
+    if(!mSource || !TraceReadHeader(*mSource, offset))
+        return false;
+
+    duint regs[TRACE_REGWORD_COUNT];
+    memset(regs, 0, sizeof(regs));
+    DWORD threadId = 0;
+    auto size = mSource->Size();
+    int lastProgress = -1;
+    TraceBlock block;
+    while(offset < size)
+    {
+        if(!TraceReadBlock(*mSource, offset, block))
+            return false;
+        for(unsigned char i = 0; i < block.regCount; i++)
+            regs[block.regPosition[i]] = block.regValue[i];
+        if(block.hasThreadId)
+            threadId = block.threadId;
+        addMemory(builder, mLength, block);
+        if(builder.deltas.size() >= max(size_t(mCheckpointDeltas), builder.latest.size()))
+        {
+            closeSegment(builder);
+            addCheckpoint(builder, mLength + 1);
+        }
+        if(mLength % mKeyframeInterval == 0)
+        {
+            Keyframe keyframe;
+            keyframe.index = mLength;
+            keyframe.nextOffset = offset;
+            keyframe.threadId = threadId;
+            mKeyframes.push_back(keyframe);
+            mKeyframeRegs.insert(mKeyframeRegs.end(), regs, regs + TRACE_REGWORD_COUNT);
+            if(cancel && *cancel)
+                return false;
+            if(progress)
+            {
+                auto percent = int(offset * 100 / size);
+                if(percent != lastProgress)
+                    progress(lastProgress = percent);
+            }
+        }
+        mLength++;
+    }
+    closeSegment(builder);
+    std::sort(mFirstMemory.begin(), mFirstMemory.end(), [](const MemoryEvent & a, const MemoryEvent & b)
+    {
+        return a.addr < b.addr;
+    });
+    if(progress)
+        progress(100);
+    return true;
+}
+
+TraceStateIndex::Index TraceStateIndex::Length() const
+{
+    return mLength;
+}
+
+bool TraceStateIndex::Registers(Index index, duint* regwords, DWORD* threadId)
+{
+    if(index >= mLength || mKeyframes.empty())
+        return false;
+    auto found = std::upper_bound(mKeyframes.begin(), mKeyframes.end(), index, [](Index value, const Keyframe & keyframe)
+    {
+        return value < keyframe.index;
+    }) - 1;
+    memcpy(regwords, mKeyframeRegs.data() + (found - mKeyframes.begin()) * TRACE_REGWORD_COUNT, TRACE_REGWORD_COUNT * sizeof(duint));
+    auto tid = found->threadId;
+    auto offset = found->nextOffset;
+    TraceBlock block;
+    for(auto i = found->index; i < index; i++)
+    {
+        if(!TraceReadBlock(*mSource, offset, block))
+            return false;
+        for(unsigned char j = 0; j < block.regCount; j++)
+            regwords[block.regPosition[j]] = block.regValue[j];
+        if(block.hasThreadId)
+            tid = block.threadId;
+    }
+    if(threadId)
+        *threadId = tid;
+    return true;
+}
+
+void TraceStateIndex::addMemory(MemoryBuilder & builder, Index index, const TraceBlock & block)
+{
+    for(unsigned char i = 0; i < block.memCount; i++)
+    {
+        auto addr = block.memAddress[i];
+        auto found = builder.latest.find(addr);
+        // The first access tells the value before the instruction, after that only changes are interesting
+        if(found == builder.latest.end())
+        {
+            MemoryEvent event = { addr, index, block.memOld[i] };
+            mFirstMemory.push_back(event);
+            builder.deltas.push_back(event);
+            found = builder.latest.emplace(addr, event).first;
+        }
+        else if(found->second.value != block.memOld[i] && found->second.time <= index)
+        {
+            MemoryEvent event = { addr, index, block.memOld[i] };
+            builder.deltas.push_back(event);
+            found->second = event;
+        }
+        if(block.memNew[i] != block.memOld[i])
+        {
+            MemoryEvent event = { addr, index + 1, block.memNew[i] };
+            builder.deltas.push_back(event);
+            found->second = event;
+        }
+    }
+}
+
+void TraceStateIndex::addCheckpoint(const MemoryBuilder & builder, Index time)
+{
+    mCheckpoints.emplace_back();
+    auto & checkpoint = mCheckpoints.back();
+    checkpoint.time = time;
+    checkpoint.state.reserve(builder.latest.size());
+    for(const auto & i : builder.latest)
+        checkpoint.state.push_back(i.second);
+    std::sort(checkpoint.state.begin(), checkpoint.state.end(), [](const MemoryEvent & a, const MemoryEvent & b)
+    {
+        return a.addr < b.addr;
+    });
+}
+
+void TraceStateIndex::closeSegment(MemoryBuilder & builder)
+{
+    // Stable, the events of a word stay in time order
+    std::stable_sort(builder.deltas.begin(), builder.deltas.end(), [](const MemoryEvent & a, const MemoryEvent & b)
+    {
+        return a.addr < b.addr;
+    });
+    mCheckpoints.back().deltas = builder.deltas;
+    builder.deltas.clear();
+}
+
+const TraceStateIndex::MemoryEvent* TraceStateIndex::latestEvent(const MemoryCheckpoint & checkpoint, Index index, duint word) const
+{
+    // Events of the segment come after the checkpoint state
+    const auto & deltas = checkpoint.deltas;
+    auto after = std::upper_bound(deltas.begin(), deltas.end(), std::make_pair(word, index), [](const std::pair<duint, Index> & value, const MemoryEvent & event)
+    {
+        return value.first < event.addr || (value.first == event.addr && value.second < event.time);
+    });
+    if(after != deltas.begin() && (after - 1)->addr == word)
+        return &*(after - 1);
+    const auto & state = checkpoint.state;
+    auto found = std::lower_bound(state.begin(), state.end(), word, [](const MemoryEvent & event, duint value)
+    {
+        return event.addr < value;
+    });
+    return found != state.end() && found->addr == word ? &*found : nullptr;
+}
+
+const TraceStateIndex::MemoryEvent* TraceStateIndex::firstEvent(duint word) const
+{
+    auto found = std::lower_bound(mFirstMemory.begin(), mFirstMemory.end(), word, [](const MemoryEvent & event, duint value)
+    {
+        return event.addr < value;
+    });
+    return found != mFirstMemory.end() && found->addr == word ? &*found : nullptr;
+}
+
+bool TraceStateIndex::readByte(const MemoryCheckpoint & checkpoint, Index index, duint addr, unsigned char & value) const
+{
+    const MemoryEvent* best = nullptr;
+    bool bestBefore = false;
+    for(duint word = addr - (sizeof(duint) - 1); word != addr + 1; word++)
+    {
+        auto before = latestEvent(checkpoint, index, word);
+        if(before)
+        {
+            // Latest observation at or before the requested time wins
+            if(!bestBefore || before->time > best->time)
+            {
+                best = before;
+                bestBefore = true;
+            }
+        }
+        else if(!bestBefore)
+        {
+            // Nothing observed yet, fall back to the earliest later observation
+            auto first = firstEvent(word);
+            if(first && (!best || first->time < best->time))
+                best = first;
+        }
+    }
+    if(!best)
+        return false;
+    value = ((const unsigned char*)&best->value)[addr - best->addr];
+    return true;
+}
+
+bool TraceStateIndex::ReadMemory(Index index, duint addr, unsigned char* dest, size_t size, bool* known) const
+{
+    if(mCheckpoints.empty())
+    {
+        if(known)
+            memset(known, 0, size);
+        return false;
+    }
+    auto checkpoint = std::upper_bound(mCheckpoints.begin(), mCheckpoints.end(), index, [](Index value, const MemoryCheckpoint & checkpoint)
+    {
+        return value < checkpoint.time;
+    }) - 1;
+    bool all = true;
+    for(size_t i = 0; i < size; i++)
+    {
+        auto valid = readByte(*checkpoint, index, addr + i, dest[i]);
+        if(!valid)
+            dest[i] = 0;
+        if(known)
+            known[i] = valid;
+        all &= valid;
+    }
+    return all;
+}
+
+size_t TraceStateIndex::TracedWordCount() const
+{
+    return mFirstMemory.size();
+}
+
+struct TraceStateEntry
+{
+    String traceFile;
+    std::unique_ptr<TraceStateIndex> index;
+    std::atomic<int> progress;
+    std::atomic<bool> cancel;
+
+    TraceStateEntry(const char* traceFile)
+        : traceFile(traceFile),
+          progress(0),
+          cancel(false)
+    {
+    }
+};
+
+static std::shared_ptr<TraceStateEntry> currentEntry;
+static HANDLE hBuildThread = nullptr;
+
+static DWORD WINAPI traceStateThread(void* param)
+{
+    auto entry = *(std::shared_ptr<TraceStateEntry>*)param;
+    delete (std::shared_ptr<TraceStateEntry>*)param;
+    std::unique_ptr<TraceFileSource> source(new TraceFileSource());
+    if(!source->Open(entry->traceFile.c_str()))
+    {
+        entry->progress = TraceStateFailed;
+        return 0;
+    }
+    std::unique_ptr<TraceStateIndex> index(new TraceStateIndex());
+    auto ok = index->Build(std::move(source), &entry->cancel, [&entry](int percent)
+    {
+        entry->progress = min(percent, TraceStateReady - 1);
+    });
+    if(!ok)
+    {
+        entry->progress = TraceStateFailed;
+        return 0;
+    }
+    // Published by the progress store, the lock is not taken so the build thread can be waited for while holding it
+    entry->index = std::move(index);
+    entry->progress = TraceStateReady;
+    return 0;
+}
+
+static void stopBuildThread()
+{
+    if(currentEntry)
+        currentEntry->cancel = true;
+    if(hBuildThread)
+    {
+        WaitForThreadTermination(hBuildThread);
+        hBuildThread = nullptr;
+    }
+}
+
+static TraceStateIndex* readyIndex()
+{
+    return currentEntry && currentEntry->progress == TraceStateReady ? currentEntry->index.get() : nullptr;
+}
+
+int TraceStateLoad(const char* fileName)
+{
+    EXCLUSIVE_ACQUIRE(LockTraceState);
+    if(currentEntry && currentEntry->traceFile == fileName && currentEntry->progress != TraceStateFailed)
+        return currentEntry->progress;
+    stopBuildThread();
+    currentEntry = std::make_shared<TraceStateEntry>(fileName);
+    hBuildThread = CreateThread(nullptr, 0, traceStateThread, new std::shared_ptr<TraceStateEntry>(currentEntry), 0, nullptr);
+    if(!hBuildThread)
+    {
+        currentEntry->progress = TraceStateFailed;
+        return TraceStateFailed;
+    }
+    return currentEntry->progress;
+}
+
+void TraceStateClear()
+{
+    EXCLUSIVE_ACQUIRE(LockTraceState);
+    stopBuildThread();
+    currentEntry.reset();
+}
+
+bool TraceStateRegisters(TraceStateIndex::Index index, duint* regwords, DWORD* threadId)
+{
+    // Registers() reads from the shared file window, so this needs exclusive access
+    EXCLUSIVE_ACQUIRE(LockTraceState);
+    auto traceState = readyIndex();
+    return traceState && traceState->Registers(index, regwords, threadId);
+}
+
+bool TraceStateReadMemory(TraceStateIndex::Index index, duint addr, unsigned char* dest, size_t size, bool* known)
+{
+    SHARED_ACQUIRE(LockTraceState);
+    auto traceState = readyIndex();
+    return traceState && traceState->ReadMemory(index, addr, dest, size, known);
+}
+
+TraceStateIndex::Index TraceStateLength()
+{
+    SHARED_ACQUIRE(LockTraceState);
+    auto traceState = readyIndex();
+    return traceState ? traceState->Length() : 0;
+}
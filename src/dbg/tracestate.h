@@ -0,0 +1,153 @@
+#ifndef _TRACESTATE_H
+#define _TRACESTATE_H
+
+#include "_global.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Number of pointer-sized register words recorded per instruction in a run trace (see TraceRecordManager::REGDUMPWORD)
+#define TRACE_REGWORD_COUNT ((FIELD_OFFSET(REGDUMP, lastError) + sizeof(DWORD)) / sizeof(duint))
+#define TRACE_MAX_MEMORY_OPERANDS 32
+
+/**
+\brief Random access to raw run trace data. Implemented for files and for in-memory buffers (synthetic traces).
+*/
+class TraceDataSource
+{
+public:
+    virtual ~TraceDataSource() {}
+    virtual unsigned long long Size() const = 0;
+    virtual bool ReadAt(unsigned long long offset, void* buffer, size_t size) = 0;
+};
+
+class TraceBufferSource : public TraceDataSource
+{
+public:
+    explicit TraceBufferSource(std::vector<unsigned char> data);
+    unsigned long long Size() const override;
+    bool ReadAt(unsigned long long offset, void* buffer, size_t size) override;
+
+private:
+    std::vector<unsigned char> mData;
+};
+
+class TraceFileSource : public TraceDataSource
+{
+public:
+    TraceFileSource();
+    ~TraceFileSource();
+    bool Open(const char* fileName);
+    unsigned long long Size() const override;
+    bool ReadAt(unsigned long long offset, void* buffer, size_t size) override;
+
+private:
+    HANDLE mFile;
+    unsigned long long mSize;
+    std::vector<unsigned char> mWindow;
+    unsigned long long mWindowStart;
+    size_t mWindowSize;
+};
+
+/**
+\brief A single decoded run trace block. The registers and memory describe the state of the instruction before it was executed,
+       memNew holds the memory contents after execution.
+*/
+struct TraceBlock
+{
+    DWORD threadId;
+    bool hasThreadId;
+    unsigned char opcodeSize;
+    unsigned char opcode[16];
+    unsigned char regCount;
+    unsigned char regPosition[TRACE_REGWORD_COUNT]; // absolute register word positions
+    duint regValue[TRACE_REGWORD_COUNT];
+    unsigned char memCount;
+    unsigned char memFlags[TRACE_MAX_MEMORY_OPERANDS];
+    duint memAddress[TRACE_MAX_MEMORY_OPERANDS];
+    duint memOld[TRACE_MAX_MEMORY_OPERANDS];
+    duint memNew[TRACE_MAX_MEMORY_OPERANDS];
+};
+
+bool TraceReadHeader(TraceDataSource & source, unsigned long long & dataOffset);
+bool TraceReadBlock(TraceDataSource & source, unsigned long long & offset, TraceBlock & block);
+
+/**
+\brief Reconstructs the register and memory state at any instruction index of a run trace.
+       Full register keyframes are kept every keyframeInterval instructions, so a register query costs
+       a binary search plus at most keyframeInterval block decodes. Memory is split in segments: a checkpoint
+       holds the latest value of every traced word at the start of the segment and the segment holds the
+       changes observed in it, both as flat arrays sorted by address. A segment is closed once it has at least
+       as many changes as the checkpoint has words (and at least checkpointDeltas), which keeps the checkpoints
+       smaller than the changes. A memory query is a binary search for the segment plus two in its arrays.
+*/
+class TraceStateIndex
+{
+public:
+    typedef unsigned long long Index;
+    typedef std::function<void(int)> ProgressCallback;
+
+    explicit TraceStateIndex(unsigned int keyframeInterval = 4096, unsigned int checkpointDeltas = 65536);
+
+    bool Build(std::unique_ptr<TraceDataSource> source, const std::atomic<bool>* cancel = nullptr, const ProgressCallback & progress = ProgressCallback());
+    Index Length() const;
+    bool Registers(Index index, duint* regwords, DWORD* threadId = nullptr);
+    bool ReadMemory(Index index, duint addr, unsigned char* dest, size_t size, bool* known = nullptr) const;
+    size_t TracedWordCount() const;
+
+private:
+    struct Keyframe
+    {
+        Index index;
+        unsigned long long nextOffset; // file offset of block index + 1
+        DWORD threadId;
+    };
+
+    struct MemoryEvent
+    {
+        duint addr; // traced word address
+        Index time; // the value is valid before instruction 'time' executes
+        duint value;
+    };
+
+    struct MemoryCheckpoint
+    {
+        Index time;
+        std::vector<MemoryEvent> state; // latest event of every word before 'time', sorted by address
+        std::vector<MemoryEvent> deltas; // events of the segment, sorted by address and time
+    };
+
+    struct MemoryBuilder;
+
+    unsigned int mKeyframeInterval;
+    unsigned int mCheckpointDeltas;
+    std::unique_ptr<TraceDataSource> mSource;
+    Index mLength;
+    std::vector<Keyframe> mKeyframes;
+    std::vector<duint> mKeyframeRegs; // mKeyframes.size() * TRACE_REGWORD_COUNT
+    std::vector<MemoryCheckpoint> mCheckpoints; // mCheckpoints[0].time is 0
+    std::vector<MemoryEvent> mFirstMemory; // first event of every word, sorted by address
+
+    void addMemory(MemoryBuilder & builder, Index index, const TraceBlock & block);
+    void addCheckpoint(const MemoryBuilder & builder, Index time);
+    void closeSegment(MemoryBuilder & builder);
+    const MemoryEvent* latestEvent(const MemoryCheckpoint & checkpoint, Index index, duint word) const;
+    const MemoryEvent* firstEvent(duint word) const;
+    bool readByte(const MemoryCheckpoint & checkpoint, Index index, duint addr, unsigned char & value) const;
+};
+
+enum TRACESTATESTATUS
+{
+    TraceStateFailed = -1,
+    TraceStateReady = 100 // values below are the build progress
+};
+
+// Starts (or polls) the background build of the state index of a run trace, loading another trace cancels the running build
+int TraceStateLoad(const char* fileName);
+// Cancels a running build and releases the index
+void TraceStateClear();
+bool TraceStateRegisters(TraceStateIndex::Index index, duint* regwords, DWORD* threadId = nullptr);
+bool TraceStateReadMemory(TraceStateIndex::Index index, duint addr, unsigned char* dest, size_t size, bool* known = nullptr);
+TraceStateIndex::Index TraceStateLength();
+
+#endif // _TRACESTATE_H
@@ -0,0 +1,296 @@
+#include "tracewriteindex.h"
+#include "threading.h"
+#include "console.h"
+#include "filemap.h"
+
+#define TRACE_WRITE_INDEX_MAGIC MAKEFOURCC('T', 'W', 'I', 'X')
+#define TRACE_WRITE_INDEX_VERSION 2
+
+struct TraceWriteIndexHeader
+{
+    DWORD magic;
+    DWORD version;
+    unsigned long long traceSize;
+    unsigned long long wordCount;
+    unsigned long long writeCount;
+};
+
+bool TraceWriteIndex::Build(TraceDataSource & source, const std::atomic<bool>* cancel, const TraceStateIndex::ProgressCallback & progress)
+{
+    mAddresses.clear();
+    mOffsets.clear();
+    mWriters.clear();
+    mMasks.clear();
+
+    unsigned long long offset;
+    if(!TraceReadHeader(source, offset))
+        return false;
+
+    std::unordered_map<duint, std::vector<std::pair<Index, unsigned char>>> writes;
+    auto size = source.Size();
+    int lastProgress = -1;
+    TraceBlock block;
+    for(Index index = 0; offset < size; index++)
+    {
+        if(!TraceReadBlock(source, offset, block))
+            return false;
+        for(unsigned char i = 0; i < block.memCount; i++)
+        {
+            auto changed = block.memOld[i] ^ block.memNew[i];
+            if(!changed)
+                continue;
+            unsigned char mask = 0;
+            for(size_t j = 0; j < sizeof(duint); j++)
+                if((changed >> (j * 8)) & 0xFF)
+                    mask |= 1 << j;
+            auto & writers = writes[block.memAddress[i]];
+            if(writers.empty() || writers.back().first != index)
+                writers.push_back(std::make_pair(index, mask));
+            else
+                writers.back().second |= mask;
+        }
+        if((index & 0xFFFF) == 0)
+        {
+            if(cancel && *cancel)
+                return false;
+            auto percent = int(offset * 100 / size);
+            if(progress && percent != lastProgress)
+                progress(lastProgress = percent);
+        }
+    }
+
+    // Flatten into sorted arrays, the hash map is only needed during the scan
+    mAddresses.reserve(writes.size());
+    for(const auto & it : writes)
+        mAddresses.push_back(it.first);
+    std::sort(mAddresses.begin(), mAddresses.end());
+    mOffsets.reserve(mAddresses.size() + 1);
+    for(auto addr : mAddresses)
+    {
+        mOffsets.push_back(mWriters.size());
+        for(const auto & write : writes[addr])
+        {
+            mWriters.push_back(write.first);
+            mMasks.push_back(write.second);
+        }
+    }
+    mOffsets.push_back(mWriters.size());
+    if(progress)
+        progress(100);
+    return true;
+}
+
+bool TraceWriteIndex::Save(const char* fileName, unsigned long long traceSize) const
+{
+    auto hFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return false;
+    TraceWriteIndexHeader header;
+    header.magic = TRACE_WRITE_INDEX_MAGIC;
+    header.version = TRACE_WRITE_INDEX_VERSION;
+    header.traceSize = traceSize;
+    header.wordCount = mAddresses.size();
+    header.writeCount = mWriters.size();
+    BufferedWriter writer(hFile);
+    return writer.Write(&header, sizeof(header)) &&
+           writer.Write(mAddresses.data(), mAddresses.size() * sizeof(duint)) &&
+           writer.Write(mOffsets.data(), mOffsets.size() * sizeof(unsigned long long)) &&
+           writer.Write(mWriters.data(), mWriters.size() * sizeof(Index)) &&
+           writer.Write(mMasks.data(), mMasks.size());
+}
+
+bool TraceWriteIndex::Load(const char* fileName, unsigned long long traceSize)
+{
+    TraceFileSource source;
+    if(!source.Open(fileName))
+        return false;
+    TraceWriteIndexHeader header;
+    if(!source.ReadAt(0, &header, sizeof(header)))
+        return false;
+    // A different trace size means the trace was appended to since the index was saved
+    if(header.magic != TRACE_WRITE_INDEX_MAGIC || header.version != TRACE_WRITE_INDEX_VERSION || header.traceSize != traceSize)
+        return false;
+    auto expected = sizeof(header) + header.wordCount * sizeof(duint) + (header.wordCount + 1) * sizeof(unsigned long long) + header.writeCount * (sizeof(Index) + 1);
+    if(source.Size() != expected)
+        return false;
+    mAddresses.resize(size_t(header.wordCount));
+    mOffsets.resize(size_t(header.wordCount + 1));
+    mWriters.resize(size_t(header.writeCount));
+    mMasks.resize(size_t(header.writeCount));
+    unsigned long long offset = sizeof(header);
+    auto ok = source.ReadAt(offset, mAddresses.data(), mAddresses.size() * sizeof(duint));
+    offset += mAddresses.size() * sizeof(duint);
+    ok = ok && source.ReadAt(offset, mOffsets.data(), mOffsets.size() * sizeof(unsigned long long));
+    offset += mOffsets.size() * sizeof(unsigned long long);
+    ok = ok && source.ReadAt(offset, mWriters.data(), mWriters.size() * sizeof(Index));
+    offset += mWriters.size() * sizeof(Index);
+    ok = ok && source.ReadAt(offset, mMasks.data(), mMasks.size());
+    if(!ok || mOffsets.back() != mWriters.size())
+    {
+        mAddresses.clear();
+        mOffsets.clear();
+        mWriters.clear();
+        mMasks.clear();
+        return false;
+    }
+    return true;
+}
+
+bool TraceWriteIndex::LastWrite(Index before, duint addr, duint size, Index & writer) const
+{
+    if(!size)
+        return false;
+    // All words that overlap [addr, addr + size)
+    auto first = addr > sizeof(duint) - 1 ? addr - (sizeof(duint) - 1) : 0;
+    auto last = addr + size - 1;
+    auto begin = std::lower_bound(mAddresses.begin(), mAddresses.end(), first);
+    auto found = false;
+    for(auto it = begin; it != mAddresses.end() && *it <= last; ++it)
+    {
+        // Bytes of this word inside the queried range
+        auto word = *it;
+        auto low = addr > word ? addr - word : 0;
+        auto high = (std::min)(last - word, duint(sizeof(duint) - 1));
+        if(low > high)
+            continue;
+        auto queried = ((2u << high) - 1) & ~((1u << low) - 1);
+
+        auto i = it - mAddresses.begin();
+        auto writersBegin = mWriters.begin() + size_t(mOffsets[i]);
+        auto writersEnd = mWriters.begin() + size_t(mOffsets[i + 1]);
+        auto next = std::lower_bound(writersBegin, writersEnd, before);
+        // The newest writer that changed one of the queried bytes, older ones cannot beat the current best
+        while(next != writersBegin && (!found || *(next - 1) > writer))
+        {
+            --next;
+            if(mMasks[next - mWriters.begin()] & queried)
+            {
+                writer = *next;
+                found = true;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+size_t TraceWriteIndex::WordCount() const
+{
+    return mAddresses.size();
+}
+
+size_t TraceWriteIndex::WriteCount() const
+{
+    return mWriters.size();
+}
+
+struct TraceWriteIndexEntry
+{
+    String traceFile;
+    unsigned long long traceSize = 0;
+    std::shared_ptr<TraceWriteIndex> index;
+    std::atomic<int> progress;
+    std::atomic<bool> cancel;
+
+    TraceWriteIndexEntry(const char* traceFile)
+        : traceFile(traceFile),
+          progress(0),
+          cancel(false)
+    {
+    }
+};
+
+static std::shared_ptr<TraceWriteIndexEntry> currentEntry;
+static HANDLE hBuildThread = nullptr;
+
+static unsigned long long getTraceFileSize(const char* traceFile)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if(!GetFileAttributesExW(StringUtils::Utf8ToUtf16(traceFile).c_str(), GetFileExInfoStandard, &data))
+        return 0;
+    return ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+}
+
+static DWORD WINAPI traceWriteIndexThread(void* param)
+{
+    auto entry = *(std::shared_ptr<TraceWriteIndexEntry>*)param;
+    delete (std::shared_ptr<TraceWriteIndexEntry>*)param;
+    auto indexFile = entry->traceFile + ".widx";
+    TraceFileSource source;
+    if(!source.Open(entry->traceFile.c_str()))
+    {
+        entry->progress = TraceWriteIndexFailed;
+        return 0;
+    }
+    auto index = std::make_shared<TraceWriteIndex>();
+    if(!index->Load(indexFile.c_str(), source.Size()))
+    {
+        auto ok = index->Build(source, &entry->cancel, [&entry](int percent)
+        {
+            entry->progress = min(percent, TraceWriteIndexReady - 1);
+        });
+        if(!ok)
+        {
+            entry->progress = TraceWriteIndexFailed;
+            return 0;
+        }
+        if(!index->Save(indexFile.c_str(), source.Size()))
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to save trace write index \"%s\"\n"), indexFile.c_str());
+    }
+    // Published by the progress store, the lock is not taken so the build thread can be waited for while holding it
+    entry->traceSize = source.Size();
+    entry->index = index;
+    entry->progress = TraceWriteIndexReady;
+    return 0;
+}
+
+static void stopBuildThread()
+{
+    if(currentEntry)
+        currentEntry->cancel = true;
+    if(hBuildThread)
+    {
+        WaitForThreadTermination(hBuildThread);
+        hBuildThread = nullptr;
+    }
+}
+
+int TraceWriteIndexRequest(const char* traceFile)
+{
+    EXCLUSIVE_ACQUIRE(LockTraceWriteIndex);
+    if(currentEntry && currentEntry->traceFile == traceFile)
+    {
+        // Rebuild when the previous build failed or the trace was appended to (run trace still recording)
+        int progress = currentEntry->progress;
+        if(progress != TraceWriteIndexFailed && (progress != TraceWriteIndexReady || currentEntry->traceSize == getTraceFileSize(traceFile)))
+            return progress;
+    }
+    stopBuildThread();
+    currentEntry = std::make_shared<TraceWriteIndexEntry>(traceFile);
+    hBuildThread = CreateThread(nullptr, 0, traceWriteIndexThread, new std::shared_ptr<TraceWriteIndexEntry>(currentEntry), 0, nullptr);
+    if(!hBuildThread)
+    {
+        currentEntry->progress = TraceWriteIndexFailed;
+        return TraceWriteIndexFailed;
+    }
+    return currentEntry->progress;
+}
+
+bool TraceWriteIndexLastWrite(const char* traceFile, TraceWriteIndex::Index before, duint addr, duint size, TraceWriteIndex::Index* writer)
+{
+    std::shared_ptr<TraceWriteIndex> index;
+    {
+        SHARED_ACQUIRE(LockTraceWriteIndex);
+        if(!currentEntry || (traceFile && currentEntry->traceFile != traceFile) || currentEntry->progress != TraceWriteIndexReady)
+            return false;
+        index = currentEntry->index;
+    }
+    return index->LastWrite(before, addr, size, *writer);
+}
+
+void TraceWriteIndexClear()
+{
+    EXCLUSIVE_ACQUIRE(LockTraceWriteIndex);
+    stopBuildThread();
+    currentEntry.reset();
+}
@@ -0,0 +1,45 @@
+#ifndef _TRACEWRITEINDEX_H
+#define _TRACEWRITEINDEX_H
+
+#include "_global.h"
+#include "tracestate.h"
+
+/**
+\brief Memory write provenance of a run trace: for every traced word the sorted list of instruction indices that changed it,
+       each with a mask of the bytes it changed. Word addresses are kept sorted in a flat array, so the words overlapping
+       a queried range are a contiguous slice and the last writer before an index is found with a binary search and a
+       backwards scan for a writer whose mask intersects the queried bytes.
+*/
+class TraceWriteIndex
+{
+public:
+    typedef unsigned long long Index;
+
+    bool Build(TraceDataSource & source, const std::atomic<bool>* cancel = nullptr, const TraceStateIndex::ProgressCallback & progress = TraceStateIndex::ProgressCallback());
+    bool Save(const char* fileName, unsigned long long traceSize) const;
+    bool Load(const char* fileName, unsigned long long traceSize);
+    bool LastWrite(Index before, duint addr, duint size, Index & writer) const;
+    size_t WordCount() const;
+    size_t WriteCount() const;
+
+private:
+    std::vector<duint> mAddresses; // sorted word addresses
+    std::vector<unsigned long long> mOffsets; // writers of mAddresses[i] are mWriters[mOffsets[i]..mOffsets[i + 1]]
+    std::vector<Index> mWriters;
+    std::vector<unsigned char> mMasks; // bit i is set if mWriters[j] changed byte i of the word
+};
+
+enum TRACEWRITEINDEXSTATUS
+{
+    TraceWriteIndexFailed = -1,
+    TraceWriteIndexReady = 100 // values below are the build progress
+};
+
+// Starts (or polls) the background build of the write index of a trace file, the index is persisted as <traceFile>.widx
+int TraceWriteIndexRequest(const char* traceFile);
+// traceFile can be nullptr to query the most recently requested trace
+bool TraceWriteIndexLastWrite(const char* traceFile, TraceWriteIndex::Index before, duint addr, duint size, TraceWriteIndex::Index* writer);
+// Cancels a running build and releases the index, called when debugging stops
+void TraceWriteIndexClear();
+
+#endif // _TRACEWRITEINDEX_H
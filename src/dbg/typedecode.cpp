@@ -0,0 +1,171 @@
+#include "typedecode.h"
+#include <cstring>
+#include <cstdio>
+
+using namespace Types;
+
+bool TypeDecoder::Compile(const TypeManager::Layout & layout)
+{
+    mFields.clear();
+    mBlocks.clear();
+    mStride = layout.size;
+    mTruncated = false;
+    if(mStride <= 0)
+        return false;
+    mBlocks.push_back({ -1, mStride });
+    flatten(layout, "", 0, 0, 0);
+    return !mFields.empty();
+}
+
+void TypeDecoder::flatten(const TypeManager::Layout & layout, const std::string & name, int block, int offset, int depth)
+{
+    if(mFields.size() >= maxFields)
+    {
+        mTruncated = true;
+        return;
+    }
+    if(layout.type)
+    {
+        const auto & t = *layout.type;
+        if(t.size <= 0 || t.size > int(sizeof(uint64_t)))
+            return;
+        auto field = int(mFields.size());
+        mFields.push_back({ name, t.primitive, offset, t.size, block });
+        if(t.pointto.empty() || !layout.pointee || layout.pointee->size <= 0)
+            return;
+        if(depth >= maxPointerDepth)
+            return;
+        auto pointee = int(mBlocks.size());
+        mBlocks.push_back({ field, layout.pointee->size });
+        flatten(*layout.pointee, layout.pointee->structUnion ? name + "->" : "*" + name, pointee, 0, depth + 1);
+        return;
+    }
+    auto separator = name.empty() || name.back() == '>' ? "" : ".";
+    for(const auto & child : layout.members)
+    {
+        if(!child.layout)
+            continue;
+        auto childName = name + separator + child.member->name;
+        if(child.member->arrsize)
+        {
+            auto count = child.member->arrsize;
+            if(count > maxArrayElements)
+            {
+                count = maxArrayElements;
+                mTruncated = true;
+            }
+            auto elementSize = child.layout->size;
+            for(auto i = 0; i < count; i++)
+                flatten(*child.layout, childName + "[" + std::to_string(i) + "]", block, offset + child.offset + i * elementSize, depth);
+        }
+        else
+            flatten(*child.layout, childName, block, offset + child.offset, depth);
+    }
+}
+
+size_t TypeDecoder::Decode(const unsigned char* data, size_t size, uint64_t address, size_t count, TypeDecodeTable & table, const ReadCallback & read) const
+{
+    table.address = address;
+    table.rows = 0;
+    table.columns.clear();
+    if(mStride <= 0)
+        return 0;
+    if(count > size / mStride)
+        count = size / mStride;
+    table.rows = count;
+    table.columns.resize(mFields.size());
+    for(auto & column : table.columns)
+    {
+        column.values.resize(count);
+        column.valid.resize(count);
+    }
+
+    // the pointee blocks of a row, blocks are created after the field that points to them
+    std::vector<std::vector<unsigned char>> blockData(mBlocks.size());
+    std::vector<unsigned char> blockValid(mBlocks.size());
+    for(size_t b = 1; b < mBlocks.size(); b++)
+        blockData[b].resize(mBlocks[b].size);
+
+    for(size_t row = 0; row < count; row++)
+    {
+        auto instance = data + row * mStride;
+        blockValid[0] = true;
+        for(size_t b = 1; b < mBlocks.size(); b++)
+            blockValid[b] = false;
+        size_t nextBlock = 1;
+        for(size_t f = 0; f < mFields.size(); f++)
+        {
+            const auto & field = mFields[f];
+            auto & column = table.columns[f];
+            uint64_t value = 0;
+            auto valid = blockValid[field.block] != 0;
+            if(valid)
+            {
+                auto source = field.block ? blockData[field.block].data() : instance;
+                memcpy(&value, source + field.offset, field.size);
+            }
+            column.values[row] = value;
+            column.valid[row] = valid;
+
+            // read the blocks this field points to, before their fields
+            while(nextBlock < mBlocks.size() && mBlocks[nextBlock].pointer == int(f))
+            {
+                auto & pointee = blockData[nextBlock];
+                blockValid[nextBlock] = valid && value && read && read(value, pointee.data(), pointee.size());
+                nextBlock++;
+            }
+        }
+    }
+    return count;
+}
+
+template<typename T>
+static std::string formatValue(const char* format, uint64_t value)
+{
+    T x;
+    memcpy(&x, &value, sizeof(x));
+    char text[64];
+#ifdef _MSC_VER
+    sprintf_s(text, format, x); // VS2013 has no snprintf
+#else
+    snprintf(text, sizeof(text), format, x);
+#endif // _MSC_VER
+    return text;
+}
+
+std::string TypeDecoder::Format(const TypeDecodeField & field, uint64_t value)
+{
+    switch(field.primitive)
+    {
+    case Int8:
+        return formatValue<signed char>("%d", value);
+    case Uint8:
+        return formatValue<unsigned char>("%u", value);
+    case Int16:
+        return formatValue<short>("%d", value);
+    case Uint16:
+        return formatValue<unsigned short>("%u", value);
+    case Int32:
+        return formatValue<int>("%d", value);
+    case Uint32:
+        return formatValue<unsigned int>("%u", value);
+    case Int64:
+        return formatValue<long long>("%lld", value);
+    case Uint64:
+        return formatValue<unsigned long long>("%llu", value);
+    case Dsint:
+        return field.size == 4 ? formatValue<int>("%d", value) : formatValue<long long>("%lld", value);
+    case Duint:
+        return field.size == 4 ? formatValue<unsigned int>("%u", value) : formatValue<unsigned long long>("%llu", value);
+    case Float:
+        return formatValue<float>("%f", value);
+    case Double:
+        return formatValue<double>("%f", value);
+    case Pointer:
+    case PtrString:
+    case PtrWString:
+        return field.size == 4 ? formatValue<unsigned int>("0x%08X", value) : formatValue<unsigned long long>("0x%016llX", value);
+    default:
+        return std::string();
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef _TYPEDECODE_H
+#define _TYPEDECODE_H
+
+// Decodes arrays of a type into a table, it works on caller supplied buffers (no debugger or Windows dependencies)
+
+#include "types.h"
+#include <functional>
+#include <cstdint>
+
+struct TypeDecodeField
+{
+    std::string name; // path of the member, like "a.b[1]" or "p->x"
+    Types::Primitive primitive;
+    int offset; // in the block
+    int size;
+    int block; // index in TypeDecoder::Blocks
+};
+
+// Memory a field is read from: block 0 is the instance, the others are read through a pointer field
+struct TypeDecodeBlock
+{
+    int pointer; // field holding the address, -1 for the instance
+    int size;
+};
+
+struct TypeDecodeColumn
+{
+    std::vector<uint64_t> values; // raw little endian value, zero extended
+    std::vector<unsigned char> valid; // false when the pointer was null or unreadable
+};
+
+struct TypeDecodeTable
+{
+    uint64_t address = 0;
+    size_t rows = 0;
+    std::vector<TypeDecodeColumn> columns; // one per field
+};
+
+class TypeDecoder
+{
+public:
+    typedef std::function<bool(uint64_t addr, void* data, size_t size)> ReadCallback;
+
+    int maxPointerDepth = 1;
+    int maxArrayElements = 64;
+    size_t maxFields = 4096;
+
+    bool Compile(const Types::TypeManager::Layout & layout);
+    // Decodes count instances from data (read from address), fields behind pointers are read with read (optional)
+    size_t Decode(const unsigned char* data, size_t size, uint64_t address, size_t count, TypeDecodeTable & table, const ReadCallback & read = ReadCallback()) const;
+    static std::string Format(const TypeDecodeField & field, uint64_t value);
+
+    const std::vector<TypeDecodeField> & Fields() const { return mFields; }
+    const std::vector<TypeDecodeBlock> & Blocks() const { return mBlocks; }
+    int Stride() const { return mStride; }
+    bool Truncated() const { return mTruncated; } // maxFields or maxArrayElements dropped fields
+
+private:
+    std::vector<TypeDecodeField> mFields;
+    std::vector<TypeDecodeBlock> mBlocks;
+    int mStride = 0;
+    bool mTruncated = false;
+
+    void flatten(const Types::TypeManager::Layout & layout, const std::string & name, int block, int offset, int depth);
+};
+
+#endif // _TYPEDECODE_H
@@ -1,4 +1,6 @@
 #include "types.h"
+#include "typedecode.h"
+#include "typesimport.h"
 #include "stringutils.h"
 #include "threading.h"
 #include "filehelper.h"
@@ -77,6 +79,8 @@ bool TypeManager::AddMember(const std::string & parent, const std::string & type
         if(member.name == name)
             return false;
 
+    layouts.clear();
+
     auto typeSize = Sizeof(type);
     if(arrsize)
         typeSize *= arrsize;
@@ -185,9 +189,27 @@ bool TypeManager::Visit(const std::string & type, const std::string & name, Visi
     Member m;
     m.name = name;
     m.type = type;
+    auto found = layouts.find(type);
+    if(found != layouts.end())
+        return visitLayout(m, *found->second, visitor);
     return visitMember(m, visitor);
 }
 
+bool TypeManager::HasLayout(const std::string & type) const
+{
+    return layouts.find(type) != layouts.end();
+}
+
+void TypeManager::CompileLayout(const std::string & type)
+{
+    compileLayout(type);
+}
+
+const TypeManager::Layout* TypeManager::GetLayout(const std::string & type)
+{
+    return compileLayout(type);
+}
+
 template<typename K, typename V>
 static void filterOwnerMap(std::unordered_map<K, V> & map, const std::string & owner)
 {
@@ -205,6 +227,7 @@ void TypeManager::Clear(const std::string & owner)
 {
     laststruct.clear();
     lastfunction.clear();
+    layouts.clear();
     filterOwnerMap(types, owner);
     filterOwnerMap(structs, owner);
     filterOwnerMap(functions, owner);
@@ -224,6 +247,7 @@ static bool removeType(std::unordered_map<K, V> & map, const std::string & type)
 
 bool TypeManager::RemoveType(const std::string & type)
 {
+    layouts.clear();
     return removeType(types, type) || removeType(structs, type) || removeType(functions, type);
 }
 
@@ -301,6 +325,20 @@ static bool mapContains(const std::unordered_map<K, V> & map, const K & k)
     return map.find(k) != map.end();
 }
 
+std::string TypeManager::Owner(const std::string & name, bool function) const
+{
+    if(function)
+    {
+        auto found = functions.find(name);
+        return found == functions.end() ? std::string() : found->second.owner;
+    }
+    auto foundType = types.find(name);
+    if(foundType != types.end())
+        return foundType->second.owner;
+    auto foundStruct = structs.find(name);
+    return foundStruct == structs.end() ? std::string() : foundStruct->second.owner;
+}
+
 bool TypeManager::isDefined(const std::string & id) const
 {
     return mapContains(types, id) || mapContains(structs, id);
@@ -330,6 +368,7 @@ bool TypeManager::addStructUnion(const StructUnion & s)
     laststruct = s.name;
     if(s.owner.empty() || s.name.empty() || isDefined(s.name))
         return false;
+    layouts.clear();
     structs.insert({s.name, s});
     return true;
 }
@@ -338,6 +377,7 @@ bool TypeManager::addType(const Type & t)
 {
     if(t.name.empty() || isDefined(t.name))
         return false;
+    layouts.clear();
     types.insert({t.name, t});
     return true;
 }
@@ -401,6 +441,89 @@ bool TypeManager::visitMember(const Member & root, Visitor & visitor) const
     return false;
 }
 
+const TypeManager::Layout* TypeManager::compileLayout(const std::string & type)
+{
+    auto found = layouts.find(type);
+    if(found != layouts.end())
+        return found->second.get();
+    auto foundT = types.find(type);
+    auto foundS = structs.find(type);
+    if(foundT == types.end() && foundS == structs.end())
+        return nullptr;
+
+    //Insert before resolving the members, pointers can refer back to this type
+    auto & layout = *layouts.emplace(type, std::unique_ptr<Layout>(new Layout())).first->second;
+    layout.size = Sizeof(type);
+    if(foundT != types.end())
+    {
+        layout.type = &foundT->second;
+        if(!layout.type->pointto.empty() && isDefined(layout.type->pointto))
+            layout.pointee = compileLayout(layout.type->pointto);
+    }
+    else
+    {
+        const auto & s = foundS->second;
+        layout.structUnion = &s;
+        layout.members.reserve(s.members.size());
+        auto offset = 0;
+        for(const auto & member : s.members)
+        {
+            LayoutMember m;
+            m.member = &member;
+            m.layout = compileLayout(member.type);
+            m.offset = offset;
+            m.size = Sizeof(member.type) * (member.arrsize ? member.arrsize : 1);
+            if(!s.isunion)
+                offset += m.size;
+            layout.members.push_back(m);
+        }
+    }
+    return &layout;
+}
+
+bool TypeManager::visitLayout(const Member & root, const Layout & layout, Visitor & visitor) const
+{
+    if(layout.type)
+    {
+        const auto & t = *layout.type;
+        if(!t.pointto.empty())
+        {
+            if(!layout.pointee)
+                return false;
+            if(visitor.visitPtr(root, t)) //allow the visitor to bail out
+            {
+                Member m;
+                m.name = "*" + root.name;
+                m.type = t.pointto;
+                if(!visitLayout(m, *layout.pointee, visitor))
+                    return false;
+                return visitor.visitBack(root);
+            }
+            return true;
+        }
+        return visitor.visitType(root, t);
+    }
+    if(!visitor.visitStructUnion(root, *layout.structUnion))
+        return false;
+    for(const auto & child : layout.members)
+    {
+        const auto & member = *child.member;
+        if(member.arrsize)
+        {
+            if(!visitor.visitArray(member))
+                return false;
+            for(auto i = 0; i < member.arrsize; i++)
+                if(!child.layout || !visitLayout(member, *child.layout, visitor))
+                    return false;
+            if(!visitor.visitBack(member))
+                return false;
+        }
+        else if(!child.layout || !visitLayout(member, *child.layout, visitor))
+            return false;
+    }
+    return visitor.visitBack(root);
+}
+
 bool AddType(const std::string & owner, const std::string & type, const std::string & name)
 {
     EXCLUSIVE_ACQUIRE(LockTypeManager);
@@ -458,9 +581,27 @@ int SizeofType(const std::string & type)
 bool VisitType(const std::string & type, const std::string & name, Types::TypeManager::Visitor & visitor)
 {
     SHARED_ACQUIRE(LockTypeManager);
+    if(!typeManager.HasLayout(type))
+    {
+        SHARED_RELEASE();
+        {
+            EXCLUSIVE_ACQUIRE(LockTypeManager);
+            typeManager.CompileLayout(type);
+        }
+        SHARED_REACQUIRE();
+    }
+    //Visit falls back to resolving the names if the types changed in between
     return typeManager.Visit(type, name, visitor);
 }
 
+bool CompileTypeDecoder(const std::string & type, TypeDecoder & decoder)
+{
+    //The decoder copies what it needs from the layout
+    EXCLUSIVE_ACQUIRE(LockTypeManager);
+    auto layout = typeManager.GetLayout(type);
+    return layout && decoder.Compile(*layout);
+}
+
 void ClearTypes(const std::string & owner)
 {
     EXCLUSIVE_ACQUIRE(LockTypeManager);
@@ -587,7 +728,23 @@ static void loadFunctions(const JSON froot, std::vector<Function> & functions)
     }
 }
 
-void LoadModel(const std::string & owner, Model & model)
+//Returns true if the name is already defined by another owner and the caller collects those (no error is printed then)
+static bool rejectDefinition(const std::string & owner, const char* kind, const std::string & name, bool function, std::vector<TypeManager::Summary>* rejected)
+{
+    if(!rejected)
+        return false;
+    auto existingOwner = typeManager.Owner(name, function);
+    if(existingOwner.empty() || existingOwner == owner)
+        return false;
+    TypeManager::Summary summary;
+    summary.kind = kind;
+    summary.name = name;
+    summary.owner = existingOwner;
+    rejected->push_back(summary);
+    return true;
+}
+
+void LoadModel(const std::string & owner, Model & model, std::vector<TypeManager::Summary>* rejected)
 {
     //Add all base struct/union types first to avoid errors later
     for(auto & su : model.structUnions)
@@ -596,7 +753,8 @@ void LoadModel(const std::string & owner, Model & model)
         if(!success)
         {
             //TODO properly handle errors
-            dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to add %s %s;\n"), su.isunion ? "union" : "struct", su.name.c_str());
+            if(!rejectDefinition(owner, su.isunion ? "union" : "struct", su.name, false, rejected))
+                dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to add %s %s;\n"), su.isunion ? "union" : "struct", su.name.c_str());
             su.name.clear(); //signal error
         }
     }
@@ -608,7 +766,8 @@ void LoadModel(const std::string & owner, Model & model)
         if(!success)
         {
             //TODO properly handle errors
-            dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to add typedef %s %s;\n"), type.type.c_str(), type.name.c_str());
+            if(!rejectDefinition(owner, "typedef", type.name, false, rejected))
+                dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to add typedef %s %s;\n"), type.type.c_str(), type.name.c_str());
         }
     }
 
@@ -619,7 +778,8 @@ void LoadModel(const std::string & owner, Model & model)
         if(!success)
         {
             //TODO properly handle errors
-            dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to add function %s %s()\n"), function.rettype.c_str(), function.name.c_str());
+            if(!rejectDefinition(owner, "function", function.name, true, rejected))
+                dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to add function %s %s()\n"), function.rettype.c_str(), function.name.c_str());
             function.name.clear(); //signal error
         }
     }
@@ -657,29 +817,38 @@ void LoadModel(const std::string & owner, Model & model)
     }
 }
 
-bool LoadTypesJson(const std::string & json, const std::string & owner)
+bool LoadTypesJsonModel(const std::string & json, Model & model)
 {
-    EXCLUSIVE_ACQUIRE(LockTypeManager);
     auto root = json_loads(json.c_str(), 0, 0);
-    if(root)
-    {
-        Model model;
-        loadTypes(json_object_get(root, "types"), model.types);
-        loadTypes(json_object_get(root, ArchValue("types32", "types64")), model.types);
-        loadStructUnions(json_object_get(root, "structs"), false, model.structUnions);
-        loadStructUnions(json_object_get(root, ArchValue("structs32", "structs64")), false, model.structUnions);
-        loadStructUnions(json_object_get(root, "unions"), true, model.structUnions);
-        loadStructUnions(json_object_get(root, ArchValue("unions32", "unions64")), true, model.structUnions);
-        loadFunctions(json_object_get(root, "functions"), model.functions);
-        loadFunctions(json_object_get(root, ArchValue("functions32", "functions64")), model.functions);
-
-        LoadModel(owner, model);
-
-        // Free root
-        json_decref(root);
-    }
-    else
+    if(!root)
         return false;
+    loadTypes(json_object_get(root, "types"), model.types);
+    loadTypes(json_object_get(root, ArchValue("types32", "types64")), model.types);
+    loadStructUnions(json_object_get(root, "structs"), false, model.structUnions);
+    loadStructUnions(json_object_get(root, ArchValue("structs32", "structs64")), false, model.structUnions);
+    loadStructUnions(json_object_get(root, "unions"), true, model.structUnions);
+    loadStructUnions(json_object_get(root, ArchValue("unions32", "unions64")), true, model.structUnions);
+    loadFunctions(json_object_get(root, "functions"), model.functions);
+    loadFunctions(json_object_get(root, ArchValue("functions32", "functions64")), model.functions);
+    json_decref(root);
+    return true;
+}
+
+void LoadTypesModel(const std::string & owner, Model & model, std::vector<TypeManager::Summary>* rejected)
+{
+    EXCLUSIVE_ACQUIRE(LockTypeManager);
+    typeManager.Clear(owner);
+    LoadModel(owner, model, rejected);
+}
+
+bool LoadTypesJson(const std::string & json, const std::string & owner)
+{
+    Model model;
+    if(!LoadTypesJsonModel(json, model))
+        return false;
+    TypesImportForget(owner);
+    EXCLUSIVE_ACQUIRE(LockTypeManager);
+    LoadModel(owner, model, nullptr);
     return true;
 }
 
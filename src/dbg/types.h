@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <memory>
 
 namespace Types
 {
@@ -90,6 +91,26 @@ namespace Types
             int size = 0;
         };
 
+        struct Layout;
+
+        struct LayoutMember
+        {
+            const Member* member;
+            const Layout* layout; //nullptr if the type is not defined
+            int offset;
+            int size; //Size including the array elements
+        };
+
+        //A type resolved once for Visit, valid until the types change
+        struct Layout
+        {
+            const Type* type = nullptr; //Primitive or pointer
+            const StructUnion* structUnion = nullptr;
+            const Layout* pointee = nullptr; //Layout of Type::pointto
+            std::vector<LayoutMember> members;
+            int size = 0;
+        };
+
         explicit TypeManager();
         bool AddType(const std::string & owner, const std::string & type, const std::string & name);
         bool AddStruct(const std::string & owner, const std::string & name);
@@ -101,15 +122,20 @@ namespace Types
         bool AppendArg(const std::string & type, const std::string & name);
         int Sizeof(const std::string & type) const;
         bool Visit(const std::string & type, const std::string & name, Visitor & visitor) const;
+        bool HasLayout(const std::string & type) const;
+        void CompileLayout(const std::string & type);
+        const Layout* GetLayout(const std::string & type);
         void Clear(const std::string & owner = "");
         bool RemoveType(const std::string & type);
         void Enum(std::vector<Summary> & typeList) const;
+        std::string Owner(const std::string & name, bool function) const; //Empty if name is not defined
 
     private:
         std::unordered_map<Primitive, int> primitivesizes;
         std::unordered_map<std::string, Type> types;
         std::unordered_map<std::string, StructUnion> structs;
         std::unordered_map<std::string, Function> functions;
+        std::unordered_map<std::string, std::unique_ptr<Layout>> layouts;
         std::string laststruct;
         std::string lastfunction;
 
@@ -119,6 +145,8 @@ namespace Types
         bool addType(const std::string & owner, Primitive primitive, const std::string & name, const std::string & pointto = "");
         bool addType(const Type & t);
         bool visitMember(const Member & root, Visitor & visitor) const;
+        const Layout* compileLayout(const std::string & type);
+        bool visitLayout(const Member & root, const Layout & layout, Visitor & visitor) const;
     };
 
     struct Model
@@ -139,9 +167,15 @@ bool AddArg(const std::string & function, const std::string & type, const std::s
 bool AppendArg(const std::string & type, const std::string & name);
 int SizeofType(const std::string & type);
 bool VisitType(const std::string & type, const std::string & name, Types::TypeManager::Visitor & visitor);
+class TypeDecoder;
+bool CompileTypeDecoder(const std::string & type, TypeDecoder & decoder);
 void ClearTypes(const std::string & owner = "");
 bool RemoveType(const std::string & type);
 void EnumTypes(std::vector<Types::TypeManager::Summary> & typeList);
 bool LoadTypesJson(const std::string & json, const std::string & owner);
+bool LoadTypesJsonModel(const std::string & json, Types::Model & model);
+//Definitions that could not be added because another owner already defines the name are stored in rejected (with that owner)
+void LoadTypesModel(const std::string & owner, Types::Model & model, std::vector<Types::TypeManager::Summary>* rejected = nullptr);
+bool ParseTypesModel(const std::string & parse, Types::Model & model, std::string & error);
 bool LoadTypesFile(const std::string & path, const std::string & owner);
 bool ParseTypes(const std::string & parse, const std::string & owner);
\ No newline at end of file
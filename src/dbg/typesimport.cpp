@@ -0,0 +1,372 @@
+#include "typesimport.h"
+#include "threading.h"
+#include "filehelper.h"
+#include "database.h"
+#include "murmurhash.h"
+#include <thread>
+#include <atomic>
+#include <unordered_set>
+
+using namespace Types;
+
+static const uint32_t modelMagic = 0x4C444F4D; // MODL
+static const uint32_t modelVersion = 1;
+
+class ModelWriter
+{
+public:
+    explicit ModelWriter(std::vector<unsigned char> & data)
+        : mData(data) { }
+
+    void Int(uint32_t value)
+    {
+        for(int i = 0; i < 4; i++)
+            mData.push_back((unsigned char)(value >> (i * 8)));
+    }
+
+    void Str(const std::string & value)
+    {
+        Int(uint32_t(value.size()));
+        mData.insert(mData.end(), value.begin(), value.end());
+    }
+
+    void Members(const std::vector<Member> & members)
+    {
+        Int(uint32_t(members.size()));
+        for(const auto & member : members)
+        {
+            Str(member.name);
+            Str(member.type);
+            Int(uint32_t(member.arrsize));
+            Int(uint32_t(member.offset));
+        }
+    }
+
+private:
+    std::vector<unsigned char> & mData;
+};
+
+class ModelReader
+{
+public:
+    ModelReader(const unsigned char* data, size_t size)
+        : mData(data), mSize(size) { }
+
+    bool Int(uint32_t & value)
+    {
+        if(mSize - mOffset < 4)
+            return false;
+        value = mData[mOffset] | mData[mOffset + 1] << 8 | mData[mOffset + 2] << 16 | uint32_t(mData[mOffset + 3]) << 24;
+        mOffset += 4;
+        return true;
+    }
+
+    bool Int(int & value)
+    {
+        uint32_t x;
+        if(!Int(x))
+            return false;
+        value = int(x);
+        return true;
+    }
+
+    bool Str(std::string & value)
+    {
+        uint32_t length;
+        if(!Int(length) || mSize - mOffset < length)
+            return false;
+        value.assign((const char*)mData + mOffset, length);
+        mOffset += length;
+        return true;
+    }
+
+    // element counts are checked against the remaining size, so corrupt files cannot cause huge allocations
+    bool Count(uint32_t & count, size_t minSize)
+    {
+        return Int(count) && count <= (mSize - mOffset) / minSize;
+    }
+
+    bool Members(std::vector<Member> & members)
+    {
+        uint32_t count;
+        if(!Count(count, 16))
+            return false;
+        members.resize(count);
+        for(auto & member : members)
+            if(!Str(member.name) || !Str(member.type) || !Int(member.arrsize) || !Int(member.offset))
+                return false;
+        return true;
+    }
+
+    bool End() const
+    {
+        return mOffset == mSize;
+    }
+
+private:
+    const unsigned char* mData;
+    size_t mSize;
+    size_t mOffset = 0;
+};
+
+void TypesModelSerialize(const Model & model, std::vector<unsigned char> & data)
+{
+    data.clear();
+    ModelWriter writer(data);
+    writer.Int(modelMagic);
+    writer.Int(modelVersion);
+    writer.Members(model.types);
+    writer.Int(uint32_t(model.structUnions.size()));
+    for(const auto & su : model.structUnions)
+    {
+        writer.Str(su.name);
+        writer.Int(su.isunion);
+        writer.Members(su.members);
+    }
+    writer.Int(uint32_t(model.functions.size()));
+    for(const auto & function : model.functions)
+    {
+        writer.Str(function.name);
+        writer.Str(function.rettype);
+        writer.Int(uint32_t(function.callconv));
+        writer.Int(function.noreturn);
+        writer.Members(function.args);
+    }
+}
+
+bool TypesModelDeserialize(const unsigned char* data, size_t size, Model & model)
+{
+    model = Model();
+    ModelReader reader(data, size);
+    uint32_t magic, version, count;
+    if(!reader.Int(magic) || magic != modelMagic || !reader.Int(version) || version != modelVersion)
+        return false;
+    if(!reader.Members(model.types))
+        return false;
+    if(!reader.Count(count, 12))
+        return false;
+    model.structUnions.resize(count);
+    for(auto & su : model.structUnions)
+    {
+        uint32_t isunion;
+        if(!reader.Str(su.name) || !reader.Int(isunion) || !reader.Members(su.members))
+            return false;
+        su.isunion = isunion != 0;
+    }
+    if(!reader.Count(count, 20))
+        return false;
+    model.functions.resize(count);
+    for(auto & function : model.functions)
+    {
+        uint32_t callconv, noreturn;
+        if(!reader.Str(function.name) || !reader.Str(function.rettype) || !reader.Int(callconv) || !reader.Int(noreturn) || !reader.Members(function.args))
+            return false;
+        if(callconv > Delphi)
+            return false;
+        function.callconv = CallingConvention(callconv);
+        function.noreturn = noreturn != 0;
+    }
+    return reader.End();
+}
+
+static String membersSignature(const std::vector<Member> & members)
+{
+    String signature;
+    for(const auto & member : members)
+        signature += StringUtils::sprintf("%s %s[%d]@%d;", member.type.c_str(), member.name.c_str(), member.arrsize, member.offset);
+    return signature;
+}
+
+void TypesModelMerge(std::vector<Model*> & models, std::vector<TypesModelConflict> & conflicts)
+{
+    // typedefs, structs and unions share a namespace, functions have their own
+    struct Definition
+    {
+        String kind;
+        String signature;
+        size_t model;
+    };
+    std::unordered_map<String, Definition> typeNames, functionNames;
+
+    auto keep = [&conflicts](std::unordered_map<String, Definition> & names, const String & name, Definition && definition)
+    {
+        auto found = names.find(name);
+        if(found == names.end())
+        {
+            names.emplace(name, std::move(definition));
+            return true;
+        }
+        const auto & first = found->second;
+        if(first.kind != definition.kind || first.signature != definition.signature)
+            conflicts.push_back({ definition.kind, name, first.model, definition.model });
+        return false;
+    };
+
+    for(size_t i = 0; i < models.size(); i++)
+    {
+        auto & model = *models[i];
+        model.types.erase(std::remove_if(model.types.begin(), model.types.end(), [&](const Member & type)
+        {
+            return !keep(typeNames, type.name, { "typedef", type.type, i });
+        }), model.types.end());
+        model.structUnions.erase(std::remove_if(model.structUnions.begin(), model.structUnions.end(), [&](const StructUnion & su)
+        {
+            return !keep(typeNames, su.name, { su.isunion ? "union" : "struct", membersSignature(su.members), i });
+        }), model.structUnions.end());
+        model.functions.erase(std::remove_if(model.functions.begin(), model.functions.end(), [&](const Function & function)
+        {
+            auto signature = StringUtils::sprintf("%s %d %d(", function.rettype.c_str(), function.callconv, function.noreturn) + membersSignature(function.args);
+            return !keep(functionNames, function.name, { "function", signature, i });
+        }), model.functions.end());
+    }
+}
+
+// owner -> content hash of the last import
+static std::unordered_map<String, String> importedHashes;
+
+static String contentHash(const String & content, bool json)
+{
+    uint64_t hash[2];
+    MurmurHash3_x64_128(content.data(), int(content.size()), 0x7970, hash);
+    // json models pick architecture specific sections, the parser does not
+    return StringUtils::sprintf("%016llX%016llX%s", hash[0], hash[1], json ? ArchValue("_json32", "_json64") : "_h");
+}
+
+static String cachePath(const String & hash)
+{
+    return StringUtils::sprintf("%s\\typecache\\%s.bin", DbGetBasePath(), hash.c_str());
+}
+
+void TypesImportForget(const String & owner)
+{
+    EXCLUSIVE_ACQUIRE(LockTypeManager);
+    importedHashes.erase(owner);
+}
+
+bool TypesImport(std::vector<TypesImportFile> & files, bool force, std::vector<TypesModelConflict> & conflicts)
+{
+    conflicts.clear();
+
+    // owners that still have types, a ClearTypes since the last import forces a reload
+    std::unordered_set<String> loadedOwners;
+    {
+        std::vector<TypeManager::Summary> summaries;
+        EnumTypes(summaries);
+        for(const auto & summary : summaries)
+            loadedOwners.insert(summary.owner);
+    }
+
+    std::vector<String> contents(files.size());
+    std::vector<Model> models(files.size());
+    std::vector<size_t> toParse;
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        auto & file = files[i];
+        file.status = TypesImportFile::Failed;
+        if(file.owner.empty())
+            file.owner = FileHelper::GetFileName(file.path);
+        if(!FileHelper::ReadAllText(file.path, contents[i]))
+        {
+            file.error = "failed to read file";
+            continue;
+        }
+        file.kind = StringUtils::EndsWith(StringUtils::ToLower(file.path), ".json") ? TypesImportFile::Json : TypesImportFile::Header;
+        file.hash = contentHash(contents[i], file.kind == TypesImportFile::Json);
+        {
+            SHARED_ACQUIRE(LockTypeManager);
+            auto found = importedHashes.find(file.owner);
+            if(!force && found != importedHashes.end() && found->second == file.hash && loadedOwners.count(file.owner))
+            {
+                file.status = TypesImportFile::Unchanged;
+                continue;
+            }
+        }
+        std::vector<unsigned char> cached;
+        if(!force && FileHelper::ReadAllData(cachePath(file.hash), cached) && TypesModelDeserialize(cached.data(), cached.size(), models[i]))
+        {
+            file.status = TypesImportFile::Cached;
+            continue;
+        }
+        toParse.push_back(i);
+    }
+
+    // parse the remaining files on worker threads
+    if(!toParse.empty())
+    {
+        std::atomic<size_t> next(0);
+        auto worker = [&]()
+        {
+            for(auto j = next++; j < toParse.size(); j = next++)
+            {
+                auto i = toParse[j];
+                auto & file = files[i];
+                bool success;
+                if(file.kind == TypesImportFile::Header)
+                    success = ParseTypesModel(contents[i], models[i], file.error);
+                else if(!(success = LoadTypesJsonModel(contents[i], models[i])))
+                    file.error = "invalid json";
+                if(success)
+                    file.status = TypesImportFile::Parsed;
+                contents[i].clear();
+            }
+        };
+        auto threadCount = (std::min)(size_t((std::max)(1u, std::thread::hardware_concurrency())), toParse.size());
+        std::vector<std::thread> threads;
+        for(size_t i = 1; i < threadCount; i++)
+            threads.emplace_back(worker);
+        worker();
+        for(auto & thread : threads)
+            thread.join();
+
+        CreateDirectoryW(StringUtils::Utf8ToUtf16(StringUtils::sprintf("%s\\typecache", DbGetBasePath())).c_str(), nullptr);
+        std::vector<unsigned char> data;
+        for(auto i : toParse)
+        {
+            if(files[i].status != TypesImportFile::Parsed)
+                continue;
+            TypesModelSerialize(models[i], data);
+            FileHelper::WriteAllData(cachePath(files[i].hash), data.data(), data.size());
+        }
+    }
+
+    // merge in argument order and replace the types of the changed owners
+    std::vector<Model*> merge;
+    std::vector<size_t> mergeIndex;
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        if(files[i].status == TypesImportFile::Cached || files[i].status == TypesImportFile::Parsed)
+        {
+            merge.push_back(&models[i]);
+            mergeIndex.push_back(i);
+        }
+    }
+    TypesModelMerge(merge, conflicts);
+    for(auto & conflict : conflicts)
+    {
+        conflict.first = mergeIndex[conflict.first];
+        conflict.second = mergeIndex[conflict.second];
+        conflict.owner = files[conflict.first].owner;
+    }
+    for(auto i : mergeIndex)
+        ClearTypes(files[i].owner);
+    bool success = true;
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        auto & file = files[i];
+        if(file.status == TypesImportFile::Failed)
+        {
+            success = false;
+            continue;
+        }
+        if(file.status == TypesImportFile::Unchanged)
+            continue;
+        // definitions the merge did not see: types of other owners and of unchanged files
+        std::vector<TypeManager::Summary> rejected;
+        LoadTypesModel(file.owner, models[i], &rejected);
+        for(const auto & summary : rejected)
+            conflicts.push_back({ summary.kind, summary.name, size_t(-1), i, summary.owner });
+        EXCLUSIVE_ACQUIRE(LockTypeManager);
+        importedHashes[file.owner] = file.hash;
+    }
+    return success;
+}
@@ -0,0 +1,56 @@
+#ifndef _TYPESIMPORT_H
+#define _TYPESIMPORT_H
+
+#include "_global.h"
+#include "types.h"
+
+struct TypesModelConflict
+{
+    String kind;
+    String name;
+    size_t first; // index of the model that keeps the definition, -1 if it was already loaded
+    size_t second; // index of the model whose definition was dropped
+    String owner; // owner that keeps the definition (set by TypesImport)
+};
+
+// Binary form of a parsed model, used for the type import cache
+void TypesModelSerialize(const Types::Model & model, std::vector<unsigned char> & data);
+bool TypesModelDeserialize(const unsigned char* data, size_t size, Types::Model & model);
+
+// Drops the definitions of a model that an earlier model already has, the ones that differ are reported as conflicts
+void TypesModelMerge(std::vector<Types::Model*> & models, std::vector<TypesModelConflict> & conflicts);
+
+struct TypesImportFile
+{
+    enum Kind
+    {
+        Header, // C header, parsed with the types parser
+        Json // JSON type model
+    };
+
+    enum Status
+    {
+        Failed,
+        Unchanged, // same content as the last import, nothing was done
+        Cached, // the model was loaded from the cache
+        Parsed
+    };
+
+    String path;
+    Kind kind = Header; // set from the file extension by TypesImport
+    String owner;
+    String hash;
+    Status status = Failed;
+    String error;
+};
+
+/**
+\brief Imports C headers (or JSON type models for .json files) with the file name as owner. Files are parsed in
+       parallel and the parsed models are cached in the database folder, keyed by a hash of the content. Files
+       with the same content as their last import are skipped unless force is set.
+*/
+bool TypesImport(std::vector<TypesImportFile> & files, bool force, std::vector<TypesModelConflict> & conflicts);
+// Forgets the content hash of the last import of owner, call it when the types of owner are loaded some other way
+void TypesImportForget(const String & owner);
+
+#endif // _TYPESIMPORT_H
@@ -1,13 +1,15 @@
 #include "types.h"
 #include "console.h"
+#include "typesimport.h"
+#include "stringutils.h"
 
 using namespace Types;
 
 #include "btparser/btparser/lexer.h"
 
-void LoadModel(const std::string & owner, Model & model);
+void LoadModel(const std::string & owner, Model & model, std::vector<TypeManager::Summary>* rejected);
 
-bool ParseTypes(const std::string & parse, const std::string & owner)
+bool ParseTypesModel(const std::string & parse, Model & model, std::string & error)
 {
     Lexer lexer;
     lexer.SetInputData(parse);
@@ -35,17 +37,13 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
                 return false;
         return true;
     };
-    std::string error;
     if(!lexer.DoLexing(tokens, error))
-    {
-        dputs_untranslated(error.c_str());
         return false;
-    }
-    Model model;
 
+    //errors are returned instead of printed, files can be parsed on worker threads
     auto errLine = [&]()
     {
-        dprintf("[line %d:%d] ", curToken().CurLine, curToken().LineIndex);
+        error = StringUtils::sprintf("[line %d:%d] ", curToken().CurLine, curToken().LineIndex);
     };
     auto eatSemic = [&]()
     {
@@ -63,7 +61,7 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
                 if(isToken(Lexer::tok_eof))
                 {
                     errLine();
-                    dputs("unexpected eof in typedef");
+                    error += "unexpected eof in typedef\n";
                     return false;
                 }
                 tdefToks.push_back(curToken());
@@ -82,7 +80,7 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
                             t.Token != Lexer::tok_void)
                     {
                         errLine();
-                        dprintf("token %s is not a type...\n", lexer.TokString(t).c_str());
+                        error += StringUtils::sprintf("token %s is not a type...\n", lexer.TokString(t).c_str());
                         return false;
                     }
                     else
@@ -96,7 +94,7 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
                 return true;
             }
             errLine();
-            dputs("not enough tokens for typedef");
+            error += "not enough tokens for typedef\n";
             return false;
         }
         return true;
@@ -109,7 +107,7 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
             if(isToken(Lexer::tok_eof))
             {
                 errLine();
-                dputs("unexpected eof in member");
+                error += "unexpected eof in member\n";
                 return false;
             }
             memToks.push_back(curToken());
@@ -127,32 +125,32 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
                     if(i + 1 >= memToks.size())
                     {
                         errLine();
-                        dputs("unexpected end after [");
+                        error += "unexpected end after [\n";
                         return false;
                     }
                     if(memToks[i + 1].Token != Lexer::tok_number)
                     {
                         errLine();
-                        dputs("expected number token");
+                        error += "expected number token\n";
                         return false;
                     }
                     m.arrsize = int(memToks[i + 1].NumberVal);
                     if(i + 2 >= memToks.size())
                     {
                         errLine();
-                        dputs("unexpected end, expected ]");
+                        error += "unexpected end, expected ]\n";
                         return false;
                     }
                     if(memToks[i + 2].Token != Lexer::tok_subclose)
                     {
                         errLine();
-                        dprintf("expected ], got %s\n", lexer.TokString(memToks[i + 2]).c_str());
+                        error += StringUtils::sprintf("expected ], got %s\n", lexer.TokString(memToks[i + 2]).c_str());
                         return false;
                     }
                     if(i + 2 != memToks.size() - 1)
                     {
                         errLine();
-                        dputs("too many tokens");
+                        error += "too many tokens\n";
                         return false;
                     }
                     break;
@@ -167,7 +165,7 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
                         t.Token != Lexer::tok_void)
                 {
                     errLine();
-                    dprintf("token %s is not a type...\n", lexer.TokString(t).c_str());
+                    error += StringUtils::sprintf("token %s is not a type...\n", lexer.TokString(t).c_str());
                     return false;
                 }
                 else
@@ -182,7 +180,7 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
             return true;
         }
         errLine();
-        dputs("not enough tokens for member");
+        error += "not enough tokens for member\n";
         return false;
     };
     auto parseStructUnion = [&]()
@@ -201,13 +199,13 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
                     if(isToken(Lexer::tok_eof))
                     {
                         errLine();
-                        dprintf("unexpected eof in %s\n", su.isunion ? "union" : "struct");
+                        error += StringUtils::sprintf("unexpected eof in %s\n", su.isunion ? "union" : "struct");
                         return false;
                     }
                     if(isToken(Lexer::tok_bropen))
                     {
                         errLine();
-                        dputs("nested blocks are not allowed!");
+                        error += "nested blocks are not allowed!\n";
                         return false;
                     }
                     if(!parseMember(su))
@@ -219,7 +217,7 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
                 if(!isToken(Lexer::tok_semic))
                 {
                     errLine();
-                    dputs("expected semicolon!");
+                    error += "expected semicolon!\n";
                     return false;
                 }
                 eatSemic();
@@ -228,7 +226,7 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
             else
             {
                 errLine();
-                dputs("invalid struct token sequence!");
+                error += "invalid struct token sequence!\n";
                 return false;
             }
         }
@@ -246,12 +244,24 @@ bool ParseTypes(const std::string & parse, const std::string & owner)
         if(curIndex == index)
         {
             errLine();
-            dprintf("unexpected token %s\n", lexer.TokString(curToken()).c_str());
+            error += StringUtils::sprintf("unexpected token %s\n", lexer.TokString(curToken()).c_str());
             return false;
         }
     }
 
-    LoadModel(owner, model);
+    return true;
+}
 
+bool ParseTypes(const std::string & parse, const std::string & owner)
+{
+    Model model;
+    std::string error;
+    if(!ParseTypesModel(parse, model, error))
+    {
+        dputs_untranslated(StringUtils::TrimRight(error).c_str());
+        return false;
+    }
+    TypesImportForget(owner);
+    LoadModel(owner, model, nullptr);
     return true;
 }
\ No newline at end of file
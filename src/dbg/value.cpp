@@ -18,6 +18,7 @@
 #include "TraceRecord.h"
 #include "plugin_loader.h"
 #include "exception.h"
+#include "eventreplay.h"
 
 static bool dosignedcalc = false;
 
@@ -640,6 +641,10 @@ duint getregister(int* size, const char* string)
 {
     if(size)
         *size = 4;
+    // a replayed event reads the recorded context
+    duint value;
+    if(EventReplayActive() && EventReplayGetRegister(string, value, size))
+        return value;
     if(scmp(string, "eax"))
     {
         return GetContextDataEx(hActiveThread, UE_EAX);
@@ -1657,6 +1662,16 @@ static bool ishexnumber(const char* string)
     return true;
 }
 
+bool valisregister(const char* string)
+{
+    return isregister(string);
+}
+
+bool valisnumber(const char* string)
+{
+    return isdecnumber(string) || ishexnumber(string);
+}
+
 bool convertNumber(const char* str, duint & result, int radix)
 {
     unsigned long long llr;
@@ -1885,7 +1900,7 @@ bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool ba
                 *isvar = true;
             return true;
         }
-        duint eflags = GetContextDataEx(hActiveThread, UE_CFLAGS);
+        duint eflags = EventReplayActive() ? EventReplayContext().eflags : GetContextDataEx(hActiveThread, UE_CFLAGS);
         if(valflagfromstring(eflags, string + 1))
             *value = 1;
         else
@@ -3,11 +3,310 @@
 #include "threading.h"
 #include "debugger.h"
 #include "taskthread.h"
+#include "memory.h"
+#include "variable.h"
+#include "eventreplay.h"
 #include <Windows.h>
 
 std::map<unsigned int, WatchExpr*> watchexpr;
 unsigned int idCounter = 1;
 
+// sizeof on a member without an object is C++11, VS2013 does not support it
+#define WATCH_CONTEXT(field) offsetof(TITAN_ENGINE_CONTEXT_t, field), sizeof(((TITAN_ENGINE_CONTEXT_t*)0)->field)
+
+struct WatchRegister
+{
+    const char* name;
+    size_t offset;
+    size_t fieldSize;
+    duint mask;
+    int shift;
+};
+
+// Registers that can be read straight from a captured context, other registers go through getregister
+static const WatchRegister watchRegisters[] =
+{
+    { "cax", WATCH_CONTEXT(cax), duint(-1), 0 },
+    { "cbx", WATCH_CONTEXT(cbx), duint(-1), 0 },
+    { "ccx", WATCH_CONTEXT(ccx), duint(-1), 0 },
+    { "cdx", WATCH_CONTEXT(cdx), duint(-1), 0 },
+    { "csi", WATCH_CONTEXT(csi), duint(-1), 0 },
+    { "cdi", WATCH_CONTEXT(cdi), duint(-1), 0 },
+    { "cbp", WATCH_CONTEXT(cbp), duint(-1), 0 },
+    { "csp", WATCH_CONTEXT(csp), duint(-1), 0 },
+    { "cip", WATCH_CONTEXT(cip), duint(-1), 0 },
+    { "cflags", WATCH_CONTEXT(eflags), duint(-1), 0 },
+    { "eax", WATCH_CONTEXT(cax), 0xFFFFFFFF, 0 },
+    { "ebx", WATCH_CONTEXT(cbx), 0xFFFFFFFF, 0 },
+    { "ecx", WATCH_CONTEXT(ccx), 0xFFFFFFFF, 0 },
+    { "edx", WATCH_CONTEXT(cdx), 0xFFFFFFFF, 0 },
+    { "esi", WATCH_CONTEXT(csi), 0xFFFFFFFF, 0 },
+    { "edi", WATCH_CONTEXT(cdi), 0xFFFFFFFF, 0 },
+    { "ebp", WATCH_CONTEXT(cbp), 0xFFFFFFFF, 0 },
+    { "esp", WATCH_CONTEXT(csp), 0xFFFFFFFF, 0 },
+    { "eip", WATCH_CONTEXT(cip), 0xFFFFFFFF, 0 },
+    { "eflags", WATCH_CONTEXT(eflags), 0xFFFFFFFF, 0 },
+    { "ax", WATCH_CONTEXT(cax), 0xFFFF, 0 },
+    { "bx", WATCH_CONTEXT(cbx), 0xFFFF, 0 },
+    { "cx", WATCH_CONTEXT(ccx), 0xFFFF, 0 },
+    { "dx", WATCH_CONTEXT(cdx), 0xFFFF, 0 },
+    { "si", WATCH_CONTEXT(csi), 0xFFFF, 0 },
+    { "di", WATCH_CONTEXT(cdi), 0xFFFF, 0 },
+    { "bp", WATCH_CONTEXT(cbp), 0xFFFF, 0 },
+    { "sp", WATCH_CONTEXT(csp), 0xFFFF, 0 },
+    { "ip", WATCH_CONTEXT(cip), 0xFFFF, 0 },
+    { "al", WATCH_CONTEXT(cax), 0xFF, 0 },
+    { "bl", WATCH_CONTEXT(cbx), 0xFF, 0 },
+    { "cl", WATCH_CONTEXT(ccx), 0xFF, 0 },
+    { "dl", WATCH_CONTEXT(cdx), 0xFF, 0 },
+    { "sil", WATCH_CONTEXT(csi), 0xFF, 0 },
+    { "dil", WATCH_CONTEXT(cdi), 0xFF, 0 },
+    { "bpl", WATCH_CONTEXT(cbp), 0xFF, 0 },
+    { "spl", WATCH_CONTEXT(csp), 0xFF, 0 },
+    { "ipl", WATCH_CONTEXT(cip), 0xFF, 0 },
+    { "ah", WATCH_CONTEXT(cax), 0xFF, 8 },
+    { "bh", WATCH_CONTEXT(cbx), 0xFF, 8 },
+    { "ch", WATCH_CONTEXT(ccx), 0xFF, 8 },
+    { "dh", WATCH_CONTEXT(cdx), 0xFF, 8 },
+    { "sih", WATCH_CONTEXT(csi), 0xFF, 8 },
+    { "dih", WATCH_CONTEXT(cdi), 0xFF, 8 },
+    { "bph", WATCH_CONTEXT(cbp), 0xFF, 8 },
+    { "sph", WATCH_CONTEXT(csp), 0xFF, 8 },
+    { "iph", WATCH_CONTEXT(cip), 0xFF, 8 },
+    { "gs", WATCH_CONTEXT(gs), 0xFFFF, 0 },
+    { "fs", WATCH_CONTEXT(fs), 0xFFFF, 0 },
+    { "es", WATCH_CONTEXT(es), 0xFFFF, 0 },
+    { "ds", WATCH_CONTEXT(ds), 0xFFFF, 0 },
+    { "cs", WATCH_CONTEXT(cs), 0xFFFF, 0 },
+    { "ss", WATCH_CONTEXT(ss), 0xFFFF, 0 },
+    { "dr0", WATCH_CONTEXT(dr0), duint(-1), 0 },
+    { "dr1", WATCH_CONTEXT(dr1), duint(-1), 0 },
+    { "dr2", WATCH_CONTEXT(dr2), duint(-1), 0 },
+    { "dr3", WATCH_CONTEXT(dr3), duint(-1), 0 },
+    { "dr6", WATCH_CONTEXT(dr6), duint(-1), 0 },
+    { "dr7", WATCH_CONTEXT(dr7), duint(-1), 0 },
+#ifdef _WIN64
+    { "rax", WATCH_CONTEXT(cax), duint(-1), 0 },
+    { "rbx", WATCH_CONTEXT(cbx), duint(-1), 0 },
+    { "rcx", WATCH_CONTEXT(ccx), duint(-1), 0 },
+    { "rdx", WATCH_CONTEXT(cdx), duint(-1), 0 },
+    { "rsi", WATCH_CONTEXT(csi), duint(-1), 0 },
+    { "rdi", WATCH_CONTEXT(cdi), duint(-1), 0 },
+    { "rbp", WATCH_CONTEXT(cbp), duint(-1), 0 },
+    { "rsp", WATCH_CONTEXT(csp), duint(-1), 0 },
+    { "rip", WATCH_CONTEXT(cip), duint(-1), 0 },
+    { "rflags", WATCH_CONTEXT(eflags), duint(-1), 0 },
+#define WATCH_R(n) \
+    { "r" #n, WATCH_CONTEXT(r##n), duint(-1), 0 }, \
+    { "r" #n "d", WATCH_CONTEXT(r##n), 0xFFFFFFFF, 0 }, \
+    { "r" #n "w", WATCH_CONTEXT(r##n), 0xFFFF, 0 }, \
+    { "r" #n "b", WATCH_CONTEXT(r##n), 0xFF, 0 }
+    WATCH_R(8), WATCH_R(9), WATCH_R(10), WATCH_R(11), WATCH_R(12), WATCH_R(13), WATCH_R(14), WATCH_R(15),
+#undef WATCH_R
+#endif //_WIN64
+};
+
+bool WatchEvalContext::ReadRegister(const WatchOperand & operand, duint & value)
+{
+    if(!captureContext())
+        return false;
+    duint field = 0;
+    memcpy(&field, (const unsigned char*)&mContext + operand.offset, operand.fieldSize);
+    value = (field >> operand.shift) & operand.mask;
+    return true;
+}
+
+bool WatchEvalContext::ReadMemory(duint addr, void* dest, size_t size)
+{
+    for(size_t i = 0; i < size;)
+    {
+        auto page = (addr + i) & ~duint(PAGE_SIZE - 1);
+        auto offset = size_t(addr + i - page);
+        auto chunk = min(size - i, size_t(PAGE_SIZE) - offset);
+        auto & data = mPages[page];
+        if(data.empty())
+        {
+            data.resize(PAGE_SIZE);
+            if(!readPage(page, data.data()))
+                data.clear();
+        }
+        if(data.empty()) // partially readable page, read exactly what was asked
+            return readMemory(addr, dest, size);
+        memcpy((unsigned char*)dest + i, data.data() + offset, chunk);
+        i += chunk;
+    }
+    return true;
+}
+
+duint WatchEvalContext::Cip()
+{
+    return captureContext() ? mContext.cip : 0;
+}
+
+bool WatchEvalContext::readContext(TITAN_ENGINE_CONTEXT_t & context)
+{
+    if(EventReplayActive())
+    {
+        context = EventReplayContext();
+        return true;
+    }
+    // registers read as 0 when not debugging, like getregister
+    return !DbgIsDebugging() || GetFullContextDataEx(hActiveThread, &context);
+}
+
+bool WatchEvalContext::readPage(duint page, void* data)
+{
+    return DbgIsDebugging() && MemRead(page, data, PAGE_SIZE);
+}
+
+bool WatchEvalContext::readMemory(duint addr, void* dest, size_t size)
+{
+    if(!DbgIsDebugging())
+    {
+        memset(dest, 0, size);
+        return true;
+    }
+    return MemRead(addr, dest, size);
+}
+
+bool WatchEvalContext::captureContext()
+{
+    if(!mCaptured)
+    {
+        mCaptured = true;
+        memset(&mContext, 0, sizeof(mContext));
+        mValid = readContext(mContext);
+    }
+    return mValid;
+}
+
+bool WatchEvaluateCompiled(const ExpressionParser & parser, const std::vector<WatchOperand> & operands, bool signedcalc, WatchEvalContext & context, duint & result)
+{
+    return parser.Calculate(result, signedcalc, [&](size_t index, const String & data, duint & value)
+    {
+        if(index < operands.size())
+        {
+            const auto & operand = operands[index];
+            switch(operand.kind)
+            {
+            case WatchOperand::Constant:
+                value = operand.value;
+                return true;
+            case WatchOperand::Register:
+                return context.ReadRegister(operand, value);
+            case WatchOperand::Memory:
+            {
+                duint addr;
+                if(!WatchEvaluateCompiled(*operand.address, operand.addressOperands, valuesignedcalc(), context, addr))
+                    return false;
+                value = 0;
+                return context.ReadMemory(addr, &value, operand.size);
+            }
+            default:
+                break;
+            }
+        }
+        return valfromstring_noexpr(data.c_str(), &value);
+    });
+}
+
+static void compileOperand(const String & data, WatchOperand & operand)
+{
+    auto string = data.c_str();
+    // memory operands, same syntax as valfromstring_noexpr (segment prefixes stay dynamic)
+    int size = sizeof(duint);
+    size_t prefix = 0;
+    if(string[0] == '[')
+        prefix = 1;
+    else if(isdigit(string[0]) && string[1] == ':' && string[2] == '[')
+    {
+        prefix = 3;
+        size = min(string[0] - '0', int(sizeof(duint)));
+    }
+    else if(strncmp(string, "byte:[", 6) == 0)
+        prefix = 6, size = 1;
+    else if(strncmp(string, "word:[", 6) == 0)
+        prefix = 6, size = 2;
+    else if(strncmp(string, "dword:[", 7) == 0)
+        prefix = 7, size = min(4, int(sizeof(duint)));
+#ifdef _WIN64
+    else if(strncmp(string, "qword:[", 7) == 0)
+        prefix = 7, size = 8;
+#endif //_WIN64
+    if(prefix)
+    {
+        // only compile when the brackets enclose the whole operand
+        size_t end = prefix;
+        for(int depth = 1; end < data.length(); end++)
+        {
+            if(data[end] == '[')
+                depth++;
+            else if(data[end] == ']' && !--depth)
+                break;
+        }
+        if(size <= 0 || end != data.length() - 1)
+            return;
+        auto address = std::make_shared<ExpressionParser>(data.substr(prefix, end - prefix));
+        if(!address->IsValidExpression())
+            return;
+        operand.kind = WatchOperand::Memory;
+        operand.size = size;
+        operand.address = address;
+        WatchCompileOperands(*address, operand.addressOperands);
+        return;
+    }
+    // variables take precedence over registers, numbers come after both (see valfromstring_noexpr)
+    if(vargettype(string))
+        return;
+    for(const auto & reg : watchRegisters)
+    {
+        if(scmp(string, reg.name))
+        {
+            operand.kind = WatchOperand::Register;
+            operand.offset = reg.offset;
+            operand.fieldSize = reg.fieldSize;
+            operand.mask = reg.mask;
+            operand.shift = reg.shift;
+            return;
+        }
+    }
+    if(valisregister(string))
+        return;
+    duint value;
+    if(valisnumber(string) && valfromstring_noexpr(string, &value))
+    {
+        operand.kind = WatchOperand::Constant;
+        operand.value = value;
+    }
+}
+
+// Reads a register of the table above from a context, size is set like getregister does
+bool WatchReadContextRegister(const TITAN_ENGINE_CONTEXT_t & context, const char* name, duint & value, int* size)
+{
+    for(const auto & reg : watchRegisters)
+    {
+        if(scmp(name, reg.name))
+        {
+            duint field = 0;
+            memcpy(&field, (const unsigned char*)&context + reg.offset, reg.fieldSize);
+            value = (field >> reg.shift) & reg.mask;
+            if(size)
+                *size = reg.mask == 0xFF ? 1 : reg.mask == 0xFFFF ? 2 : reg.mask == 0xFFFFFFFF ? 4 : int(sizeof(duint));
+            return true;
+        }
+    }
+    return false;
+}
+
+void WatchCompileOperands(const ExpressionParser & parser, std::vector<WatchOperand> & operands)
+{
+    auto data = parser.GetDataOperands();
+    operands.clear();
+    operands.resize(data.size());
+    for(size_t i = 0; i < data.size(); i++)
+        compileOperand(data[i], operands[i]);
+}
+
 WatchExpr::WatchExpr(const char* name, const char* expression, WATCHVARTYPE type) :
     expr(expression),
     haveCurrValue(false),
@@ -18,69 +317,67 @@ WatchExpr::WatchExpr(const char* name, const char* expression, WATCHVARTYPE type
 {
     if(!expr.IsValidExpression())
         varType = WATCHVARTYPE::TYPE_INVALID;
+    else
+        compile();
     strcpy_s(this->WatchName, name);
 }
 
+void WatchExpr::compile()
+{
+    WatchCompileOperands(expr, operands);
+}
+
 duint WatchExpr::getIntValue()
+{
+    WatchEvalContext context;
+    evaluate(context);
+    return currValue;
+}
+
+bool WatchExpr::evaluate(WatchEvalContext & context)
 {
     duint origVal = currValue;
+    bool hadValue = haveCurrValue;
     if(varType == WATCHVARTYPE::TYPE_UINT || varType == WATCHVARTYPE::TYPE_INT ||
             varType == WATCHVARTYPE::TYPE_FLOAT ||
             varType == WATCHVARTYPE::TYPE_ASCII || varType == WATCHVARTYPE::TYPE_UNICODE)
     {
         duint val;
-        bool ok = expr.Calculate(val, varType == WATCHVARTYPE::TYPE_INT, false);
+        bool ok = WatchEvaluateCompiled(expr, operands, varType == WATCHVARTYPE::TYPE_INT, context, val);
         if(ok)
         {
             currValue = val;
             haveCurrValue = true;
-            if(getType() != WATCHVARTYPE::TYPE_INVALID)
+            bool triggered = false;
+            switch(getWatchdogMode())
             {
-                switch(getWatchdogMode())
-                {
-                default:
-                case WATCHDOGMODE::MODE_DISABLED:
-                    break;
-                case WATCHDOGMODE::MODE_ISTRUE:
-                    if(currValue != 0)
-                    {
-                        duint cip = GetContextDataEx(hActiveThread, UE_CIP);
-                        dprintf(QT_TRANSLATE_NOOP("DBG", "Watchdog %s (expression \"%s\") is triggered at %p ! Original value: %p, New value: %p\n"), WatchName, getExpr().c_str(), cip, origVal, currValue);
-                        watchdogTriggered = 1;
-                    }
-                    break;
-                case WATCHDOGMODE::MODE_ISFALSE:
-                    if(currValue == 0)
-                    {
-                        duint cip = GetContextDataEx(hActiveThread, UE_CIP);
-                        dprintf(QT_TRANSLATE_NOOP("DBG", "Watchdog %s (expression \"%s\") is triggered at %p ! Original value: %p, New value: %p\n"), WatchName, getExpr().c_str(), cip, origVal, currValue);
-                        watchdogTriggered = 1;
-                    }
-                    break;
-                case WATCHDOGMODE::MODE_CHANGED:
-                    if(currValue != origVal || !haveCurrValue)
-                    {
-                        duint cip = GetContextDataEx(hActiveThread, UE_CIP);
-                        dprintf(QT_TRANSLATE_NOOP("DBG", "Watchdog %s (expression \"%s\") is triggered at %p ! Original value: %p, New value: %p\n"), WatchName, getExpr().c_str(), cip, origVal, currValue);
-                        watchdogTriggered = 1;
-                    }
-                    break;
-                case WATCHDOGMODE::MODE_UNCHANGED:
-                    if(currValue == origVal || !haveCurrValue)
-                    {
-                        duint cip = GetContextDataEx(hActiveThread, UE_CIP);
-                        dprintf(QT_TRANSLATE_NOOP("DBG", "Watchdog %s (expression \"%s\") is triggered at %p ! Original value: %p, New value: %p\n"), WatchName, getExpr().c_str(), cip, origVal, currValue);
-                        watchdogTriggered = 1;
-                    }
-                    break;
-                }
+            default:
+            case WATCHDOGMODE::MODE_DISABLED:
+                break;
+            case WATCHDOGMODE::MODE_ISTRUE:
+                triggered = currValue != 0;
+                break;
+            case WATCHDOGMODE::MODE_ISFALSE:
+                triggered = currValue == 0;
+                break;
+            case WATCHDOGMODE::MODE_CHANGED:
+                triggered = currValue != origVal;
+                break;
+            case WATCHDOGMODE::MODE_UNCHANGED:
+                triggered = currValue == origVal;
+                break;
             }
-            return val;
+            if(triggered)
+            {
+                dprintf(QT_TRANSLATE_NOOP("DBG", "Watchdog %s (expression \"%s\") is triggered at %p ! Original value: %p, New value: %p\n"), WatchName, getExpr().c_str(), context.Cip(), origVal, currValue);
+                watchdogTriggered = 1;
+            }
+            return !hadValue || currValue != origVal;
         }
     }
     currValue = 0;
     haveCurrValue = false;
-    return 0;
+    return hadValue;
 }
 
 bool WatchExpr::modifyExpr(const char* expression, WATCHVARTYPE type)
@@ -92,6 +389,7 @@ bool WatchExpr::modifyExpr(const char* expression, WATCHVARTYPE type)
         varType = type;
         currValue = 0;
         haveCurrValue = false;
+        compile();
         return true;
     }
     else
@@ -112,6 +410,39 @@ void GuiUpdateWatchViewAsync()
 }
 
 // Global functions
+static WATCHINFO watchInfo(unsigned int id, WatchExpr* watch)
+{
+    WATCHINFO info;
+    info.value = watch->getCurrIntValue();
+    strcpy_s(info.WatchName, watch->getName());
+    strcpy_s(info.Expression, watch->getExpr().c_str());
+    info.varType = watch->getType();
+    info.id = id;
+    info.watchdogMode = watch->getWatchdogMode();
+    info.watchdogTriggered = watch->watchdogTriggered;
+    info.window = watch->watchWindow;
+    return info;
+}
+
+// Evaluate all watches in one pass against a single register snapshot, changed gets the watches whose value or watchdog state changed
+void WatchEvaluateAll(bool & watchdogTriggered, std::vector<WATCHINFO> & changed)
+{
+    EXCLUSIVE_ACQUIRE(LockWatch);
+    watchdogTriggered = false;
+    changed.clear();
+    if(watchexpr.empty())
+        return;
+    WatchEvalContext context;
+    for(auto & i : watchexpr)
+    {
+        auto wasTriggered = i.second->watchdogTriggered;
+        i.second->watchdogTriggered = false;
+        if(i.second->evaluate(context) || i.second->watchdogTriggered != wasTriggered)
+            changed.push_back(watchInfo(i.first, i.second));
+        watchdogTriggered |= i.second->watchdogTriggered;
+    }
+}
+
 // Clear all watch
 void WatchClear()
 {
@@ -276,18 +607,7 @@ std::vector<WATCHINFO> WatchGetList()
     EXCLUSIVE_ACQUIRE(LockWatch);
     std::vector<WATCHINFO> watchList;
     for(auto & i : watchexpr)
-    {
-        WATCHINFO info;
-        info.value = i.second->getCurrIntValue();
-        strcpy_s(info.WatchName, i.second->getName());
-        strcpy_s(info.Expression, i.second->getExpr().c_str());
-        info.varType = i.second->getType();
-        info.id = i.first;
-        info.watchdogMode = i.second->getWatchdogMode();
-        info.watchdogTriggered = i.second->watchdogTriggered;
-        info.window = i.second->watchWindow;
-        watchList.push_back(info);
-    }
+        watchList.push_back(watchInfo(i.first, i.second));
     return watchList;
 }
 
@@ -3,18 +3,70 @@
 #include "_global.h"
 #include "jansson/jansson_x64dbg.h"
 #include "expressionparser.h"
+#include "TitanEngine/TitanEngine.h"
 #include <map>
+#include <memory>
+
+// An expression operand resolved when the watch is compiled, so evaluation does not parse strings
+struct WatchOperand
+{
+    enum Kind
+    {
+        Dynamic, // anything else (symbols, labels, variables, ...), resolved with valfromstring_noexpr
+        Constant,
+        Register,
+        Memory
+    };
+
+    Kind kind = Dynamic;
+    duint value = 0; // Constant
+    size_t offset = 0; // Register: offset in the thread context
+    size_t fieldSize = 0; // Register: size of the context field
+    duint mask = 0; // Register
+    int shift = 0; // Register
+    int size = 0; // Memory: read size
+    std::shared_ptr<ExpressionParser> address; // Memory
+    std::vector<WatchOperand> addressOperands; // Memory
+};
+
+// Register snapshot and memory read batch shared by all watches in one evaluation pass
+class WatchEvalContext
+{
+public:
+    virtual ~WatchEvalContext() {}
+
+    bool ReadRegister(const WatchOperand & operand, duint & value);
+    bool ReadMemory(duint addr, void* dest, size_t size);
+    duint Cip();
+
+protected:
+    // The debuggee by default, overridden to evaluate against a recorded process
+    virtual bool readContext(TITAN_ENGINE_CONTEXT_t & context);
+    virtual bool readPage(duint page, void* data);
+    virtual bool readMemory(duint addr, void* dest, size_t size);
+
+private:
+    bool mCaptured = false;
+    bool mValid = false;
+    TITAN_ENGINE_CONTEXT_t mContext;
+    std::unordered_map<duint, std::vector<unsigned char>> mPages;
+
+    bool captureContext();
+};
 
 class WatchExpr
 {
 protected:
     char WatchName[MAX_WATCH_NAME_SIZE];
     ExpressionParser expr;
+    std::vector<WatchOperand> operands; // compiled data operands of expr
     WATCHDOGMODE watchdogMode;
     bool haveCurrValue;
     WATCHVARTYPE varType;
     duint currValue; // last result of getIntValue()
 
+    void compile();
+
 public:
     bool watchdogTriggered;
     unsigned int watchWindow;
@@ -22,6 +74,7 @@ public:
     WatchExpr(const char* name, const char* expression, WATCHVARTYPE type);
     ~WatchExpr() {};
     duint getIntValue(); // evaluate the expression as integer
+    bool evaluate(WatchEvalContext & context); // evaluate against a shared context, returns true if the value changed
     bool modifyExpr(const char* expression, WATCHVARTYPE type); // modify the expression and data type
     void modifyName(const char* newName);
 
@@ -58,6 +111,10 @@ public:
 extern std::map<unsigned int, WatchExpr*> watchexpr;
 
 void GuiUpdateWatchViewAsync();
+void WatchEvaluateAll(bool & watchdogTriggered, std::vector<WATCHINFO> & changed);
+void WatchCompileOperands(const ExpressionParser & parser, std::vector<WatchOperand> & operands);
+bool WatchEvaluateCompiled(const ExpressionParser & parser, const std::vector<WatchOperand> & operands, bool signedcalc, WatchEvalContext & context, duint & result);
+bool WatchReadContextRegister(const TITAN_ENGINE_CONTEXT_t & context, const char* name, duint & value, int* size);
 void WatchClear();
 unsigned int WatchAddExpr(const char* expr, WATCHVARTYPE type);
 bool WatchModifyExpr(unsigned int id, const char* expr, WATCHVARTYPE type);
@@ -27,6 +27,8 @@
 #include "formatfunctions.h"
 #include "stringformat.h"
 #include "dbghelp_safe.h"
+#include "tracewriteindex.h"
+#include "traceprofile.h"
 
 static MESSAGE_STACK* gMsgStack = 0;
 static HANDLE hCommandLoopThread = 0;
@@ -146,6 +148,7 @@ static void registercommands()
     dbgcmdnew("bpgoto", cbDebugSetBPGoto, true);
     dbgcmdnew("bplist", cbDebugBplist, true); //breakpoint list
     dbgcmdnew("SetBPXOptions,bptype", cbDebugSetBPXOptions, false); //breakpoint type
+    dbgcmdnew("BulkBPX,bpbulk", cbDebugBulkBPX, true); //set/delete/enable/disable many breakpoints at once
 
     //conditional breakpoint control
     dbgcmdnew("SetBreakpointName,bpname", cbDebugSetBPXName, true); //set breakpoint name
@@ -223,6 +226,16 @@ static void registercommands()
     dbgcmdnew("TraceSetLogFile,SetTraceLogFile", cbDebugTraceSetLogFile, true); //Set trace log file
     dbgcmdnew("StartRunTrace,opentrace", cbDebugStartRunTrace, true); //start run trace (Ollyscript command "opentrace" "opens run trace window")
     dbgcmdnew("StopRunTrace,tc", cbDebugStopRunTrace, true); //stop run trace (and Ollyscript command)
+    dbgcmdnew("TraceRecordStats", cbDebugTraceRecordStats, false); //trace record memory usage, optionally set the budget (MB)
+    dbgcmdnew("TraceStateLoad", cbDebugTraceStateLoad, false); //index a run trace for state reconstruction
+    dbgcmdnew("TraceStateRegisters,TraceStateRegs", cbDebugTraceStateRegisters, false); //registers at a run trace index
+    dbgcmdnew("TraceStateMemory,TraceStateMem", cbDebugTraceStateMemory, false); //memory at a run trace index
+    dbgcmdnew("TraceWriteIndex", cbDebugTraceWriteIndex, false); //build the memory write index of a run trace
+    dbgcmdnew("TraceLastWrite", cbDebugTraceLastWrite, false); //last instruction that wrote memory before a run trace index
+    dbgcmdnew("TraceProfile", cbDebugTraceProfile, false); //run trace hot spots and call tree
+    dbgcmdnew("TraceProfileCancel", cbDebugTraceProfileCancel, false); //cancel the trace profile and release it
+    dbgcmdnew("TraceProfileExport", cbDebugTraceProfileExport, false); //export the last trace profile as JSON
+    dbgcmdnew("TraceExport", cbDebugTraceExport, false); //export a range of a run trace as CSV/TSV/JSON
 
     //thread control
     dbgcmdnew("createthread,threadcreate,newthread,threadnew", cbDebugCreatethread, true); //create thread
@@ -243,6 +256,7 @@ static void registercommands()
     dbgcmdnew("getpagerights,getrightspage", cbDebugGetPageRights, true);
     dbgcmdnew("setpagerights,setrightspage", cbDebugSetPageRights, true);
     dbgcmdnew("savedata", cbInstrSavedata, true); //save data to disk
+    dbgcmdnew("PatchExport", cbInstrPatchExport, true); //write all patches to the module files
 
     //operating system control
     dbgcmdnew("GetPrivilegeState", cbGetPrivilegeState, true); //get priv state
@@ -270,6 +284,9 @@ static void registercommands()
     dbgcmdnew("findall", cbInstrFindAll, true); //find all patterns
     dbgcmdnew("findallmem,findmemall", cbInstrFindAllMem, true); //memory map pattern find
     dbgcmdnew("findasm,asmfind", cbInstrFindAsm, true); //find instruction
+    dbgcmdnew("findasmpattern,asmpattern", cbInstrFindAsmPattern, true); //find instructions matching a pattern
+    dbgcmdnew("findasmsequence,asmsequence", cbInstrFindAsmSequence, true); //find instruction sequences
+    dbgcmdnew("findgadget,gadget", cbInstrFindGadget, true); //find gadgets
     dbgcmdnew("reffind,findref,ref", cbInstrRefFind, true); //find references to a value
     dbgcmdnew("reffindrange,findrefrange,refrange", cbInstrRefFindRange, true);
     dbgcmdnew("refstr,strref", cbInstrRefStr, true); //find string references
@@ -313,6 +330,9 @@ static void registercommands()
     dbgcmdnew("looplist", cbInstrLoopList, true); //list loops TODO: undocumented
     dbgcmdnew("loopclear", cbInstrLoopClear, true); //clear loops TODO: undocumented
 
+    dbgcmdnew("foldfunctions", cbInstrFoldFunctions, true); //fold all functions of a module
+    dbgcmdnew("foldclear", cbInstrFoldClear, false); //delete code folds
+
     //analysis
     dbgcmdnew("analyse,analyze,anal", cbInstrAnalyse, true); //secret analysis command
     dbgcmdnew("exanal,exanalyse,exanalyze", cbInstrExanalyse, true); //exception directory analysis
@@ -327,6 +347,7 @@ static void registercommands()
     dbgcmdnew("symdownload,downloadsym", cbDebugDownloadSymbol, true); //download symbols
     dbgcmdnew("symload,loadsym", cbDebugLoadSymbol, true); //load symbols
     dbgcmdnew("symunload,unloadsym", cbDebugUnloadSymbol, true); //unload symbols
+    dbgcmdnew("symexport,exportsym", cbDebugExportSymbols, true); //export the symbols of a module as CSV/TSV/JSON
     dbgcmdnew("imageinfo,modimageinfo", cbInstrImageinfo, true); //print module image information
     dbgcmdnew("GetRelocSize,grs", cbInstrGetRelocSize, true); //get relocation table size
     dbgcmdnew("exhandlers", cbInstrExhandlers, true); //enumerate exception handlers
@@ -363,11 +384,13 @@ static void registercommands()
     dbgcmdnew("AppendArg", cbInstrAppendArg, false); //AppendArg
     dbgcmdnew("SizeofType", cbInstrSizeofType, false); //SizeofType
     dbgcmdnew("VisitType", cbInstrVisitType, false); //VisitType
+    dbgcmdnew("DecodeType", cbInstrDecodeType, true); //DecodeType
     dbgcmdnew("ClearTypes", cbInstrClearTypes, false); //ClearTypes
     dbgcmdnew("RemoveType", cbInstrRemoveType, false); //RemoveType
     dbgcmdnew("EnumTypes", cbInstrEnumTypes, false); //EnumTypes
     dbgcmdnew("LoadTypes", cbInstrLoadTypes, false); //LoadTypes
     dbgcmdnew("ParseTypes", cbInstrParseTypes, false); //ParseTypes
+    dbgcmdnew("ImportTypes", cbInstrImportTypes, false); //ImportTypes
 
     //plugins
     dbgcmdnew("StartScylla,scylla,imprec", cbDebugStartScylla, false); //start scylla
@@ -431,6 +454,11 @@ static void registercommands()
 
     //undocumented
     dbgcmdnew("bench", cbDebugBenchmark, true); //benchmark test (readmem etc)
+    dbgcmdnew("benchundecorate", cbDebugBenchmarkUndecorate, false); //benchmark symbol undecoration
+    dbgcmdnew("eventrecordstart", cbDebugEventRecordStart, false); //record debug events for benchreplay
+    dbgcmdnew("eventrecordstop", cbDebugEventRecordStop, false); //stop recording debug events
+    dbgcmdnew("benchreplay", cbDebugBenchmarkReplay, false); //benchmark the debug event handlers on a recording
+    dbgcmdnew("benchcore", cbDebugBenchmarkCore, false); //benchmark core data structures on synthetic inputs
     dbgcmdnew("dprintf", cbPrintf, false); //printf
     dbgcmdnew("setstr,strset", cbInstrSetstr, false); //set a string variable
     dbgcmdnew("getstr,strget", cbInstrGetstr, false); //get a string variable
@@ -822,6 +850,9 @@ extern "C" DLL_EXPORT void _dbg_dbgexitsignal()
     dputs(QT_TRANSLATE_NOOP("DBG", "Cleaning up allocated data..."));
     cmdfree();
     varfree();
+    TraceWriteIndexClear();
+    TraceStateClear();
+    TraceProfileClear();
     Zydis::GlobalFinalize();
     dputs(QT_TRANSLATE_NOOP("DBG", "Cleaning up wait objects..."));
     waitdeinitialize();
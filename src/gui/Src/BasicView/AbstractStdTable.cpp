@@ -775,14 +775,16 @@ void AbstractStdTable::copyLineToLogSlot()
     emit Bridge::getBridge()->addMsgToLog(finalText.toUtf8());
 }
 
-QString AbstractStdTable::copyTable(const std::vector<int> & colWidths)
+QString AbstractStdTable::copyTable(const std::vector<int> & colWidths, int firstRow, int rowCount)
 {
     int colCount = getColumnCount();
-    int rowCount = getRowCount();
+    int endRow = getRowCount();
+    if(rowCount >= 0)
+        endRow = std::min(endRow, firstRow + rowCount);
     QString finalText = "";
     if(colCount == 1)
     {
-        for(int i = 0; i < rowCount; i++)
+        for(int i = firstRow; i < endRow; i++)
         {
             QString cellContent = getCellContent(i, 0);
             if(!cellContent.length()) //skip empty cells
@@ -795,18 +797,21 @@ QString AbstractStdTable::copyTable(const std::vector<int> & colWidths)
         //std::vector<int> colWidths;
         //for(int i = 0; i < colCount; i++)
         //    colWidths.push_back(getMaxColumnLength(i));
-        for(int i = 0; i < colCount; i++)
+        if(firstRow == 0)
         {
-            if(i)
-                finalText += " ";
-            int colWidth = colWidths[i];
-            if(colWidth)
-                finalText += getColTitle(i).leftJustified(colWidth, QChar(' '), true);
-            else
-                finalText += getColTitle(i);
+            for(int i = 0; i < colCount; i++)
+            {
+                if(i)
+                    finalText += " ";
+                int colWidth = colWidths[i];
+                if(colWidth)
+                    finalText += getColTitle(i).leftJustified(colWidth, QChar(' '), true);
+                else
+                    finalText += getColTitle(i);
+            }
+            finalText += "\r\n";
         }
-        finalText += "\r\n";
-        for(int i = 0; i < rowCount; i++)
+        for(int i = firstRow; i < endRow; i++)
         {
             QString finalRowText = "";
             for(int j = 0; j < colCount; j++)
@@ -826,6 +831,15 @@ QString AbstractStdTable::copyTable(const std::vector<int> & colWidths)
     return finalText;
 }
 
+void AbstractStdTable::copyTableToLog(const std::vector<int> & colWidths)
+{
+    // The log appends, so big tables are sent in pieces instead of as one string
+    const int chunkRows = 4096;
+    int rowCount = getRowCount();
+    for(int i = 0; i == 0 || i < rowCount; i += chunkRows)
+        emit Bridge::getBridge()->addMsgToLog(copyTable(colWidths, i, chunkRows).toUtf8());
+}
+
 void AbstractStdTable::copyTableSlot()
 {
     std::vector<int> colWidths;
@@ -841,7 +855,7 @@ void AbstractStdTable::copyTableToLogSlot()
     int colCount = getColumnCount();
     for(int i = 0; i < colCount; i++)
         colWidths.push_back(getColumnWidth(i) / getCharWidth());
-    emit Bridge::getBridge()->addMsgToLog(copyTable(colWidths).toUtf8());
+    copyTableToLog(colWidths);
 }
 
 void AbstractStdTable::copyTableResizeSlot()
@@ -871,7 +885,7 @@ void AbstractStdTable::copyTableResizeToLogSlot()
             max = std::max(getCellContent(j, i).length(), max);
         colWidths.push_back(max);
     }
-    emit Bridge::getBridge()->addMsgToLog(copyTable(colWidths).toUtf8());
+    copyTableToLog(colWidths);
 }
 
 void AbstractStdTable::copyEntrySlot()
@@ -891,9 +905,10 @@ void AbstractStdTable::exportTableSlot()
     headers.reserve(getColumnCount());
     for(int i = 0; i < getColumnCount(); i++)
         headers.push_back(getColTitle(i));
-    ExportCSV(getRowCount(), getColumnCount(), headers, [this](duint row, duint column)
+    ExportTable(this, getRowCount(), getColumnCount(), headers, [this](dsint row, dsint column)
     {
-        return getCellContent(row, column);
+        // The export runs in the background, rows might have been removed in the meantime
+        return row < getRowCount() ? getCellContent(row, column) : QString();
     });
 }
 
@@ -95,7 +95,8 @@ public slots:
     void headerButtonPressedSlot(int col);
 
 protected:
-    QString copyTable(const std::vector<int> & colWidths);
+    QString copyTable(const std::vector<int> & colWidths, int firstRow = 0, int rowCount = -1);
+    void copyTableToLog(const std::vector<int> & colWidths);
 
     struct SelectionData
     {
@@ -1741,6 +1741,9 @@ RichTextPainter::List Disassembly::getRichBytes(const Instruction_t & instr, boo
 
 void Disassembly::prepareData()
 {
+    if(mCodeFoldingManager)
+        mCodeFoldingManager->syncDatabase();
+
     dsint wViewableRowsCount = getViewableRowsCount();
     mInstBuffer.clear();
     mInstBuffer.reserve(wViewableRowsCount);
@@ -1767,6 +1770,7 @@ void Disassembly::prepareData()
 
 void Disassembly::reloadData()
 {
+    mDisasm->getEncodeMap()->invalidate();
     emit selectionChanged(rvaToVa(mSelection.firstSelectedIndex));
     AbstractTableView::reloadData();
 }
@@ -176,6 +176,24 @@ void ReferenceView::addColumnAtRef(int width, QString title)
     StdSearchListView::addColumnAt(width, title, true);
 }
 
+void ReferenceView::setColumnTypeRef(int col, int type)
+{
+    // The cell text is kept as sent, numeric columns only add a sort key
+    clearFilter();
+    switch(type)
+    {
+    case REF_COLUMN_DECIMAL:
+        setColumnType(col, StdTable::IntegerColumn, StdTable::FormatFn(), StdTable::SortBy::AsInt);
+        break;
+    case REF_COLUMN_HEX:
+        setColumnType(col, StdTable::IntegerColumn, StdTable::FormatFn(), StdTable::SortBy::AsHex);
+        break;
+    default:
+        setColumnType(col, StdTable::TextColumn, StdTable::FormatFn(), StdTable::SortBy::AsText);
+        break;
+    }
+}
+
 void ReferenceView::setRowCount(dsint count)
 {
     if(!stdList()->getRowCount() && count) //from zero to N rows
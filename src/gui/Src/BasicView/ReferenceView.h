@@ -22,6 +22,7 @@ public:
 
 public slots:
     void addColumnAtRef(int width, QString title);
+    void setColumnTypeRef(int col, int type);
 
     void setRowCount(dsint count) override;
 
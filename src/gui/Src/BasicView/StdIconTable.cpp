@@ -37,28 +37,16 @@ void StdIconTable::setRowCount(dsint count)
     StdTable::setRowCount(count);
 }
 
-void StdIconTable::sortRows(int column, bool ascending)
+void StdIconTable::permuteRows(const std::vector<size_t> & order)
 {
-    auto sortFn = mColumnSortFunctions.at(column);
-    std::vector<size_t> index;
-    index.resize(mData.size());
-    size_t i;
-    for(i = 0; i < mData.size(); i++)
-    {
-        index[i] = i;
-    }
-    std::stable_sort(index.begin(), index.end(), [column, ascending, this, &sortFn](const size_t & a, const size_t & b)
-    {
-        auto less = sortFn(mData.at(a).at(column).text, mData.at(b).at(column).text);
-        return ascending ? less : !less;
-    });
-    auto copy1 = mData;
-    auto copy2 = mIcon;
-    for(i = 0; i < mData.size(); i++)
-    {
-        mData[i] = std::move(copy1[index[i]]);
-        mIcon[i] = std::move(copy2[index[i]]);
-    }
+    StdTable::permuteRows(order);
+    if(order.size() != mIcon.size())
+        return;
+    std::vector<QIcon> icons;
+    icons.reserve(mIcon.size());
+    for(auto i : order)
+        icons.push_back(std::move(mIcon[i]));
+    mIcon = std::move(icons);
 }
 
 QString StdIconTable::paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h)
@@ -15,11 +15,12 @@ public:
     void setIconColumn(int c);
     int getIconColumn() const;
     void setRowCount(dsint count) override;
-    void sortRows(int column, bool ascending) override;
 
     QString paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h) override;
 
 protected:
+    void permuteRows(const std::vector<size_t> & order) override;
+
     std::vector<QIcon> mIcon; //listof(row) where row = (listof(col) where col = CellData)
     int mIconColumn;
 };
@@ -33,6 +33,12 @@ void StdSearchListView::addColumnAt(int width, QString title, bool isClickable,
     stdSearchList()->addColumnAt(width, title, isClickable, copyTitle, sortFn);
 }
 
+void StdSearchListView::setColumnType(int c, StdTable::ColumnType type, StdTable::FormatFn formatFn, StdTable::SortBy::t sortFn)
+{
+    stdList()->setColumnType(c, type, formatFn, sortFn);
+    stdSearchList()->setColumnType(c, type, formatFn, sortFn);
+}
+
 void StdSearchListView::setDrawDebugOnly(bool value)
 {
     stdList()->setDrawDebugOnly(value);
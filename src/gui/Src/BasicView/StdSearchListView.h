@@ -15,6 +15,7 @@ public:
     void setInternalTitle(const QString & title);
     int getCharWidth();
     void addColumnAt(int width, QString title, bool isClickable, QString copyTitle = "", StdTable::SortBy::t sortFn = StdTable::SortBy::AsText);
+    void setColumnType(int c, StdTable::ColumnType type, StdTable::FormatFn formatFn = StdTable::FormatFn(), StdTable::SortBy::t sortFn = StdTable::SortBy::t());
     void setDrawDebugOnly(bool value);
     void enableMultiSelection(bool enabled);
     void setAddressColumn(int col, bool cipBase = false);
@@ -1,5 +1,6 @@
 #include "StdTable.h"
 #include "Bridge.h"
+#include <numeric>
 
 StdTable::StdTable(QWidget* parent) : AbstractStdTable(parent)
 {
@@ -43,18 +44,42 @@ void StdTable::addColumnAt(int width, QString title, bool isClickable, QString c
 {
     AbstractTableView::addColumnAt(width, title, isClickable);
 
-    //append empty column to list of rows
-    for(size_t i = 0; i < mData.size(); i++)
-        mData[i].push_back(CellData());
-
     //Append copy title
     if(!copyTitle.length())
         mCopyTitles.push_back(title);
     else
         mCopyTitles.push_back(copyTitle);
 
-    //append column sort function
-    mColumnSortFunctions.push_back(sortFn);
+    Column column;
+    column.sortKind = sortKindOf(sortFn);
+    column.sortFn = std::move(sortFn);
+    resizeColumn(column, mRows);
+    mColumns.push_back(std::move(column));
+}
+
+void StdTable::setColumnType(int c, ColumnType type, FormatFn formatFn, SortBy::t sortFn)
+{
+    if(c < 0 || c >= int(mColumns.size()))
+        return;
+    std::vector<QString> content(mRows);
+    for(size_t r = 0; r < mRows; r++)
+        content[r] = getCellContent(int(r), c);
+    auto & column = mColumns[c];
+    column.type = type;
+    column.formatFn = std::move(formatFn);
+    if(sortFn)
+    {
+        column.sortKind = sortKindOf(sortFn);
+        column.sortFn = std::move(sortFn);
+    }
+    column.text.clear();
+    column.keys.clear();
+    column.strings.clear();
+    column.pool.clear();
+    column.poolIndex.clear();
+    resizeColumn(column, mRows);
+    for(size_t r = 0; r < mRows; r++)
+        setCellContent(int(r), c, std::move(content[r]));
 }
 
 void StdTable::deleteAllColumns()
@@ -62,64 +87,291 @@ void StdTable::deleteAllColumns()
     setRowCount(0);
     AbstractTableView::deleteAllColumns();
     mCopyTitles.clear();
-    mColumnSortFunctions.clear();
+    mColumns.clear();
 }
 
 void StdTable::setRowCount(dsint count)
 {
-    int wRowToAddOrRemove = count - int(mData.size());
-    for(int i = 0; i < qAbs(wRowToAddOrRemove); i++)
+    mRows = size_t(count);
+    for(auto & column : mColumns)
     {
-        if(wRowToAddOrRemove > 0)
+        resizeColumn(column, mRows);
+        if(!mRows)
         {
-            mData.push_back(std::vector<CellData>());
-            for(int j = 0; j < getColumnCount(); j++)
-                mData[mData.size() - 1].push_back(CellData());
+            column.pool.clear();
+            column.poolIndex.clear();
         }
-        else
-            mData.pop_back();
     }
     AbstractTableView::setRowCount(count);
 }
 
 void StdTable::setCellContent(int r, int c, QString s)
 {
-    if(isValidIndex(r, c))
-        mData[r][c].text = std::move(s);
+    if(!isValidIndex(r, c))
+        return;
+    auto & column = mColumns[c];
+    switch(column.type)
+    {
+    case TextColumn:
+        if(!column.keys.empty())
+            column.keys[r] = parseKey(column, s);
+        column.text[r] = std::move(s);
+        break;
+    case IntegerColumn:
+        column.keys[r] = parseKey(column, s);
+        column.text[r] = std::move(s);
+        break;
+    case InternedColumn:
+    {
+        auto found = column.poolIndex.constFind(s);
+        if(found == column.poolIndex.constEnd())
+        {
+            int index = int(column.pool.size());
+            column.poolIndex.insert(s, index);
+            column.pool.push_back(std::move(s));
+            column.strings[r] = index;
+        }
+        else
+            column.strings[r] = found.value();
+    }
+    break;
+    }
 }
 
 QString StdTable::getCellContent(int r, int c)
 {
-    if(isValidIndex(r, c))
-        return mData[r][c].text;
-    else
+    if(!isValidIndex(r, c))
         return QString("");
+    auto & column = mColumns[c];
+    switch(column.type)
+    {
+    case IntegerColumn:
+        if(column.text[r].isNull())
+        {
+            auto value = duint(column.keys[r]);
+            if(column.formatFn)
+                return column.formatFn(value);
+            if(column.sortKind == SortSigned)
+                return QString::number(qlonglong(dsint(value)));
+            return QString::number(qulonglong(value), 16).toUpper();
+        }
+        return column.text[r];
+    case InternedColumn:
+        return column.pool[column.strings[r]];
+    default:
+        return column.text[r];
+    }
+}
+
+void StdTable::setCellValue(int r, int c, duint value)
+{
+    if(!isValidIndex(r, c))
+        return;
+    auto & column = mColumns[c];
+    if(column.type == IntegerColumn)
+    {
+        column.keys[r] = value;
+        column.text[r] = QString();
+    }
+    else
+    {
+        QString text;
+        if(column.formatFn)
+            text = column.formatFn(value);
+        else if(column.sortKind == SortSigned)
+            text = QString::number(qlonglong(dsint(value)));
+        else
+            text = QString::number(qulonglong(value), 16).toUpper();
+        setCellContent(r, c, std::move(text));
+    }
+}
+
+duint StdTable::getCellValue(int r, int c)
+{
+    if(!isValidIndex(r, c))
+        return 0;
+    auto & column = mColumns[c];
+    if(!column.keys.empty())
+        return duint(column.keys[r]);
+    return duint(parseKey(column, getCellContent(r, c)));
 }
 
 void StdTable::setCellUserdata(int r, int c, duint userdata)
 {
     if(isValidIndex(r, c))
-        mData[r][c].userdata = userdata;
+        mColumns[c].userdata[r] = userdata;
 }
 
 duint StdTable::getCellUserdata(int r, int c)
 {
-    return isValidIndex(r, c) ? mData[r][c].userdata : 0;
+    return isValidIndex(r, c) ? mColumns[c].userdata[r] : 0;
+}
+
+void StdTable::copyRow(int r, StdTable & source, int sourceRow)
+{
+    int columns = std::min(int(mColumns.size()), int(source.mColumns.size()));
+    for(int c = 0; c < columns; c++)
+    {
+        if(!isValidIndex(r, c) || !source.isValidIndex(sourceRow, c))
+            return;
+        auto & to = mColumns[c];
+        const auto & from = source.mColumns[c];
+        if(to.type != InternedColumn && to.type == from.type && to.keys.empty() == from.keys.empty())
+        {
+            //same layout, copy the key and the (possibly null) text without formatting or parsing
+            to.text[r] = from.text[sourceRow];
+            if(!to.keys.empty())
+                to.keys[r] = from.keys[sourceRow];
+        }
+        else
+            setCellContent(r, c, source.getCellContent(sourceRow, c));
+        to.userdata[r] = from.userdata[sourceRow];
+    }
 }
 
 bool StdTable::isValidIndex(int r, int c)
 {
-    if(r < 0 || c < 0 || r >= int(mData.size()))
+    if(r < 0 || c < 0 || r >= int(mRows))
         return false;
-    return c < int(mData.at(r).size());
+    return c < int(mColumns.size());
 }
 
 void StdTable::sortRows(int column, bool ascending)
 {
-    auto sortFn = mColumnSortFunctions.at(column);
-    std::stable_sort(mData.begin(), mData.end(), [column, ascending, &sortFn](const std::vector<CellData> & a, const std::vector<CellData> & b)
+    permuteRows(sortedRows(column, ascending));
+}
+
+template<typename Less>
+static void sortOrder(std::vector<size_t> & order, bool ascending, const Less & less)
+{
+    if(ascending)
+    {
+        std::stable_sort(order.begin(), order.end(), less);
+    }
+    else
+    {
+        std::stable_sort(order.begin(), order.end(), [&less](size_t a, size_t b)
+        {
+            return less(b, a);
+        });
+    }
+}
+
+std::vector<size_t> StdTable::sortedRows(int column, bool ascending)
+{
+    std::vector<size_t> order(mRows);
+    std::iota(order.begin(), order.end(), size_t(0));
+    if(column < 0 || column >= int(mColumns.size()))
+        return order;
+    const auto & col = mColumns[column];
+    if(col.type == InternedColumn)
     {
-        auto less = sortFn(a.at(column).text, b.at(column).text);
-        return ascending ? less : !less;
-    });
+        //rank the distinct strings once, the rows are then sorted by rank
+        std::vector<int> byText(col.pool.size());
+        std::iota(byText.begin(), byText.end(), 0);
+        auto textLess = [&col](const QString & a, const QString & b)
+        {
+            return col.sortKind == SortText ? QString::compare(a, b) < 0 : col.sortFn(a, b);
+        };
+        std::stable_sort(byText.begin(), byText.end(), [&col, &textLess](int a, int b)
+        {
+            return textLess(col.pool[a], col.pool[b]);
+        });
+        std::vector<int> rank(col.pool.size());
+        for(size_t i = 0; i < byText.size(); i++)
+        {
+            if(i && !textLess(col.pool[byText[i - 1]], col.pool[byText[i]]))
+                rank[byText[i]] = rank[byText[i - 1]];
+            else
+                rank[byText[i]] = int(i);
+        }
+        sortOrder(order, ascending, [&col, &rank](size_t a, size_t b)
+        {
+            return rank[col.strings[a]] < rank[col.strings[b]];
+        });
+    }
+    else if(!col.keys.empty() && col.sortKind == SortSigned)
+    {
+        sortOrder(order, ascending, [&col](size_t a, size_t b)
+        {
+            return qint64(col.keys[a]) < qint64(col.keys[b]);
+        });
+    }
+    else if(!col.keys.empty() && (col.sortKind != SortCustom || col.type == IntegerColumn))
+    {
+        sortOrder(order, ascending, [&col](size_t a, size_t b)
+        {
+            return col.keys[a] < col.keys[b];
+        });
+    }
+    else if(col.sortKind == SortText)
+    {
+        sortOrder(order, ascending, [&col](size_t a, size_t b)
+        {
+            return QString::compare(col.text[a], col.text[b]) < 0;
+        });
+    }
+    else
+    {
+        sortOrder(order, ascending, [&col](size_t a, size_t b)
+        {
+            return col.sortFn(col.text[a], col.text[b]);
+        });
+    }
+    return order;
+}
+
+template<typename T>
+static void permute(std::vector<T> & data, const std::vector<size_t> & order)
+{
+    if(data.size() != order.size())
+        return;
+    std::vector<T> result;
+    result.reserve(data.size());
+    for(auto i : order)
+        result.push_back(std::move(data[i]));
+    data = std::move(result);
+}
+
+void StdTable::permuteRows(const std::vector<size_t> & order)
+{
+    for(auto & column : mColumns)
+    {
+        permute(column.text, order);
+        permute(column.keys, order);
+        permute(column.userdata, order);
+        permute(column.strings, order);
+    }
+}
+
+StdTable::SortKind StdTable::sortKindOf(const SortBy::t & sortFn)
+{
+    //the built-in sort functions are replaced by native comparisons of the stored keys
+    typedef bool(*SortFnPtr)(const QString &, const QString &);
+    auto sortFnPtr = sortFn.target<SortFnPtr>();
+    if(sortFnPtr && *sortFnPtr == SortBy::AsText)
+        return SortText;
+    if(sortFnPtr && *sortFnPtr == SortBy::AsInt)
+        return SortSigned;
+    if(sortFnPtr && *sortFnPtr == SortBy::AsHex)
+        return SortUnsigned;
+    return SortCustom;
+}
+
+quint64 StdTable::parseKey(const Column & column, const QString & s) const
+{
+    if(column.sortKind == SortSigned)
+        return quint64(s.toLongLong());
+    return s.toULongLong(nullptr, 16);
+}
+
+void StdTable::resizeColumn(Column & column, size_t rows)
+{
+    column.userdata.resize(rows);
+    if(column.type == InternedColumn)
+        column.strings.resize(rows);
+    else
+        column.text.resize(rows);
+    if(column.type == IntegerColumn || column.sortKind == SortSigned || column.sortKind == SortUnsigned)
+        column.keys.resize(rows);
 }
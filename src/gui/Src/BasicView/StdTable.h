@@ -2,6 +2,7 @@
 #define STDTABLE_H
 
 #include "AbstractStdTable.h"
+#include <QHash>
 
 class StdTable : public AbstractStdTable
 {
@@ -18,26 +19,63 @@ public:
         static bool AsHex(const QString & a, const QString & b);
     };
 
+    // Column storage
+    enum ColumnType
+    {
+        TextColumn, // a string per cell, AsInt/AsHex columns also keep the parsed number as sort key
+        IntegerColumn, // a number per cell, the text is formatted when it is requested
+        InternedColumn // an index into a string pool per cell, for columns with few distinct values
+    };
+    typedef std::function<QString(duint)> FormatFn;
+
     // Data Management
     void addColumnAt(int width, QString title, bool isClickable, QString copyTitle = "", SortBy::t sortFn = SortBy::AsText);
+    void setColumnType(int c, ColumnType type, FormatFn formatFn = FormatFn(), SortBy::t sortFn = SortBy::t()); // an empty sortFn keeps the sort function
     void deleteAllColumns() override;
     void setRowCount(dsint count) override;
     void setCellContent(int r, int c, QString s);
     QString getCellContent(int r, int c) override;
+    void setCellValue(int r, int c, duint value);
+    duint getCellValue(int r, int c);
     void setCellUserdata(int r, int c, duint userdata);
     duint getCellUserdata(int r, int c);
+    void copyRow(int r, StdTable & source, int sourceRow);
     bool isValidIndex(int r, int c) override;
     void sortRows(int column, bool ascending) override;
 
 protected:
-    struct CellData
+    std::vector<size_t> sortedRows(int column, bool ascending);
+    virtual void permuteRows(const std::vector<size_t> & order);
+
+private:
+    enum SortKind
     {
-        QString text;
-        duint userdata = 0;
+        SortText,
+        SortSigned,
+        SortUnsigned,
+        SortCustom
     };
 
-    std::vector<std::vector<CellData>> mData; //listof(row) where row = (listof(col) where col = CellData)
-    std::vector<SortBy::t> mColumnSortFunctions;
+    struct Column
+    {
+        ColumnType type = TextColumn;
+        SortKind sortKind = SortText;
+        SortBy::t sortFn;
+        FormatFn formatFn;
+        std::vector<QString> text; // TextColumn, IntegerColumn: text set with setCellContent (null when formatted lazily)
+        std::vector<quint64> keys; // numeric value (IntegerColumn or AsInt/AsHex TextColumn)
+        std::vector<duint> userdata;
+        std::vector<int> strings; // InternedColumn: index in pool
+        std::vector<QString> pool;
+        QHash<QString, int> poolIndex;
+    };
+
+    static SortKind sortKindOf(const SortBy::t & sortFn);
+    quint64 parseKey(const Column & column, const QString & s) const;
+    void resizeColumn(Column & column, size_t rows);
+
+    std::vector<Column> mColumns;
+    size_t mRows = 0;
 };
 
 #endif // STDTABLE_H
@@ -879,6 +879,34 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
     case GUI_SHOW_REF:
         emit showReferences();
         break;
+
+    case GUI_REF_SETCELLCONTENTS:
+    {
+        auto cells = (const CELLINFO*)param1;
+        auto count = int(duint(param2));
+        auto view = referenceManager->currentReferenceView();
+        if(view)
+        {
+            view->clearFilter();
+            for(int i = 0; i < count; i++)
+                view->stdList()->setCellContent(cells[i].row, cells[i].col, QString(cells[i].str));
+        }
+    }
+    break;
+
+    case GUI_UPDATE_WATCH_VALUES:
+    {
+        auto watches = (const WATCHINFO*)param1;
+        auto count = int(duint(param2));
+        for(int i = 0; i < count; i++)
+            emit updateWatchValue(watches[i].id, int(watches[i].varType), watches[i].value);
+    }
+    break;
+
+    case GUI_REF_SETCOLUMNTYPE:
+        if(referenceManager->currentReferenceView())
+            referenceManager->currentReferenceView()->setColumnTypeRef(int(duint(param1)), int(duint(param2)));
+        break;
     }
 
     return nullptr;
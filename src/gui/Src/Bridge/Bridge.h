@@ -142,6 +142,7 @@ signals:
     void focusGraph();
     void focusMemmap();
     void updateWatch();
+    void updateWatchValue(unsigned int id, int type, duint value);
     void loadGraph(BridgeCFGraphList* graph, duint addr);
     void graphAt(duint addr);
     void updateGraph();
@@ -127,24 +127,16 @@ void BreakpointsView::updateColors()
 
 void BreakpointsView::sortRows(int column, bool ascending)
 {
-    std::stable_sort(mData.begin(), mData.end(), [this, column, ascending](const std::vector<CellData> & a, const std::vector<CellData> & b)
+    //sort on the column content first, then stable sort on header type so the groups stay together
+    auto order = sortedRows(column, ascending);
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
     {
-        //this function sorts on header type first and then on column content
-        auto aBp = &mBps.at(a.at(ColAddr).userdata), bBp = &mBps.at(b.at(ColAddr).userdata);
+        auto aBp = &mBps.at(getCellUserdata(int(a), ColAddr)), bBp = &mBps.at(getCellUserdata(int(b), ColAddr));
         auto aType = aBp->type, bType = bBp->type;
         auto aHeader = aBp->addr || aBp->active, bHeader = bBp->addr || bBp->active;
-        struct Hax
-        {
-            const bool & greater;
-            const QString & s;
-            Hax(const bool & greater, const QString & s) : greater(greater), s(s) { }
-            bool operator<(const Hax & b)
-            {
-                return greater ? s > b.s : s < b.s;
-            }
-        } aHax(!ascending, a.at(column).text), bHax(!ascending, b.at(column).text);
-        return std::tie(aType, aHeader, aHax) < std::tie(bType, bHeader, bHax);
+        return std::tie(aType, aHeader) < std::tie(bType, bHeader);
     });
+    permuteRows(order);
 }
 
 QString BreakpointsView::paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h)
@@ -29,6 +29,11 @@ MemoryMapView::MemoryMapView(StdTable* parent)
     addColumnAt(8 + charwidth * 5, tr("Type"), true, tr("Allocation Type")); //allocation type
     addColumnAt(8 + charwidth * 11, tr("Protection"), true, tr("Current Protection")); //current protection
     addColumnAt(8 + charwidth * 8, tr("Initial"), true, tr("Allocation Protection")); //allocation protection
+    setColumnType(0, IntegerColumn, ToPtrString);
+    setColumnType(1, IntegerColumn, ToPtrString);
+    setColumnType(4, InternedColumn);
+    setColumnType(5, InternedColumn);
+    setColumnType(6, InternedColumn);
     loadColumnFromConfig("MemoryMap");
 
     connect(Bridge::getBridge(), SIGNAL(updateMemory()), this, SLOT(refreshMap()));
@@ -268,11 +273,7 @@ QString MemoryMapView::paintContent(QPainter* painter, dsint rowBase, int rowOff
     if(col == 0) //address
     {
         QString wStr = getCellContent(rowBase + rowOffset, col);
-#ifdef _WIN64
-        duint addr = wStr.toULongLong(0, 16);
-#else //x86
-        duint addr = wStr.toULong(0, 16);
-#endif //_WIN64
+        duint addr = getCellUserdata(rowBase + rowOffset, col);
         QColor color = mTextColor;
         QColor backgroundColor = Qt::transparent;
         bool isBp = (DbgGetBpxTypeAt(addr) & bp_memory) == bp_memory;
@@ -362,94 +363,239 @@ void MemoryMapView::ExecCommand()
     }
 }
 
-void MemoryMapView::refreshMap()
+static bool sameRegion(const MEMPAGE & a, const MEMPAGE & b)
 {
-    MEMMAP wMemMapStruct;
-    int wI;
+    return a.mbi.BaseAddress == b.mbi.BaseAddress &&
+           a.mbi.RegionSize == b.mbi.RegionSize &&
+           a.mbi.Type == b.mbi.Type &&
+           a.mbi.Protect == b.mbi.Protect &&
+           a.mbi.AllocationProtect == b.mbi.AllocationProtect &&
+           strcmp(a.info, b.info) == 0;
+}
 
-    memset(&wMemMapStruct, 0, sizeof(MEMMAP));
+QString MemoryMapView::getSectionContent(const QString & info)
+{
+    // TODO: proper section content analysis in dbg/memory.cpp:MemUpdateMap
+    if(info.contains(".bss"))
+        return tr("Uninitialized data");
+    else if(info.contains(".data"))
+        return tr("Initialized data");
+    else if(info.contains(".edata"))
+        return tr("Export tables");
+    else if(info.contains(".idata"))
+        return tr("Import tables");
+    else if(info.contains(".pdata"))
+        return tr("Exception information");
+    else if(info.contains(".rdata"))
+        return tr("Read-only initialized data");
+    else if(info.contains(".reloc"))
+        return tr("Base relocations");
+    else if(info.contains(".rsrc"))
+        return tr("Resources");
+    else if(info.contains(".text"))
+        return tr("Executable code");
+    else if(info.contains(".tls"))
+        return tr("Thread-local storage");
+    else if(info.contains(".xdata"))
+        return tr("Exception information");
+    else
+        return QString("");
+}
 
-    DbgMemMap(&wMemMapStruct);
+void MemoryMapView::setRegionRow(int row, const MEMPAGE & page)
+{
+    const auto & wMbi = page.mbi;
 
-    setRowCount(wMemMapStruct.count);
+    // Base address
+    setCellValue(row, 0, (duint)wMbi.BaseAddress);
+    setCellUserdata(row, 0, (duint)wMbi.BaseAddress);
 
-    QString wS;
-    MEMORY_BASIC_INFORMATION wMbi;
-    for(wI = 0; wI < wMemMapStruct.count; wI++)
+    // Size
+    setCellValue(row, 1, (duint)wMbi.RegionSize);
+    setCellUserdata(row, 1, (duint)wMbi.RegionSize);
+
+    // Information
+    setCellContent(row, 2, QString(page.info));
+
+    // Type
+    const char* type = "";
+    switch(wMbi.Type)
     {
-        wMbi = (wMemMapStruct.page)[wI].mbi;
+    case MEM_IMAGE:
+        type = "IMG";
+        break;
+    case MEM_MAPPED:
+        type = "MAP";
+        break;
+    case MEM_PRIVATE:
+        type = "PRV";
+        break;
+    default:
+        type = "N/A";
+        break;
+    }
+    setCellContent(row, 4, type);
 
-        // Base address
-        setCellContent(wI, 0, ToPtrString((duint)wMbi.BaseAddress));
-        setCellUserdata(wI, 0, (duint)wMbi.BaseAddress);
+    // current access protection
+    setCellContent(row, 5, getProtectionString(wMbi.Protect));
 
-        // Size
-        setCellContent(wI, 1, ToPtrString((duint)wMbi.RegionSize));
-        setCellUserdata(wI, 1, (duint)wMbi.RegionSize);
+    // allocation protection
+    setCellContent(row, 6, getProtectionString(wMbi.AllocationProtect));
+}
+
+void MemoryMapView::setContentCell(int row, const MEMPAGE & page, const QString & comment)
+{
+    if(!comment.isNull()) // user comment present
+        setCellContent(row, 3, comment);
+    else
+        setCellContent(row, 3, getSectionContent(QString(page.info)));
+}
 
-        // Information
-        wS = QString((wMemMapStruct.page)[wI].info);
-        setCellContent(wI, 2, wS);
+void MemoryMapView::refreshMap()
+{
+    MEMMAP wMemMapStruct;
+    memset(&wMemMapStruct, 0, sizeof(MEMMAP));
+    DbgMemMap(&wMemMapStruct);
+
+    std::vector<MEMPAGE> pages;
+    if(wMemMapStruct.page != 0)
+    {
+        pages.assign(wMemMapStruct.page, wMemMapStruct.page + wMemMapStruct.count);
+        BridgeFree(wMemMapStruct.page);
+    }
 
-        // Content, TODO: proper section content analysis in dbg/memory.cpp:MemUpdateMap
+    // Look up the user comments of all regions at once
+    QHash<duint, QString> comments;
+    if(DbgFunctions()->GetUserComments && !pages.empty())
+    {
+        std::vector<duint> bases;
+        bases.reserve(pages.size());
+        for(const auto & page : pages)
+            bases.push_back((duint)page.mbi.BaseAddress);
+        BridgeList<DBGUSERCOMMENT> found;
+        if(DbgFunctions()->GetUserComments(bases.data(), bases.size(), &found))
+            for(int i = 0; i < found.Count(); i++)
+                comments.insert(found[i].addr, QString(found[i].comment));
+    }
+    else
+    {
         char comment_text[MAX_COMMENT_SIZE];
-        if(DbgFunctions()->GetUserComment((duint)wMbi.BaseAddress, comment_text)) // user comment present
-            wS = comment_text;
-        else if(wS.contains(".bss"))
-            wS = tr("Uninitialized data");
-        else if(wS.contains(".data"))
-            wS = tr("Initialized data");
-        else if(wS.contains(".edata"))
-            wS = tr("Export tables");
-        else if(wS.contains(".idata"))
-            wS = tr("Import tables");
-        else if(wS.contains(".pdata"))
-            wS = tr("Exception information");
-        else if(wS.contains(".rdata"))
-            wS = tr("Read-only initialized data");
-        else if(wS.contains(".reloc"))
-            wS = tr("Base relocations");
-        else if(wS.contains(".rsrc"))
-            wS = tr("Resources");
-        else if(wS.contains(".text"))
-            wS = tr("Executable code");
-        else if(wS.contains(".tls"))
-            wS = tr("Thread-local storage");
-        else if(wS.contains(".xdata"))
-            wS = tr("Exception information");
-        else
-            wS = QString("");
-        setCellContent(wI, 3, std::move(wS));
+        for(const auto & page : pages)
+            if(DbgFunctions()->GetUserComment((duint)page.mbi.BaseAddress, comment_text))
+                comments.insert((duint)page.mbi.BaseAddress, QString(comment_text));
+    }
 
-        // Type
-        const char* type = "";
-        switch(wMbi.Type)
+    // Remember the selection and scroll position by region, row indices move when regions come and go
+    int rowCount = getRowCount();
+    auto baseAt = [this, rowCount](dsint row)
+    {
+        return row >= 0 && row < rowCount ? getCellUserdata(int(row), 0) : 0;
+    };
+    duint selectedBase = baseAt(mSelection.firstSelectedIndex);
+    duint fromBase = baseAt(mSelection.fromIndex);
+    duint toBase = baseAt(mSelection.toIndex);
+    duint topBase = baseAt(getTableOffset());
+
+    QHash<duint, int> rowOf;
+    rowOf.reserve(rowCount);
+    for(int row = 0; row < rowCount; row++)
+        rowOf.insert(getCellUserdata(row, 0), row);
+
+    // Update the rows of regions that changed, collect the new regions
+    std::vector<bool> keep(rowCount, false);
+    std::vector<size_t> inserted;
+    bool changed = false;
+    for(size_t i = 0; i < pages.size(); i++)
+    {
+        const auto & page = pages[i];
+        auto base = (duint)page.mbi.BaseAddress;
+        auto row = rowOf.value(base, -1);
+        auto previous = mRegions.find(base);
+        if(row == -1 || previous == mRegions.end())
         {
-        case MEM_IMAGE:
-            type = "IMG";
-            break;
-        case MEM_MAPPED:
-            type = "MAP";
-            break;
-        case MEM_PRIVATE:
-            type = "PRV";
-            break;
-        default:
-            type = "N/A";
-            break;
+            inserted.push_back(i);
+            continue;
         }
-        setCellContent(wI, 4, type);
-
-        // current access protection
-        setCellContent(wI, 5, getProtectionString(wMbi.Protect));
+        keep[row] = true;
+        auto comment = comments.value(base);
+        if(!sameRegion(previous->second, page))
+        {
+            setRegionRow(row, page);
+            setContentCell(row, page, comment);
+            changed = true;
+        }
+        else if(comment != mComments.value(base))
+        {
+            setContentCell(row, page, comment);
+            changed = true;
+        }
+    }
 
-        // allocation protection
-        setCellContent(wI, 6, getProtectionString(wMbi.AllocationProtect));
+    // Drop the rows of regions that are gone and append the new regions
+    int kept = int(std::count(keep.begin(), keep.end(), true));
+    if(kept != rowCount || !inserted.empty())
+    {
+        std::vector<size_t> order;
+        order.reserve(rowCount);
+        for(int row = 0; row < rowCount; row++)
+            if(keep[row])
+                order.push_back(row);
+        for(int row = 0; row < rowCount; row++)
+            if(!keep[row])
+                order.push_back(row);
+        permuteRows(order);
+        setRowCount(kept + int(inserted.size()));
+        for(size_t i = 0; i < inserted.size(); i++)
+        {
+            const auto & page = pages[inserted[i]];
+            setRegionRow(kept + int(i), page);
+            setContentCell(kept + int(i), page, comments.value((duint)page.mbi.BaseAddress));
+        }
+        changed = true;
+    }
 
+    // Changed cells can move a row as well, keep the order the user picked (address order when unsorted)
+    if(changed)
+    {
+        if(mSort.column == -1)
+            sortRows(0, true);
+        else
+            sortRows(mSort.column, mSort.ascending);
     }
-    if(wMemMapStruct.page != 0)
-        BridgeFree(wMemMapStruct.page);
+
+    mRegions.clear();
+    mRegions.reserve(pages.size());
+    for(const auto & page : pages)
+        mRegions.emplace((duint)page.mbi.BaseAddress, page);
+    mComments = std::move(comments);
+
     reloadData(); //refresh memory map
+
+    // Restore the selection and scroll position
+    rowCount = getRowCount();
+    if(rowCount)
+    {
+        rowOf.clear();
+        for(int row = 0; row < rowCount; row++)
+            rowOf.insert(getCellUserdata(row, 0), row);
+        int previousSelection = mSelection.firstSelectedIndex;
+        int selected = rowOf.value(selectedBase, -1);
+        if(selected == -1)
+            setSingleSelection(std::min(std::max(previousSelection, 0), rowCount - 1));
+        else
+        {
+            int from = rowOf.value(fromBase, selected);
+            int to = rowOf.value(toBase, selected);
+            mSelection.firstSelectedIndex = selected;
+            mSelection.fromIndex = std::min(std::min(from, to), selected);
+            mSelection.toIndex = std::max(std::max(from, to), selected);
+            if(selected != previousSelection)
+                emit selectionChangedSignal(selected);
+        }
+        int top = rowOf.value(topBase, -1);
+        if(top != -1 && top != getTableOffset())
+            setTableOffset(top);
+    }
 }
 
 void MemoryMapView::stateChangedSlot(DBGSTATE state)
@@ -589,10 +735,9 @@ void MemoryMapView::selectAddress(duint va)
     auto base = DbgMemFindBaseAddr(va, nullptr);
     if(base)
     {
-        auto baseText = ToPtrString(base);
         auto rows = getRowCount();
         for(dsint row = 0; row < rows; row++)
-            if(getCellContent(row, 0) == baseText)
+            if(getCellUserdata(row, 0) == base)
             {
                 scrollSelect(row);
                 reloadData();
@@ -2,6 +2,7 @@
 #define MEMORYMAPVIEW_H
 
 #include "StdTable.h"
+#include <unordered_map>
 
 class GotoDialog;
 
@@ -42,6 +43,9 @@ public slots:
 
 private:
     QString getProtectionString(DWORD Protect);
+    QString getSectionContent(const QString & info);
+    void setRegionRow(int row, const MEMPAGE & page);
+    void setContentCell(int row, const MEMPAGE & page, const QString & comment);
     QAction* makeCommandAction(QAction* action, const QString & command);
 
     GotoDialog* mGoto = nullptr;
@@ -79,6 +83,10 @@ private:
     QMenu* mPluginMenu;
 
     duint mCipBase;
+
+    // Regions and user comments of the last refresh, by base address
+    std::unordered_map<duint, MEMPAGE> mRegions;
+    QHash<duint, QString> mComments;
 };
 
 #endif // MEMORYMAPVIEW_H
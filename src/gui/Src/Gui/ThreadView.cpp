@@ -181,195 +181,352 @@ ThreadView::ThreadView(StdTable* parent) : StdTable(parent)
     setupContextMenu();
 }
 
-void ThreadView::updateThreadList()
+QString ThreadView::getPriorityString(THREADPRIORITY priority)
+{
+    QString priorityString;
+    switch(priority)
+    {
+    case _PriorityIdle:
+        priorityString = tr("Idle");
+        break;
+    case _PriorityAboveNormal:
+        priorityString = tr("AboveNormal");
+        break;
+    case _PriorityBelowNormal:
+        priorityString = tr("BelowNormal");
+        break;
+    case _PriorityHighest:
+        priorityString = tr("Highest");
+        break;
+    case _PriorityLowest:
+        priorityString = tr("Lowest");
+        break;
+    case _PriorityNormal:
+        priorityString = tr("Normal");
+        break;
+    case _PriorityTimeCritical:
+        priorityString = tr("TimeCritical");
+        break;
+    default:
+        priorityString = tr("Unknown");
+        break;
+    }
+    return priorityString;
+}
+
+QString ThreadView::getWaitReasonString(THREADWAITREASON waitReason)
+{
+    QString waitReasonString;
+    switch(waitReason)
+    {
+    case _Executive:
+        waitReasonString = "Executive";
+        break;
+    case _FreePage:
+        waitReasonString = "FreePage";
+        break;
+    case _PageIn:
+        waitReasonString = "PageIn";
+        break;
+    case _PoolAllocation:
+        waitReasonString = "PoolAllocation";
+        break;
+    case _DelayExecution:
+        waitReasonString = "DelayExecution";
+        break;
+    case _Suspended:
+        waitReasonString = "Suspended";
+        break;
+    case _UserRequest:
+        waitReasonString = "UserRequest";
+        break;
+    case _WrExecutive:
+        waitReasonString = "WrExecutive";
+        break;
+    case _WrFreePage:
+        waitReasonString = "WrFreePage";
+        break;
+    case _WrPageIn:
+        waitReasonString = "WrPageIn";
+        break;
+    case _WrPoolAllocation:
+        waitReasonString = "WrPoolAllocation";
+        break;
+    case _WrDelayExecution:
+        waitReasonString = "WrDelayExecution";
+        break;
+    case _WrSuspended:
+        waitReasonString = "WrSuspended";
+        break;
+    case _WrUserRequest:
+        waitReasonString = "WrUserRequest";
+        break;
+    case _WrEventPair:
+        waitReasonString = "WrEventPair";
+        break;
+    case _WrQueue:
+        waitReasonString = "WrQueue";
+        break;
+    case _WrLpcReceive:
+        waitReasonString = "WrLpcReceive";
+        break;
+    case _WrLpcReply:
+        waitReasonString = "WrLpcReply";
+        break;
+    case _WrVirtualMemory:
+        waitReasonString = "WrVirtualMemory";
+        break;
+    case _WrPageOut:
+        waitReasonString = "WrPageOut";
+        break;
+    case _WrRendezvous:
+        waitReasonString = "WrRendezvous";
+        break;
+    case _Spare2:
+        waitReasonString = "Spare2";
+        break;
+    case _Spare3:
+        waitReasonString = "Spare3";
+        break;
+    case _Spare4:
+        waitReasonString = "Spare4";
+        break;
+    case _Spare5:
+        waitReasonString = "Spare5";
+        break;
+    case _WrCalloutStack:
+        waitReasonString = "WrCalloutStack";
+        break;
+    case _WrKernel:
+        waitReasonString = "WrKernel";
+        break;
+    case _WrResource:
+        waitReasonString = "WrResource";
+        break;
+    case _WrPushLock:
+        waitReasonString = "WrPushLock";
+        break;
+    case _WrMutex:
+        waitReasonString = "WrMutex";
+        break;
+    case _WrQuantumEnd:
+        waitReasonString = "WrQuantumEnd";
+        break;
+    case _WrDispatchInt:
+        waitReasonString = "WrDispatchInt";
+        break;
+    case _WrPreempted:
+        waitReasonString = "WrPreempted";
+        break;
+    case _WrYieldExecution:
+        waitReasonString = "WrYieldExecution";
+        break;
+    case _WrFastMutex:
+        waitReasonString = "WrFastMutex";
+        break;
+    case _WrGuardedMutex:
+        waitReasonString = "WrGuardedMutex";
+        break;
+    case _WrRundown:
+        waitReasonString = "WrRundown";
+        break;
+    default:
+        waitReasonString = "Unknown";
+        break;
+    }
+    return waitReasonString;
+}
+
+bool ThreadView::isDetailsColumn(int c)
+{
+    // Columns the debugger queries per thread, they are only filled for the rows that are shown
+    return c == 4 || c == 5 || c == 6 || c == 8 || c == 12;
+}
+
+void ThreadView::setThreadRow(int row, const THREADALLINFO & thread)
 {
-    THREADLIST threadList;
-    memset(&threadList, 0, sizeof(THREADLIST));
-    DbgGetThreadList(&threadList);
-    setRowCount(threadList.count);
     auto tidFormat = ConfigBool("Gui", "PidTidInHex") ? "%X" : "%d";
-    for(int i = 0; i < threadList.count; i++)
+    if(!thread.BasicInfo.ThreadNumber)
+        setCellContent(row, 0, tr("Main"));
+    else
+        setCellContent(row, 0, ToDecString(thread.BasicInfo.ThreadNumber));
+    setCellContent(row, 1, QString().sprintf(tidFormat, thread.BasicInfo.ThreadId));
+    setCellUserdata(row, 1, thread.BasicInfo.ThreadId);
+    setCellContent(row, 2, ToPtrString(thread.BasicInfo.ThreadStartAddress));
+    setCellContent(row, 3, ToPtrString(thread.BasicInfo.ThreadLocalBase));
+    setCellContent(row, 7, getWaitReasonString(thread.WaitReason));
+    setCellContent(row, 9, FILETIMEToTime(thread.UserTime));
+    setCellContent(row, 10, FILETIMEToTime(thread.KernelTime));
+    setCellContent(row, 11, FILETIMEToDate(thread.CreationTime));
+    setCellContent(row, 13, thread.BasicInfo.threadName);
+}
+
+void ThreadView::setThreadDetails(int row, const THREADALLINFO & thread)
+{
+    setCellContent(row, 4, ToPtrString(thread.ThreadCip));
+    setCellContent(row, 5, ToDecString(thread.SuspendCount));
+    setCellContent(row, 6, getPriorityString(thread.Priority));
+    setCellContent(row, 8, QString("%1").arg(thread.LastError, sizeof(unsigned int) * 2, 16, QChar('0')).toUpper());
+    setCellContent(row, 12, ToLongLongHexString(thread.Cycles));
+}
+
+void ThreadView::updateDetails(const std::vector<int> & rows)
+{
+    if(rows.empty() || !DbgFunctions()->ThreadSnapshotGetDetails)
+        return;
+    std::vector<DWORD> threadIds;
+    threadIds.reserve(rows.size());
+    QHash<DWORD, int> rowOf;
+    for(auto row : rows)
     {
-        if(!threadList.list[i].BasicInfo.ThreadNumber)
-            setCellContent(i, 0, tr("Main"));
+        auto threadId = DWORD(getCellUserdata(row, 1));
+        threadIds.push_back(threadId);
+        rowOf.insert(threadId, row);
+        // the row is up to date even when the thread is gone by now
+        setCellUserdata(row, 4, mGeneration);
+    }
+    BridgeList<THREADALLINFO> threads;
+    if(!DbgFunctions()->ThreadSnapshotGetDetails(threadIds.data(), threadIds.size(), &threads))
+        return;
+    for(int i = 0; i < threads.Count(); i++)
+    {
+        auto row = rowOf.value(threads[i].BasicInfo.ThreadId, -1);
+        if(row != -1)
+            setThreadDetails(row, threads[i]);
+    }
+}
+
+void ThreadView::updateThreadList()
+{
+    BridgeList<THREADALLINFO> changed;
+    BridgeList<DWORD> removed;
+    DWORD currentThreadId = 0;
+    if(!DbgFunctions()->ThreadSnapshotUpdate || !DbgFunctions()->ThreadSnapshotUpdate(&changed, &removed, &currentThreadId))
+        return;
+    mCurrentThreadId = currentThreadId;
+    mGeneration++; // the details of every row are stale now
+
+    // Remember the selection and scroll position by thread id
+    int rowCount = getRowCount();
+    auto threadAt = [this, rowCount](dsint row)
+    {
+        return row >= 0 && row < rowCount ? DWORD(getCellUserdata(int(row), 1)) : 0;
+    };
+    DWORD selectedThread = threadAt(mSelection.firstSelectedIndex);
+    DWORD fromThread = threadAt(mSelection.fromIndex);
+    DWORD toThread = threadAt(mSelection.toIndex);
+    DWORD topThread = threadAt(getTableOffset());
+
+    QHash<DWORD, int> rowOf;
+    rowOf.reserve(rowCount);
+    for(int row = 0; row < rowCount; row++)
+        rowOf.insert(DWORD(getCellUserdata(row, 1)), row);
+
+    // Only the threads that were added, removed or changed since the last snapshot are touched
+    std::vector<bool> keep(rowCount, true);
+    for(int i = 0; i < removed.Count(); i++)
+    {
+        auto row = rowOf.value(removed[i], -1);
+        if(row != -1)
+            keep[row] = false;
+    }
+    std::vector<int> inserted;
+    for(int i = 0; i < changed.Count(); i++)
+    {
+        auto row = rowOf.value(changed[i].BasicInfo.ThreadId, -1);
+        if(row == -1 || !keep[row])
+            inserted.push_back(i);
         else
-            setCellContent(i, 0, ToDecString(threadList.list[i].BasicInfo.ThreadNumber));
-        setCellContent(i, 1, QString().sprintf(tidFormat, threadList.list[i].BasicInfo.ThreadId));
-        setCellContent(i, 2, ToPtrString(threadList.list[i].BasicInfo.ThreadStartAddress));
-        setCellContent(i, 3, ToPtrString(threadList.list[i].BasicInfo.ThreadLocalBase));
-        setCellContent(i, 4, ToPtrString(threadList.list[i].ThreadCip));
-        setCellContent(i, 5, ToDecString(threadList.list[i].SuspendCount));
-        QString priorityString;
-        switch(threadList.list[i].Priority)
+            setThreadRow(row, changed[i]);
+    }
+    int kept = int(std::count(keep.begin(), keep.end(), true));
+    if(kept != rowCount || !inserted.empty())
+    {
+        std::vector<size_t> order;
+        order.reserve(rowCount);
+        for(int row = 0; row < rowCount; row++)
+            if(keep[row])
+                order.push_back(row);
+        for(int row = 0; row < rowCount; row++)
+            if(!keep[row])
+                order.push_back(row);
+        permuteRows(order);
+        setRowCount(kept + int(inserted.size()));
+        for(size_t i = 0; i < inserted.size(); i++)
         {
-        case _PriorityIdle:
-            priorityString = tr("Idle");
-            break;
-        case _PriorityAboveNormal:
-            priorityString = tr("AboveNormal");
-            break;
-        case _PriorityBelowNormal:
-            priorityString = tr("BelowNormal");
-            break;
-        case _PriorityHighest:
-            priorityString = tr("Highest");
-            break;
-        case _PriorityLowest:
-            priorityString = tr("Lowest");
-            break;
-        case _PriorityNormal:
-            priorityString = tr("Normal");
-            break;
-        case _PriorityTimeCritical:
-            priorityString = tr("TimeCritical");
-            break;
-        default:
-            priorityString = tr("Unknown");
-            break;
+            setThreadRow(kept + int(i), changed[inserted[i]]);
+            setCellUserdata(kept + int(i), 4, 0);
         }
-        setCellContent(i, 6, priorityString);
-        QString waitReasonString;
-        switch(threadList.list[i].WaitReason)
+        if(mSort.column == -1) //keep the thread number order when the user did not sort
+            sortRows(0, true);
+    }
+
+    reloadData();
+
+    // Restore the selection and scroll position
+    rowCount = getRowCount();
+    if(rowCount)
+    {
+        rowOf.clear();
+        for(int row = 0; row < rowCount; row++)
+            rowOf.insert(DWORD(getCellUserdata(row, 1)), row);
+        int previousSelection = mSelection.firstSelectedIndex;
+        int selected = rowOf.value(selectedThread, -1);
+        if(selected == -1)
+            setSingleSelection(std::min(std::max(previousSelection, 0), rowCount - 1));
+        else
         {
-        case _Executive:
-            waitReasonString = "Executive";
-            break;
-        case _FreePage:
-            waitReasonString = "FreePage";
-            break;
-        case _PageIn:
-            waitReasonString = "PageIn";
-            break;
-        case _PoolAllocation:
-            waitReasonString = "PoolAllocation";
-            break;
-        case _DelayExecution:
-            waitReasonString = "DelayExecution";
-            break;
-        case _Suspended:
-            waitReasonString = "Suspended";
-            break;
-        case _UserRequest:
-            waitReasonString = "UserRequest";
-            break;
-        case _WrExecutive:
-            waitReasonString = "WrExecutive";
-            break;
-        case _WrFreePage:
-            waitReasonString = "WrFreePage";
-            break;
-        case _WrPageIn:
-            waitReasonString = "WrPageIn";
-            break;
-        case _WrPoolAllocation:
-            waitReasonString = "WrPoolAllocation";
-            break;
-        case _WrDelayExecution:
-            waitReasonString = "WrDelayExecution";
-            break;
-        case _WrSuspended:
-            waitReasonString = "WrSuspended";
-            break;
-        case _WrUserRequest:
-            waitReasonString = "WrUserRequest";
-            break;
-        case _WrEventPair:
-            waitReasonString = "WrEventPair";
-            break;
-        case _WrQueue:
-            waitReasonString = "WrQueue";
-            break;
-        case _WrLpcReceive:
-            waitReasonString = "WrLpcReceive";
-            break;
-        case _WrLpcReply:
-            waitReasonString = "WrLpcReply";
-            break;
-        case _WrVirtualMemory:
-            waitReasonString = "WrVirtualMemory";
-            break;
-        case _WrPageOut:
-            waitReasonString = "WrPageOut";
-            break;
-        case _WrRendezvous:
-            waitReasonString = "WrRendezvous";
-            break;
-        case _Spare2:
-            waitReasonString = "Spare2";
-            break;
-        case _Spare3:
-            waitReasonString = "Spare3";
-            break;
-        case _Spare4:
-            waitReasonString = "Spare4";
-            break;
-        case _Spare5:
-            waitReasonString = "Spare5";
-            break;
-        case _WrCalloutStack:
-            waitReasonString = "WrCalloutStack";
-            break;
-        case _WrKernel:
-            waitReasonString = "WrKernel";
-            break;
-        case _WrResource:
-            waitReasonString = "WrResource";
-            break;
-        case _WrPushLock:
-            waitReasonString = "WrPushLock";
-            break;
-        case _WrMutex:
-            waitReasonString = "WrMutex";
-            break;
-        case _WrQuantumEnd:
-            waitReasonString = "WrQuantumEnd";
-            break;
-        case _WrDispatchInt:
-            waitReasonString = "WrDispatchInt";
-            break;
-        case _WrPreempted:
-            waitReasonString = "WrPreempted";
-            break;
-        case _WrYieldExecution:
-            waitReasonString = "WrYieldExecution";
-            break;
-        case _WrFastMutex:
-            waitReasonString = "WrFastMutex";
-            break;
-        case _WrGuardedMutex:
-            waitReasonString = "WrGuardedMutex";
-            break;
-        case _WrRundown:
-            waitReasonString = "WrRundown";
-            break;
-        default:
-            waitReasonString = "Unknown";
-            break;
+            int from = rowOf.value(fromThread, selected);
+            int to = rowOf.value(toThread, selected);
+            mSelection.firstSelectedIndex = selected;
+            mSelection.fromIndex = std::min(std::min(from, to), selected);
+            mSelection.toIndex = std::max(std::max(from, to), selected);
+            if(selected != previousSelection)
+                emit selectionChangedSignal(selected);
         }
-        setCellContent(i, 7, waitReasonString);
-        setCellContent(i, 8, QString("%1").arg(threadList.list[i].LastError, sizeof(unsigned int) * 2, 16, QChar('0')).toUpper());
-        setCellContent(i, 9, FILETIMEToTime(threadList.list[i].UserTime));
-        setCellContent(i, 10, FILETIMEToTime(threadList.list[i].KernelTime));
-        setCellContent(i, 11, FILETIMEToDate(threadList.list[i].CreationTime));
-        setCellContent(i, 12, ToLongLongHexString(threadList.list[i].Cycles));
-        setCellContent(i, 13, threadList.list[i].BasicInfo.threadName);
+        int top = rowOf.value(topThread, -1);
+        if(top != -1 && top != getTableOffset())
+            setTableOffset(top);
     }
-    mCurrentThreadId = "NONE";
-    if(threadList.count)
+}
+
+void ThreadView::prepareData()
+{
+    StdTable::prepareData();
+    auto offset = getTableOffset();
+    auto lines = getNbrOfLineToPrint();
+    std::vector<int> rows;
+    for(int i = 0; i < lines; i++)
+        if(getCellUserdata(int(offset) + i, 4) != mGeneration)
+            rows.push_back(int(offset) + i);
+    updateDetails(rows);
+}
+
+QString ThreadView::getCellContent(int r, int c)
+{
+    // Rows that were not shown yet (copying the table for example)
+    if(isDetailsColumn(c) && isValidIndex(r, c) && getCellUserdata(r, 4) != mGeneration)
+        updateDetails(std::vector<int> { r });
+    return StdTable::getCellContent(r, c);
+}
+
+void ThreadView::sortRows(int column, bool ascending)
+{
+    if(isDetailsColumn(column))
     {
-        int currentThread = threadList.CurrentThread;
-        if(currentThread >= 0 && currentThread < threadList.count)
-            mCurrentThreadId = ToHexString(threadList.list[currentThread].BasicInfo.ThreadId);
-        BridgeFree(threadList.list);
+        std::vector<int> rows;
+        for(int row = 0; row < getRowCount(); row++)
+            if(getCellUserdata(row, 4) != mGeneration)
+                rows.push_back(row);
+        updateDetails(rows);
     }
-    reloadData();
+    StdTable::sortRows(column, ascending);
 }
 
 QString ThreadView::paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h)
 {
     QString ret = StdTable::paintContent(painter, rowBase, rowOffset, col, x, y, w, h);
-    QString threadId = getCellContent(rowBase + rowOffset, 1);
-    if(threadId == mCurrentThreadId && !col)
+    if(getCellUserdata(rowBase + rowOffset, 1) == mCurrentThreadId && !col)
     {
         painter->fillRect(QRect(x, y, w, h), QBrush(ConfigColor("ThreadCurrentBackgroundColor")));
         painter->setPen(QPen(ConfigColor("ThreadCurrentColor"))); //white text
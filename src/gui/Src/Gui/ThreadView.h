@@ -11,6 +11,9 @@ public:
     explicit ThreadView(StdTable* parent = 0);
     QString paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h);
     void setupContextMenu();
+    void prepareData() override;
+    QString getCellContent(int r, int c) override;
+    void sortRows(int column, bool ascending) override;
 
 public slots:
     void updateThreadList();
@@ -22,7 +25,15 @@ public slots:
 
 private:
     QAction* makeCommandAction(QAction* action, const QString & command);
-    QString mCurrentThreadId;
+    QString getPriorityString(THREADPRIORITY priority);
+    QString getWaitReasonString(THREADWAITREASON waitReason);
+    bool isDetailsColumn(int c);
+    void setThreadRow(int row, const THREADALLINFO & thread);
+    void setThreadDetails(int row, const THREADALLINFO & thread);
+    void updateDetails(const std::vector<int> & rows);
+
+    DWORD mCurrentThreadId = 0;
+    unsigned int mGeneration = 0; // thread snapshot the details of a row belong to, kept in the userdata of column 4
     MenuBuilder* mMenuBuilder;
 };
 
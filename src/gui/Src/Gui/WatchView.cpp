@@ -15,6 +15,7 @@ WatchView::WatchView(CPUMultiDump* parent) : StdTable(parent)
     addColumnAt(30, tr("ID"), true, "", SortBy::AsInt);
 
     connect(Bridge::getBridge(), SIGNAL(updateWatch()), this, SLOT(updateWatch()));
+    connect(Bridge::getBridge(), SIGNAL(updateWatchValue(unsigned int, int, duint)), this, SLOT(updateWatchValue(unsigned int, int, duint)));
     connect(this, SIGNAL(contextMenuSignal(QPoint)), this, SLOT(contextMenuSlot(QPoint)));
 
     setupContextMenu();
@@ -43,68 +44,25 @@ void WatchView::updateWatch()
         {
         case WATCHVARTYPE::TYPE_UINT:
             setCellContent(i, 3, "UINT");
-            setCellContent(i, 2, ToPtrString(WatchList[i].value));
             break;
         case WATCHVARTYPE::TYPE_INT:
             setCellContent(i, 3, "INT");
-            setCellContent(i, 2, QString::number((dsint)WatchList[i].value));
             break;
         case WATCHVARTYPE::TYPE_FLOAT:
             setCellContent(i, 3, "FLOAT");
-            setCellContent(i, 2, ToFloatString(&WatchList[i].value));
             break;
         case WATCHVARTYPE::TYPE_ASCII:
             setCellContent(i, 3, "ASCII");
-            {
-                char buffer[128];
-                // zero the buffer
-                memset(buffer, 0, sizeof(buffer));
-                if(DbgMemRead(WatchList[i].value, (unsigned char*)buffer, sizeof(buffer) - 1))
-                {
-                    // convert the ASCII string to QString
-                    QString text = QString::fromLocal8Bit(buffer);
-                    if(strlen(buffer) == sizeof(buffer) - 1)
-                        text.append("...");
-                    // remove CRLF
-                    text.replace(QChar('\x13'), "\\r");
-                    text.replace(QChar('\x10'), "\\n");
-                    setCellContent(i, 2, text);
-                }
-                else
-                    setCellContent(i, 2, tr("%1 is not readable.").arg(ToPtrString(WatchList[i].value)));
-            }
             break;
         case WATCHVARTYPE::TYPE_UNICODE:
             setCellContent(i, 3, "UNICODE");
-            {
-                unsigned short buffer[128];
-                // zero the buffer
-                memset(buffer, 0, sizeof(buffer));
-                if(DbgMemRead(WatchList[i].value, (unsigned char*)buffer, sizeof(buffer) - sizeof(unsigned short)))
-                {
-                    QString text = QString::fromUtf16(buffer);
-                    size_t size = text.size();
-                    // Check if the last character is an incomplete UTF-16 surrogate.
-                    if(text.at(text.size() - 1).isHighSurrogate())
-                        text.chop(text.size() - 1); // Delete the incomplete surrogate.
-                    // Check if something is truncated.
-                    if(size == sizeof(buffer) / sizeof(unsigned short) - 1)
-                        text.append("...");
-                    // remove CRLF
-                    text.replace(QChar('\x13'), "\\r");
-                    text.replace(QChar('\x10'), "\\n");
-                    setCellContent(i, 2, text);
-                }
-                else
-                    setCellContent(i, 2, tr("%1 is not readable.").arg(ToPtrString(WatchList[i].value)));
-            }
             break;
         case WATCHVARTYPE::TYPE_INVALID:
         default:
             setCellContent(i, 3, "INVALID");
-            setCellContent(i, 2, "");
             break;
         }
+        setCellContent(i, 2, valueText(WatchList[i].varType, WatchList[i].value));
         switch(WatchList[i].watchdogMode)
         {
         case WATCHDOGMODE::MODE_DISABLED:
@@ -129,6 +87,77 @@ void WatchView::updateWatch()
     reloadData();
 }
 
+QString WatchView::valueText(WATCHVARTYPE type, duint value)
+{
+    switch(type)
+    {
+    case WATCHVARTYPE::TYPE_UINT:
+        return ToPtrString(value);
+    case WATCHVARTYPE::TYPE_INT:
+        return QString::number((dsint)value);
+    case WATCHVARTYPE::TYPE_FLOAT:
+        return ToFloatString(&value);
+    case WATCHVARTYPE::TYPE_ASCII:
+    {
+        char buffer[128];
+        // zero the buffer
+        memset(buffer, 0, sizeof(buffer));
+        if(!DbgMemRead(value, (unsigned char*)buffer, sizeof(buffer) - 1))
+            return tr("%1 is not readable.").arg(ToPtrString(value));
+        // convert the ASCII string to QString
+        QString text = QString::fromLocal8Bit(buffer);
+        if(strlen(buffer) == sizeof(buffer) - 1)
+            text.append("...");
+        // remove CRLF
+        text.replace(QChar('\x13'), "\\r");
+        text.replace(QChar('\x10'), "\\n");
+        return text;
+    }
+    case WATCHVARTYPE::TYPE_UNICODE:
+    {
+        unsigned short buffer[128];
+        // zero the buffer
+        memset(buffer, 0, sizeof(buffer));
+        if(!DbgMemRead(value, (unsigned char*)buffer, sizeof(buffer) - sizeof(unsigned short)))
+            return tr("%1 is not readable.").arg(ToPtrString(value));
+        QString text = QString::fromUtf16(buffer);
+        size_t size = text.size();
+        // Check if the last character is an incomplete UTF-16 surrogate.
+        if(text.at(text.size() - 1).isHighSurrogate())
+            text.chop(text.size() - 1); // Delete the incomplete surrogate.
+        // Check if something is truncated.
+        if(size == sizeof(buffer) / sizeof(unsigned short) - 1)
+            text.append("...");
+        // remove CRLF
+        text.replace(QChar('\x13'), "\\r");
+        text.replace(QChar('\x10'), "\\n");
+        return text;
+    }
+    case WATCHVARTYPE::TYPE_INVALID:
+    default:
+        return "";
+    }
+}
+
+// Only the value of a single watch changed, update its cell without rebuilding the table
+void WatchView::updateWatchValue(unsigned int id, int type, duint value)
+{
+    if(!DbgIsDebugging())
+        return;
+    QString idText = QString::number(id);
+    for(int i = 0; i < getRowCount(); i++)
+    {
+        if(getCellContent(i, 5) == idText)
+        {
+            setCellContent(i, 2, valueText(WATCHVARTYPE(type), value));
+            updateViewport();
+            return;
+        }
+    }
+    // not in the table yet, fall back to a full refresh
+    updateWatch();
+}
+
 void WatchView::updateColors()
 {
     mWatchTriggeredColor = QPen(ConfigColor("WatchTriggeredColor"));
@@ -16,6 +16,7 @@ public:
 public slots:
     void contextMenuSlot(const QPoint & event);
     void updateWatch();
+    void updateWatchValue(unsigned int id, int type, duint value);
     void addWatchSlot();
     void delWatchSlot();
     void renameWatchSlot();
@@ -31,6 +32,7 @@ protected:
     void setupContextMenu();
 
     QString getSelectedId();
+    QString valueText(WATCHVARTYPE type, duint value);
 
     MenuBuilder* mMenu;
     QPen mWatchTriggeredColor;
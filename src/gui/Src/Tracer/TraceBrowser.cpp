@@ -831,6 +831,10 @@ void TraceBrowser::setupRightClickContextMenu()
     {
         return mTraceFile != nullptr;
     });
+    mMenuBuilder->addAction(makeAction(DIcon("graph.png"), tr("Profile"), SLOT(profileSlot())), [this](QMenu*)
+    {
+        return mTraceFile != nullptr && mTraceFile->Progress() == 100;
+    });
     mMenuBuilder->addSeparator();
     auto isValid = [this](QMenu*)
     {
@@ -893,6 +897,7 @@ void TraceBrowser::setupRightClickContextMenu()
     MenuBuilder* searchMenu = new MenuBuilder(this, isValid);
     searchMenu->addAction(makeAction(DIcon("search_for_constant.png"), tr("Constant"), SLOT(searchConstantSlot())));
     searchMenu->addAction(makeAction(DIcon("memory-map.png"), tr("Memory Reference"), SLOT(searchMemRefSlot())));
+    searchMenu->addAction(makeAction(DIcon("memory-map.png"), tr("Last Write to Address"), SLOT(searchLastWriteSlot())));
     mMenuBuilder->addMenu(makeMenu(DIcon("search.png"), tr("&Search")), searchMenu);
 
     // The following code adds a menu to view the information about currently selected instruction. When info box is completed, remove me.
@@ -1350,6 +1355,8 @@ void TraceBrowser::parseFinishedSlot()
         setRowCount(mTraceFile->Length());
         mMRUList->addEntry(mFileName);
         mMRUList->save();
+        // Build the memory write index in the background so "Last Write to Address" is instant
+        DbgFunctions()->TraceWriteIndexRequest(mFileName.toUtf8().constData());
     }
     setSingleSelection(0);
     makeVisible(0);
@@ -1703,8 +1710,11 @@ void TraceBrowser::exportSlot()
     headers.reserve(getColumnCount());
     for(int i = 0; i < getColumnCount(); i++)
         headers.push_back(getColTitle(i));
-    ExportCSV(getRowCount(), getColumnCount(), headers, [this](dsint row, dsint col)
+    ExportTable(this, getRowCount(), getColumnCount(), headers, [this](dsint row, dsint col)
     {
+        // The export runs in the background, the trace might have been closed in the meantime
+        if(mTraceFile == nullptr || mTraceFile->Progress() < 100 || row >= getRowCount())
+            return QString();
         QString temp;
         switch(col)
         {
@@ -1905,6 +1915,46 @@ void TraceBrowser::searchMemRefSlot()
     }
 }
 
+void TraceBrowser::searchLastWriteSlot()
+{
+    if(mTraceFile == nullptr || mTraceFile->Progress() < 100)
+        return;
+    auto fileName = mFileName.toUtf8();
+    auto status = DbgFunctions()->TraceWriteIndexRequest(fileName.constData());
+    if(status < 0)
+    {
+        SimpleErrorBox(this, tr("Error"), tr("Failed to build the memory write index of this trace."));
+        return;
+    }
+    if(status < 100)
+    {
+        GuiAddStatusBarMessage(tr("The memory write index is being built (%1%), try again later.\n").arg(status).toUtf8().constData());
+        return;
+    }
+    WordEditDialog addrDlg(this);
+    addrDlg.setup(tr("Last Write to Address"), 0, sizeof(duint));
+    if(addrDlg.exec() != QDialog::Accepted)
+        return;
+    unsigned long long writer;
+    if(!DbgFunctions()->TraceLastWrite(fileName.constData(), getInitialSelection(), addrDlg.getVal(), 1, &writer))
+    {
+        GuiAddStatusBarMessage(tr("No write to %1 before the selected instruction.\n").arg(ToPtrString(addrDlg.getVal())).toUtf8().constData());
+        return;
+    }
+    setSingleSelection(writer);
+    makeVisible(writer);
+    mHistory.addVaToHistory(writer);
+    updateViewport();
+}
+
+void TraceBrowser::profileSlot()
+{
+    if(mTraceFile == nullptr || mTraceFile->Progress() < 100)
+        return;
+    DbgCmdExec(QString("TraceProfile \"%1\"").arg(mFileName));
+    emit displayReferencesWidget();
+}
+
 void TraceBrowser::updateSlot()
 {
     if(mTraceFile && mTraceFile->Progress() == 100) // && this->isVisible()
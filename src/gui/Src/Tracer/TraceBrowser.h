@@ -180,6 +180,8 @@ public slots:
 
     void searchConstantSlot();
     void searchMemRefSlot();
+    void searchLastWriteSlot();
+    void profileSlot();
 
     void updateSlot();
 
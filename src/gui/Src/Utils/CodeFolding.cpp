@@ -1,6 +1,8 @@
 #include "CodeFolding.h"
+#include <algorithm>
 
 CodeFoldingHelper::CodeFoldingHelper()
+    : generation(0)
 {
 
 }
@@ -61,12 +63,8 @@ bool CodeFoldingHelper::isFolded(duint va) const
  */
 bool CodeFoldingHelper::isDataRangeFolded(duint vaStart, duint vaEnd) const
 {
-    CompareFunc less;
-    Range lower(vaStart, vaStart);
-    Range upper(vaEnd, vaEnd);
-    auto iteratorStart = root.upper_bound(lower);
-    auto iteratorEnd = root.lower_bound(upper);
-    return (iteratorStart != root.cend() && less(iteratorStart->first, upper)) && (iteratorEnd != root.cend() && less(lower, iteratorEnd->first));
+    const Range* range = foldedRanges.findAfter(vaStart);
+    return range != nullptr && range->second < vaEnd;
 }
 
 /**
@@ -76,6 +74,9 @@ bool CodeFoldingHelper::isDataRangeFolded(duint vaStart, duint vaEnd) const
  */
 duint CodeFoldingHelper::getFoldBegin(duint va) const
 {
+    const Range* range = foldedRanges.find(va);
+    if(range)
+        return range->first;
     const FoldTree* temp = getFirstFoldedTree(va);
     return temp == nullptr ? 0 : temp->range.first;
 }
@@ -87,6 +88,9 @@ duint CodeFoldingHelper::getFoldBegin(duint va) const
  */
 duint CodeFoldingHelper::getFoldEnd(duint va) const
 {
+    const Range* range = foldedRanges.find(va);
+    if(range)
+        return range->second;
     const FoldTree* temp = getFirstFoldedTree(va);
     return temp == nullptr ? 0 : temp->range.second;
 }
@@ -99,35 +103,34 @@ duint CodeFoldingHelper::getFoldEnd(duint va) const
  */
 duint CodeFoldingHelper::getFoldedSize(duint vaStart, duint vaEnd) const
 {
-    CompareFunc less;
-    Range keyLower(vaStart, vaStart);
-    Range keyUpper(vaEnd, vaEnd);
-    duint size = 0;
-    auto iteratorLower = root.upper_bound(keyLower);
-    auto iteratorUpper = root.lower_bound(keyUpper);
-    if(iteratorLower == root.cend() || iteratorUpper == root.cend() || less(iteratorUpper->first, iteratorLower->first))
-        return 0;
-    for(auto i = iteratorLower; i != iteratorUpper; i ++)
-        size += getFoldedSize(&i->second);
-    return size;
+    // The folded ranges are disjoint, so the ranges ending before vaEnd minus the ones starting at or before vaStart are the ones inside
+    duint before = foldedRanges.sumStartAtMost(vaStart);
+    duint inside = foldedRanges.sumEndBefore(vaEnd);
+    return inside > before ? inside - before : 0;
 }
 
 /**
- * @brief    Internal. Get the total bytes that should be invisible due to code folding withing a code folding segment.
- * @param node The code folding segment.
- * @return   Number of bytes folded.
+ * @brief    Get the offset of a virtual address with the folded bytes removed. A folded segment takes the place of its first byte.
+ * @param va The virtual address.
+ * @return   The number of visible bytes before va.
  */
-duint CodeFoldingHelper::getFoldedSize(const FoldTree* node) const
+duint CodeFoldingHelper::getVisualOffset(duint va) const
 {
-    if(node->folded)
-        return node->range.second - node->range.first;
-    else
-    {
-        duint size = 0;
-        for(auto i = node->children.cbegin(); i != node->children.cend(); i++)
-            size += getFoldedSize(&i->second);
-        return size;
-    }
+    duint hidden = foldedRanges.sumEndBefore(va);
+    const Range* range = foldedRanges.find(va);
+    if(range)
+        hidden += va - range->first;
+    return va - hidden;
+}
+
+/**
+ * @brief    Inverse of getVisualOffset.
+ * @param offset The number of visible bytes.
+ * @return   The lowest virtual address with this visual offset.
+ */
+duint CodeFoldingHelper::getAddressFromVisual(duint offset) const
+{
+    return foldedRanges.toAddress(offset);
 }
 
 /**
@@ -137,9 +140,18 @@ duint CodeFoldingHelper::getFoldedSize(const FoldTree* node) const
  */
 void CodeFoldingHelper::setFolded(duint va, bool folded)
 {
-    FoldTree* temp = getFoldTree(va);
-    if(temp)
-        temp->folded = folded;
+    bool parentFolded;
+    FoldTree* temp = getFoldTree(va, parentFolded);
+    if(temp == nullptr || temp->folded == folded)
+        return;
+    temp->folded = folded;
+    // A segment inside a folded segment stays hidden either way
+    if(!parentFolded)
+    {
+        foldedRanges.erase(temp->range.first, temp->range.second);
+        addFoldedRanges(temp);
+    }
+    storeFold(temp);
 }
 
 /**
@@ -152,7 +164,19 @@ void CodeFoldingHelper::setFolded(duint va, bool folded)
  */
 bool CodeFoldingHelper::addFoldSegment(duint va, duint length, bool folded)
 {
-    FoldTree* temp = getFoldTree(va);
+    if(!insertFoldSegment(va, length, folded))
+        return false;
+    storeFold(getFoldTree(va));
+    return true;
+}
+
+/**
+ * @brief    Internal. Adds a code folding segment without storing it in the database.
+ */
+bool CodeFoldingHelper::insertFoldSegment(duint va, duint length, bool folded)
+{
+    bool parentFolded;
+    FoldTree* temp = getFoldTree(va, parentFolded);
     FoldTree* temp2 = getFoldTree(va + length);
     if(temp != temp2)
         return false;
@@ -163,7 +187,11 @@ bool CodeFoldingHelper::addFoldSegment(duint va, duint length, bool folded)
     }
     auto map = (temp == nullptr) ? &root : &temp->children;
     auto result = map->insert(std::make_pair(std::make_pair(va, va + length), FoldTree(folded, va, va + length)));
-    return result.second;
+    if(!result.second)
+        return false;
+    if(folded && !parentFolded && (temp == nullptr || !temp->folded))
+        foldedRanges.insert(result.first->first);
+    return true;
 }
 
 /**
@@ -178,15 +206,20 @@ bool CodeFoldingHelper::delFoldSegment(duint va)
     if(temp1 == root.cend())
         return false;
     auto parent = &root;
+    bool parentFolded = false;
     do
     {
         auto temp2 = temp1->second.children.find(key);
         if(temp2 == temp1->second.children.cend())
             break;
+        parentFolded |= temp1->second.folded;
         parent = &temp1->second.children;
         temp1 = temp2;
     }
     while(true);
+    if(!parentFolded)
+        foldedRanges.erase(temp1->first.first, temp1->first.second);
+    delFoldSegments(&temp1->second);
     parent->erase(temp1);
     return true;
 }
@@ -241,6 +274,25 @@ CodeFoldingHelper::FoldTree* CodeFoldingHelper::getFoldTree(duint va)
     return &temp1->second;
 }
 
+CodeFoldingHelper::FoldTree* CodeFoldingHelper::getFoldTree(duint va, bool & parentFolded)
+{
+    parentFolded = false;
+    Range key(va, va);
+    auto temp1 = root.find(key);
+    if(temp1 == root.cend())
+        return nullptr;
+    do
+    {
+        auto temp2 = temp1->second.children.find(key);
+        if(temp2 == temp1->second.children.cend())
+            break;
+        parentFolded |= temp1->second.folded;
+        temp1 = temp2;
+    }
+    while(true);
+    return &temp1->second;
+}
+
 CodeFoldingHelper::FoldTree* CodeFoldingHelper::getFirstFoldedTree(duint va)
 {
     Range key(va, va);
@@ -267,19 +319,308 @@ void CodeFoldingHelper::expandFoldSegment(duint va)
     auto temp1 = root.find(key);
     if(temp1 == root.cend())
         return;
-    temp1->second.folded = false;
+    // Only the ranges below the outermost folded segment on the path change
+    FoldTree* outermost = nullptr;
     do
     {
+        if(temp1->second.folded)
+        {
+            if(outermost == nullptr)
+            {
+                outermost = &temp1->second;
+                foldedRanges.erase(outermost->range.first, outermost->range.second);
+            }
+            temp1->second.folded = false;
+            storeFold(&temp1->second);
+        }
         auto temp2 = temp1->second.children.find(key);
         if(temp2 == temp1->second.children.cend())
             break;
-        temp2->second.folded = false;
         temp1 = temp2;
     }
     while(true);
+    if(outermost)
+        addFoldedRanges(outermost);
+}
+
+/**
+ * @brief    Reloads the code folding segments from the database when they were changed outside of this helper.
+ * @return   True if the segments were reloaded.
+ */
+bool CodeFoldingHelper::syncDatabase()
+{
+    duint current = DbgFunctions()->CodeFoldGeneration();
+    if(current == generation)
+        return false;
+    generation = current;
+    root.clear();
+    foldedRanges.clear();
+    BridgeList<DBGCODEFOLD> folds;
+    DbgFunctions()->GetCodeFolds(&folds);
+    std::vector<DBGCODEFOLD> list(folds.Count());
+    for(int i = 0; i < folds.Count(); i++)
+        list[i] = folds[i];
+    // Outer segments first, the inner ones are added as their children
+    std::sort(list.begin(), list.end(), [](const DBGCODEFOLD & a, const DBGCODEFOLD & b)
+    {
+        return a.start < b.start || (a.start == b.start && a.end > b.end);
+    });
+    for(const auto & fold : list)
+        insertFoldSegment(fold.start, fold.end - fold.start, fold.folded);
+    return true;
+}
+
+/**
+ * @brief    Internal. Adds the ranges hidden by a segment that has no folded parent.
+ */
+void CodeFoldingHelper::addFoldedRanges(const FoldTree* node)
+{
+    if(node->folded)
+        foldedRanges.insert(node->range);
+    else
+    {
+        for(auto i = node->children.cbegin(); i != node->children.cend(); i++)
+            addFoldedRanges(&i->second);
+    }
+}
+
+/**
+ * @brief    Internal. Deletes a segment and its children from the database.
+ */
+void CodeFoldingHelper::delFoldSegments(const FoldTree* node)
+{
+    for(auto i = node->children.cbegin(); i != node->children.cend(); i++)
+        delFoldSegments(&i->second);
+    if(DbgFunctions()->DeleteCodeFold(node->range.first, node->range.second))
+        updateGeneration();
+}
+
+void CodeFoldingHelper::storeFold(const FoldTree* node)
+{
+    if(node && DbgFunctions()->SetCodeFold(node->range.first, node->range.second, node->folded))
+        updateGeneration();
+}
+
+void CodeFoldingHelper::updateGeneration()
+{
+    // Skip the reload for our own change, but not when something else changed the database in between
+    duint current = DbgFunctions()->CodeFoldGeneration();
+    if(current == generation + 1)
+        generation = current;
 }
 
 bool CodeFoldingHelper::CompareFunc::operator()(const CodeFoldingHelper::Range & lhs, const CodeFoldingHelper::Range & rhs) const
 {
     return lhs.second < rhs.first;
 }
+
+CodeFoldingHelper::FoldedRanges::FoldedRanges()
+    : top(-1), seed(0x9E3779B9)
+{
+}
+
+void CodeFoldingHelper::FoldedRanges::clear()
+{
+    nodes.clear();
+    freeNodes.clear();
+    top = -1;
+}
+
+/**
+ * @brief    Inserts a range, it must not overlap the ranges already present.
+ */
+void CodeFoldingHelper::FoldedRanges::insert(const Range & range)
+{
+    int node;
+    if(freeNodes.empty())
+    {
+        node = int(nodes.size());
+        nodes.emplace_back();
+    }
+    else
+    {
+        node = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    // xorshift, the priorities only have to be independent of the insertion order
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    nodes[node].range = range;
+    nodes[node].priority = seed;
+    nodes[node].left = -1;
+    nodes[node].right = -1;
+    update(node);
+    int left, right;
+    split(top, range.first, left, right);
+    top = merge(merge(left, node), right);
+}
+
+/**
+ * @brief    Erases the ranges that start within [start, end].
+ */
+void CodeFoldingHelper::FoldedRanges::erase(duint start, duint end)
+{
+    int left, middle, right = -1;
+    split(top, start, left, middle);
+    if(end != duint(-1))
+        split(middle, end + 1, middle, right);
+    release(middle);
+    top = merge(left, right);
+}
+
+/**
+ * @brief    Finds the range that contains va.
+ */
+const CodeFoldingHelper::Range* CodeFoldingHelper::FoldedRanges::find(duint va) const
+{
+    const Range* found = nullptr;
+    for(int node = top; node != -1;)
+    {
+        if(nodes[node].range.first <= va)
+        {
+            found = &nodes[node].range;
+            node = nodes[node].right;
+        }
+        else
+            node = nodes[node].left;
+    }
+    return found != nullptr && found->second >= va ? found : nullptr;
+}
+
+/**
+ * @brief    Finds the first range that starts after va.
+ */
+const CodeFoldingHelper::Range* CodeFoldingHelper::FoldedRanges::findAfter(duint va) const
+{
+    const Range* found = nullptr;
+    for(int node = top; node != -1;)
+    {
+        if(nodes[node].range.first > va)
+        {
+            found = &nodes[node].range;
+            node = nodes[node].left;
+        }
+        else
+            node = nodes[node].right;
+    }
+    return found;
+}
+
+/**
+ * @brief    Folded bytes of the ranges that start at or before va.
+ */
+duint CodeFoldingHelper::FoldedRanges::sumStartAtMost(duint va) const
+{
+    duint result = 0;
+    for(int node = top; node != -1;)
+    {
+        const Node & current = nodes[node];
+        if(current.range.first <= va)
+        {
+            result += sum(current.left) + current.range.second - current.range.first;
+            node = current.right;
+        }
+        else
+            node = current.left;
+    }
+    return result;
+}
+
+/**
+ * @brief    Folded bytes of the ranges that end before va.
+ */
+duint CodeFoldingHelper::FoldedRanges::sumEndBefore(duint va) const
+{
+    duint result = 0;
+    for(int node = top; node != -1;)
+    {
+        const Node & current = nodes[node];
+        if(current.range.second < va)
+        {
+            result += sum(current.left) + current.range.second - current.range.first;
+            node = current.right;
+        }
+        else
+            node = current.left;
+    }
+    return result;
+}
+
+/**
+ * @brief    Lowest address whose offset with the folded bytes removed is offset.
+ */
+duint CodeFoldingHelper::FoldedRanges::toAddress(duint offset) const
+{
+    duint hidden = 0;
+    for(int node = top; node != -1;)
+    {
+        const Node & current = nodes[node];
+        duint hiddenBefore = hidden + sum(current.left);
+        if(offset <= current.range.first - hiddenBefore)
+            node = current.left;
+        else
+        {
+            hidden = hiddenBefore + current.range.second - current.range.first;
+            node = current.right;
+        }
+    }
+    return offset + hidden;
+}
+
+duint CodeFoldingHelper::FoldedRanges::sum(int node) const
+{
+    return node == -1 ? 0 : nodes[node].sum;
+}
+
+void CodeFoldingHelper::FoldedRanges::update(int node)
+{
+    Node & current = nodes[node];
+    current.sum = sum(current.left) + current.range.second - current.range.first + sum(current.right);
+}
+
+void CodeFoldingHelper::FoldedRanges::split(int node, duint start, int & left, int & right)
+{
+    if(node == -1)
+    {
+        left = right = -1;
+        return;
+    }
+    if(nodes[node].range.first < start)
+    {
+        split(nodes[node].right, start, nodes[node].right, right);
+        left = node;
+    }
+    else
+    {
+        split(nodes[node].left, start, left, nodes[node].left);
+        right = node;
+    }
+    update(node);
+}
+
+int CodeFoldingHelper::FoldedRanges::merge(int left, int right)
+{
+    if(left == -1)
+        return right;
+    if(right == -1)
+        return left;
+    if(nodes[left].priority > nodes[right].priority)
+    {
+        nodes[left].right = merge(nodes[left].right, right);
+        update(left);
+        return left;
+    }
+    nodes[right].left = merge(left, nodes[right].left);
+    update(right);
+    return right;
+}
+
+void CodeFoldingHelper::FoldedRanges::release(int node)
+{
+    if(node == -1)
+        return;
+    release(nodes[node].left);
+    release(nodes[node].right);
+    freeNodes.push_back(node);
+}
@@ -2,6 +2,7 @@
 #define CODEFOLDING_H
 #include "Imports.h"
 #include <map>
+#include <vector>
 
 class CodeFoldingHelper
 {
@@ -17,10 +18,13 @@ public:
     duint getFoldBegin(duint va) const;
     duint getFoldEnd(duint va) const;
     duint getFoldedSize(duint vaStart, duint vaEnd) const;
+    duint getVisualOffset(duint va) const;
+    duint getAddressFromVisual(duint offset) const;
     void setFolded(duint va, bool folded);
     bool addFoldSegment(duint va, duint length, bool folded = true);
     bool delFoldSegment(duint va);
     void expandFoldSegment(duint va);
+    bool syncDatabase();
 
 protected:
     typedef std::pair<duint, duint> Range;
@@ -38,13 +42,59 @@ protected:
         std::map<Range, FoldTree, CompareFunc> children;
     };
 
+    /**
+     * @brief Treap of the disjoint ranges that are hidden, the folded segments without a folded parent.
+     *        Every node keeps the folded bytes of its subtree, so the prefix sums needed by the folded
+     *        size and visual offset queries are a single descent.
+     */
+    class FoldedRanges
+    {
+    public:
+        FoldedRanges();
+        void clear();
+        void insert(const Range & range);
+        void erase(duint start, duint end);
+        const Range* find(duint va) const;
+        const Range* findAfter(duint va) const;
+        duint sumStartAtMost(duint va) const;
+        duint sumEndBefore(duint va) const;
+        duint toAddress(duint offset) const;
+
+    private:
+        struct Node
+        {
+            Range range;
+            duint sum;
+            unsigned int priority;
+            int left;
+            int right;
+        };
+        std::vector<Node> nodes;
+        std::vector<int> freeNodes;
+        int top;
+        unsigned int seed;
+
+        duint sum(int node) const;
+        void update(int node);
+        void split(int node, duint start, int & left, int & right);
+        int merge(int left, int right);
+        void release(int node);
+    };
+
     std::map<Range, FoldTree, CompareFunc> root;
+    FoldedRanges foldedRanges;
+    duint generation;
 
     const FoldTree* getFoldTree(duint va) const;
     FoldTree* getFoldTree(duint va);
+    FoldTree* getFoldTree(duint va, bool & parentFolded);
     const FoldTree* getFirstFoldedTree(duint va) const;
     FoldTree* getFirstFoldedTree(duint va);
-    duint getFoldedSize(const FoldTree* node) const;
+    bool insertFoldSegment(duint va, duint length, bool folded);
+    void addFoldedRanges(const FoldTree* node);
+    void delFoldSegments(const FoldTree* node);
+    void storeFold(const FoldTree* node);
+    void updateGeneration();
 };
 
 #endif // CODEFOLDING_H
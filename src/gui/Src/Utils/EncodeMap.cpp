@@ -4,26 +4,21 @@ EncodeMap::EncodeMap(QObject* parent)
     : QObject(parent),
       mBase(0),
       mSize(0),
-      mBuffer(nullptr),
-      mBufferSize(0)
+      mCacheBase(0)
 {
 }
 
 EncodeMap::~EncodeMap()
 {
-    if(mBuffer)
-        DbgReleaseEncodeTypeBuffer(mBuffer);
 }
 
+// The types are kept as runs in the debugger, only a window around the painted addresses is copied
 void EncodeMap::setMemoryRegion(duint addr)
 {
     mBase = DbgMemFindBaseAddr(addr, &mSize);
     if(!mBase)
-        return;
-
-    if(mBuffer)
-        DbgReleaseEncodeTypeBuffer(mBuffer);
-    mBuffer = (byte*)DbgGetEncodeTypeBuffer(addr, &mBufferSize);
+        mSize = 0;
+    invalidate();
 }
 
 void EncodeMap::setDataType(duint va, ENCODETYPE type)
@@ -34,39 +29,59 @@ void EncodeMap::setDataType(duint va, ENCODETYPE type)
 void EncodeMap::setDataType(duint va, duint size, ENCODETYPE type)
 {
     DbgSetEncodeType(va, size, type);
-    if(!mBuffer && va >= mBase && va < mBase + mSize)
-        setMemoryRegion(va);
+    invalidate();
 }
 
 void EncodeMap::delRange(duint start, duint size)
 {
     DbgDelEncodeTypeRange(start, size);
+    invalidate();
 }
 
 void EncodeMap::delSegment(duint va)
 {
     DbgDelEncodeTypeSegment(va);
-    if(mBuffer && va >= mBase && va < mBase + mSize)
-    {
-        mBuffer = nullptr;
-        DbgReleaseEncodeTypeBuffer(mBuffer);
-    }
+    invalidate();
+}
+
+void EncodeMap::invalidate()
+{
+    mCache.clear();
+}
+
+bool EncodeMap::cacheTypes(duint addr)
+{
+    if(!inMemoryRegion(addr))
+        return false;
+    if(addr - mCacheBase < mCache.size())
+        return true;
+
+    // a page before and after as well, disassembling backwards and scrolling stay in the window
+    const duint page = 0x1000;
+    auto start = addr & ~(page - 1);
+    start = start >= mBase + page ? start - page : mBase;
+    auto end = mBase + mSize;
+    auto size = end - start > 3 * page ? 3 * page : end - start;
+    mCache.resize(size);
+    mCacheBase = start;
+    DbgFunctions()->GetEncodeTypes(start, size, mCache.data());
+    return true;
 }
 
 ENCODETYPE EncodeMap::getDataType(duint addr)
 {
-    if(!mBuffer || !inBufferRange(addr))
+    if(!cacheTypes(addr))
         return enc_unknown;
 
-    return ENCODETYPE(mBuffer[addr - mBase]);
+    return ENCODETYPE(mCache[addr - mCacheBase]);
 }
 
 duint EncodeMap::getDataSize(duint addr, duint codesize)
 {
-    if(!mBuffer || !inBufferRange(addr))
+    if(!cacheTypes(addr))
         return codesize;
 
-    auto type = ENCODETYPE(mBuffer[addr - mBase]);
+    auto type = ENCODETYPE(mCache[addr - mCacheBase]);
 
     auto datasize = getEncodeTypeSize(type);
     if(isCode(type))
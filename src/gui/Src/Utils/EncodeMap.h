@@ -2,6 +2,7 @@
 #define ENCODEMAP_H
 
 #include <QObject>
+#include <vector>
 #include "Imports.h"
 
 class EncodeMap : public QObject
@@ -18,6 +19,7 @@ public:
     void setDataType(duint va, duint size, ENCODETYPE type);
     void delRange(duint start, duint size);
     void delSegment(duint va);
+    void invalidate();
 
     static duint getEncodeTypeSize(ENCODETYPE type)
     {
@@ -72,16 +74,19 @@ public:
         }
     }
 
-    bool inBufferRange(duint addr) const
+    bool inMemoryRegion(duint addr) const
     {
-        return addr >= mBase && addr < mBase + mBufferSize;
+        return addr >= mBase && addr < mBase + mSize;
     }
 
 protected:
+    bool cacheTypes(duint addr);
+
     duint mBase;
     duint mSize;
-    byte* mBuffer;
-    duint mBufferSize;
+    // types of a window around the addresses painted last, fetched in a single call instead of one per byte
+    duint mCacheBase;
+    std::vector<unsigned char> mCache;
 };
 
 #endif // ENCODEMAP_H
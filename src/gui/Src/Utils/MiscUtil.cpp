@@ -3,10 +3,12 @@
 #include <QApplication>
 #include <QMessageBox>
 #include <QDir>
+#include <QProgressDialog>
 #include "LineEditDialog.h"
 #include "ComboBoxDialog.h"
 #include "StringUtil.h"
 #include "BrowseDialog.h"
+#include "TableExportThread.h"
 
 void SetApplicationIcon(WId winId)
 {
@@ -169,119 +171,36 @@ QIcon getFileIcon(QString file)
     return result;
 }
 
-bool ExportCSV(dsint rows, dsint columns, std::vector<QString> headers, std::function<QString(dsint, dsint)> getCellContent)
+bool ExportTable(QWidget* parent, dsint rows, dsint columns, std::vector<QString> headers, std::function<QString(dsint, dsint)> getCellContent)
 {
-    BrowseDialog browse(nullptr, QApplication::translate("ExportCSV", "Export data in CSV format"), QApplication::translate("ExportCSV", "Enter the CSV file name to export"), QApplication::translate("ExportCSV", "CSV files (*.csv);;All files (*.*)"), QApplication::applicationDirPath() + QDir::separator() + "db", true);
+    BrowseDialog browse(parent, QApplication::translate("ExportTable", "Export table"), QApplication::translate("ExportTable", "Enter the file name to export"), QApplication::translate("ExportTable", "CSV files (*.csv);;TSV files (*.tsv);;JSON files (*.json);;All files (*.*)"), QApplication::applicationDirPath() + QDir::separator() + "db", true);
     browse.setWindowIcon(DIcon("database-export.png"));
-    if(browse.exec() == QDialog::Accepted)
+    if(browse.exec() != QDialog::Accepted)
+        return false;
+    duint setting;
+    bool utf16 = BridgeSettingGetUint("Misc", "Utf16LogRedirect", &setting) && setting;
+    auto thread = new TableExportThread(browse.path, TableExportThread::formatFromFileName(browse.path), utf16, rows, columns, headers, getCellContent, parent);
+    auto progress = new QProgressDialog(QApplication::translate("ExportTable", "Exporting %1...").arg(browse.path), QApplication::translate("ExportTable", "Cancel"), 0, 100, parent);
+    progress->setWindowTitle(QApplication::translate("ExportTable", "Export table"));
+    progress->setWindowIcon(DIcon("database-export.png"));
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+    QObject::connect(thread, SIGNAL(progress(int)), progress, SLOT(setValue(int)));
+    QObject::connect(progress, &QProgressDialog::canceled, thread, &TableExportThread::cancel);
+    QObject::connect(thread, &QThread::finished, progress, [thread, progress]()
     {
-        FILE* csv;
-        bool utf16;
-        csv = _wfopen(browse.path.toStdWString().c_str(), L"wb");
-        if(csv == NULL)
-        {
-            GuiAddLogMessage(QApplication::translate("ExportCSV", "CSV export error\n").toUtf8().constData());
-            return false;
-        }
+        if(thread->succeeded())
+            GuiAddLogMessage(QApplication::translate("ExportTable", "Saved table at %1\n").arg(thread->fileName()).toUtf8().constData());
+        else if(thread->isCanceled())
+            GuiAddLogMessage(QApplication::translate("ExportTable", "Table export canceled\n").toUtf8().constData());
         else
-        {
-            duint setting;
-            if(BridgeSettingGetUint("Misc", "Utf16LogRedirect", &setting))
-                utf16 = !!setting;
-            else
-                utf16 = false;
-            if(utf16 && ftell(csv) == 0)
-            {
-                unsigned short BOM = 0xfeff;
-                fwrite(&BOM, 2, 1, csv);
-            }
-            dsint row, column;
-            QString text;
-            QString cell;
-            if(headers.size() > 0)
-            {
-                for(column = 0; column < columns; column++)
-                {
-                    cell = headers.at(column);
-                    if(cell.contains('"') || cell.contains(',') || cell.contains('\r') || cell.contains('\n'))
-                    {
-                        if(cell.contains('"'))
-                            cell = cell.replace("\"", "\"\"");
-                        cell = "\"" + cell + "\"";
-                    }
-                    if(column != columns - 1)
-                        cell = cell + ",";
-                    text = text + cell;
-                }
-                if(utf16)
-                {
-                    text = text + "\r\n";
-                    if(!fwrite(text.utf16(), text.length(), 2, csv))
-                    {
-                        fclose(csv);
-                        GuiAddLogMessage(QApplication::translate("ExportCSV", "CSV export error\n").toUtf8().constData());
-                        return false;
-                    }
-                }
-                else
-                {
-                    text = text + "\n";
-                    QByteArray utf8;
-                    utf8 = text.toUtf8();
-                    if(!fwrite(utf8.constData(), utf8.size(), 1, csv))
-                    {
-                        fclose(csv);
-                        GuiAddLogMessage(QApplication::translate("ExportCSV", "CSV export error\n").toUtf8().constData());
-                        return false;
-                    }
-                }
-            }
-            for(row = 0; row < rows; row++)
-            {
-                text.clear();
-                for(column = 0; column < columns; column++)
-                {
-                    cell = getCellContent(row, column);
-                    if(cell.contains('"') || cell.contains(',') || cell.contains('\r') || cell.contains('\n'))
-                    {
-                        if(cell.contains('"'))
-                            cell = cell.replace("\"", "\"\"");
-                        cell = "\"" + cell + "\"";
-                    }
-                    if(column != columns - 1)
-                        cell = cell + ",";
-                    text = text + cell;
-                }
-                if(utf16)
-                {
-                    text = text + "\r\n";
-                    if(!fwrite(text.utf16(), text.length(), 2, csv))
-                    {
-                        fclose(csv);
-                        GuiAddLogMessage(QApplication::translate("ExportCSV", "CSV export error\n").toUtf8().constData());
-                        return false;
-                    }
-                }
-                else
-                {
-                    text = text + "\n";
-                    QByteArray utf8;
-                    utf8 = text.toUtf8();
-                    if(!fwrite(utf8.constData(), utf8.size(), 1, csv))
-                    {
-                        fclose(csv);
-                        GuiAddLogMessage(QApplication::translate("ExportCSV", "CSV export error\n").toUtf8().constData());
-                        return false;
-                    }
-                }
-            }
-            fclose(csv);
-            GuiAddLogMessage(QApplication::translate("ExportCSV", "Saved CSV data at %1\n").arg(browse.path).toUtf8().constData());
-            return true;
-        }
-    }
-    else
-        return false;
+            GuiAddLogMessage(QApplication::translate("ExportTable", "Table export error\n").toUtf8().constData());
+        progress->deleteLater();
+        thread->deleteLater();
+    });
+    thread->start();
+    return true;
 }
 
 static bool allowSeasons()
@@ -0,0 +1,212 @@
+#include "TableExportThread.h"
+#include <QFile>
+#include <algorithm>
+
+static const dsint ChunkRows = 4096;
+
+TableExportThread::TableExportThread(const QString & fileName, Format format, bool utf16, dsint rows, dsint columns, const std::vector<QString> & headers, EXPORTCELLCB getCellContent, QObject* parent)
+    : QThread(parent),
+      mFileName(fileName),
+      mFormat(format),
+      mUtf16(utf16 && format != Json),
+      mRows(rows),
+      mColumns(columns),
+      mHeaders(headers),
+      mGetCellContent(getCellContent),
+      mCancel(false),
+      mDone(false),
+      mSucceeded(false),
+      mHasChunk(false)
+{
+    mHeaders.resize(columns);
+    connect(this, SIGNAL(fetchRowsRequest(dsint, dsint)), this, SLOT(fetchRows(dsint, dsint)), Qt::QueuedConnection);
+}
+
+TableExportThread::~TableExportThread()
+{
+    cancel();
+    wait();
+}
+
+TableExportThread::Format TableExportThread::formatFromFileName(const QString & fileName)
+{
+    if(fileName.endsWith(".tsv", Qt::CaseInsensitive))
+        return Tsv;
+    if(fileName.endsWith(".json", Qt::CaseInsensitive))
+        return Json;
+    return Csv;
+}
+
+void TableExportThread::cancel()
+{
+    QMutexLocker lock(&mChunkMutex);
+    mCancel = true;
+    mChunkReady.wakeAll();
+}
+
+bool TableExportThread::isCanceled() const
+{
+    return mCancel;
+}
+
+bool TableExportThread::succeeded() const
+{
+    return mSucceeded;
+}
+
+const QString & TableExportThread::fileName() const
+{
+    return mFileName;
+}
+
+// Runs on the GUI thread
+void TableExportThread::fetchRows(dsint first, dsint count)
+{
+    if(mDone)
+        return;
+    std::vector<QString> cells;
+    cells.reserve(count * mColumns);
+    for(dsint row = first; row < first + count && !mCancel; row++)
+        for(dsint column = 0; column < mColumns; column++)
+            cells.push_back(mGetCellContent(row, column));
+    QMutexLocker lock(&mChunkMutex);
+    mChunk.swap(cells);
+    mHasChunk = true;
+    mChunkReady.wakeAll();
+}
+
+static QString jsonString(const QString & str)
+{
+    QString result;
+    result.reserve(str.length() + 2);
+    result += '\"';
+    for(QChar ch : str)
+    {
+        switch(ch.unicode())
+        {
+        case '\"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        default:
+            if(ch.unicode() < 0x20)
+                result += QString("\\u%1").arg(ch.unicode(), 4, 16, QChar('0'));
+            else
+                result += ch;
+            break;
+        }
+    }
+    result += '\"';
+    return result;
+}
+
+void TableExportThread::appendRow(QString & text, const QString* cells, bool first)
+{
+    if(mFormat == Json)
+    {
+        text += first ? "\n{" : ",\n{";
+        for(dsint column = 0; column < mColumns; column++)
+        {
+            if(column)
+                text += ',';
+            text += jsonString(mHeaders[column]);
+            text += ':';
+            text += jsonString(cells[column]);
+        }
+        text += '}';
+        return;
+    }
+    for(dsint column = 0; column < mColumns; column++)
+    {
+        QString cell = cells[column];
+        if(mFormat == Tsv)
+        {
+            // TSV has no quoting, keep the row on one line
+            cell.replace('\t', ' ').replace('\r', ' ').replace('\n', ' ');
+            if(column)
+                text += '\t';
+        }
+        else
+        {
+            if(cell.contains('"') || cell.contains(',') || cell.contains('\r') || cell.contains('\n'))
+                cell = "\"" + cell.replace("\"", "\"\"") + "\"";
+            if(column)
+                text += ',';
+        }
+        text += cell;
+    }
+    text += mUtf16 ? "\r\n" : "\n";
+}
+
+void TableExportThread::run()
+{
+    QFile file(mFileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+    auto write = [this, &file](const QString & text)
+    {
+        if(mUtf16)
+            return file.write((const char*)text.utf16(), text.length() * 2) == text.length() * 2;
+        QByteArray utf8 = text.toUtf8();
+        return file.write(utf8) == utf8.size();
+    };
+
+    QString text;
+    if(mUtf16)
+        text += QChar(0xFEFF);
+    if(mFormat == Json)
+        text += '[';
+    else if(!mHeaders.empty())
+        appendRow(text, mHeaders.data(), true);
+    bool ok = write(text);
+
+    // The next chunk is read on the GUI thread while the current one is written
+    std::vector<QString> cells;
+    int lastProgress = -1;
+    if(mRows > 0)
+        emit fetchRowsRequest(0, std::min(ChunkRows, mRows));
+    for(dsint first = 0; ok && first < mRows; first += ChunkRows)
+    {
+        {
+            QMutexLocker lock(&mChunkMutex);
+            while(!mHasChunk && !mCancel)
+                mChunkReady.wait(&mChunkMutex);
+            if(mCancel)
+                break;
+            cells.swap(mChunk);
+            mHasChunk = false;
+        }
+        dsint next = first + ChunkRows;
+        if(next < mRows)
+            emit fetchRowsRequest(next, std::min(ChunkRows, mRows - next));
+        text.clear();
+        dsint count = dsint(cells.size()) / std::max(mColumns, dsint(1));
+        for(dsint row = 0; row < count; row++)
+            appendRow(text, cells.data() + row * mColumns, first + row == 0);
+        ok = write(text);
+        int percent = int((first + count) * 100 / mRows);
+        if(percent != lastProgress)
+        {
+            lastProgress = percent;
+            emit progress(percent);
+        }
+    }
+    if(ok && !mCancel && mFormat == Json)
+        ok = write("\n]\n");
+    file.close();
+    mDone = true;
+    mSucceeded = ok && !mCancel;
+    if(!mSucceeded)
+        file.remove();
+}
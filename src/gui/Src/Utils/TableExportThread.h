@@ -0,0 +1,65 @@
+#ifndef TABLEEXPORTTHREAD_H
+#define TABLEEXPORTTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <functional>
+#include <vector>
+#include "Imports.h"
+
+typedef std::function<QString(dsint row, dsint column)> EXPORTCELLCB;
+
+/**
+ * @brief Writes a table to a CSV, TSV or JSON file on a worker thread. The cells are read in chunks of rows
+ *        on the GUI thread (the table is not thread safe) while the previous chunk is written, so only one
+ *        chunk of text is in memory at a time.
+ */
+class TableExportThread : public QThread
+{
+    Q_OBJECT
+public:
+    enum Format
+    {
+        Csv,
+        Tsv,
+        Json
+    };
+
+    TableExportThread(const QString & fileName, Format format, bool utf16, dsint rows, dsint columns, const std::vector<QString> & headers, EXPORTCELLCB getCellContent, QObject* parent = nullptr);
+    ~TableExportThread();
+    static Format formatFromFileName(const QString & fileName);
+    void cancel();
+    bool isCanceled() const;
+    bool succeeded() const;
+    const QString & fileName() const;
+
+signals:
+    void progress(int percent);
+    void fetchRowsRequest(dsint first, dsint count);
+
+private slots:
+    void fetchRows(dsint first, dsint count);
+
+private:
+    QString mFileName;
+    Format mFormat;
+    bool mUtf16;
+    dsint mRows;
+    dsint mColumns;
+    std::vector<QString> mHeaders;
+    EXPORTCELLCB mGetCellContent;
+    volatile bool mCancel;
+    volatile bool mDone;
+    bool mSucceeded;
+
+    QMutex mChunkMutex;
+    QWaitCondition mChunkReady;
+    std::vector<QString> mChunk;
+    bool mHasChunk;
+
+    void run();
+    void appendRow(QString & text, const QString* cells, bool first);
+};
+
+#endif // TABLEEXPORTTHREAD_H
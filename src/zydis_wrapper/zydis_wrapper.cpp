@@ -121,6 +121,16 @@ bool Zydis::Disassemble(size_t addr, const unsigned char data[MAX_DISASM_BUFFER]
 }
 
 bool Zydis::Disassemble(size_t addr, const unsigned char* data, int size)
+{
+    return decode(addr, data, size, true);
+}
+
+bool Zydis::Decode(size_t addr, const unsigned char* data, int size)
+{
+    return decode(addr, data, size, false);
+}
+
+bool Zydis::decode(size_t addr, const unsigned char* data, int size, bool formatText)
 {
     if(!data || !size)
         return false;
@@ -132,11 +142,13 @@ bool Zydis::Disassemble(size_t addr, const unsigned char* data, int size)
         return false;
 
     // Format it to human readable representation.
-    if(!ZYDIS_SUCCESS(ZydisFormatterFormatInstruction(
-                          &mFormatter,
-                          const_cast<ZydisDecodedInstruction*>(&mInstr),
-                          mInstrText,
-                          sizeof(mInstrText))))
+    if(!formatText)
+        *mInstrText = '\0';
+    else if(!ZYDIS_SUCCESS(ZydisFormatterFormatInstruction(
+                               &mFormatter,
+                               const_cast<ZydisDecodedInstruction*>(&mInstr),
+                               mInstrText,
+                               sizeof(mInstrText))))
         return false;
 
     // Count explicit operands.
@@ -627,6 +639,11 @@ std::string Zydis::Mnemonic() const
     return ZydisMnemonicGetStringHook(mInstr.mnemonic);
 }
 
+const char* Zydis::MnemonicName(ZydisMnemonic mnemonic)
+{
+    return ZydisMnemonicGetStringHook(mnemonic);
+}
+
 const char* Zydis::MemSizeName(int size) const
 {
     switch(size)
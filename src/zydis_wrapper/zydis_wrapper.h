@@ -18,6 +18,8 @@ public:
     bool Disassemble(size_t addr, const unsigned char data[MAX_DISASM_BUFFER]);
     bool Disassemble(size_t addr, const unsigned char* data, int size);
     bool DisassembleSafe(size_t addr, const unsigned char* data, int size);
+    // Like Disassemble, but without formatting the instruction (InstructionText is empty)
+    bool Decode(size_t addr, const unsigned char* data, int size);
     const ZydisDecodedInstruction* GetInstr() const;
     bool Success() const;
     const char* RegName(ZydisRegister reg) const;
@@ -34,6 +36,7 @@ public:
     const ZydisDecodedOperand & operator[](int index) const;
     std::string Mnemonic() const;
     const char* MemSizeName(int size) const;
+    static const char* MnemonicName(ZydisMnemonic mnemonic);
     size_t BranchDestination() const;
     size_t ResolveOpValue(int opindex, const std::function<size_t(ZydisRegister)> & resolveReg) const;
     bool IsBranchGoingToExecute(size_t cflags, size_t ccx) const;
@@ -109,6 +112,8 @@ public:
     bool IsInt3() const { return IsBranchType(BTInt3); }
 
 private:
+    bool decode(size_t addr, const unsigned char* data, int size, bool formatText);
+
     static ZydisDecoder mDecoder;
     static ZydisFormatter mFormatter;
     static bool mInitialized;